@@ -0,0 +1,547 @@
+// AccuracyBenchmark.cpp : speed against accuracy of the mean shift speed-up levels
+//
+//===========================================================================
+// Segments a corpus with each mean shift mode and reports what the faster
+// modes cost in accuracy, measured against a reference mode (by default
+// the exact filter, NO_SPEEDUP), so that an operating point can be chosen
+// from data and a new filter engine validated against the same numbers.
+//
+// Usage:
+//   AccuracyBenchmark [options] [photo] ...
+//
+// A mode is a SpeedUpLevel, optionally with the speed threshold of the
+// HIGH_SPEEDUP filter: none, med, high or high:<threshold> (high alone
+// uses the processor default, 0.1). For every image and mode the report
+// gives the wall time of Segment(), the share of it spent in the filter,
+// the number of segments and, against the reference segmentation:
+//
+//   vi     variation of information (0 = same partition)
+//   ari    adjusted Rand index (1 = same partition)
+//   bf     boundary F-measure within --tolerance pixels
+//   iou    intersection over union of the salient object mask, the
+//          segments ChooseSalientSegments picks from the saliency map
+//
+// The corpus is the photos given plus --synthetic images from
+// MakeSyntheticImage; for those the report also compares each mode with
+// the generator's ground truth (truth_vi, truth_bf). The summary gives per
+// mode the total time, the speed-up over the reference and the mean and
+// worst of each measure.
+//===========================================================================
+
+#include "Saliency.h"
+#include "SaliencyPipeline.h"
+#include "RegionTable.h"
+#include "SegmentationCompare.h"
+#include "SyntheticImage.h"
+#include "BenchmarkPhoto.h"
+#include "MeanShiftCode/msImageProcessor.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <chrono>
+
+using namespace std;
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double ElapsedMs(const BenchClock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+//=================================================================================
+///	EvalMode
+//=================================================================================
+struct EvalMode
+{
+	string				name;
+	SpeedUpLevel		level;
+	float				threshold;		// < 0 for the processor default
+
+	EvalMode() : level(HIGH_SPEEDUP), threshold(-1) {}
+};
+
+//=================================================================================
+///	EvalImage
+//=================================================================================
+struct EvalImage
+{
+	string				name;
+	vector<UINT>		img;
+	int					width;
+	int					height;
+	vector<int>			truth;			// synthetic images only
+	int					truthLabels;
+
+	EvalImage() : width(0), height(0), truthLabels(0) {}
+};
+
+//=================================================================================
+///	EvalResult
+///
+///	One mode on one image.
+//=================================================================================
+struct EvalResult
+{
+	string					image;
+	string					mode;
+	int						width;
+	int						height;
+	double					ms;				// fastest of the runs
+	double					filterMs;
+	int						segments;
+	SegmentationAgreement	reference;
+	double					maskIoU;
+	bool					hasTruth;
+	SegmentationAgreement	truth;
+
+	EvalResult() : width(0), height(0), ms(0), filterMs(0), segments(0), maskIoU(1), hasTruth(false) {}
+};
+
+//=================================================================================
+///	BenchOptions
+//=================================================================================
+struct BenchOptions
+{
+	vector<EvalMode>	modes;			// the reference first
+	vector<string>		photos;
+	int					synthetic;
+	int					width;			// of the synthetic images
+	int					height;
+	int					regions;
+	double				noise;
+	double				texture;
+	int					tolerance;
+	int					repeat;
+	int					sigmaS;
+	float				sigmaR;
+	int					minRegion;
+	double				salientFactor;
+	string				format;			// text, json or csv
+	string				output;			// file, empty for stdout
+
+	BenchOptions() : synthetic(-1), width(320), height(240), regions(24), noise(8), texture(0.25), tolerance(2),
+		repeat(1), sigmaS(7), sigmaR(10), minRegion(20), salientFactor(2.0), format("text") {}
+};
+
+//=================================================================================
+///	PrintUsage
+//=================================================================================
+static void PrintUsage(const char* prog)
+{
+	cerr << "Usage: " << prog << " [options] [photo] ...\n"
+		 << "Options:\n"
+		 << "  --modes <list>     comma separated modes: none, med, high, high:<threshold>\n"
+		 << "                     (default none,med,high,high:0.25,high:0.5)\n"
+		 << "  --reference <mode> mode the others are compared with (default none)\n"
+		 << "  --synthetic <n>    synthetic images in the corpus (default 2 without photos, else 0)\n"
+		 << "  --size <WxH>       size of the synthetic images (default 320x240)\n"
+		 << "  --regions <n> --noise <sigma> --texture <0..1>  synthetic content (24, 8, 0.25)\n"
+		 << "  --tolerance <px>   boundary match distance (default 2)\n"
+		 << "  --repeat <n>       timed runs per mode and image, fastest kept (default 1)\n"
+		 << "  -s <sigmaS> -r <sigmaR> -m <minRegion>  mean shift settings (7, 10, 20)\n"
+		 << "  -f <factor>        salient segment factor (default 2.0)\n"
+		 << "  --format <text|json|csv>  report format (default text)\n"
+		 << "  -o <file>          write the report to file instead of stdout\n"
+#ifdef SRD_HAVE_OPENCV
+		 << "Photos may be in any format OpenCV reads, e.g. the dataSource folder.\n";
+#else
+		 << "Photos must be binary PPM files (built without OpenCV).\n";
+#endif
+}
+
+//=================================================================================
+///	SplitList
+//=================================================================================
+static vector<string> SplitList(const string& text)
+{
+	vector<string> items;
+	stringstream ss(text);
+	string item;
+	while( getline(ss, item, ',') )
+	{
+		if( !item.empty() ) items.push_back(item);
+	}
+	return items;
+}
+
+//=================================================================================
+///	ParseMode
+//=================================================================================
+static bool ParseMode(const string& text, EvalMode& mode)
+{
+	mode = EvalMode();
+	mode.name = text;
+	string level = text.substr(0, text.find(':'));
+	if( level == "none" )		mode.level = NO_SPEEDUP;
+	else if( level == "med" )	mode.level = MED_SPEEDUP;
+	else if( level == "high" )	mode.level = HIGH_SPEEDUP;
+	else return false;
+
+	if( level.size() < text.size() )
+	{
+		if( mode.level != HIGH_SPEEDUP ) return false;
+		char* end(NULL);
+		mode.threshold = (float)strtod(text.c_str() + level.size() + 1, &end);
+		if( *end || mode.threshold < 0 ) return false;
+	}
+	return true;
+}
+
+//=================================================================================
+///	SegmentMode
+///
+///	Segments with one mode and returns the labels and the object mask.
+//=================================================================================
+static void SegmentMode(
+	const BenchOptions&			opt,
+	const EvalMode&				mode,
+	const EvalImage&			image,
+	const vector<double>&		lvec,
+	const vector<double>&		avec,
+	const vector<double>&		bvec,
+	const vector<double>&		salmap,
+	EvalResult&					result,
+	vector<int>&				labels,
+	vector<bool>&				mask)
+{
+	const int sz = image.width*image.height;
+	for( int run = 0; run < opt.repeat; run++ )
+	{
+		msImageProcessor mss;
+		mss.DefineLabImage(&lvec[0], &avec[0], &bvec[0], image.height, image.width);
+		if( mode.threshold >= 0 ) mss.SetSpeedThreshold(mode.threshold);
+		mss.ResetTimingReport();
+		BenchClock::time_point start = BenchClock::now();
+		mss.Segment(opt.sigmaS, opt.sigmaR, opt.minRegion, mode.level);
+		double ms = ElapsedMs(start);
+
+		if( run && ms >= result.ms ) continue;
+		result.ms		= ms;
+		result.filterMs	= 0;
+		msKernelTiming report[MS_TIMING_KERNELS];
+		int count = mss.GetTimingReport(report, MS_TIMING_KERNELS);
+		for( int i = 0; i < count; i++ )
+		{
+			if( strstr(report[i].kernel, "Filter") ) result.filterMs += report[i].ms;
+		}
+		if( run ) continue;
+
+		const int* p_labels = mss.GetLabelsView();
+		result.segments = mss.GetRegionCount();
+		labels.assign(p_labels, p_labels + sz);
+	}
+
+	RegionTable regions;
+	regions.Build(&labels[0], image.width, image.height, result.segments, &salmap[0]);
+	vector<bool> segtochoose(0);
+	SaliencyPipeline::ChooseSalientSegments(regions, segtochoose, opt.salientFactor);
+	mask.resize(sz);
+	for( int i = 0; i < sz; i++ ) mask[i] = segtochoose[labels[i]];
+}
+
+//=================================================================================
+///	EvaluateImage
+//=================================================================================
+static void EvaluateImage(const BenchOptions& opt, const EvalImage& image, vector<EvalResult>& results)
+{
+	Saliency sal;
+	vector<double> lvec, avec, bvec, salmap;
+	sal.RGB2LAB(image.img, lvec, avec, bvec);
+	sal.GetSaliencyMap(lvec, avec, bvec, image.width, image.height, salmap, true);
+
+	vector<int> refLabels;
+	vector<bool> refMask;
+	int refSegments(0);
+	for( size_t m = 0; m < opt.modes.size(); m++ )
+	{
+		cerr << image.name << " " << opt.modes[m].name << " ..." << endl;
+		EvalResult r;
+		r.image		= image.name;
+		r.mode		= opt.modes[m].name;
+		r.width		= image.width;
+		r.height	= image.height;
+		vector<int> labels;
+		vector<bool> mask;
+		SegmentMode(opt, opt.modes[m], image, lvec, avec, bvec, salmap, r, labels, mask);
+
+		if( 0 == m )
+		{
+			refLabels.swap(labels);
+			refMask.swap(mask);
+			refSegments = r.segments;
+		}
+		else
+		{
+			CompareSegmentations(&labels[0], r.segments, &refLabels[0], refSegments,
+				image.width, image.height, opt.tolerance, r.reference);
+			r.maskIoU = MaskIoU(mask, refMask);
+		}
+		if( !image.truth.empty() )
+		{
+			const vector<int>& own = m ? labels : refLabels;
+			r.hasTruth = true;
+			CompareSegmentations(&own[0], r.segments, &image.truth[0], image.truthLabels,
+				image.width, image.height, opt.tolerance, r.truth);
+		}
+		results.push_back(r);
+	}
+}
+
+//=================================================================================
+///	ModeSummary
+//=================================================================================
+struct ModeSummary
+{
+	string				mode;
+	int					images;
+	int					truthImages;
+	double				ms;				// summed over the images
+	double				speedup;		// reference time over this time
+	double				vi, worstVi;
+	double				ari, worstAri;
+	double				bf, worstBf;
+	double				iou, worstIou;
+	double				truthVi;
+	double				truthBf;
+
+	ModeSummary() : images(0), truthImages(0), ms(0), speedup(0), vi(0), worstVi(0), ari(0), worstAri(1),
+		bf(0), worstBf(1), iou(0), worstIou(1), truthVi(0), truthBf(0) {}
+};
+
+static vector<ModeSummary> Summarize(const BenchOptions& opt, const vector<EvalResult>& results)
+{
+	vector<ModeSummary> summary(opt.modes.size());
+	for( size_t m = 0; m < opt.modes.size(); m++ )
+	{
+		ModeSummary& s = summary[m];
+		s.mode = opt.modes[m].name;
+		for( size_t i = 0; i < results.size(); i++ )
+		{
+			const EvalResult& r = results[i];
+			if( r.mode != s.mode ) continue;
+			s.images++;
+			s.ms		+= r.ms;
+			s.vi		+= r.reference.vi;
+			s.ari		+= r.reference.adjustedRand;
+			s.bf		+= r.reference.boundaryF;
+			s.iou		+= r.maskIoU;
+			s.worstVi	= max(s.worstVi, r.reference.vi);
+			s.worstAri	= min(s.worstAri, r.reference.adjustedRand);
+			s.worstBf	= min(s.worstBf, r.reference.boundaryF);
+			s.worstIou	= min(s.worstIou, r.maskIoU);
+			if( r.hasTruth )
+			{
+				s.truthImages++;
+				s.truthVi += r.truth.vi;
+				s.truthBf += r.truth.boundaryF;
+			}
+		}
+		if( s.images )
+		{
+			s.vi /= s.images;	s.ari /= s.images;	s.bf /= s.images;	s.iou /= s.images;
+		}
+		if( s.truthImages )
+		{
+			s.truthVi /= s.truthImages;
+			s.truthBf /= s.truthImages;
+		}
+	}
+	for( size_t m = 0; m < summary.size(); m++ )
+	{
+		summary[m].speedup = summary[m].ms > 0 ? summary[0].ms/summary[m].ms : 0;
+	}
+	return summary;
+}
+
+//=================================================================================
+///	WriteReport
+//=================================================================================
+static void WriteReport(const BenchOptions& opt, const vector<EvalResult>& results, FILE* out)
+{
+	char stamp[32];
+	time_t now = time(NULL);
+	strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+	vector<ModeSummary> summary = Summarize(opt, results);
+
+	if( opt.format == "json" )
+	{
+		fprintf(out, "{\n  \"benchmark\": \"accuracy\",\n  \"time\": \"%s\",\n  \"reference\": \"%s\",\n"
+			"  \"repeat\": %d,\n  \"tolerance\": %d,\n  \"sigmaS\": %d,\n  \"sigmaR\": %g,\n  \"minRegion\": %d,\n"
+			"  \"results\": [\n",
+			stamp, opt.modes[0].name.c_str(), opt.repeat, opt.tolerance, opt.sigmaS, opt.sigmaR, opt.minRegion);
+		for( size_t i = 0; i < results.size(); i++ )
+		{
+			const EvalResult& r = results[i];
+			fprintf(out, "    {\"image\": \"%s\", \"mode\": \"%s\", \"width\": %d, \"height\": %d, \"ms\": %.3f, "
+				"\"filter_ms\": %.3f, \"segments\": %d, \"vi\": %.4f, \"rand\": %.4f, \"ari\": %.4f, "
+				"\"boundary_precision\": %.4f, \"boundary_recall\": %.4f, \"bf\": %.4f, \"iou\": %.4f",
+				r.image.c_str(), r.mode.c_str(), r.width, r.height, r.ms, r.filterMs, r.segments,
+				r.reference.vi, r.reference.rand, r.reference.adjustedRand,
+				r.reference.boundaryPrecision, r.reference.boundaryRecall, r.reference.boundaryF, r.maskIoU);
+			if( r.hasTruth ) fprintf(out, ", \"truth_vi\": %.4f, \"truth_bf\": %.4f", r.truth.vi, r.truth.boundaryF);
+			fprintf(out, "}%s\n", i + 1 < results.size() ? "," : "");
+		}
+		fprintf(out, "  ],\n  \"summary\": [\n");
+		for( size_t m = 0; m < summary.size(); m++ )
+		{
+			const ModeSummary& s = summary[m];
+			fprintf(out, "    {\"mode\": \"%s\", \"images\": %d, \"ms\": %.3f, \"speedup\": %.3f, "
+				"\"vi\": %.4f, \"worst_vi\": %.4f, \"ari\": %.4f, \"worst_ari\": %.4f, \"bf\": %.4f, \"worst_bf\": %.4f, "
+				"\"iou\": %.4f, \"worst_iou\": %.4f",
+				s.mode.c_str(), s.images, s.ms, s.speedup, s.vi, s.worstVi, s.ari, s.worstAri, s.bf, s.worstBf,
+				s.iou, s.worstIou);
+			if( s.truthImages ) fprintf(out, ", \"truth_vi\": %.4f, \"truth_bf\": %.4f", s.truthVi, s.truthBf);
+			fprintf(out, "}%s\n", m + 1 < summary.size() ? "," : "");
+		}
+		fprintf(out, "  ]\n}\n");
+	}
+	else if( opt.format == "csv" )
+	{
+		fprintf(out, "time,image,mode,width,height,ms,filter_ms,segments,vi,rand,ari,boundary_precision,boundary_recall,bf,iou,truth_vi,truth_bf\n");
+		for( size_t i = 0; i < results.size(); i++ )
+		{
+			const EvalResult& r = results[i];
+			fprintf(out, "%s,%s,%s,%d,%d,%.3f,%.3f,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,",
+				stamp, r.image.c_str(), r.mode.c_str(), r.width, r.height, r.ms, r.filterMs, r.segments,
+				r.reference.vi, r.reference.rand, r.reference.adjustedRand,
+				r.reference.boundaryPrecision, r.reference.boundaryRecall, r.reference.boundaryF, r.maskIoU);
+			if( r.hasTruth )	fprintf(out, "%.4f,%.4f\n", r.truth.vi, r.truth.boundaryF);
+			else				fprintf(out, ",\n");
+		}
+	}
+	else
+	{
+		fprintf(out, "%-20s %-10s %10s %10s %8s %7s %7s %7s %7s %9s %9s\n",
+			"image", "mode", "ms", "filter_ms", "segments", "vi", "ari", "bf", "iou", "truth_vi", "truth_bf");
+		for( size_t i = 0; i < results.size(); i++ )
+		{
+			const EvalResult& r = results[i];
+			char truthVi[16] = "-", truthBf[16] = "-";
+			if( r.hasTruth )
+			{
+				sprintf(truthVi, "%.3f", r.truth.vi);
+				sprintf(truthBf, "%.3f", r.truth.boundaryF);
+			}
+			fprintf(out, "%-20s %-10s %10.1f %10.1f %8d %7.3f %7.3f %7.3f %7.3f %9s %9s\n",
+				r.image.c_str(), r.mode.c_str(), r.ms, r.filterMs, r.segments, r.reference.vi,
+				r.reference.adjustedRand, r.reference.boundaryF, r.maskIoU, truthVi, truthBf);
+		}
+		fprintf(out, "\nAgainst %s (mean / worst over the corpus):\n", opt.modes[0].name.c_str());
+		fprintf(out, "%-10s %12s %8s %15s %15s %15s %15s\n", "mode", "total_ms", "speedup", "vi", "ari", "bf", "iou");
+		for( size_t m = 0; m < summary.size(); m++ )
+		{
+			const ModeSummary& s = summary[m];
+			fprintf(out, "%-10s %12.1f %7.2fx %7.3f/%-7.3f %7.3f/%-7.3f %7.3f/%-7.3f %7.3f/%.3f\n",
+				s.mode.c_str(), s.ms, s.speedup, s.vi, s.worstVi, s.ari, s.worstAri, s.bf, s.worstBf, s.iou, s.worstIou);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions opt;
+	string modes = "none,med,high,high:0.25,high:0.5";
+	string reference = "none";
+
+	for( int a = 1; a < argc; a++ )
+	{
+		string arg(argv[a]);
+		bool hasvalue = a + 1 < argc;
+		if( arg == "--modes" && hasvalue )				modes = argv[++a];
+		else if( arg == "--reference" && hasvalue )		reference = argv[++a];
+		else if( arg == "--synthetic" && hasvalue )		opt.synthetic = atoi(argv[++a]);
+		else if( arg == "--size" && hasvalue )
+		{
+			if( 2 != sscanf(argv[++a], "%dx%d", &opt.width, &opt.height) ) opt.width = 0;
+		}
+		else if( arg == "--regions" && hasvalue )		opt.regions = atoi(argv[++a]);
+		else if( arg == "--noise" && hasvalue )			opt.noise = atof(argv[++a]);
+		else if( arg == "--texture" && hasvalue )		opt.texture = atof(argv[++a]);
+		else if( arg == "--tolerance" && hasvalue )		opt.tolerance = atoi(argv[++a]);
+		else if( arg == "--repeat" && hasvalue )		opt.repeat = atoi(argv[++a]);
+		else if( arg == "--format" && hasvalue )		opt.format = argv[++a];
+		else if( arg == "-o" && hasvalue )				opt.output = argv[++a];
+		else if( arg == "-s" && hasvalue )				opt.sigmaS = atoi(argv[++a]);
+		else if( arg == "-r" && hasvalue )				opt.sigmaR = (float)atof(argv[++a]);
+		else if( arg == "-m" && hasvalue )				opt.minRegion = atoi(argv[++a]);
+		else if( arg == "-f" && hasvalue )				opt.salientFactor = atof(argv[++a]);
+		else if( !arg.empty() && arg[0] == '-' )
+		{
+			cerr << "unknown or incomplete option " << arg << endl;
+			PrintUsage(argv[0]);
+			return 2;
+		}
+		else opt.photos.push_back(arg);
+	}
+	if( opt.synthetic < 0 ) opt.synthetic = opt.photos.empty() ? 2 : 0;
+	if( opt.repeat < 1 || opt.sigmaS <= 0 || opt.sigmaR <= 0 || opt.minRegion < 0 || opt.tolerance < 0 ||
+		opt.width < 2 || opt.height < 2 || opt.regions < 1 || opt.noise < 0 || opt.texture < 0 ||
+		(opt.format != "text" && opt.format != "json" && opt.format != "csv") )
+	{
+		PrintUsage(argv[0]);
+		return 2;
+	}
+
+	// the reference first, then the other modes in the order given
+	vector<string> modeList = SplitList(modes);
+	modeList.erase(remove(modeList.begin(), modeList.end(), reference), modeList.end());
+	modeList.insert(modeList.begin(), reference);
+	for( size_t i = 0; i < modeList.size(); i++ )
+	{
+		EvalMode mode;
+		if( !ParseMode(modeList[i], mode) )
+		{
+			cerr << "unknown mode " << modeList[i] << endl;
+			return 2;
+		}
+		opt.modes.push_back(mode);
+	}
+
+	vector<EvalResult> results;
+	for( int i = 0; i < opt.synthetic; i++ )
+	{
+		EvalImage image;
+		SyntheticSpec spec;
+		spec.width		= opt.width;
+		spec.height		= opt.height;
+		spec.regions	= opt.regions;
+		spec.noise		= opt.noise;
+		spec.texture	= opt.texture;
+		spec.seed		= unsigned(i + 1);
+		image.truthLabels = MakeSyntheticImage(spec, image.img, &image.truth);
+		image.width		= opt.width;
+		image.height	= opt.height;
+		char name[32];
+		sprintf(name, "synthetic%d", i + 1);
+		image.name = name;
+		EvaluateImage(opt, image, results);
+	}
+	for( size_t p = 0; p < opt.photos.size(); p++ )
+	{
+		EvalImage image;
+		image.name = BenchmarkPhotoName(opt.photos[p]);
+		if( !LoadBenchmarkPhoto(opt.photos[p], image.img, image.width, image.height) )
+		{
+			cerr << opt.photos[p] << ": cannot read image" << endl;
+			continue;
+		}
+		EvaluateImage(opt, image, results);
+	}
+
+	FILE* out = stdout;
+	if( !opt.output.empty() && NULL == (out = fopen(opt.output.c_str(), "w")) )
+	{
+		cerr << "cannot write " << opt.output << endl;
+		return 1;
+	}
+	WriteReport(opt, results, out);
+	if( out != stdout ) fclose(out);
+	return 0;
+}
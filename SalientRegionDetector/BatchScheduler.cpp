@@ -0,0 +1,251 @@
+// BatchScheduler.cpp: implementation of the BatchScheduler class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "BatchScheduler.h"
+#include "Trace.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <exception>
+#include <cstdio>
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+BatchScheduler::BatchScheduler(
+	const int&						workers,
+	const size_t&					memoryBudget,
+	const SaliencyParams&			params)
+	: m_workers(workers), m_budget(memoryBudget), m_params(params)
+{
+	if( m_workers <= 0 )
+	{
+		m_workers = int(thread::hardware_concurrency());
+		if( m_workers <= 0 ) m_workers = 1;
+	}
+}
+
+BatchScheduler::~BatchScheduler()
+{
+
+}
+
+//===========================================================================
+///	EstimatePeakBytes
+///
+/// Sum of the buffers alive at the peak of SaliencyPipeline::Process, per
+/// pixel:
+///		input image and Lab planes				4 + 3*8
+///		saliency map and its smoothed planes	8 + 4*8
+///		mean shift (input, filtered data, modes,
+///		labels, mode table, point list, scaled
+///		copy and bucket list of the filter)		12*4 + 4 + 1 + 4 + 5*4 + 4
+///		label copy, selection and output images	4 + 6*4
+///		region table pixel indices				4
+///		contour mask							1
+/// The region table adds a fixed amount per region, which is negligible.
+//===========================================================================
+size_t BatchScheduler::EstimatePeakBytes(
+	const int&						width,
+	const int&						height,
+	const SaliencyParams&			params)
+{
+	size_t sz = size_t(width)*size_t(height);
+	size_t perpixel = (4 + 3*8) + (8 + 4*8) + (12*4 + 4 + 1 + 4 + 5*4 + 4);
+	int outputs(0);
+	for( unsigned int f = params.outputs; f; f >>= 1 ) outputs += f & 1;
+	perpixel += 4 + 4*outputs;
+	perpixel += 4 + 1;
+	return sz*perpixel;
+}
+
+//===========================================================================
+///	PeekImageSize
+///
+/// Only the header is read: PNG IHDR, BMP info header or the first JPEG
+/// start of frame marker.
+//===========================================================================
+bool BatchScheduler::PeekImageSize(
+	const string&					filename,
+	int&							width,
+	int&							height)
+{
+	width = height = 0;
+	FILE* fp = fopen(filename.c_str(), "rb");
+	if( !fp ) return false;
+
+	unsigned char h[26];
+	size_t n = fread(h, 1, sizeof(h), fp);
+	bool ok(false);
+
+	if( n >= 24 && h[0] == 0x89 && h[1] == 'P' && h[2] == 'N' && h[3] == 'G' )
+	{
+		width  = h[16] << 24 | h[17] << 16 | h[18] << 8 | h[19];
+		height = h[20] << 24 | h[21] << 16 | h[22] << 8 | h[23];
+		ok = true;
+	}
+	else if( n >= 26 && h[0] == 'B' && h[1] == 'M' )
+	{
+		int hdrsize = h[14] | h[15] << 8 | h[16] << 16 | h[17] << 24;
+		if( 12 == hdrsize )	// OS/2 core header
+		{
+			width  = h[18] | h[19] << 8;
+			height = h[20] | h[21] << 8;
+		}
+		else
+		{
+			width  = h[18] | h[19] << 8 | h[20] << 16 | h[21] << 24;
+			height = h[22] | h[23] << 8 | h[24] << 16 | h[25] << 24;
+			if( height < 0 ) height = -height;		// top-down bitmap
+		}
+		ok = true;
+	}
+	else if( n >= 4 && h[0] == 0xFF && h[1] == 0xD8 )
+	{
+		// walk the marker segments up to the first SOFn
+		fseek(fp, 2, SEEK_SET);
+		int c;
+		while( (c = fgetc(fp)) != EOF )
+		{
+			if( c != 0xFF ) continue;
+			int marker;
+			do { marker = fgetc(fp); } while( marker == 0xFF );
+			if( marker == EOF ) break;
+			if( marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8) ) continue;	// no length
+			if( marker == 0xD9 || marker == 0xDA ) break;							// EOI, SOS
+			unsigned char seg[7];
+			if( fread(seg, 1, 2, fp) != 2 ) break;
+			int length = seg[0] << 8 | seg[1];
+			if( length < 2 ) break;
+			if( marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC )
+			{
+				if( fread(seg, 1, 5, fp) != 5 ) break;
+				height = seg[1] << 8 | seg[2];
+				width  = seg[3] << 8 | seg[4];
+				ok = true;
+				break;
+			}
+			if( fseek(fp, length - 2, SEEK_CUR) != 0 ) break;
+		}
+	}
+	fclose(fp);
+
+	if( width <= 0 || height <= 0 ) ok = false;
+	if( !ok ) width = height = 0;
+	return ok;
+}
+
+//===========================================================================
+///	Run
+///
+/// The calling thread admits the jobs in order: a job waits until a worker
+/// is free and its estimate fits next to the running ones (or nothing else
+/// runs). Jobs whose estimate is above half of the budget, or whose size is
+/// unknown, wait for all others to finish and keep the rest out while they
+/// run.
+//===========================================================================
+void BatchScheduler::Run(
+	vector<BatchJob>&				jobs,
+	BatchStats&						stats)
+{
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+	stats = BatchStats();
+	stats.jobs = int(jobs.size());
+
+	mutex					lock;
+	condition_variable		changed;
+	deque<int>				ready;
+	vector<char>			alone(jobs.size(), 0);
+	int						running(0);
+	size_t					reserved(0);
+	bool					exclusiveRunning(false);
+	bool					done(false);
+
+	vector<thread> pool;
+	for( int w = 0; w < m_workers; w++ )
+	{
+		pool.push_back(thread([&, w]()
+		{
+			if( Trace::IsEnabled() )
+			{
+				char name[32];
+				sprintf(name, "batch worker %d", w + 1);
+				Trace::SetThreadName(name);
+			}
+			for(;;)
+			{
+				unique_lock<mutex> lk(lock);
+				changed.wait(lk, [&]() { return !ready.empty() || done; });
+				if( ready.empty() ) return;
+				int j = ready.front();
+				ready.pop_front();
+				int threads = alone[j] ? m_workers : 1;
+				lk.unlock();
+
+				try
+				{
+					jobs[j].run(threads);
+				}
+				catch( const exception& e )
+				{
+					jobs[j].failed = true;
+					jobs[j].error  = e.what();
+				}
+				catch( ... )
+				{
+					jobs[j].failed = true;
+					jobs[j].error  = "unknown error";
+				}
+
+				lk.lock();
+				running--;
+				reserved -= jobs[j].estimate;
+				if( alone[j] ) exclusiveRunning = false;
+				if( jobs[j].failed ) stats.failed++;
+				changed.notify_all();
+			}
+		}));
+	}
+
+	int numjobs = int(jobs.size());
+	for( int j = 0; j < numjobs; j++ )
+	{
+		BatchJob& job = jobs[j];
+		bool known = job.width > 0 && job.height > 0;
+		job.estimate = known ? EstimatePeakBytes(job.width, job.height, m_params) : m_budget;
+		alone[j] = (m_budget > 0) && (!known || job.estimate > m_budget/2);
+
+		unique_lock<mutex> lk(lock);
+		changed.wait(lk, [&]()
+		{
+			if( exclusiveRunning || running >= m_workers ) return false;
+			if( alone[j] ) return 0 == running;
+			return 0 == m_budget || 0 == running || reserved + job.estimate <= m_budget;
+		});
+		running++;
+		reserved += job.estimate;
+		if( alone[j] )
+		{
+			exclusiveRunning = true;
+			stats.exclusive++;
+		}
+		if( running > stats.maxConcurrent )	stats.maxConcurrent = running;
+		if( reserved > stats.peakReserved )	stats.peakReserved = reserved;
+		ready.push_back(j);
+		changed.notify_all();
+	}
+
+	{
+		unique_lock<mutex> lk(lock);
+		changed.wait(lk, [&]() { return 0 == running; });
+		done = true;
+		changed.notify_all();
+	}
+	for( size_t w = 0; w < pool.size(); w++ ) pool[w].join();
+
+	stats.elapsedMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
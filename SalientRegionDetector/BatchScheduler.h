@@ -0,0 +1,88 @@
+// BatchScheduler.h: interface for the BatchScheduler class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Runs a list of image jobs on a pool of worker threads. Every job carries
+// the size of its image, from which its peak memory is estimated; a job is
+// only started while the estimates of all running jobs fit in the memory
+// budget. Small images therefore run many at a time, while an image whose
+// estimate exceeds half of the budget runs alone and is handed all the
+// worker threads for intra-image parallelism.
+//===========================================================================
+
+#if !defined(_BATCHSCHEDULER_H_INCLUDED_)
+#define _BATCHSCHEDULER_H_INCLUDED_
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <stddef.h>
+#include "SaliencyPipeline.h"
+using namespace std;
+
+//---------------------------------------------------------------------------
+// One unit of work. run() is called on a worker thread with the number of
+// threads it may use for itself (1 unless it runs alone).
+//---------------------------------------------------------------------------
+struct BatchJob
+{
+	int							width;			// image size, 0 if unknown
+	int							height;
+	function<void(int)>			run;
+
+	size_t						estimate;		// filled by the scheduler
+	bool						failed;			// run() threw
+	string						error;
+
+	BatchJob() : width(0), height(0), estimate(0), failed(false) {}
+};
+
+struct BatchStats
+{
+	int							jobs;
+	int							failed;
+	int							maxConcurrent;	// most jobs running at once
+	int							exclusive;		// jobs that ran alone
+	size_t						peakReserved;	// largest sum of running estimates
+	double						elapsedMs;
+
+	BatchStats() : jobs(0), failed(0), maxConcurrent(0), exclusive(0), peakReserved(0), elapsedMs(0) {}
+};
+
+class BatchScheduler
+{
+public:
+	BatchScheduler(
+		const int&						workers,			// 0 for the number of cores
+		const size_t&					memoryBudget,		// bytes, 0 for no limit
+		const SaliencyParams&			params = SaliencyParams());
+	virtual ~BatchScheduler();
+
+	// Runs all jobs in order of submission and returns when they are done.
+	void Run(
+		vector<BatchJob>&				jobs,
+		BatchStats&						stats);
+
+	int GetWorkers() const { return m_workers; }
+	size_t GetMemoryBudget() const { return m_budget; }
+
+	// Peak bytes needed to process one width x height image with the pipeline.
+	static size_t EstimatePeakBytes(
+		const int&						width,
+		const int&						height,
+		const SaliencyParams&			params);
+
+	// Reads the image size from a JPEG, PNG or BMP header without decoding.
+	static bool PeekImageSize(
+		const string&					filename,
+		int&							width,
+		int&							height);
+
+private:
+
+	int									m_workers;
+	size_t								m_budget;
+	SaliencyParams						m_params;			// for the estimates
+};
+
+#endif // !defined(_BATCHSCHEDULER_H_INCLUDED_)
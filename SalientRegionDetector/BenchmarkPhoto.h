@@ -0,0 +1,81 @@
+// BenchmarkPhoto.h: photo loading shared by the benchmark executables.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Reads a photo into a 0x00RRGGBB buffer. With SRD_HAVE_OPENCV defined any
+// format OpenCV reads is accepted. Without it, JPEG and PNG are read with
+// ImageDecoder when it is built with SRD_HAVE_LIBJPEG or SRD_HAVE_LIBPNG,
+// and binary PPM (P6, 8 bit) always, so that the benchmarks build and run
+// where OpenCV is not installed.
+//===========================================================================
+
+#if !defined(_BENCHMARKPHOTO_H_INCLUDED_)
+#define _BENCHMARKPHOTO_H_INCLUDED_
+
+#include <vector>
+#include <string>
+#include <fstream>
+#ifdef SRD_HAVE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#elif defined(SRD_HAVE_LIBJPEG) || defined(SRD_HAVE_LIBPNG)
+#include "ImageDecoder.h"
+#endif
+using namespace std;
+
+typedef unsigned int UINT;
+
+inline bool LoadBenchmarkPhoto(const string& path, vector<UINT>& img, int& width, int& height)
+{
+#ifdef SRD_HAVE_OPENCV
+	cv::Mat mat = cv::imread(path, cv::IMREAD_COLOR);
+	if( mat.empty() ) return false;
+	width	= mat.cols;
+	height	= mat.rows;
+	img.resize(size_t(width)*height);
+	size_t i(0);
+	for( int y = 0; y < height; y++ )
+	{
+		const unsigned char* row = mat.ptr<unsigned char>(y);
+		for( int x = 0; x < width; x++ )
+		{
+			img[i++] = (UINT)row[3*x+2] << 16 | (UINT)row[3*x+1] << 8 | row[3*x];
+		}
+	}
+	return true;
+#else
+#if defined(SRD_HAVE_LIBJPEG) || defined(SRD_HAVE_LIBPNG)
+	if( ImageDecoder::IsSupported(path) )
+	{
+		ImageDecoder decoder;
+		if( !decoder.Open(path) || !decoder.ReadImage(img) ) return false;
+		width	= decoder.GetWidth();
+		height	= decoder.GetHeight();
+		return true;
+	}
+#endif
+	ifstream in(path.c_str(), ios::binary);
+	string magic;
+	int maxval(0);
+	in >> magic >> width >> height >> maxval;
+	in.get();
+	if( !in || magic != "P6" || maxval != 255 || width <= 0 || height <= 0 ) return false;
+	vector<unsigned char> rgb(size_t(width)*height*3);
+	if( !in.read((char*)&rgb[0], rgb.size()) ) return false;
+	img.resize(size_t(width)*height);
+	for( size_t i = 0; i < img.size(); i++ )
+	{
+		img[i] = UINT(rgb[3*i]) << 16 | UINT(rgb[3*i+1]) << 8 | rgb[3*i+2];
+	}
+	return true;
+#endif
+}
+
+// file name without the folder, to label the photo in reports
+inline string BenchmarkPhotoName(const string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return (slash == string::npos) ? path : path.substr(slash + 1);
+}
+
+#endif // !defined(_BENCHMARKPHOTO_H_INCLUDED_)
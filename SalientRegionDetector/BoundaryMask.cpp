@@ -0,0 +1,211 @@
+// BoundaryMask.cpp: implementation of the segment boundary functions.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "BoundaryMask.h"
+#include <string.h>
+
+//use SSE2 for the row comparisons where the target supports it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define SRD_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+//===========================================================================
+///	CountNeighbours
+///
+/// Neighbours of pixel k in another segment among those that can not be on
+/// the contour yet when the pixel is visited: the three above (unless
+/// taken), the right one and the three below. left is set to 1 if the left
+/// neighbour is in another segment; whether it counts depends on the
+/// contour decision for that neighbour, which is left to the caller.
+//===========================================================================
+static inline int CountNeighbours(
+	const int*						cur,
+	const int*						up,				// NULL in the first row
+	const int*						down,			// NULL in the last row
+	const unsigned char*			takenAbove,
+	const int&						width,
+	const int&						k,
+	unsigned char&					left)
+{
+	int label = cur[k];
+	int np(0);
+	int x0 = (k > 0) ? k-1 : k;
+	int x1 = (k < width-1) ? k+1 : k;
+	for( int x = x0; x <= x1; x++ )
+	{
+		if( up && !takenAbove[x] && up[x] != label ) np++;
+		if( down && down[x] != label ) np++;
+	}
+	if( k < width-1 && cur[k+1] != label ) np++;
+	left = (unsigned char)(k > 0 && cur[k-1] != label);
+	return np;
+}
+
+//===========================================================================
+///	CountRowNeighbours
+///
+/// CountNeighbours for every pixel of row j; the interior pixels of the
+/// interior rows are done four at a time by comparing the row with its
+/// shifted neighbours.
+//===========================================================================
+static void CountRowNeighbours(
+	const int*						labels,
+	const unsigned char*			takenAbove,		// contour of row j-1
+	const int&						width,
+	const int&						height,
+	const int&						j,
+	unsigned char*					base,
+	unsigned char*					left)
+{
+	const int* cur  = labels + j*width;
+	const int* up   = (j > 0)        ? cur - width : NULL;
+	const int* down = (j < height-1) ? cur + width : NULL;
+
+	int k = 0;
+
+#ifdef SRD_USE_SSE2
+	if( up && down && width >= 6 )
+	{
+		base[0] = (unsigned char)CountNeighbours(cur, up, down, takenAbove, width, 0, left[0]);
+
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i ones = _mm_cmpeq_epi32(zero, zero);
+		for( k = 1; k + 4 <= width - 1; k += 4 )
+		{
+			__m128i c = _mm_loadu_si128((const __m128i*)&cur[k]);
+
+			// taken flags of the row above for the up-left, up and up-right
+			// neighbours, widened to 32 bit lanes that are all ones where
+			// the neighbour is not taken
+			// (built unsigned, as a byte shifted into bit 31 of an int is undefined)
+			unsigned b0 = unsigned(takenAbove[k-1]) | unsigned(takenAbove[k])   << 8 | unsigned(takenAbove[k+1]) << 16 | unsigned(takenAbove[k+2]) << 24;
+			unsigned b1 = unsigned(takenAbove[k])   | unsigned(takenAbove[k+1]) << 8 | unsigned(takenAbove[k+2]) << 16 | unsigned(takenAbove[k+3]) << 24;
+			unsigned b2 = unsigned(takenAbove[k+1]) | unsigned(takenAbove[k+2]) << 8 | unsigned(takenAbove[k+3]) << 16 | unsigned(takenAbove[k+4]) << 24;
+			__m128i tl = _mm_cmpeq_epi32(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(int(b0)), zero), zero), zero);
+			__m128i tu = _mm_cmpeq_epi32(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(int(b1)), zero), zero), zero);
+			__m128i tr = _mm_cmpeq_epi32(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(int(b2)), zero), zero), zero);
+
+			// the "differs" masks are all ones, so subtracting them from
+			// the count adds one per neighbour in another segment
+			__m128i cnt = zero;
+			cnt = _mm_sub_epi32(cnt, _mm_andnot_si128(_mm_cmpeq_epi32(c, _mm_loadu_si128((const __m128i*)&up[k-1])), tl));
+			cnt = _mm_sub_epi32(cnt, _mm_andnot_si128(_mm_cmpeq_epi32(c, _mm_loadu_si128((const __m128i*)&up[k])), tu));
+			cnt = _mm_sub_epi32(cnt, _mm_andnot_si128(_mm_cmpeq_epi32(c, _mm_loadu_si128((const __m128i*)&up[k+1])), tr));
+			cnt = _mm_sub_epi32(cnt, _mm_xor_si128(_mm_cmpeq_epi32(c, _mm_loadu_si128((const __m128i*)&cur[k+1])), ones));
+			cnt = _mm_sub_epi32(cnt, _mm_xor_si128(_mm_cmpeq_epi32(c, _mm_loadu_si128((const __m128i*)&down[k-1])), ones));
+			cnt = _mm_sub_epi32(cnt, _mm_xor_si128(_mm_cmpeq_epi32(c, _mm_loadu_si128((const __m128i*)&down[k])), ones));
+			cnt = _mm_sub_epi32(cnt, _mm_xor_si128(_mm_cmpeq_epi32(c, _mm_loadu_si128((const __m128i*)&down[k+1])), ones));
+			__m128i lf = _mm_sub_epi32(zero, _mm_xor_si128(_mm_cmpeq_epi32(c, _mm_loadu_si128((const __m128i*)&cur[k-1])), ones));
+
+			// counts are at most 7: pack both down to bytes
+			__m128i packed = _mm_packus_epi16(_mm_packs_epi32(cnt, lf), zero);
+			int bytes[2];
+			_mm_storel_epi64((__m128i*)bytes, packed);
+			memcpy(&base[k], &bytes[0], 4);
+			memcpy(&left[k], &bytes[1], 4);
+		}
+	}
+#endif
+
+	for( ; k < width; k++ )
+	{
+		base[k] = (unsigned char)CountNeighbours(cur, up, down, takenAbove, width, k, left[k]);
+	}
+}
+
+//===========================================================================
+///	ComputeBoundaryMask
+///
+/// Pixels are decided in raster order, as in DrawContoursAroundSegments:
+/// the neighbour counts of a row are computed in bulk, and one pass from
+/// left to right then adds the left neighbour where it is not on the
+/// contour itself.
+//===========================================================================
+void ComputeBoundaryMask(
+	const vector<int>&				labels,
+	const int&						width,
+	const int&						height,
+	vector<unsigned char>&			mask)
+{
+	int sz = width*height;
+	mask.assign(sz, 0);
+	if( sz <= 0 ) return;
+
+	vector<unsigned char> base(width), left(width);
+	vector<unsigned char> none(width, 0);
+	for( int j = 0; j < height; j++ )
+	{
+		const unsigned char* above = (j > 0) ? &mask[(j-1)*width] : &none[0];
+		CountRowNeighbours(&labels[0], above, width, height, j, &base[0], &left[0]);
+
+		unsigned char* row = &mask[j*width];
+		unsigned char prev(0);
+		for( int k = 0; k < width; k++ )
+		{
+			int np = base[k] + (left[k] & (prev ^ 1));
+			prev = (unsigned char)(np > 2);//1 for thicker lines and 2 for thinner lines
+			row[k] = (unsigned char)(0 - prev);
+		}
+	}
+}
+
+//===========================================================================
+///	CompositeBoundaryMask
+//===========================================================================
+void CompositeBoundaryMask(
+	const vector<unsigned int>&		src,
+	const vector<unsigned char>&	mask,
+	const unsigned int&				color,
+	vector<unsigned int>&			dst)
+{
+	int sz = int(mask.size());
+	if( &dst != &src ) dst.resize(sz);
+	if( sz <= 0 ) return;
+
+	const unsigned int* s = &src[0];
+	const unsigned char* m = &mask[0];
+	unsigned int* d = &dst[0];
+	int i = 0;
+
+#ifdef SRD_USE_SSE2
+	const __m128i col = _mm_set1_epi32(int(color));
+	for( ; i + 16 <= sz; i += 16 )
+	{
+		__m128i m8 = _mm_loadu_si128((const __m128i*)&m[i]);
+		if( 0 == _mm_movemask_epi8(m8) )
+		{
+			// no contour among these 16 pixels
+			if( d != s )
+			{
+				_mm_storeu_si128((__m128i*)&d[i   ], _mm_loadu_si128((const __m128i*)&s[i   ]));
+				_mm_storeu_si128((__m128i*)&d[i+4 ], _mm_loadu_si128((const __m128i*)&s[i+4 ]));
+				_mm_storeu_si128((__m128i*)&d[i+8 ], _mm_loadu_si128((const __m128i*)&s[i+8 ]));
+				_mm_storeu_si128((__m128i*)&d[i+12], _mm_loadu_si128((const __m128i*)&s[i+12]));
+			}
+			continue;
+		}
+		// mask bytes are 0 or 255: widening by unpacking with themselves
+		// gives all ones or zero per 32 bit lane
+		__m128i lo = _mm_unpacklo_epi8(m8, m8);
+		__m128i hi = _mm_unpackhi_epi8(m8, m8);
+		__m128i mk[4];
+		mk[0] = _mm_unpacklo_epi16(lo, lo);
+		mk[1] = _mm_unpackhi_epi16(lo, lo);
+		mk[2] = _mm_unpacklo_epi16(hi, hi);
+		mk[3] = _mm_unpackhi_epi16(hi, hi);
+		for( int q = 0; q < 4; q++ )
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)&s[i + 4*q]);
+			v = _mm_or_si128(_mm_and_si128(mk[q], col), _mm_andnot_si128(mk[q], v));
+			_mm_storeu_si128((__m128i*)&d[i + 4*q], v);
+		}
+	}
+#endif
+
+	for( ; i < sz; i++ )
+	{
+		d[i] = m[i] ? color : s[i];
+	}
+}
@@ -0,0 +1,34 @@
+// BoundaryMask.h: interface for the segment boundary functions.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Segment contours computed once from the label image and drawn onto any
+// number of images. The contour rule is the one DrawContoursAroundSegments
+// applied to the colours of the segmented image: a pixel is on the contour
+// if more than two of its eight neighbours belong to another segment,
+// neighbours already on the contour not counted, which keeps the lines one
+// pixel thin. Rows are compared against their shifted neighbours with SSE2
+// where the target supports it.
+//===========================================================================
+
+#if !defined(_BOUNDARYMASK_H_INCLUDED_)
+#define _BOUNDARYMASK_H_INCLUDED_
+
+#include <vector>
+using namespace std;
+
+// mask[i] is 255 on the contour, 0 elsewhere
+void ComputeBoundaryMask(
+	const vector<int>&				labels,
+	const int&						width,
+	const int&						height,
+	vector<unsigned char>&			mask);
+
+// dst[i] = color where mask[i] is 255 and src[i] where it is 0; dst may be src
+void CompositeBoundaryMask(
+	const vector<unsigned int>&		src,
+	const vector<unsigned char>&	mask,
+	const unsigned int&				color,
+	vector<unsigned int>&			dst);
+
+#endif // !defined(_BOUNDARYMASK_H_INCLUDED_)
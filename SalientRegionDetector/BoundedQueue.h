@@ -0,0 +1,126 @@
+// BoundedQueue.h: interface and implementation of the BoundedQueue class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Fixed capacity multi-producer multi-consumer queue without locks, after
+// D. Vyukov's bounded MPMC queue. Every cell carries a sequence number that
+// tells producers and consumers whether the cell is free for the current lap
+// of the ring; a push or pop claims its position with a single compare and
+// swap and never waits on another thread. TryPush fails when the queue is
+// full and TryPop when it is empty, blocking is left to the caller.
+//===========================================================================
+
+#if !defined(_BOUNDEDQUEUE_H_INCLUDED_)
+#define _BOUNDEDQUEUE_H_INCLUDED_
+
+#include <atomic>
+#include <stddef.h>
+
+template <typename T>
+class BoundedQueue
+{
+public:
+	// capacity is rounded up to a power of two, at least 2
+	BoundedQueue(size_t capacity)
+	{
+		size_t size = 2;
+		while( size < capacity ) size <<= 1;
+		m_mask		= size - 1;
+		m_buffer	= new Cell[size];
+		for( size_t i = 0; i < size; i++ )
+			m_buffer[i].sequence.store(i, std::memory_order_relaxed);
+		m_enqueuePos.store(0, std::memory_order_relaxed);
+		m_dequeuePos.store(0, std::memory_order_relaxed);
+	}
+
+	virtual ~BoundedQueue()
+	{
+		delete [] m_buffer;
+	}
+
+	bool TryPush(const T& value)
+	{
+		Cell* cell;
+		size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+		for(;;)
+		{
+			cell = &m_buffer[pos & m_mask];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+			if( 0 == diff )
+			{
+				// the cell is free on this lap, try to claim it
+				if( m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) )
+					break;
+			}
+			else if( diff < 0 )
+				return false;		// full: the cell still holds last lap's item
+			else
+				pos = m_enqueuePos.load(std::memory_order_relaxed);
+		}
+		cell->data = value;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(T& value)
+	{
+		Cell* cell;
+		size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+		for(;;)
+		{
+			cell = &m_buffer[pos & m_mask];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)(pos + 1);
+			if( 0 == diff )
+			{
+				if( m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) )
+					break;
+			}
+			else if( diff < 0 )
+				return false;		// empty: nothing published in this cell yet
+			else
+				pos = m_dequeuePos.load(std::memory_order_relaxed);
+		}
+		value = cell->data;
+		// free the cell for the producers of the next lap
+		cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	// number of items, only exact when no push or pop is in progress
+	size_t SizeApprox() const
+	{
+		size_t enq = m_enqueuePos.load(std::memory_order_relaxed);
+		size_t deq = m_dequeuePos.load(std::memory_order_relaxed);
+		return (enq > deq) ? enq - deq : 0;
+	}
+
+	size_t Capacity() const { return m_mask + 1; }
+
+private:
+
+	struct Cell
+	{
+		std::atomic<size_t>		sequence;
+		T						data;
+	};
+
+	// keep the two positions on separate cache lines
+	enum { CACHE_LINE = 64 };
+
+	char						m_pad0[CACHE_LINE];
+	Cell*						m_buffer;
+	size_t						m_mask;
+	char						m_pad1[CACHE_LINE];
+	std::atomic<size_t>			m_enqueuePos;
+	char						m_pad2[CACHE_LINE];
+	std::atomic<size_t>			m_dequeuePos;
+	char						m_pad3[CACHE_LINE];
+
+	// not copyable
+	BoundedQueue(const BoundedQueue&);
+	BoundedQueue& operator=(const BoundedQueue&);
+};
+
+#endif // !defined(_BOUNDEDQUEUE_H_INCLUDED_)
@@ -0,0 +1,515 @@
+// ImageDecoder.cpp: implementation of the ImageDecoder class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "ImageDecoder.h"
+#include <cstdio>
+#include <cstring>
+#include <csetjmp>
+#include <algorithm>
+
+#ifdef SRD_HAVE_LIBJPEG
+extern "C" {
+#include <jpeglib.h>
+}
+#endif
+#ifdef SRD_HAVE_LIBPNG
+#include <png.h>
+#endif
+
+namespace
+{
+	enum FileFormat
+	{
+		FORMAT_NONE = 0,		// cannot be read
+		FORMAT_UNKNOWN,
+		FORMAT_JPEG,
+		FORMAT_PNG
+	};
+
+	FileFormat Sniff(const string& path)
+	{
+		FILE* fp = fopen(path.c_str(), "rb");
+		if( !fp ) return FORMAT_NONE;
+		unsigned char sig[8];
+		size_t n = fread(sig, 1, sizeof(sig), fp);
+		fclose(fp);
+		if( n >= 3 && sig[0] == 0xFF && sig[1] == 0xD8 && sig[2] == 0xFF ) return FORMAT_JPEG;
+		if( n >= 8 && 0 == memcmp(sig, "\x89PNG\r\n\x1a\n", 8) ) return FORMAT_PNG;
+		return FORMAT_UNKNOWN;
+	}
+
+	bool FormatBuiltIn(const FileFormat& format)
+	{
+#ifdef SRD_HAVE_LIBJPEG
+		if( FORMAT_JPEG == format ) return true;
+#endif
+#ifdef SRD_HAVE_LIBPNG
+		if( FORMAT_PNG == format ) return true;
+#endif
+		(void)format;
+		return false;
+	}
+
+	// Both libraries report errors with longjmp; the functions that call
+	// them set the jump and hold no objects that would need unwinding.
+#ifdef SRD_HAVE_LIBJPEG
+	struct JpegError
+	{
+		jpeg_error_mgr		pub;
+		jmp_buf				jump;
+		char				message[JMSG_LENGTH_MAX];
+	};
+
+	void JpegErrorExit(j_common_ptr cinfo)
+	{
+		JpegError* err = (JpegError*)cinfo->err;
+		(*cinfo->err->format_message)(cinfo, err->message);
+		longjmp(err->jump, 1);
+	}
+
+	// warnings about recoverable damage are not printed
+	void JpegOutputMessage(j_common_ptr)
+	{
+	}
+
+	bool JpegStart(jpeg_decompress_struct* cinfo, JpegError* err, FILE* fp, const int scale)
+	{
+		if( setjmp(err->jump) ) return false;
+		jpeg_create_decompress(cinfo);
+		jpeg_stdio_src(cinfo, fp);
+		jpeg_read_header(cinfo, TRUE);
+		cinfo->scale_num	= 1;
+		cinfo->scale_denom	= scale;
+		// libjpeg converts grey and YCbCr to RGB, but not CMYK
+		bool cmyk = (JCS_CMYK == cinfo->jpeg_color_space || JCS_YCCK == cinfo->jpeg_color_space);
+		cinfo->out_color_space = cmyk ? JCS_CMYK : JCS_RGB;
+		jpeg_start_decompress(cinfo);
+		return true;
+	}
+
+	bool JpegReadScanline(jpeg_decompress_struct* cinfo, JpegError* err, unsigned char* line)
+	{
+		if( setjmp(err->jump) ) return false;
+		JSAMPROW rows[1] = {line};
+		return 1 == jpeg_read_scanlines(cinfo, rows, 1);
+	}
+#endif
+
+#ifdef SRD_HAVE_LIBPNG
+	struct PngError
+	{
+		char				message[256];
+	};
+
+	void PngErrorExit(png_structp png, png_const_charp msg)
+	{
+		PngError* err = (PngError*)png_get_error_ptr(png);
+		strncpy(err->message, msg, sizeof(err->message) - 1);
+		err->message[sizeof(err->message) - 1] = 0;
+		png_longjmp(png, 1);
+	}
+
+	void PngWarning(png_structp, png_const_charp)
+	{
+	}
+
+	// 8-bit RGB whatever the colour type and depth, alpha dropped
+	bool PngStart(png_structp png, png_infop info, FILE* fp, int* passes)
+	{
+		if( setjmp(png_jmpbuf(png)) ) return false;
+		png_init_io(png, fp);
+		png_read_info(png, info);
+		png_set_expand(png);
+		png_set_strip_16(png);
+		png_set_strip_alpha(png);
+		png_set_gray_to_rgb(png);
+		*passes = png_set_interlace_handling(png);
+		png_read_update_info(png, info);
+		return png_get_rowbytes(png, info) == 3*png_get_image_width(png, info);
+	}
+
+	bool PngReadRow(png_structp png, unsigned char* line)
+	{
+		if( setjmp(png_jmpbuf(png)) ) return false;
+		png_read_row(png, line, NULL);
+		return true;
+	}
+
+	bool PngReadImage(png_structp png, png_bytepp rows)
+	{
+		if( setjmp(png_jmpbuf(png)) ) return false;
+		png_read_image(png, rows);
+		return true;
+	}
+#endif
+}
+
+#ifdef SRD_HAVE_LIBJPEG
+struct ImageDecoder::JpegSource
+{
+	jpeg_decompress_struct				cinfo;
+	JpegError							err;
+	FILE*								fp;
+};
+#else
+struct ImageDecoder::JpegSource
+{
+};
+#endif
+
+#ifdef SRD_HAVE_LIBPNG
+struct ImageDecoder::PngSource
+{
+	png_structp							png;
+	png_infop							info;
+	PngError							err;
+	FILE*								fp;
+	vector<unsigned char>				image;			// interlaced images, read whole
+};
+#else
+struct ImageDecoder::PngSource
+{
+};
+#endif
+
+ImageDecoder::ImageDecoder()
+	: m_jpeg(NULL), m_png(NULL), m_width(0), m_height(0), m_sourceWidth(0), m_sourceHeight(0),
+	  m_scale(0), m_rowsRead(0), m_failed(false)
+{
+}
+
+ImageDecoder::~ImageDecoder()
+{
+	Close();
+}
+
+//===========================================================================
+///	Close
+//===========================================================================
+void ImageDecoder::Close()
+{
+#ifdef SRD_HAVE_LIBJPEG
+	if( m_jpeg )
+	{
+		jpeg_destroy_decompress(&m_jpeg->cinfo);
+		if( m_jpeg->fp ) fclose(m_jpeg->fp);
+	}
+#endif
+#ifdef SRD_HAVE_LIBPNG
+	if( m_png )
+	{
+		if( m_png->png ) png_destroy_read_struct(&m_png->png, m_png->info ? &m_png->info : NULL, NULL);
+		if( m_png->fp ) fclose(m_png->fp);
+	}
+#endif
+	delete m_jpeg;
+	delete m_png;
+	m_jpeg			= NULL;
+	m_png			= NULL;
+	m_width			= 0;
+	m_height		= 0;
+	m_sourceWidth	= 0;
+	m_sourceHeight	= 0;
+	m_scale			= 0;
+	m_rowsRead		= 0;
+	m_failed		= false;
+	m_scanline.clear();
+	m_sums.clear();
+}
+
+//===========================================================================
+///	IsSupported
+//===========================================================================
+bool ImageDecoder::IsSupported(const string& path)
+{
+	return FormatBuiltIn(Sniff(path));
+}
+
+//===========================================================================
+///	ScaleFor
+//===========================================================================
+int ImageDecoder::ScaleFor(const int& width, const int& height, const int& maxSide)
+{
+	const int side = max(width, height);
+	for( int s = 8; s > 1; s /= 2 )
+	{
+		if( (side + s - 1)/s >= maxSide ) return s;
+	}
+	return 1;
+}
+
+//===========================================================================
+///	Open
+//===========================================================================
+bool ImageDecoder::Open(const string& path, const int& scale)
+{
+	Close();
+	m_error.clear();
+	if( scale != 1 && scale != 2 && scale != 4 && scale != 8 )
+	{
+		m_error = "the decode scale must be 1, 2, 4 or 8";
+		return false;
+	}
+	FileFormat format = Sniff(path);
+	if( FORMAT_NONE == format )
+	{
+		m_error = path + ": cannot open";
+		return false;
+	}
+	if( !FormatBuiltIn(format) )
+	{
+		if( FORMAT_JPEG == format )		m_error = path + ": JPEG decoding is not built in";
+		else if( FORMAT_PNG == format )	m_error = path + ": PNG decoding is not built in";
+		else							m_error = path + ": not a JPEG or PNG file";
+		return false;
+	}
+
+	m_scale = scale;
+	bool ok = (FORMAT_JPEG == format) ? OpenJpeg(path) : OpenPng(path);
+	if( ok && (m_width <= 0 || m_height <= 0) )
+	{
+		m_error = "empty image";
+		ok = false;
+	}
+	if( !ok )
+	{
+		string error = m_error;
+		Close();
+		m_error = path + ": " + error;
+	}
+	return ok;
+}
+
+//===========================================================================
+///	OpenJpeg
+///
+/// libjpeg decodes at the scale itself.
+//===========================================================================
+bool ImageDecoder::OpenJpeg(const string& path)
+{
+#ifdef SRD_HAVE_LIBJPEG
+	m_jpeg = new JpegSource;
+	memset(&m_jpeg->cinfo, 0, sizeof(m_jpeg->cinfo));
+	m_jpeg->err.message[0] = 0;
+	m_jpeg->fp = fopen(path.c_str(), "rb");
+	if( !m_jpeg->fp )
+	{
+		m_error = "cannot open";
+		return false;
+	}
+	m_jpeg->cinfo.err				= jpeg_std_error(&m_jpeg->err.pub);
+	m_jpeg->err.pub.error_exit		= JpegErrorExit;
+	m_jpeg->err.pub.output_message	= JpegOutputMessage;
+	if( !JpegStart(&m_jpeg->cinfo, &m_jpeg->err, m_jpeg->fp, m_scale) )
+	{
+		m_error = m_jpeg->err.message;
+		return false;
+	}
+	m_sourceWidth	= int(m_jpeg->cinfo.image_width);
+	m_sourceHeight	= int(m_jpeg->cinfo.image_height);
+	m_width			= int(m_jpeg->cinfo.output_width);
+	m_height		= int(m_jpeg->cinfo.output_height);
+	m_scanline.resize(size_t(m_width)*m_jpeg->cinfo.output_components);
+	return true;
+#else
+	(void)path;
+	m_error = "JPEG decoding is not built in";
+	return false;
+#endif
+}
+
+//===========================================================================
+///	OpenPng
+///
+/// Interlaced images are read whole here, since their rows are only
+/// complete after the last pass.
+//===========================================================================
+bool ImageDecoder::OpenPng(const string& path)
+{
+#ifdef SRD_HAVE_LIBPNG
+	m_png = new PngSource;
+	m_png->png			= NULL;
+	m_png->info			= NULL;
+	m_png->err.message[0] = 0;
+	m_png->fp = fopen(path.c_str(), "rb");
+	if( !m_png->fp )
+	{
+		m_error = "cannot open";
+		return false;
+	}
+	m_png->png = png_create_read_struct(PNG_LIBPNG_VER_STRING, &m_png->err, PngErrorExit, PngWarning);
+	if( m_png->png ) m_png->info = png_create_info_struct(m_png->png);
+	if( !m_png->info )
+	{
+		m_error = "out of memory";
+		return false;
+	}
+	int passes(1);
+	if( !PngStart(m_png->png, m_png->info, m_png->fp, &passes) )
+	{
+		m_error = m_png->err.message[0] ? m_png->err.message : "unsupported pixel format";
+		return false;
+	}
+	m_sourceWidth	= int(png_get_image_width(m_png->png, m_png->info));
+	m_sourceHeight	= int(png_get_image_height(m_png->png, m_png->info));
+	m_width			= (m_sourceWidth + m_scale - 1)/m_scale;
+	m_height		= (m_sourceHeight + m_scale - 1)/m_scale;
+	if( m_sourceWidth <= 0 || m_sourceHeight <= 0 ) return true;	// reported by Open()
+
+	m_scanline.resize(size_t(m_sourceWidth)*3);
+	if( m_scale > 1 ) m_sums.resize(size_t(m_width)*3);
+	if( passes > 1 )
+	{
+		const size_t rowbytes = size_t(m_sourceWidth)*3;
+		m_png->image.resize(rowbytes*m_sourceHeight);
+		vector<png_bytep> rows(m_sourceHeight);
+		for( int y = 0; y < m_sourceHeight; y++ ) rows[y] = &m_png->image[y*rowbytes];
+		if( !PngReadImage(m_png->png, &rows[0]) )
+		{
+			m_error = m_png->err.message;
+			return false;
+		}
+	}
+	return true;
+#else
+	(void)path;
+	m_error = "PNG decoding is not built in";
+	return false;
+#endif
+}
+
+//===========================================================================
+///	ReadRow
+//===========================================================================
+bool ImageDecoder::ReadRow(UINT* row)
+{
+	if( !IsOpen() || m_failed || m_rowsRead >= m_height ) return false;
+
+	bool ok(false);
+#ifdef SRD_HAVE_LIBJPEG
+	if( m_jpeg )
+	{
+		ok = JpegReadScanline(&m_jpeg->cinfo, &m_jpeg->err, &m_scanline[0]);
+		if( !ok ) m_error = m_jpeg->err.message[0] ? m_jpeg->err.message : "truncated JPEG data";
+		const unsigned char* p = &m_scanline[0];
+		if( ok && 4 == m_jpeg->cinfo.output_components )
+		{
+			// Adobe CMYK is stored inverted, so R = C*K/255 and so on
+			for( int x = 0; x < m_width; x++, p += 4 )
+			{
+				UINT k = p[3];
+				row[x] = (p[0]*k + 127)/255 << 16 | (p[1]*k + 127)/255 << 8 | (p[2]*k + 127)/255;
+			}
+		}
+		else if( ok )
+		{
+			for( int x = 0; x < m_width; x++, p += 3 ) row[x] = UINT(p[0]) << 16 | UINT(p[1]) << 8 | p[2];
+		}
+	}
+#endif
+	if( m_png ) ok = ReadPngRow(row);
+
+	if( !ok )
+	{
+		m_failed = true;
+		return false;
+	}
+	m_rowsRead++;
+	return true;
+}
+
+//===========================================================================
+///	ReadPngRow
+///
+/// A scaled row is the mean of each scale x scale box of the source rows
+/// it covers, which are read one at a time into the same scanline.
+//===========================================================================
+bool ImageDecoder::ReadPngRow(UINT* row)
+{
+#ifdef SRD_HAVE_LIBPNG
+	const int s = m_scale;
+	const int first = m_rowsRead*s;
+	const int last = min(first + s, m_sourceHeight);
+	const size_t rowbytes = size_t(m_sourceWidth)*3;
+	if( s > 1 ) fill(m_sums.begin(), m_sums.end(), 0u);
+
+	for( int y = first; y < last; y++ )
+	{
+		const unsigned char* p;
+		if( !m_png->image.empty() ) p = &m_png->image[y*rowbytes];
+		else
+		{
+			if( !PngReadRow(m_png->png, &m_scanline[0]) )
+			{
+				m_error = m_png->err.message;
+				return false;
+			}
+			p = &m_scanline[0];
+		}
+
+		if( 1 == s )
+		{
+			for( int x = 0; x < m_width; x++, p += 3 ) row[x] = UINT(p[0]) << 16 | UINT(p[1]) << 8 | p[2];
+			return true;
+		}
+		unsigned int* sum = &m_sums[0];
+		for( int bx = 0; bx < m_width; bx++, sum += 3 )
+		{
+			const int xend = min(bx*s + s, m_sourceWidth);
+			for( int x = bx*s; x < xend; x++, p += 3 )
+			{
+				sum[0] += p[0];
+				sum[1] += p[1];
+				sum[2] += p[2];
+			}
+		}
+	}
+
+	const int rows = last - first;
+	const unsigned int* sum = &m_sums[0];
+	for( int bx = 0; bx < m_width; bx++, sum += 3 )
+	{
+		const unsigned int count = unsigned(min(bx*s + s, m_sourceWidth) - bx*s)*rows;
+		row[bx] = (sum[0] + count/2)/count << 16 | (sum[1] + count/2)/count << 8 | (sum[2] + count/2)/count;
+	}
+	return true;
+#else
+	(void)row;
+	return false;
+#endif
+}
+
+//===========================================================================
+///	ReadRows
+//===========================================================================
+bool ImageDecoder::ReadRows(const ImageView& dst)
+{
+	if( !IsOpen() || dst.width != m_width || dst.height > m_height - m_rowsRead )
+	{
+		if( IsOpen() ) m_error = "the rows asked for do not fit the image";
+		return false;
+	}
+	const bool direct = (PIXEL_XRGB32 == dst.layout);
+	vector<UINT> scratch(direct ? 0 : m_width);
+	for( int y = 0; y < dst.height; y++ )
+	{
+		UINT* row = direct ? (UINT*)dst.Row(y) : &scratch[0];
+		if( !ReadRow(row) ) return false;
+		if( !direct ) dst.WriteRow(y, row);
+	}
+	return true;
+}
+
+//===========================================================================
+///	ReadImage
+//===========================================================================
+bool ImageDecoder::ReadImage(vector<UINT>& img)
+{
+	img.clear();
+	if( !IsOpen() ) return false;
+	const int rows = m_height - m_rowsRead;
+	if( rows <= 0 ) return true;
+	img.resize(size_t(m_width)*rows);
+	return ReadRows(ImageView(&img[0], m_width, rows));
+}
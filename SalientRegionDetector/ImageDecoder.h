@@ -0,0 +1,101 @@
+// ImageDecoder.h: interface for the ImageDecoder class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Portable JPEG and PNG decoder that can decode at 1/2, 1/4 or 1/8 of the
+// size and hands the image out row by row, so that a preview never holds
+// the full resolution pixels and a tiled consumer pulls rows as it needs
+// them:
+//
+//   ImageDecoder decoder;
+//   if( decoder.Open(path, 4) )
+//       while( decoder.ReadRow(row) ) ... GetWidth() pixels in 0x00RRGGBB ...
+//
+// JPEG images are scaled by libjpeg while it decodes (only the low
+// frequency DCT coefficients are used), which is much faster than a full
+// decode. PNG rows are read one at a time and averaged over scale x scale
+// boxes as they come; interlaced PNGs are the exception and are read whole
+// at Open(). Scaled images are ceil(width/scale) x ceil(height/scale), the
+// boxes of the last column and row covering what is left.
+//
+// JPEG support is built with SRD_HAVE_LIBJPEG and PNG support with
+// SRD_HAVE_LIBPNG; without them Open() fails for that format and the
+// caller falls back to its own decoder. Grey, palette and 16-bit images are
+// expanded to 8-bit RGB and alpha is dropped. A decoder is meant for one
+// thread; decoders of different files may run in parallel.
+//===========================================================================
+
+#if !defined(_IMAGEDECODER_H_INCLUDED_)
+#define _IMAGEDECODER_H_INCLUDED_
+
+#include <vector>
+#include <string>
+#include "ImageView.h"
+using namespace std;
+
+class ImageDecoder
+{
+public:
+	ImageDecoder();
+	virtual ~ImageDecoder();
+
+	// Reads the header and prepares to decode at 1/scale of the size (1, 2,
+	// 4 or 8); false, with GetError(), if the file cannot be read or its
+	// format is not built in.
+	bool Open(const string& path, const int& scale = 1);
+	void Close();
+
+	// The file is a JPEG or PNG, going by its signature, and that format is
+	// built in.
+	static bool IsSupported(const string& path);
+
+	// The largest scale whose image still has maxSide pixels on its longer
+	// side, or 1 if the image is not larger than that.
+	static int ScaleFor(const int& width, const int& height, const int& maxSide);
+
+	bool IsOpen() const { return m_scale > 0; }
+	int GetWidth() const { return m_width; }				// of the decoded image
+	int GetHeight() const { return m_height; }
+	int GetSourceWidth() const { return m_sourceWidth; }
+	int GetSourceHeight() const { return m_sourceHeight; }
+	int GetScale() const { return m_scale; }
+	int GetRowsRead() const { return m_rowsRead; }
+	const string& GetError() const { return m_error; }
+
+	// The next row, GetWidth() pixels in 0x00RRGGBB; false after the last
+	// row or, with GetError(), if the file is corrupt.
+	bool ReadRow(UINT* row);
+
+	// The next dst.height rows into dst, in its layout; dst.width must be
+	// GetWidth().
+	bool ReadRows(const ImageView& dst);
+
+	// All the rows not read yet, as a whole image if none were.
+	bool ReadImage(vector<UINT>& img);
+
+private:
+	ImageDecoder(const ImageDecoder&);
+	ImageDecoder& operator=(const ImageDecoder&);
+
+	struct JpegSource;
+	struct PngSource;
+
+	bool OpenJpeg(const string& path);
+	bool OpenPng(const string& path);
+	bool ReadPngRow(UINT* row);
+
+	JpegSource*							m_jpeg;
+	PngSource*							m_png;
+	int									m_width;
+	int									m_height;
+	int									m_sourceWidth;
+	int									m_sourceHeight;
+	int									m_scale;		// 0 while closed
+	int									m_rowsRead;
+	bool								m_failed;		// no rows after a decoding error
+	vector<unsigned char>				m_scanline;		// one source row as decoded
+	vector<unsigned int>				m_sums;			// box sums of a scaled PNG row
+	string								m_error;
+};
+
+#endif // !defined(_IMAGEDECODER_H_INCLUDED_)
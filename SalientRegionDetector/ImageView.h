@@ -0,0 +1,168 @@
+// ImageView.h: interface for the ImageView struct.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Non-owning view of the pixels of an image in the layout a decoder or an
+// encoder uses, so that they can be handed through the pipeline without
+// being copied into a 0x00RRGGBB buffer first:
+//
+//   ImageView view(mat.data, mat.cols, mat.rows, PIXEL_BGR24, mat.step);
+//   pipeline.Process(view, result);
+//
+// Rows are stride bytes apart, which may be more than the pixels of a row
+// need (padded bitmaps) or negative (bottom-up DIBs, data then pointing at
+// the top row). Planar images keep R, G and B in three planes planeStride
+// bytes apart. The view does not keep the pixels alive: they must outlive
+// every use of it. Functions that read a view never write through it;
+// those documented as writing into one (GetResults, the converters) need
+// writable pixels.
+//
+// Consumers either ask for a row in 0x00RRGGBB with ReadRow(), which only
+// converts when the layout is not already PIXEL_XRGB32, or use
+// IsContiguousXRGB() to take the buffer as it is. The top byte of
+// PIXEL_XRGB32 pixels is carried along unchanged (GDI+ fills it with the
+// alpha) and otherwise ignored.
+//===========================================================================
+
+#if !defined(_IMAGEVIEW_H_INCLUDED_)
+#define _IMAGEVIEW_H_INCLUDED_
+
+#include <vector>
+#include <cstring>
+#include <stddef.h>
+using namespace std;
+
+typedef unsigned int UINT;
+
+enum PixelLayout
+{
+	PIXEL_XRGB32			= 0,		// UINT 0x00RRGGBB (the pipeline's buffers, GDI+ 32bpp)
+	PIXEL_BGR24				= 1,		// B, G, R bytes (OpenCV, GDI+ 24bpp)
+	PIXEL_RGB24				= 2,		// R, G, B bytes (EDISON, libjpeg, libpng)
+	PIXEL_GRAY8				= 3,		// one byte, R = G = B
+	PIXEL_PLANAR_RGB8		= 4			// R, G and B planes of one byte per pixel
+};
+
+struct ImageView
+{
+	unsigned char*		data;			// first pixel of the top row (of the R plane)
+	int					width;
+	int					height;
+	ptrdiff_t			stride;			// bytes from one row to the next
+	ptrdiff_t			planeStride;	// bytes from one plane to the next, PIXEL_PLANAR_RGB8 only
+	PixelLayout			layout;
+
+	ImageView() : data(NULL), width(0), height(0), stride(0), planeStride(0), layout(PIXEL_XRGB32) {}
+
+	// rowStride 0 for rows without padding; planes 0 for planes stored one
+	// after the other
+	ImageView(
+		const void*						pixels,
+		const int&						w,
+		const int&						h,
+		const PixelLayout&				l = PIXEL_XRGB32,
+		const ptrdiff_t&				rowStride = 0,
+		const ptrdiff_t&				planes = 0)
+		: data((unsigned char*)pixels), width(w), height(h),
+		  stride(rowStride ? rowStride : ptrdiff_t(w)*PixelBytes(l)),
+		  planeStride(planes ? planes : stride*h), layout(l) {}
+
+	// over a 0x00RRGGBB buffer of the pipeline; empty if the sizes disagree
+	static ImageView Of(const vector<UINT>& img, const int& w, const int& h)
+	{
+		if( w <= 0 || h <= 0 || img.size() != size_t(w)*size_t(h) ) return ImageView();
+		return ImageView(&img[0], w, h);
+	}
+
+	// bytes of one pixel in a row (of one plane)
+	static int PixelBytes(const PixelLayout& l)
+	{
+		if( PIXEL_XRGB32 == l ) return 4;
+		if( PIXEL_BGR24 == l || PIXEL_RGB24 == l ) return 3;
+		return 1;
+	}
+
+	bool IsEmpty() const { return NULL == data || width <= 0 || height <= 0; }
+
+	// the pixels are one 0x00RRGGBB buffer of width*height entries
+	bool IsContiguousXRGB() const { return PIXEL_XRGB32 == layout && stride == ptrdiff_t(width)*4; }
+
+	unsigned char* Row(const int& y) const { return data + ptrdiff_t(y)*stride; }
+
+	UINT GetPixel(const int& x, const int& y) const
+	{
+		const unsigned char* p = Row(y);
+		switch( layout )
+		{
+		case PIXEL_XRGB32:		return ((const UINT*)p)[x];
+		case PIXEL_BGR24:		p += 3*x; return UINT(p[2]) << 16 | UINT(p[1]) << 8 | p[0];
+		case PIXEL_RGB24:		p += 3*x; return UINT(p[0]) << 16 | UINT(p[1]) << 8 | p[2];
+		case PIXEL_GRAY8:		return UINT(p[x])*0x010101u;
+		default:				p += x; return UINT(p[0]) << 16 | UINT(p[planeStride]) << 8 | p[2*planeStride];
+		}
+	}
+
+	// grey levels are the rounded mean of R, G and B
+	void SetPixel(const int& x, const int& y, const UINT& value) const
+	{
+		unsigned char* p = Row(y);
+		const unsigned char r = (unsigned char)(value >> 16), g = (unsigned char)(value >> 8), b = (unsigned char)value;
+		switch( layout )
+		{
+		case PIXEL_XRGB32:		((UINT*)p)[x] = value; break;
+		case PIXEL_BGR24:		p += 3*x; p[0] = b; p[1] = g; p[2] = r; break;
+		case PIXEL_RGB24:		p += 3*x; p[0] = r; p[1] = g; p[2] = b; break;
+		case PIXEL_GRAY8:		p[x] = (unsigned char)((r + g + b + 1)/3); break;
+		default:				p += x; p[0] = r; p[planeStride] = g; p[2*planeStride] = b; break;
+		}
+	}
+
+	// Row y in 0x00RRGGBB: the row itself for PIXEL_XRGB32, otherwise
+	// converted into scratch, which has room for width pixels.
+	const UINT* ReadRow(const int& y, UINT* scratch) const
+	{
+		if( PIXEL_XRGB32 == layout ) return (const UINT*)Row(y);
+		for( int x = 0; x < width; x++ ) scratch[x] = GetPixel(x, y);
+		return scratch;
+	}
+
+	void WriteRow(const int& y, const UINT* pixels) const
+	{
+		if( PIXEL_XRGB32 == layout )	memcpy(Row(y), pixels, sizeof(UINT)*width);
+		else							for( int x = 0; x < width; x++ ) SetPixel(x, y, pixels[x]);
+	}
+
+	// the pixels of a rectangle inside the view, without a copy
+	ImageView Crop(const int& x, const int& y, const int& w, const int& h) const
+	{
+		ImageView crop(*this);
+		crop.data	= Row(y) + ptrdiff_t(x)*PixelBytes(layout);
+		crop.width	= w;
+		crop.height	= h;
+		return crop;
+	}
+
+	// into a 0x00RRGGBB buffer of the pipeline
+	void CopyTo(vector<UINT>& img) const
+	{
+		img.resize(size_t(width)*size_t(height));
+		for( int y = 0; y < height; y++ )
+		{
+			UINT* row = &img[size_t(y)*width];
+			const UINT* src = ReadRow(y, row);
+			if( src != row ) memcpy(row, src, sizeof(UINT)*width);
+		}
+	}
+
+	// Copies src into dst, converting the layout; false if the sizes differ.
+	static bool Convert(const ImageView& src, const ImageView& dst)
+	{
+		if( src.width != dst.width || src.height != dst.height ) return false;
+		if( src.IsEmpty() ) return true;
+		vector<UINT> scratch(src.width);
+		for( int y = 0; y < src.height; y++ ) dst.WriteRow(y, src.ReadRow(y, &scratch[0]));
+		return true;
+	}
+};
+
+#endif // !defined(_IMAGEVIEW_H_INCLUDED_)
@@ -0,0 +1,365 @@
+// ImageWriterPool.cpp: implementation of the ImageWriterPool class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "ImageWriterPool.h"
+#include "Trace.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+
+typedef std::chrono::high_resolution_clock WriterClock;
+
+static double ElapsedMs(const WriterClock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(WriterClock::now() - start).count();
+}
+
+//---------------------------------------------------------------------------
+// The image of a result that holds the given artifact.
+//---------------------------------------------------------------------------
+static vector<UINT>& OutputImage(SaliencyResult& result, const SaliencyOutput& output)
+{
+	switch( output )
+	{
+	case OUTPUT_SALMAP:				return result.salimg;
+	case OUTPUT_MEANSHIFT:			return result.segimg;
+	case OUTPUT_OBJECT:				return result.segobj;
+	case OUTPUT_MEANSHIFT_BORDERED:	return result.segimgbordered;
+	case OUTPUT_OBJECT_BORDERED:	return result.segobjbordered;
+	default:						return result.boximg;
+	}
+}
+
+//---------------------------------------------------------------------------
+// Moves a request without copying its image (Visual Studio 2013 does not
+// generate move constructors).
+//---------------------------------------------------------------------------
+static void TakeRequest(ImageWriteRequest& to, ImageWriteRequest& from)
+{
+	to.path.swap(from.path);
+	to.img.swap(from.img);
+	to.source.swap(from.source);
+	to.width	= from.width;
+	to.height	= from.height;
+	to.format	= from.format;
+	to.quality	= from.quality;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+ImageWriterPool::ImageWriterPool(
+	const EncodeFunc&				encoder,
+	const int&						threads,
+	const size_t&					maxPending)
+	: m_encoder(encoder), m_maxPending(maxPending < 1 ? 1 : maxPending), m_busy(0), m_stopping(false)
+{
+	for( int t = 0; t < threads; t++ )
+	{
+		m_workers.push_back(thread(&ImageWriterPool::WorkerLoop, this, t));
+	}
+}
+
+ImageWriterPool::~ImageWriterPool()
+{
+	Flush();
+	{
+		lock_guard<mutex> lk(m_lock);
+		m_stopping = true;
+	}
+	m_changed.notify_all();
+	for( size_t t = 0; t < m_workers.size(); t++ ) m_workers[t].join();
+}
+
+//===========================================================================
+///	Encode
+///
+/// Calls the encoder and books the outcome. An encoder that throws counts
+/// as a failed write.
+//===========================================================================
+void ImageWriterPool::Encode(
+	const int&						worker,
+	const ImageWriteRequest&		request)
+{
+	TRACE_SPAN(span, "encode");
+	span.SetDetail(request.path);
+	WriterClock::time_point start = WriterClock::now();
+	bool ok(false);
+	try
+	{
+		ok = m_encoder(worker, request);
+	}
+	catch( ... )
+	{
+		ok = false;
+	}
+	double ms = ElapsedMs(start);
+
+	lock_guard<mutex> lk(m_lock);
+	m_stats.encodeMs += ms;
+	if( ok ) m_stats.written++;
+	else
+	{
+		m_stats.failed++;
+		ImageWriteFailure f;
+		f.source = request.source;
+		f.path = request.path;
+		m_failures.push_back(f);
+	}
+}
+
+//===========================================================================
+///	WorkerLoop
+//===========================================================================
+void ImageWriterPool::WorkerLoop(
+	const int&						worker)
+{
+	if( Trace::IsEnabled() )
+	{
+		char name[32];
+		sprintf(name, "writer %d", worker + 1);
+		Trace::SetThreadName(name);
+	}
+	for(;;)
+	{
+		ImageWriteRequest request;
+		{
+			unique_lock<mutex> lk(m_lock);
+			m_changed.wait(lk, [&]() { return !m_queue.empty() || m_stopping; });
+			if( m_queue.empty() ) return;
+			TakeRequest(request, m_queue.front());
+			m_queue.pop_front();
+			m_busy++;
+		}
+		m_changed.notify_all();				// a slot is free for Submit()
+
+		Encode(worker, request);
+
+		{
+			lock_guard<mutex> lk(m_lock);
+			m_busy--;
+		}
+		m_changed.notify_all();
+	}
+}
+
+//===========================================================================
+///	Submit
+//===========================================================================
+void ImageWriterPool::Submit(
+	ImageWriteRequest&				request)
+{
+	request.quality = ClampQuality(request.format, request.quality);
+	if( m_workers.empty() )
+	{
+		{
+			lock_guard<mutex> lk(m_lock);
+			m_stats.submitted++;
+		}
+		{
+			// callers on several threads would otherwise all be worker 0 at once
+			lock_guard<mutex> lk(m_callerLock);
+			Encode(0, request);
+		}
+		vector<UINT>().swap(request.img);
+		return;
+	}
+
+	unique_lock<mutex> lk(m_lock);
+	if( m_queue.size() >= m_maxPending )
+	{
+		WriterClock::time_point start = WriterClock::now();
+		m_changed.wait(lk, [&]() { return m_queue.size() < m_maxPending; });
+		m_stats.blockedMs += ElapsedMs(start);
+	}
+	m_queue.push_back(ImageWriteRequest());
+	TakeRequest(m_queue.back(), request);
+	m_stats.submitted++;
+	if( m_queue.size() > m_stats.maxPending ) m_stats.maxPending = m_queue.size();
+	lk.unlock();
+	m_changed.notify_all();
+}
+
+//===========================================================================
+///	SubmitResult
+//===========================================================================
+void ImageWriterPool::SubmitResult(
+	const string&					basepath,
+	const string&					source,
+	SaliencyResult&					result,
+	const vector<OutputSpec>&		specs)
+{
+	vector<ImageWriteRequest> requests;
+	MakeRequests(basepath, source, result, specs, requests);
+	for( size_t r = 0; r < requests.size(); r++ ) Submit(requests[r]);
+}
+
+//===========================================================================
+///	Flush
+//===========================================================================
+void ImageWriterPool::Flush()
+{
+	unique_lock<mutex> lk(m_lock);
+	m_changed.wait(lk, [&]() { return m_queue.empty() && 0 == m_busy; });
+}
+
+ImageWriterStats ImageWriterPool::GetStats()
+{
+	lock_guard<mutex> lk(m_lock);
+	return m_stats;
+}
+
+void ImageWriterPool::TakeFailures(vector<ImageWriteFailure>& failures)
+{
+	lock_guard<mutex> lk(m_lock);
+	failures.clear();
+	failures.swap(m_failures);
+}
+
+//===========================================================================
+///	MakeRequests
+///
+/// One request per spec whose image was rendered. The images are moved out
+/// of the result, except when a later spec writes the same artifact again
+/// in another format.
+//===========================================================================
+void ImageWriterPool::MakeRequests(
+	const string&					basepath,
+	const string&					source,
+	SaliencyResult&					result,
+	const vector<OutputSpec>&		specs,
+	vector<ImageWriteRequest>&		requests)
+{
+	requests.reserve(requests.size() + specs.size());	// no image is copied when the vector grows
+	for( size_t s = 0; s < specs.size(); s++ )
+	{
+		vector<UINT>& img = OutputImage(result, specs[s].output);
+		if( img.empty() ) continue;
+
+		bool usedagain(false);
+		for( size_t n = s+1; n < specs.size(); n++ )
+		{
+			if( specs[n].output == specs[s].output ) usedagain = true;
+		}
+
+		requests.push_back(ImageWriteRequest());
+		ImageWriteRequest& r = requests.back();
+		r.path		= basepath + SaliencyPipeline::OutputSuffix(specs[s].output) + "." + FormatExtension(specs[s].format);
+		r.width		= result.width;
+		r.height	= result.height;
+		r.format	= specs[s].format;
+		r.quality	= specs[s].quality;
+		r.source	= source;
+		if( usedagain ) r.img = img;
+		else r.img.swap(img);
+	}
+}
+
+//===========================================================================
+///	OutputMask
+//===========================================================================
+unsigned int ImageWriterPool::OutputMask(
+	const vector<OutputSpec>&		specs)
+{
+	unsigned int outputs(0);
+	for( size_t s = 0; s < specs.size(); s++ ) outputs |= specs[s].output;
+	return outputs;
+}
+
+const char* ImageWriterPool::FormatExtension(
+	const ImageFormat&				format)
+{
+	switch( format )
+	{
+	case IMAGE_PNG:		return "png";
+	case IMAGE_BMP:		return "bmp";
+	default:			return "jpg";
+	}
+}
+
+int ImageWriterPool::ClampQuality(
+	const ImageFormat&				format,
+	const int&						quality)
+{
+	if( quality < 0 ) return -1;
+	return min(quality, IMAGE_PNG == format ? 9 : 100);
+}
+
+bool ImageWriterPool::ParseFormat(
+	const string&					name,
+	ImageFormat&					format)
+{
+	if( name == "jpg" || name == "jpeg" )	format = IMAGE_JPEG;
+	else if( name == "png" )				format = IMAGE_PNG;
+	else if( name == "bmp" )				format = IMAGE_BMP;
+	else return false;
+	return true;
+}
+
+//===========================================================================
+///	ParseOutputSpecs
+///
+/// Comma separated entries of the form name[:format[:quality]].
+//===========================================================================
+bool ImageWriterPool::ParseOutputSpecs(
+	const string&					list,
+	const ImageFormat&				defaultFormat,
+	const int&						defaultQuality,
+	vector<OutputSpec>&				specs)
+{
+	static const struct { const char* name; SaliencyOutput output; } names[] =
+	{
+		{ "salmap",				OUTPUT_SALMAP },
+		{ "meanshift",			OUTPUT_MEANSHIFT },
+		{ "object",				OUTPUT_OBJECT },
+		{ "meanshiftbordered",	OUTPUT_MEANSHIFT_BORDERED },
+		{ "objectbordered",		OUTPUT_OBJECT_BORDERED },
+		{ "boxes",				OUTPUT_BOXES }
+	};
+	const int numnames = int(sizeof(names)/sizeof(names[0]));
+
+	specs.clear();
+	size_t pos(0);
+	while( pos <= list.size() )
+	{
+		size_t comma = list.find(',', pos);
+		if( comma == string::npos ) comma = list.size();
+		string entry = list.substr(pos, comma - pos);
+		pos = comma + 1;
+
+		string name(entry);
+		ImageFormat format(defaultFormat);
+		int quality(defaultQuality);
+		size_t colon = entry.find(':');
+		if( colon != string::npos )
+		{
+			name = entry.substr(0, colon);
+			string rest = entry.substr(colon + 1);
+			size_t colon2 = rest.find(':');
+			if( !ParseFormat(rest.substr(0, colon2), format) ) return false;
+			if( colon2 != string::npos )
+			{
+				string q = rest.substr(colon2 + 1);
+				char* end(NULL);
+				quality = int(strtol(q.c_str(), &end, 10));
+				if( q.empty() || *end != '\0' || quality < 0 ) return false;
+			}
+		}
+		if( ClampQuality(format, quality) != quality ) return false;
+
+		if( name.empty() || name == "none" ) continue;
+		if( name == "all" )
+		{
+			for( int n = 0; n < numnames; n++ ) specs.push_back(OutputSpec(names[n].output, format, quality));
+			continue;
+		}
+		int n(0);
+		while( n < numnames && name != names[n].name ) n++;
+		if( n == numnames ) return false;
+		specs.push_back(OutputSpec(names[n].output, format, quality));
+	}
+	return true;
+}
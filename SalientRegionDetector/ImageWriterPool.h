@@ -0,0 +1,176 @@
+// ImageWriterPool.h: interface for the ImageWriterPool class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Writes result images on a small pool of background threads, so that the
+// caller can go on to the next image while the previous one is encoded.
+// The encoder itself is supplied by the front end (GDI+ in the dialog,
+// OpenCV in the command line tool) and is told which writer thread calls
+// it, so that it can keep per-thread state such as encoder handles and
+// conversion buffers from one image to the next. The queue is bounded:
+// Submit() blocks while it is full, which bounds the images held in memory.
+//
+// OutputSpec selects which artifacts of a SaliencyResult are written and
+// the format and quality of each; OutputMask() turns a list of them into
+// SaliencyParams::outputs so that images nobody writes are not rendered.
+//===========================================================================
+
+#if !defined(_IMAGEWRITERPOOL_H_INCLUDED_)
+#define _IMAGEWRITERPOOL_H_INCLUDED_
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stddef.h>
+#include "SaliencyPipeline.h"
+using namespace std;
+
+enum ImageFormat
+{
+	IMAGE_JPEG = 0,
+	IMAGE_PNG,
+	IMAGE_BMP
+};
+
+//---------------------------------------------------------------------------
+// One artifact to write. quality is the JPEG quality (0-100) or the PNG
+// compression level (0-9), and is ignored for BMP; -1 leaves the encoder
+// default.
+//---------------------------------------------------------------------------
+struct OutputSpec
+{
+	SaliencyOutput		output;
+	ImageFormat			format;
+	int					quality;
+
+	OutputSpec(const SaliencyOutput& o = OUTPUT_SALMAP, const ImageFormat& f = IMAGE_JPEG, const int& q = -1)
+		: output(o), format(f), quality(q) {}
+};
+
+struct ImageWriteRequest
+{
+	string				path;			// full path, extension included
+	vector<UINT>		img;			// 0x00RRGGBB, row-major
+	int					width;
+	int					height;
+	ImageFormat			format;
+	int					quality;
+	string				source;			// input image, for error reports
+
+	ImageWriteRequest() : width(0), height(0), format(IMAGE_JPEG), quality(-1) {}
+};
+
+struct ImageWriteFailure
+{
+	string				source;
+	string				path;
+};
+
+struct ImageWriterStats
+{
+	int					submitted;
+	int					written;
+	int					failed;
+	double				encodeMs;		// summed over the writer threads
+	double				blockedMs;		// time Submit() waited for a free slot
+	size_t				maxPending;		// most requests queued at once
+
+	ImageWriterStats() : submitted(0), written(0), failed(0), encodeMs(0), blockedMs(0), maxPending(0) {}
+};
+
+class ImageWriterPool
+{
+public:
+	// Writes one image. worker is in [0, threads) and no two calls with the
+	// same worker overlap; with 0 threads the encoder is called as worker 0
+	// on whichever thread called Submit(), one call at a time.
+	typedef function<bool(int, const ImageWriteRequest&)>	EncodeFunc;
+
+	ImageWriterPool(
+		const EncodeFunc&				encoder,
+		const int&						threads = 2,		// 0 writes on the calling thread
+		const size_t&					maxPending = 16);
+	virtual ~ImageWriterPool();							// flushes
+
+	// Queues a write. The image is taken over, request.img is left empty; a
+	// quality out of the range of the format is clamped to it.
+	void Submit(
+		ImageWriteRequest&				request);
+
+	// Queues the selected artifacts of a result, taking its images over.
+	// Names are basepath + suffix + extension, as the front ends have
+	// always used.
+	void SubmitResult(
+		const string&					basepath,
+		const string&					source,
+		SaliencyResult&					result,
+		const vector<OutputSpec>&		specs);
+
+	// Waits until every queued image has been written.
+	void Flush();
+
+	ImageWriterStats GetStats();
+	// failures since the last call
+	void TakeFailures(vector<ImageWriteFailure>& failures);
+
+	int GetThreads() const { return int(m_workers.size()); }
+
+	static void MakeRequests(
+		const string&					basepath,
+		const string&					source,
+		SaliencyResult&					result,
+		const vector<OutputSpec>&		specs,
+		vector<ImageWriteRequest>&		requests);
+
+	static unsigned int OutputMask(
+		const vector<OutputSpec>&		specs);
+
+	static const char* FormatExtension(
+		const ImageFormat&				format);
+
+	// quality clamped to the range of the format, -1 kept
+	static int ClampQuality(
+		const ImageFormat&				format,
+		const int&						quality);
+
+	static bool ParseFormat(
+		const string&					name,				// jpg, jpeg, png or bmp
+		ImageFormat&					format);
+
+	// "salmap,object:png,boxes:jpg:90"; entries without a format take the
+	// defaults, "all" and "none" are accepted. False on an unknown name or
+	// a quality out of the range of its format.
+	static bool ParseOutputSpecs(
+		const string&					list,
+		const ImageFormat&				defaultFormat,
+		const int&						defaultQuality,
+		vector<OutputSpec>&				specs);
+
+private:
+
+	void WorkerLoop(
+		const int&						worker);
+
+	void Encode(
+		const int&						worker,
+		const ImageWriteRequest&		request);
+
+	EncodeFunc							m_encoder;
+	size_t								m_maxPending;
+	vector<thread>						m_workers;
+	mutex								m_callerLock;	// the one "worker" of a pool without threads
+
+	mutex								m_lock;
+	condition_variable					m_changed;
+	deque<ImageWriteRequest>			m_queue;
+	int									m_busy;
+	bool								m_stopping;
+	ImageWriterStats					m_stats;
+	vector<ImageWriteFailure>			m_failures;
+};
+
+#endif // !defined(_IMAGEWRITERPOOL_H_INCLUDED_)
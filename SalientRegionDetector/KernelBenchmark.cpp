@@ -0,0 +1,463 @@
+// KernelBenchmark.cpp : microbenchmarks of the saliency and mean shift kernels
+//
+//===========================================================================
+// Times each kernel on synthetic images of several sizes and kinds of
+// content, and optionally on photos, so that a change to one kernel can be
+// measured on its own and runs can be compared over time.
+//
+// Usage:
+//   KernelBenchmark [options] [photo] ...
+//
+// RGB2LAB, GaussianSmooth and LAB2RGB are called directly. The mean shift
+// kernels (the filter, Connect, BuildRAM, TransitiveClosure and Prune) are
+// private to msImageProcessor; they are timed from its timing report over
+// a full Segment(), so their samples include every call made in one run.
+// Each kernel is run once untimed and then --repeat times; the report gives
+// the mean, median, standard deviation and minimum of the samples, the
+// mean time per pixel and the throughput, as a table, JSON or CSV.
+//===========================================================================
+
+#include "Saliency.h"
+#include "MeanShiftCode/msImageProcessor.h"
+#include "BenchmarkPhoto.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <chrono>
+
+using namespace std;
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double ElapsedMs(const BenchClock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// written by the LAB2RGB loop so that it is not optimized away
+static volatile unsigned int s_sink;
+
+//=================================================================================
+///	BenchImage
+//=================================================================================
+struct BenchImage
+{
+	string				content;		// flat, textured, noisy or the photo name
+	vector<UINT>		img;			// 0x00RRGGBB
+	int					width;
+	int					height;
+
+	BenchImage() : width(0), height(0) {}
+};
+
+//=================================================================================
+///	BenchResult
+///
+///	Samples of one kernel on one image, in milliseconds.
+//=================================================================================
+struct BenchResult
+{
+	string				kernel;
+	string				content;
+	int					width;
+	int					height;
+	int					calls;			// per sample
+	vector<double>		samples;
+
+	double				mean;
+	double				median;
+	double				stddev;
+	double				minimum;
+
+	BenchResult() : width(0), height(0), calls(0), mean(0), median(0), stddev(0), minimum(0) {}
+
+	void Summarize()
+	{
+		if( samples.empty() ) return;
+		vector<double> sorted(samples);
+		sort(sorted.begin(), sorted.end());
+		size_t n = sorted.size();
+		median	= (n & 1) ? sorted[n/2] : 0.5*(sorted[n/2-1] + sorted[n/2]);
+		minimum	= sorted[0];
+		mean	= 0;
+		for( size_t i = 0; i < n; i++ ) mean += sorted[i];
+		mean /= n;
+		double var(0);
+		for( size_t i = 0; i < n; i++ ) var += (sorted[i] - mean)*(sorted[i] - mean);
+		stddev = n > 1 ? sqrt(var/(n - 1)) : 0;
+	}
+	double NsPerPixel() const { return mean*1e6/(double(width)*height); }
+	double MPixelsPerSecond() const { return mean > 0 ? double(width)*height/(mean*1e3) : 0; }
+};
+
+//=================================================================================
+///	BenchOptions
+//=================================================================================
+struct BenchOptions
+{
+	vector<int>			widths;
+	vector<int>			heights;
+	vector<string>		contents;
+	vector<string>		photos;
+	string				kernels;		// comma separated substrings, empty for all
+	string				format;			// text, json or csv
+	string				output;			// file, empty for stdout
+	int					repeat;
+	int					sigmaS;
+	float				sigmaR;
+	int					minRegion;
+
+	BenchOptions() : format("text"), repeat(5), sigmaS(7), sigmaR(10), minRegion(20) {}
+};
+
+//=================================================================================
+///	PrintUsage
+//=================================================================================
+static void PrintUsage(const char* prog)
+{
+	cerr << "Usage: " << prog << " [options] [photo] ...\n"
+		 << "Options:\n"
+		 << "  --sizes <list>   comma separated WxH sizes of the synthetic images\n"
+		 << "                   (default 160x120,320x240,640x480)\n"
+		 << "  --content <list> comma separated subset of flat, textured, noisy\n"
+		 << "                   (default all three; none for photos only)\n"
+		 << "  --kernels <list> only run kernels whose name contains one of these\n"
+		 << "  --repeat <n>     timed runs per kernel and image (default 5)\n"
+		 << "  -s <sigmaS> -r <sigmaR> -m <minRegion>  mean shift settings (7, 10, 20)\n"
+		 << "  --format <text|json|csv>  report format (default text)\n"
+		 << "  -o <file>        write the report to file instead of stdout\n"
+#ifdef SRD_HAVE_OPENCV
+		 << "Photos may be in any format OpenCV reads, e.g. the dataSource folder.\n";
+#else
+		 << "Photos must be binary PPM files (built without OpenCV).\n";
+#endif
+}
+
+//=================================================================================
+///	SplitList
+//=================================================================================
+static vector<string> SplitList(const string& text)
+{
+	vector<string> items;
+	stringstream ss(text);
+	string item;
+	while( getline(ss, item, ',') )
+	{
+		if( !item.empty() ) items.push_back(item);
+	}
+	return items;
+}
+
+//=================================================================================
+///	MakeImage
+///
+///	Synthetic content, the same for a given size on every run:
+///	  flat      a few large uniform regions
+///	  textured  smooth stripes and gradients
+///	  noisy     independent random pixels
+//=================================================================================
+static void MakeImage(const string& content, const int& width, const int& height, BenchImage& image)
+{
+	image.content	= content;
+	image.width		= width;
+	image.height	= height;
+	image.img.resize(size_t(width)*height);
+
+	unsigned int seed = 12345u + unsigned(width)*31u + unsigned(height);
+	for( int y = 0; y < height; y++ )
+	{
+		for( int x = 0; x < width; x++ )
+		{
+			int r(0), g(0), b(0);
+			if( content == "flat" )
+			{
+				bool disc = (x - width/2)*(x - width/2) + (y - height/2)*(y - height/2) < (height/4)*(height/4);
+				bool band = y < height/5;
+				r = disc ? 220 : (band ? 40 : 90);
+				g = disc ? 50 : (band ? 90 : 140);
+				b = disc ? 40 : (band ? 200 : 70);
+			}
+			else if( content == "textured" )
+			{
+				r = int(128 + 100*sin(x*0.15) * cos(y*0.05));
+				g = int(128 + 90*sin((x + y)*0.08));
+				b = (x*255/(width > 1 ? width - 1 : 1) + (y/8 % 2)*60) % 256;
+			}
+			else
+			{
+				seed = seed*1664525u + 1013904223u;
+				r = seed >> 24;
+				g = (seed >> 16) & 0xff;
+				b = (seed >> 8) & 0xff;
+			}
+			image.img[size_t(y)*width + x] = UINT(r) << 16 | UINT(g) << 8 | UINT(b);
+		}
+	}
+}
+
+//=================================================================================
+///	Wanted
+//=================================================================================
+static bool Wanted(const BenchOptions& opt, const string& kernel)
+{
+	if( opt.kernels.empty() ) return true;
+	vector<string> names = SplitList(opt.kernels);
+	for( size_t i = 0; i < names.size(); i++ )
+	{
+		if( kernel.find(names[i]) != string::npos ) return true;
+	}
+	return false;
+}
+
+static BenchResult& ResultFor(vector<BenchResult>& results, const string& kernel, const BenchImage& image)
+{
+	for( size_t i = 0; i < results.size(); i++ )
+	{
+		BenchResult& r = results[i];
+		if( r.kernel == kernel && r.content == image.content && r.width == image.width && r.height == image.height ) return r;
+	}
+	BenchResult r;
+	r.kernel	= kernel;
+	r.content	= image.content;
+	r.width		= image.width;
+	r.height	= image.height;
+	results.push_back(r);
+	return results.back();
+}
+
+//=================================================================================
+///	BenchImageKernels
+///
+///	Runs every wanted kernel on one image. Run 0 warms the caches and is
+///	not recorded.
+//=================================================================================
+static void BenchImageKernels(const BenchOptions& opt, const BenchImage& image, vector<BenchResult>& results)
+{
+	const int sz = image.width*image.height;
+	Saliency sal;
+	vector<double> lvec, avec, bvec;
+	sal.RGB2LAB(image.img, lvec, avec, bvec);
+
+	vector<double> kernel(0);
+	kernel.push_back(1.0);
+	kernel.push_back(2.0);
+	kernel.push_back(1.0);
+
+	for( int run = 0; run <= opt.repeat; run++ )
+	{
+		if( Wanted(opt, "RGB2LAB") )
+		{
+			vector<double> l, a, b;
+			BenchClock::time_point start = BenchClock::now();
+			sal.RGB2LAB(image.img, l, a, b);
+			double ms = ElapsedMs(start);
+			BenchResult& r = ResultFor(results, "RGB2LAB", image);
+			r.calls = 1;
+			if( run ) r.samples.push_back(ms);
+		}
+		if( Wanted(opt, "GaussianSmooth") )
+		{
+			vector<double> smooth;
+			BenchClock::time_point start = BenchClock::now();
+			sal.GaussianSmooth(lvec, image.width, image.height, kernel, smooth);
+			double ms = ElapsedMs(start);
+			BenchResult& r = ResultFor(results, "GaussianSmooth", image);
+			r.calls = 1;
+			if( run ) r.samples.push_back(ms);
+		}
+
+		msImageProcessor mss;
+		mss.DefineLabImage(&lvec[0], &avec[0], &bvec[0], image.height, image.width);
+		if( Wanted(opt, "LAB2RGB") )
+		{
+			unsigned int checksum(0);
+			BenchClock::time_point start = BenchClock::now();
+			for( int i = 0; i < sz; i++ )
+			{
+				BYTE r, g, b;
+				mss.LAB2RGB(float(lvec[i]), float(avec[i]), float(bvec[i]), r, g, b);
+				checksum += r + g + b;
+			}
+			double ms = ElapsedMs(start);
+			BenchResult& r = ResultFor(results, "LAB2RGB", image);
+			r.calls = 1;
+			if( run ) r.samples.push_back(ms);
+			s_sink = checksum;
+		}
+
+		// the mean shift kernels, from the report of one segmentation
+		static const char* msKernels[] = {"NewOptimizedFilter2", "Connect", "BuildRAM", "TransitiveClosure", "Prune"};
+		bool any(false);
+		for( size_t k = 0; k < sizeof(msKernels)/sizeof(msKernels[0]); k++ ) any = any || Wanted(opt, msKernels[k]);
+		if( !any ) continue;
+
+		mss.ResetTimingReport();
+		mss.Segment(opt.sigmaS, opt.sigmaR, opt.minRegion, HIGH_SPEEDUP);
+		msKernelTiming report[MS_TIMING_KERNELS];
+		int count = mss.GetTimingReport(report, MS_TIMING_KERNELS);
+		for( int i = 0; i < count; i++ )
+		{
+			string name(report[i].kernel);
+			if( !Wanted(opt, name) ) continue;
+			BenchResult& r = ResultFor(results, name, image);
+			r.calls = report[i].calls;
+			if( run ) r.samples.push_back(report[i].ms);
+		}
+	}
+}
+
+//=================================================================================
+///	WriteReport
+//=================================================================================
+static void WriteReport(const BenchOptions& opt, const vector<BenchResult>& results, FILE* out)
+{
+	char stamp[32];
+	time_t now = time(NULL);
+	strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+	if( opt.format == "json" )
+	{
+		fprintf(out, "{\n  \"benchmark\": \"kernels\",\n  \"time\": \"%s\",\n  \"repeat\": %d,\n"
+			"  \"sigmaS\": %d,\n  \"sigmaR\": %g,\n  \"minRegion\": %d,\n  \"results\": [\n",
+			stamp, opt.repeat, opt.sigmaS, opt.sigmaR, opt.minRegion);
+		for( size_t i = 0; i < results.size(); i++ )
+		{
+			const BenchResult& r = results[i];
+			fprintf(out, "    {\"kernel\": \"%s\", \"content\": \"%s\", \"width\": %d, \"height\": %d, \"calls\": %d, "
+				"\"samples\": %d, \"mean_ms\": %.4f, \"median_ms\": %.4f, \"stddev_ms\": %.4f, \"min_ms\": %.4f, "
+				"\"ns_per_pixel\": %.3f, \"mpixels_per_s\": %.3f}%s\n",
+				r.kernel.c_str(), r.content.c_str(), r.width, r.height, r.calls, int(r.samples.size()),
+				r.mean, r.median, r.stddev, r.minimum, r.NsPerPixel(), r.MPixelsPerSecond(),
+				i + 1 < results.size() ? "," : "");
+		}
+		fprintf(out, "  ]\n}\n");
+	}
+	else if( opt.format == "csv" )
+	{
+		fprintf(out, "time,kernel,content,width,height,calls,samples,mean_ms,median_ms,stddev_ms,min_ms,ns_per_pixel,mpixels_per_s\n");
+		for( size_t i = 0; i < results.size(); i++ )
+		{
+			const BenchResult& r = results[i];
+			fprintf(out, "%s,%s,%s,%d,%d,%d,%d,%.4f,%.4f,%.4f,%.4f,%.3f,%.3f\n",
+				stamp, r.kernel.c_str(), r.content.c_str(), r.width, r.height, r.calls, int(r.samples.size()),
+				r.mean, r.median, r.stddev, r.minimum, r.NsPerPixel(), r.MPixelsPerSecond());
+		}
+	}
+	else
+	{
+		fprintf(out, "%-20s %-16s %10s %6s %10s %10s %9s %10s %10s\n",
+			"kernel", "content", "size", "calls", "mean_ms", "median_ms", "stddev%", "ns/pixel", "Mpixel/s");
+		for( size_t i = 0; i < results.size(); i++ )
+		{
+			const BenchResult& r = results[i];
+			char size[32];
+			sprintf(size, "%dx%d", r.width, r.height);
+			fprintf(out, "%-20s %-16s %10s %6d %10.3f %10.3f %8.1f%% %10.2f %10.2f\n",
+				r.kernel.c_str(), r.content.c_str(), size, r.calls, r.mean, r.median,
+				r.mean > 0 ? 100.0*r.stddev/r.mean : 0.0, r.NsPerPixel(), r.MPixelsPerSecond());
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions opt;
+	string sizes = "160x120,320x240,640x480";
+	string contents = "flat,textured,noisy";
+
+	for( int a = 1; a < argc; a++ )
+	{
+		string arg(argv[a]);
+		bool hasvalue = (a + 1 < argc);
+		if( arg == "-h" || arg == "--help" )
+		{
+			PrintUsage(argv[0]);
+			return 0;
+		}
+		else if( arg == "--sizes" && hasvalue )		sizes = argv[++a];
+		else if( arg == "--content" && hasvalue )	contents = argv[++a];
+		else if( arg == "--kernels" && hasvalue )	opt.kernels = argv[++a];
+		else if( arg == "--repeat" && hasvalue )	opt.repeat = atoi(argv[++a]);
+		else if( arg == "--format" && hasvalue )	opt.format = argv[++a];
+		else if( arg == "-o" && hasvalue )			opt.output = argv[++a];
+		else if( arg == "-s" && hasvalue )			opt.sigmaS = atoi(argv[++a]);
+		else if( arg == "-r" && hasvalue )			opt.sigmaR = (float)atof(argv[++a]);
+		else if( arg == "-m" && hasvalue )			opt.minRegion = atoi(argv[++a]);
+		else if( !arg.empty() && arg[0] == '-' )
+		{
+			cerr << "unknown or incomplete option " << arg << endl;
+			PrintUsage(argv[0]);
+			return 2;
+		}
+		else opt.photos.push_back(arg);
+	}
+	if( opt.repeat < 1 || opt.sigmaS <= 0 || opt.sigmaR <= 0 || opt.minRegion < 0 ||
+		(opt.format != "text" && opt.format != "json" && opt.format != "csv") )
+	{
+		PrintUsage(argv[0]);
+		return 2;
+	}
+
+	vector<string> sizeList = SplitList(sizes);
+	for( size_t i = 0; i < sizeList.size(); i++ )
+	{
+		int w(0), h(0);
+		if( 2 != sscanf(sizeList[i].c_str(), "%dx%d", &w, &h) || w < 2 || h < 2 )
+		{
+			cerr << "bad size " << sizeList[i] << endl;
+			return 2;
+		}
+		opt.widths.push_back(w);
+		opt.heights.push_back(h);
+	}
+	opt.contents = SplitList(contents == "none" ? string() : contents);
+	for( size_t i = 0; i < opt.contents.size(); i++ )
+	{
+		const string& c = opt.contents[i];
+		if( c != "flat" && c != "textured" && c != "noisy" )
+		{
+			cerr << "unknown content " << c << endl;
+			return 2;
+		}
+	}
+
+	vector<BenchResult> results;
+	for( size_t c = 0; c < opt.contents.size(); c++ )
+	{
+		for( size_t s = 0; s < opt.widths.size(); s++ )
+		{
+			BenchImage image;
+			MakeImage(opt.contents[c], opt.widths[s], opt.heights[s], image);
+			BenchImageKernels(opt, image, results);
+		}
+	}
+	for( size_t p = 0; p < opt.photos.size(); p++ )
+	{
+		BenchImage image;
+		image.content = BenchmarkPhotoName(opt.photos[p]);
+		if( !LoadBenchmarkPhoto(opt.photos[p], image.img, image.width, image.height) )
+		{
+			cerr << opt.photos[p] << ": cannot read image" << endl;
+			continue;
+		}
+		BenchImageKernels(opt, image, results);
+	}
+	for( size_t i = 0; i < results.size(); i++ ) results[i].Summarize();
+
+	FILE* out = stdout;
+	if( !opt.output.empty() && NULL == (out = fopen(opt.output.c_str(), "w")) )
+	{
+		cerr << "cannot write " << opt.output << endl;
+		return 1;
+	}
+	WriteReport(opt, results, out);
+	if( out != stdout ) fclose(out);
+	return 0;
+}
@@ -0,0 +1,112 @@
+// MappedFile.cpp: implementation of the MappedFile class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+MappedFile::MappedFile()
+	: m_data(NULL), m_size(0)
+#ifdef _WIN32
+	, m_file(INVALID_HANDLE_VALUE), m_mapping(NULL)
+#else
+	, m_fd(-1)
+#endif
+{
+
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const string& path)
+{
+	Close();
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if( INVALID_HANDLE_VALUE == m_file ) return false;
+
+	LARGE_INTEGER size;
+	if( !GetFileSizeEx(m_file, &size) || 0 == size.QuadPart || ULONGLONG(size.QuadPart) > size_t(-1) )
+	{
+		Close();
+		return false;
+	}
+	m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if( NULL == m_mapping )
+	{
+		Close();
+		return false;
+	}
+	m_data = (const unsigned char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if( NULL == m_data )
+	{
+		Close();
+		return false;
+	}
+	m_size = size_t(size.QuadPart);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if( m_data ) UnmapViewOfFile(m_data);
+	if( m_mapping ) CloseHandle(m_mapping);
+	if( INVALID_HANDLE_VALUE != m_file ) CloseHandle(m_file);
+	m_data		= NULL;
+	m_size		= 0;
+	m_mapping	= NULL;
+	m_file		= INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::Open(const string& path)
+{
+	Close();
+	m_fd = open(path.c_str(), O_RDONLY);
+	if( m_fd < 0 ) return false;
+
+	struct stat st;
+	if( fstat(m_fd, &st) != 0 || st.st_size <= 0 )
+	{
+		Close();
+		return false;
+	}
+	void* p = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_SHARED, m_fd, 0);
+	if( MAP_FAILED == p )
+	{
+		Close();
+		return false;
+	}
+	m_data = (const unsigned char*)p;
+	m_size = size_t(st.st_size);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if( m_data ) munmap((void*)m_data, m_size);
+	if( m_fd >= 0 ) close(m_fd);
+	m_data	= NULL;
+	m_size	= 0;
+	m_fd	= -1;
+}
+
+#endif
@@ -0,0 +1,46 @@
+// MappedFile.h: interface for the MappedFile class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Read-only memory mapping of a whole file (mmap on POSIX systems, a file
+// mapping object on Windows). The pages are only read from disk when they
+// are touched, so a reader can look at part of a large file without
+// loading the rest.
+//===========================================================================
+
+#if !defined(_MAPPEDFILE_H_INCLUDED_)
+#define _MAPPEDFILE_H_INCLUDED_
+
+#include <string>
+#include <stddef.h>
+using namespace std;
+
+class MappedFile
+{
+public:
+	MappedFile();
+	virtual ~MappedFile();
+
+	// False if the file cannot be opened, is empty or cannot be mapped.
+	bool Open(const string& path);
+	void Close();
+
+	bool IsOpen() const { return NULL != m_data; }
+	const unsigned char* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const unsigned char*				m_data;
+	size_t								m_size;
+#ifdef _WIN32
+	void*								m_file;			// HANDLEs
+	void*								m_mapping;
+#else
+	int									m_fd;
+#endif
+};
+
+#endif // !defined(_MAPPEDFILE_H_INCLUDED_)
@@ -31,7 +31,6 @@ and they are is available at:
 
 Implemented by Chris M. Christoudias, Bogdan Georgescu
 ********************************************************/
-#include	<stdafx.h>
 //include Region Adjacency List class prototype
 #include	"RAList.h"
 
@@ -44,7 +44,6 @@ Implemented by Chris M. Christoudias, Bogdan Georgescu
 
 
 //Include Needed Libraries
-#include <stdafx.h>
 #include	"ms.h"
 #include	<string.h>
 #include	<stdlib.h>
@@ -80,6 +79,7 @@ MeanShift::MeanShift( void )
 	
 	//initialize input data set storage structures...
 	data						= NULL;
+	dataBorrowed				= false;
 	
 	//initialize input data set kd-tree
 	root						= NULL;
@@ -436,53 +436,50 @@ void MeanShift::DefineInput(float *x, int L_, int N_)
 void MeanShift::DefineLInput(float *x, int ht, int wt, int N_)
 {
 	
-	//if input data is defined de-allocate memory, and
-	//re-initialize the input data structure
-	if((class_state.INPUT_DEFINED)||(class_state.LATTICE_DEFINED))
-		ResetInput();
-	
-	//Obtain lattice height and width
-	if(((height	= ht) <= 0)||((width	= wt) <= 0))
-	{
-		ErrorHandler("MeanShift", "DefineLInput", "Lattice defined using zero or negative height and/or width.");
-		return;
-	}
-	
-	//Obtain input data dimension
-	if((N = N_) <= 0)
+	//make sure x is not NULL...
+	if(!x)
 	{
-		ErrorHandler("MeanShift", "DefineInput", "Input defined using zero or negative dimension.");
+		ErrorHandler("MeanShift", "DefineLInput", "Input data set is NULL.");
 		return;
 	}
 	
-	//compute the data length, L, of input data set
-	//using height and width
-	L		= height*width;
+	//copy x into the mean shift class
+	DefineLattice(x, ht, wt, N_, false);
 	
-	//Allocate memory for input data set, and copy
-	//x into the private data members of the mean
-	//shift class
-	InitializeInput(x);
+	//done.
+	return;
 	
-	//check for errors
-	if(ErrorStatus == EL_ERROR)
-		return;
+}
 
-	//allocate memory for weight map
-	if(!(weightMap = new float [L]))
+/*******************************************************/
+/*Define Borrowed Lattice                              */
+/*******************************************************/
+/*Defines a lattice input that uses the caller's data  */
+/*set in place.                                        */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - x is a floating point array of ht*wt, N_ di- */
+/*        mensional data points that stays valid and   */
+/*        unchanged until the input is re-defined or   */
+/*        the class is destroyed                       */
+/*Post:                                                */
+/*      - the lattice has been defined as by DefineL-  */
+/*        Input without copying x; x is not de-alloc-  */
+/*        ated by the mean shift class.                */
+/*******************************************************/
+
+void MeanShift::DefineLInputBorrowed(float *x, int ht, int wt, int N_)
+{
+	
+	//make sure x is not NULL...
+	if(!x)
 	{
-		ErrorHandler("MeanShift", "InitializeInput", "Not enough memory.");
+		ErrorHandler("MeanShift", "DefineLInputBorrowed", "Input data set is NULL.");
 		return;
 	}
-
-	//initialize weightMap to an array of zeros
-	memset(weightMap, 0, L*(sizeof(float)));
 	
-	//Indicate that a lattice input has recently been
-	//defined
-	class_state.LATTICE_DEFINED	= true;
-	class_state.INPUT_DEFINED	= false;
-	class_state.OUTPUT_DEFINED	= false;
+	//use x in place
+	DefineLattice(x, ht, wt, N_, true);
 	
 	//done.
 	return;
@@ -1163,6 +1160,44 @@ void MeanShift::ErrorHandler(char *className, char *methodName, char* errmsg)
 	ErrorStatus = EL_ERROR;
 	
 	
+}
+
+  /*/\/\/\/\/\/\/\/\/\/\/\/\/\*/
+  /*** Lattice Input Storage ***/
+  /*\/\/\/\/\/\/\/\/\/\/\/\/\/*/
+
+/*******************************************************/
+/*Allocate Lattice Input                               */
+/*******************************************************/
+/*Defines a lattice input and returns its storage so   */
+/*that a derived class can convert its data set into   */
+/*it directly.                                         */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - ht and wt are the height and width of the    */
+/*        lattice and N_ the dimension of its points   */
+/*Post:                                                */
+/*      - the lattice has been defined as by DefineL-  */
+/*        Input, with uninitialized data, and the      */
+/*        ht*wt*N_ floats of data have been returned;  */
+/*        they must be filled before the input is      */
+/*        used.                                        */
+/*      - NULL has been returned if an error occured.  */
+/*******************************************************/
+
+float *MeanShift::AllocateLInput(int ht, int wt, int N_)
+{
+	
+	//allocate only
+	DefineLattice(NULL, ht, wt, N_, false);
+	
+	//check for errors
+	if(ErrorStatus == EL_ERROR)
+		return NULL;
+	
+	//done.
+	return data;
+	
 }
 
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
@@ -1393,6 +1428,88 @@ void MeanShift::CreateBST( void )
 	
 }
 
+/*******************************************************/
+/*Define Lattice Input                                 */
+/*******************************************************/
+/*Defines the lattice input common to DefineLInput,    */
+/*DefineLInputBorrowed and AllocateLInput.             */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - x is a floating point array of ht*wt, N_ di- */
+/*        mensional data points, or NULL              */
+/*      - borrow is true if x is to be used in place   */
+/*Post:                                                */
+/*      - the lattice has been defined with a copy of  */
+/*        x, with x itself (borrow), or with uninit-   */
+/*        ialized storage if x is NULL.                */
+/*******************************************************/
+
+void MeanShift::DefineLattice(float *x, int ht, int wt, int N_, bool borrow)
+{
+	
+	//if input data is defined de-allocate memory, and
+	//re-initialize the input data structure
+	if((class_state.INPUT_DEFINED)||(class_state.LATTICE_DEFINED))
+		ResetInput();
+	
+	//Obtain lattice height and width
+	if(((height	= ht) <= 0)||((width	= wt) <= 0))
+	{
+		ErrorHandler("MeanShift", "DefineLInput", "Lattice defined using zero or negative height and/or width.");
+		return;
+	}
+	
+	//Obtain input data dimension
+	if((N = N_) <= 0)
+	{
+		ErrorHandler("MeanShift", "DefineInput", "Input defined using zero or negative dimension.");
+		return;
+	}
+	
+	//compute the data length, L, of input data set
+	//using height and width
+	L		= height*width;
+	
+	//Allocate memory for input data set, and copy
+	//x into the private data members of the mean
+	//shift class, unless x is borrowed
+	if(borrow)
+	{
+		data			= x;
+		dataBorrowed	= true;
+	}
+	else
+		InitializeInput(x);
+	
+	//check for errors
+	if(ErrorStatus == EL_ERROR)
+		return;
+
+	//allocate memory for weight map, releasing that of the
+	//previous lattice
+	if(weightMap)
+		delete [] weightMap;
+	weightMapDefined	= false;
+	if(!(weightMap = new float [L]))
+	{
+		ErrorHandler("MeanShift", "InitializeInput", "Not enough memory.");
+		return;
+	}
+
+	//initialize weightMap to an array of zeros
+	memset(weightMap, 0, L*(sizeof(float)));
+	
+	//Indicate that a lattice input has recently been
+	//defined
+	class_state.LATTICE_DEFINED	= true;
+	class_state.INPUT_DEFINED	= false;
+	class_state.OUTPUT_DEFINED	= false;
+	
+	//done.
+	return;
+	
+}
+
 /*******************************************************/
 /*Initialize Input                                     */
 /*******************************************************/
@@ -1401,12 +1518,13 @@ void MeanShift::CreateBST( void )
 /*******************************************************/
 /*Pre:                                                 */
 /*      - x is a floating point array of L, N dimens-  */
-/*        ional input data points                      */
+/*        ional input data points, or NULL             */
 /*Post:                                                */
 /*      - memory has been allocated for the input data */
 /*        structure and x has been stored using into   */
 /*        the mean shift class using the resulting     */
-/*        structure.                                   */
+/*        structure; if x is NULL the memory is left   */
+/*        uninitialized.                               */
 /*******************************************************/
 
 void MeanShift::InitializeInput(float *x)
@@ -1420,9 +1538,8 @@ void MeanShift::InitializeInput(float *x)
 	}
 	
 	//copy x into data
-	int i;
-	for(i = 0; i < L*N; i++)
-		data[i]	= x[i];
+	if(x)
+		memcpy(data, x, L*N*sizeof(float));
 	
 	//done.
 	return;
@@ -1444,12 +1561,14 @@ void MeanShift::InitializeInput(float *x)
 void MeanShift::ResetInput( void )
 {
 	
-	//de-allocate memory of input data structure (BST)
-	if(data)	delete [] data;
+	//de-allocate memory of input data structure (BST),
+	//leaving a borrowed data set to its owner
+	if((data)&&(!dataBorrowed))	delete [] data;
 	if(forest)	delete [] forest;
 	
 	//initialize input data structure for re-use
-	data	= NULL;
+	data			= NULL;
+	dataBorrowed	= false;
 	forest	= NULL;
 	root	= NULL;
 	L		= 0;
@@ -362,6 +362,38 @@ class MeanShift {
 
   void	DefineLInput(float*, int, int, int);
 
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|      * Define Borrowed Lattice Input *             |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   The same as DefineLInput, except that x is used  |//
+  //|   in place rather than copied, which saves a copy  |//
+  //|   of the whole data set.                           |//
+  //|                                                    |//
+  //|   Lifetime: x must stay valid and unchanged until  |//
+  //|   the input is defined again or the object is      |//
+  //|   destroyed. The class only reads x and never de-  |//
+  //|   allocates it.                                    |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======                                           |//
+  //|       DefineLInputBorrowed(x, height, width, N)    |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+  void	DefineLInputBorrowed(float*, int, int, int);
+
  /*/\/\/\/\/\/\/\/\/\/\/\*/
  /*  Lattice Weight Map  */
  /*\/\/\/\/\/\/\/\/\/\/\/*/
@@ -707,6 +739,19 @@ class MeanShift {
 
    void ErrorHandler(char*, char*, char*);				// flags an error and halts the system
 
+	 /*/\/\/\/\/\/\/\/\/\/\/\/\/\*/
+	 /* Lattice Input Storage  */
+	 /*\/\/\/\/\/\/\/\/\/\/\/\/*/
+
+   ////////////////////////////////////////////////////////////
+   // <<*>> Usage: x = AllocateLInput(height, width, N) <<*>> //
+   ////////////////////////////////////////////////////////////
+
+   float *AllocateLInput(int, int, int);				// defines a lattice input as DefineLInput does, but returns its
+														// (uninitialized) storage for the caller to convert the data set
+														// into directly instead of copying it from another buffer; NULL
+														// if an error was flagged
+
 
   //===============================
   // *** Protected Data Members ***
@@ -736,6 +781,9 @@ class MeanShift {
 														// data = <x11, x12, ..., x1N,...,xL1, xL2, ..., xLN>
 														// in the case of the lattice the i in data(i,j) corresponds
 
+	bool			dataBorrowed;						// data belongs to the caller of DefineLInputBorrowed and is
+														// not de-allocated by this class
+
    //##########################################
    //######## LATTICE DATA STRUCTURE ##########
    //##########################################
@@ -812,6 +860,9 @@ class MeanShift {
 
    void	InitializeInput	(float*);						// Allocates memory for and initializes the input data structure
 
+   void	DefineLattice	(float*, int, int, int, bool);	// defines a lattice input, copying, borrowing (true) or, if x
+														// is NULL, only allocating the data set
+
    void	ResetInput		( void );						// de-allocate memory for and re-initialize input data structure
 														// and mode structure
 
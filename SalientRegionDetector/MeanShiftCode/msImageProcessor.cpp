@@ -32,7 +32,6 @@ and they are is available at:
 
 Implemented by Chris M. Christoudias, Bogdan Georgescu
 ********************************************************/
-#include <stdafx.h>
 //include image processor class prototype
 #include	"msImageProcessor.h"
 
@@ -42,6 +41,15 @@ Implemented by Chris M. Christoudias, Bogdan Georgescu
 #include	<assert.h>
 #include	<string.h>
 #include	<stdlib.h>
+#include	<chrono>
+
+//use SSE2 for the boundary pass where the target supports it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define	MS_USE_SSE2
+#include	<emmintrin.h>
+#endif
+
+std::atomic<msKernelHook>	msImageProcessor::kernelHook(NULL);
 
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
@@ -72,14 +80,25 @@ msImageProcessor::msImageProcessor( void )
 
 	//initialize region list
 	regionList			= NULL;
+	labelRuns			= NULL;
 
 	//initialize output structures...
 	msRawData			= NULL;
+	rawDataStale		= false;
 	labels				= NULL;
+	labels16			= NULL;
+	modeCapacity		= 0;
+	outputLength		= 0;
 	modes				= NULL;
 	modePointCounts		= NULL;
 	regionCount			= 0;
 
+	//no filter result has been saved
+	savedLabels				= NULL;
+	savedModes				= NULL;
+	savedModePointCounts	= NULL;
+	savedRegionCount		= 0;
+
 	//intialize temporary buffers used for
 	//performing connected components
 	indexTable			= NULL;
@@ -93,6 +112,13 @@ msImageProcessor::msImageProcessor( void )
 	//intialize visit table to having NULL entries
 	visitTable			= NULL;
 
+	//compact mode is off by default; no memory has been
+	//reported yet
+	compactMode			= false;
+	filterScratchBytes	= 0;
+	memoryStages		= 0;
+	timingKernels		= 0;
+
 	//initialize epsilon such that transitive closure
 	//does not take edge strength into consideration when
 	//fusing regions of similar color
@@ -105,6 +131,14 @@ msImageProcessor::msImageProcessor( void )
 
 
    LUV_treshold = 1.0;
+
+	//speed up threshold of the HIGH_SPEEDUP filter, the EDISON
+	//default; see SetSpeedThreshold()
+	speedThreshold		= 0.1f;
+
+	//no halt conditions until SetHaltConditions() is called
+	haltDeadline		= 0;
+	haltFlag			= NULL;
 }
 
 /*******************************************************/
@@ -118,10 +152,14 @@ msImageProcessor::msImageProcessor( void )
 msImageProcessor::~msImageProcessor( void )
 {
 
-	//de-allocate memory
-	if(class_state.OUTPUT_DEFINED)	DestroyOutput();
+	//de-allocate memory (the output of an image may
+	//still be held after another image was defined)
+	DestroyOutput();
 	if(regionList)					delete regionList;
 	regionList = NULL;
+	if(labelRuns)					delete labelRuns;
+	labelRuns = NULL;
+	DiscardFilterResult();
 
 	//done.
 
@@ -163,9 +201,15 @@ void msImageProcessor::DefineImage(byte *data_, imageType type, int height_, int
 	else
 		dim = 1;
 
+	//define input defined on a lattice using mean shift base class,
+	//converting straight into its storage rather than into a
+	//buffer that would then be copied
+	float	*luv	= AllocateLInput(height_, width_, dim);
+	if(!luv)
+		return;
+
 	//perfor rgb to luv conversion
 	int		i;
-	float	*luv	= new float [height_*width_*dim];
 	if(dim == 1)
 	{
 		for(i = 0; i < height_*width_; i++)
@@ -178,8 +222,63 @@ void msImageProcessor::DefineImage(byte *data_, imageType type, int height_, int
 		for(i = 0; i < sz; i+= 3)	RGB2LAB(data_[i], data_[i+1], data_[i+2], luv[i], luv[i+1], luv[i+2]);
 	}
 
+	//Define a default kernel if it has not been already
+	//defined by user
+	if(!h)
+	{
+		//define default kernel paramerters...
+		kernelType	k[2]		= {Uniform, Uniform};
+		int			P[2]		= {2, N};
+		float		tempH[2]	= {1.0 , 1.0};
+
+		//define default kernel in mean shift base class
+		DefineKernel(k, tempH, P, 2);
+	}
+
+	//start a new memory and timing report
+	memoryStages	= 0;
+	timingKernels	= 0;
+	RecordMemory("define", 0);
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Define Lab Image                                     */
+/*******************************************************/
+/*Uploads an image that is already in the Lab space    */
+/*into the image segmenter class to be segmented.      */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - l_, a_ and b_ are planar arrays of height_ x */
+/*        width_ Lab components in the scale produced  */
+/*        by RGB2LAB                                   */
+/*Post:                                                */
+/*      - the image specified has been uploaded into   */
+/*        the image segmenter class to be segmented,   */
+/*        exactly as DefineImage would have done for   */
+/*        the RGB image it was converted from.         */
+/*******************************************************/
+
+void msImageProcessor::DefineLabImage(const double *l_, const double *a_, const double *b_, int height_, int width_)
+{
+
 	//define input defined on a lattice using mean shift base class
-	DefineLInput(luv, height_, width_, dim);
+	int		i, sz = height_*width_;
+	float	*lab	= AllocateLInput(height_, width_, 3);
+	if(!lab)
+		return;
+
+	//interleave the planes into the layout expected by
+	//the mean shift base class (no colour conversion)
+	for(i = 0; i < sz; i++)
+	{
+		lab[3*i  ]	= (float)(l_[i]);
+		lab[3*i+1]	= (float)(a_[i]);
+		lab[3*i+2]	= (float)(b_[i]);
+	}
 
 	//Define a default kernel if it has not been already
 	//defined by user
@@ -194,8 +293,90 @@ void msImageProcessor::DefineImage(byte *data_, imageType type, int height_, int
 		DefineKernel(k, tempH, P, 2);
 	}
 
-	//de-allocate memory
-	delete [] luv;
+	//start a new memory and timing report
+	memoryStages	= 0;
+	timingKernels	= 0;
+	RecordMemory("define", 0);
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Define Image (View)                                  */
+/*******************************************************/
+/*Uploads an image given as a strided view into the    */
+/*image segmenter class to be segmented.               */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - image views height x width pixels in one of  */
+/*        the ImageView layouts                        */
+/*Post:                                                */
+/*      - the image specified has been uploaded into   */
+/*        the image segmenter class to be segmented,   */
+/*        exactly as DefineImage would have done for   */
+/*        the same pixels as RGB (or GREYSCALE) bytes. */
+/*******************************************************/
+
+void msImageProcessor::DefineImage(const ImageView& image)
+{
+
+	if(image.IsEmpty())
+	{
+		ErrorHandler("msImageProcessor", "DefineImage", "Image view is empty.");
+		return;
+	}
+
+	//obtain image dimension from the pixel layout
+	int dim		= ((image.layout == PIXEL_GRAY8) ? 1 : 3);
+	int	height_	= image.height, width_ = image.width;
+
+	//define input defined on a lattice using mean shift base class
+	float			*luv	= AllocateLInput(height_, width_, dim);
+	if(!luv)
+		return;
+
+	//convert row by row into its storage; rows that are not
+	//already packed 0x00RRGGBB are converted into a one row
+	//buffer first
+	int				i, j;
+	unsigned int	*row	= new unsigned int [width_];
+	float			*dst	= luv;
+	for(i = 0; i < height_; i++)
+	{
+		if(dim == 1)
+		{
+			const byte	*src	= image.Row(i);
+			for(j = 0; j < width_; j++)
+				*(dst++)	= (float)(src[j]);
+		}
+		else
+		{
+			const unsigned int	*src	= image.ReadRow(i, row);
+			for(j = 0; j < width_; j++, dst += 3)
+				RGB2LAB((byte)(src[j] >> 16), (byte)(src[j] >> 8), (byte)(src[j]), dst[0], dst[1], dst[2]);
+		}
+	}
+	delete [] row;
+
+	//Define a default kernel if it has not been already
+	//defined by user
+	if(!h)
+	{
+		//define default kernel paramerters...
+		kernelType	k[2]		= {Uniform, Uniform};
+		int			P[2]		= {2, N};
+		float		tempH[2]	= {1.0 , 1.0};
+
+		//define default kernel in mean shift base class
+		DefineKernel(k, tempH, P, 2);
+	}
+
+	//start a new memory and timing report
+	memoryStages	= 0;
+	timingKernels	= 0;
+	RecordMemory("define", 0);
 
 	//done.
 	return;
@@ -212,9 +393,13 @@ void msImageProcessor::DefineBgImage(byte* data_, imageType type, int height_, i
 	else
 		dim = 1;
 
+	//define input defined on a lattice using mean shift base class
+	float	*luv	= AllocateLInput(height_, width_, dim);
+	if(!luv)
+		return;
+
 	//perform texton classification
 	int		i;
-	float	*luv	= new float [height_*width_*dim];
 	if(dim == 1)
 	{
 		for(i = 0; i < height_*width_; i++)
@@ -226,9 +411,6 @@ void msImageProcessor::DefineBgImage(byte* data_, imageType type, int height_, i
 			RGBtoLUV(&data_[dim*i], &luv[dim*i]);
 	}
 
-	//define input defined on a lattice using mean shift base class
-	DefineLInput(luv, height_, width_, dim);
-
 	//Define a default kernel if it has not been already
 	//defined by user
 	if(!h)
@@ -242,9 +424,6 @@ void msImageProcessor::DefineBgImage(byte* data_, imageType type, int height_, i
 		DefineKernel(k, tempH, P, 2);
 	}
 
-	//de-allocate memory
-	delete [] luv;
-
 	//done.
 	return;
 
@@ -344,6 +523,33 @@ void msImageProcessor::RemoveWeightMap( void )
 /*******************************************************/
 
 void msImageProcessor::Filter(int sigmaS, float sigmaR, SpeedUpLevel speedUpLevel)
+{
+
+	//filter and label the image
+	ApplyFilter(sigmaS, sigmaR, speedUpLevel);
+	if(ErrorStatus != EL_OKAY)
+		return;
+
+	//release what compact mode does not need to keep
+	CompactOutput();
+	RecordMemory("output", 0);
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Apply Filter                                         */
+/*******************************************************/
+/*Filters the image and labels the resulting regions,  */
+/*leaving the classification structure at full size so */
+/*that Segment() can continue from it.                 */
+/*******************************************************/
+/*Pre/Post: see Filter().                              */
+/*******************************************************/
+
+void msImageProcessor::ApplyFilter(int sigmaS, float sigmaR, SpeedUpLevel speedUpLevel)
 {
 
 	//Check Class consistency...
@@ -355,15 +561,17 @@ void msImageProcessor::Filter(int sigmaS, float sigmaR, SpeedUpLevel speedUpLeve
 	// (4) if the dimension of the kernel agrees with that
 	//     of the defined data set
 	// if not ... flag an error!
+	if(ErrorStatus == EL_HALT)
+		ErrorStatus	= EL_OKAY;	//a halted call does not keep this one from starting
 	classConsistencyCheck(N+2, true);
 	if(ErrorStatus == EL_ERROR)
 		return;
 
 	//If the algorithm has been halted, then exit
-//	if((ErrorStatus = msSys.Progress((float)(0.0))) == EL_HALT)
-//	{
-//		return;
-//	}
+	if((ErrorStatus = CheckHalt()) == EL_HALT)
+	{
+		return;
+	}
 	
 	//If the image has just been read then allocate memory
 	//for and initialize output data structure used to store
@@ -395,25 +603,44 @@ void msImageProcessor::Filter(int sigmaS, float sigmaR, SpeedUpLevel speedUpLeve
 	//*****************************************************
 
 	//filter image according to speedup level...
+	double		kernelStart		= KernelClock();
+	const char	*filterKernel	= NULL;
 	switch(speedUpLevel)
 	{
 	//no speedup...
 	case NO_SPEEDUP:	
       //NonOptimizedFilter((float)(sigmaS), sigmaR);	break;
-      NewNonOptimizedFilter((float)(sigmaS), sigmaR);	break;
+      NewNonOptimizedFilter((float)(sigmaS), sigmaR);
+      filterKernel	= "NewNonOptimizedFilter";		break;
 	//medium speedup
 	case MED_SPEEDUP:	
       //OptimizedFilter1((float)(sigmaS), sigmaR);		break;
-      NewOptimizedFilter1((float)(sigmaS), sigmaR);		break;
+      NewOptimizedFilter1((float)(sigmaS), sigmaR);
+      filterKernel	= "NewOptimizedFilter1";		break;
 	//high speedup
 	case HIGH_SPEEDUP: 
       //OptimizedFilter2((float)(sigmaS), sigmaR);		break;
-      NewOptimizedFilter2((float)(sigmaS), sigmaR);		break;
+      if(compactMode)
+      {
+         CompactOptimizedFilter2((float)(sigmaS), sigmaR);
+         filterKernel	= "CompactOptimizedFilter2";
+      }
+      else
+      {
+         NewOptimizedFilter2((float)(sigmaS), sigmaR);
+         filterKernel	= "NewOptimizedFilter2";
+      }
+      break;
    // new speedup
 	}
+	if(filterKernel)
+		RecordTiming(filterKernel, kernelStart);
 
 	//****************** Deallocate Memory ******************
 
+	//report peak usage of the filter stage
+	RecordMemory("filter", filterScratchBytes);
+
 	//de-allocate memory used by basin of attraction mode structure
 	delete [] modeTable;
 	delete [] pointList;
@@ -423,15 +650,18 @@ void msImageProcessor::Filter(int sigmaS, float sigmaR, SpeedUpLevel speedUpLeve
 	pointList	= NULL;
 	pointCount	= 0;
 
+	//msRawData now holds the filtered image
+	rawDataStale	= false;
+
 	//*******************************************************
 
 	//If the algorithm has been halted, then de-allocate the output
 	//and exit
-//	if((ErrorStatus = msSys.Progress((float)(0.8))) == EL_HALT)
-//	{
-//		DestroyOutput();
-//		return;
-//	}
+	if(ErrorStatus == EL_HALT)
+	{
+		DestroyOutput();
+		return;
+	}
 
 	//Label image regions, also if segmentation is not to be
 	//performed use the resulting classification structure to
@@ -449,11 +679,9 @@ void msImageProcessor::Filter(int sigmaS, float sigmaR, SpeedUpLevel speedUpLeve
 			LUV_data[i] = (int)(msRawData[i] + 0.5);
 	}
    */
-   int i;
-   for (i=0; i<L*N; i++)
-   {
-      LUV_data[i] = msRawData[i];
-   }
+   //Connect only reads LUV_data, so use msRawData in place
+   //rather than a copy of it
+   LUV_data	= msRawData;
 
 
 //#ifdef PROMPT
@@ -514,17 +742,19 @@ void msImageProcessor::FuseRegions(float sigmaS, int minRegion)
 	// (4) if the dimension of the kernel agrees with that
 	//     of the defined data set
 	// if not ... flag an error!
+	if(ErrorStatus == EL_HALT)
+		ErrorStatus	= EL_OKAY;	//a halted call does not keep this one from starting
 	classConsistencyCheck(N+2, true);
 	if(ErrorStatus == EL_ERROR)
 		return;
 
 	//Check to see if the algorithm is to be halted, if so then
 	//destroy output and exit
-//	if((ErrorStatus = msSys.Progress((float)(0.8))) == EL_HALT)
-//	{
-//		if(class_state.OUTPUT_DEFINED)	DestroyOutput();
-//		return;
-//	}
+	if((ErrorStatus = CheckHalt()) == EL_HALT)
+	{
+		if(class_state.OUTPUT_DEFINED)	DestroyOutput();
+		return;
+	}
 
 	//obtain sigmaS (make sure it is not zero or negative, if not
 	//flag an error)
@@ -559,11 +789,9 @@ void msImageProcessor::FuseRegions(float sigmaS, int minRegion)
 				LUV_data[i] = (int)(data[i] + 0.5);
 		}
       */
-      int i;
-      for (i=0; i<L*N; i++)
-      {
-         LUV_data[i] = data[i];
-      }
+      //Connect only reads LUV_data, so use the input data
+      //in place rather than a copy of it
+      LUV_data	= data;
 		
 //#ifdef PROMPT
 //		msSys.Prompt("Connecting regions         ...");
@@ -584,13 +812,18 @@ void msImageProcessor::FuseRegions(float sigmaS, int minRegion)
 		
 	}
 
+	//otherwise fuse the regions of the current output, whose
+	//labels may be held in 16 bits
+	else
+		ExpandLabels();
+
 	//Check to see if the algorithm is to be halted, if so then
 	//destroy output and exit
-//	if((ErrorStatus = msSys.Progress((float)(0.85))) == EL_HALT)
-//	{
-//		DestroyOutput();
-//		return;
-//	}
+	if((ErrorStatus = CheckHalt()) == EL_HALT)
+	{
+		DestroyOutput();
+		return;
+	}
 
 //#ifdef PROMPT
 //	msSys.Prompt("Applying transitive closure...");
@@ -612,7 +845,7 @@ void msImageProcessor::FuseRegions(float sigmaS, int minRegion)
 		deltaRC = oldRC-regionCount;
 		oldRC = regionCount;
 		counter++;
-	} while ((deltaRC <= 0)&&(counter < 10));
+	} while ((deltaRC <= 0)&&(counter < 10)&&((ErrorStatus = CheckHalt()) != EL_HALT));
 
 	//de-allocate memory for visit table
 	delete [] visitTable;
@@ -620,12 +853,12 @@ void msImageProcessor::FuseRegions(float sigmaS, int minRegion)
 
 	//Check to see if the algorithm is to be halted, if so then
 	//destroy output and region adjacency matrix and exit
-//	if((ErrorStatus = msSys.Progress((float)(1.0))) == EL_HALT)
-//	{
-//		DestroyRAM();
-//		DestroyOutput();
-//		return;
-//	}
+	if((ErrorStatus == EL_HALT)||((ErrorStatus = CheckHalt()) == EL_HALT))
+	{
+		DestroyRAM();
+		DestroyOutput();
+		return;
+	}
 
 //#ifdef PROMPT
 //	double timer	= msSys.ElapsedTime();
@@ -645,26 +878,23 @@ void msImageProcessor::FuseRegions(float sigmaS, int minRegion)
 
 	//Check to see if the algorithm is to be halted, if so then
 	//destroy output and region adjacency matrix and exit
-//	if((ErrorStatus = msSys.Progress((float)(1.0))) == EL_HALT)
-//	{
-//		DestroyRAM();
-//		DestroyOutput();
-//		return;
-//	}
+	if((ErrorStatus == EL_HALT)||((ErrorStatus = CheckHalt()) == EL_HALT))
+	{
+		DestroyRAM();
+		DestroyOutput();
+		return;
+	}
 
 	//de-allocate memory for region adjacency matrix
 	DestroyRAM();
 
-	//output to msRawData
-	int i, j, label;
-	for(i = 0; i < L; i++)
-	{
-		label	= labels[i];
-		for(j = 0; j < N; j++)
-			{
-				msRawData[N*i+j] = modes[N*label+j];
-			}
-	}
+	//the output is now fully described by labels and modes;
+	//msRawData is only rebuilt if raw data is requested
+	rawDataStale	= true;
+
+	//release what compact mode does not need to keep
+	CompactOutput();
+	RecordMemory("fuse", 0);
 
 	//done.
 	return;
@@ -712,7 +942,7 @@ void msImageProcessor::Segment(int sigmaS, float sigmaR, int minRegion, SpeedUpL
 	}
 
 	//Apply mean shift to data set using sigmaS and sigmaR...
-	Filter(sigmaS, sigmaR, speedUpLevel);
+	ApplyFilter(sigmaS, sigmaR, speedUpLevel);
 
 	//check for errors
 	if(ErrorStatus == EL_ERROR)
@@ -724,11 +954,11 @@ void msImageProcessor::Segment(int sigmaS, float sigmaR, int minRegion, SpeedUpL
 
 	//Check to see if the algorithm is to be halted, if so then
 	//destroy output and exit
-//	if((ErrorStatus = msSys.Progress((float)(0.85))) == EL_HALT)
-//	{
-//		DestroyOutput();
-//		return;
-//	}
+	if((ErrorStatus = CheckHalt()) == EL_HALT)
+	{
+		DestroyOutput();
+		return;
+	}
 
 //#ifdef PROMPT
 //	msSys.Prompt("Applying transitive closure...");
@@ -750,7 +980,7 @@ void msImageProcessor::Segment(int sigmaS, float sigmaR, int minRegion, SpeedUpL
 		deltaRC = oldRC-regionCount;
 		oldRC = regionCount;
 		counter++;
-	} while ((deltaRC <= 0)&&(counter < 10));
+	} while ((deltaRC <= 0)&&(counter < 10)&&((ErrorStatus = CheckHalt()) != EL_HALT));
 
 	//de-allocate memory for visit table
 	delete [] visitTable;
@@ -758,12 +988,12 @@ void msImageProcessor::Segment(int sigmaS, float sigmaR, int minRegion, SpeedUpL
 
 	//Check to see if the algorithm is to be halted, if so then
 	//destroy output and regions adjacency matrix and exit
-//	if((ErrorStatus = msSys.Progress((float)(0.95))) == EL_HALT)
-//	{
-//		DestroyRAM();
-//		DestroyOutput();
-//		return;
-//	}
+	if((ErrorStatus == EL_HALT)||((ErrorStatus = CheckHalt()) == EL_HALT))
+	{
+		DestroyRAM();
+		DestroyOutput();
+		return;
+	}
 
 //#ifdef PROMPT
 //	double timer	= msSys.ElapsedTime();
@@ -783,26 +1013,23 @@ void msImageProcessor::Segment(int sigmaS, float sigmaR, int minRegion, SpeedUpL
 
 	//Check to see if the algorithm is to be halted, if so then
 	//destroy output and regions adjacency matrix and exit
-//	if((ErrorStatus = msSys.Progress(1.0)) == EL_HALT)
-//	{
-//		DestroyRAM();
-//		DestroyOutput();
-//		return;
-//	}
+	if((ErrorStatus == EL_HALT)||((ErrorStatus = CheckHalt()) == EL_HALT))
+	{
+		DestroyRAM();
+		DestroyOutput();
+		return;
+	}
 
 	//de-allocate memory for region adjacency matrix
 	DestroyRAM();
 
-	//output to msRawData
-	int j, i, label;
-	for(i = 0; i < L; i++)
-	{
-		label	= labels[i];
-		for(j = 0; j < N; j++)
-			{
-				msRawData[N*i+j] = modes[N*label+j];
-			}
-	}
+	//the output is now fully described by labels and modes;
+	//msRawData is only rebuilt if raw data is requested
+	rawDataStale	= true;
+
+	//release what compact mode does not need to keep
+	CompactOutput();
+	RecordMemory("segment", 0);
 
 	//done.
 	return;
@@ -911,9 +1138,11 @@ void msImageProcessor::LAB2RGB(const float& lval, const float& aval, const float
 	if( b <= 0.0031308 )	B = 12.92*b;
 	else					B = 1.055*pow(b, 1.0/2.4);
 
-	sR = min(0.5 + R*255.0, 255);
-	sG = min(0.5 + G*255.0, 255);
-	sB = min(0.5 + B*255.0, 255);
+	//round and saturate to the byte range
+	double vR = 0.5 + R*255.0, vG = 0.5 + G*255.0, vB = 0.5 + B*255.0;
+	sR = (BYTE) ((vR < 255.0) ? vR : 255.0);
+	sG = (BYTE) ((vG < 255.0) ? vG : 255.0);
+	sB = (BYTE) ((vB < 255.0) ? vB : 255.0);
 }
 
 
@@ -1081,6 +1310,10 @@ void msImageProcessor::GetRawData(float *outputImageData)
 		return;
 	}
 
+	//segmented output is held as labels and modes until
+	//raw data is asked for
+	RebuildRawData();
+
 	//copy msRawData to outputImageData
 	int i;
 	for(i = 0; i < L*N; i++)
@@ -1114,9 +1347,40 @@ void msImageProcessor::GetResults(byte *outputImage)
 		return;
 	}
 
+	//segmented image: convert each region's mode once and
+	//fill the output by label
+	if((rawDataStale)&&((N == 1)||(N == 3)))
+	{
+		unsigned int	*colorTable	= new unsigned int [regionCount];
+		unsigned int	*row		= new unsigned int [width];
+		RegionColorTable(colorTable);
+		int i, j;
+		byte	*dst	= outputImage;
+		for(i = 0; i < height; i++)
+		{
+			GatherRow(i, colorTable, row);
+			if(N == 3)
+			{
+				for(j = 0; j < width; j++, dst += 3)
+				{
+					dst[0]	= (byte)(row[j] >> 16);
+					dst[1]	= (byte)(row[j] >>  8);
+					dst[2]	= (byte)(row[j]);
+				}
+			}
+			else
+			{
+				for(j = 0; j < width; j++)
+					*(dst++)	= (byte)(row[j]);
+			}
+		}
+		delete [] row;
+		delete [] colorTable;
+	}
+
 	//if the image type is GREYSCALE simply
 	//copy it over to the segmentedImage
-	if(N == 1)
+	else if(N == 1)
 	{
 		//copy over msRawData to segmentedImage checking
 		//bounds
@@ -1176,12 +1440,47 @@ RegionList *msImageProcessor::GetBoundaries( void )
 
 	//define bounds using label information
 	if(class_state.OUTPUT_DEFINED)
+	{
+		ExpandLabels();
 		DefineBoundaries();
+		CompactOutput();
+	}
 
 	//return region list structure
 	return regionList;
 
 }
+
+/*******************************************************/
+/*Get Label Runs                                       */
+/*******************************************************/
+/*The label image is returned run-length encoded.      */
+/*******************************************************/
+/*Post:                                                */
+/*      - the label image has been encoded as row      */
+/*        broken (label, length) runs                  */
+/*      - the run list is returned                     */
+/*      - NULL is returned if the image has not been   */
+/*        filtered or segmented                        */
+/*******************************************************/
+
+LabelRunList *msImageProcessor::GetLabelRuns( void )
+{
+
+	//encode the label image
+	if(class_state.OUTPUT_DEFINED)
+	{
+		if(!labelRuns)
+			labelRuns	= new LabelRunList;
+		ExpandLabels();
+		labelRuns->Encode(labels, width, height);
+		CompactOutput();
+	}
+
+	//return run list
+	return labelRuns;
+
+}
  
 /*******************************************************/
 /*Get Regions                                          */
@@ -1242,8 +1541,7 @@ int msImageProcessor::GetRegions(int **labels_out, float **modes_out, int **MPC_
 
 	//populate labels_out with image labels
 	int	i;
-	for(i = 0; i < L; i++)
-		labels_[i] = labels[i];
+	GetLabels(labels_);
 
 	//populate modes_out and MPC_out with the color and point
 	//count of each region
@@ -1252,6 +1550,11 @@ int msImageProcessor::GetRegions(int **labels_out, float **modes_out, int **MPC_
 	for(i = 0; i < regionCount; i++)
 		MPC_out_[i]	= modePointCounts[i];
 
+	//hand the copies to the caller
+	*labels_out	= labels_;
+	*modes_out	= modes_;
+	*MPC_out	= MPC_out_;
+
 	//done. Return the number of regions resulting from filtering or segmentation.
 	return regionCount;
 }
@@ -1259,54 +1562,358 @@ int msImageProcessor::GetRegions(int **labels_out, float **modes_out, int **MPC_
 int msImageProcessor::GetLabels(int* lab)
 {
 	int	i;
-	for(i = 0; i < L; i++)lab[i] = labels[i];
+	if(labels16)
+		for(i = 0; i < L; i++)lab[i] = labels16[i];
+	else
+		for(i = 0; i < L; i++)lab[i] = labels[i];
 
 	return regionCount;
 }
 
-/*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
-/*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
-/*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@     PRIVATE METHODS     @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
-/*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
-/*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
+/*******************************************************/
+/*Get Region Views                                     */
+/*******************************************************/
+/*Read-only views of the classification structures.    */
+/*******************************************************/
+/*Post:                                                */
+/*      - if the image has been filtered or segmented  */
+/*        a pointer to the internal labels, modes or   */
+/*        modePointCounts array is returned, other-    */
+/*        wise NULL (or zero regions) is returned.     */
+/*******************************************************/
 
-	/*/\/\/\/\/\/\/\/\/\*/
-	/*  Image Filtering */
-	/*\/\/\/\/\/\/\/\/\/*/
+const int *msImageProcessor::GetLabelsView( void ) const
+{
+	return (class_state.OUTPUT_DEFINED ? labels : NULL);
+}
+
+const float *msImageProcessor::GetModesView( void ) const
+{
+	return (class_state.OUTPUT_DEFINED ? modes : NULL);
+}
+
+const int *msImageProcessor::GetModePointCountsView( void ) const
+{
+	return (class_state.OUTPUT_DEFINED ? modePointCounts : NULL);
+}
+
+int msImageProcessor::GetRegionCount( void ) const
+{
+	return (class_state.OUTPUT_DEFINED ? regionCount : 0);
+}
 
 /*******************************************************/
-/*Non Optimized Filter                                 */
+/*Get Results ARGB                                     */
 /*******************************************************/
-/*Performs mean shift filtering on the specified input */
-/*image using a user defined kernel.                   */
+/*The output image is returned as packed 32-bit pixels.*/
 /*******************************************************/
 /*Pre:                                                 */
-/*      - the user defined kernel used to apply mean   */
-/*        shift filtering to the defined input image   */
-/*        has spatial bandwidth sigmaS and range band- */
-/*        width sigmaR                                 */
-/*      - a data set has been defined                  */
-/*      - the height and width of the lattice has been */
-/*        specified using method DefineLattice()       */
+/*      - outputImage is a pre-allocated array of at   */
+/*        least (height-1)*stride+width pixels         */
+/*      - stride is the row pitch in pixels            */
+/*      - alpha is placed in the top byte of every     */
+/*        pixel                                        */
 /*Post:                                                */
-/*      - mean shift filtering has been applied to the */
-/*        input image using a user defined kernel      */
-/*      - the filtered image is stored in the private  */
-/*        data members of the msImageProcessor class.  */
+/*      - the filtered or segmented image is stored by */
+/*        outputImage as (alpha<<24)|(R<<16)|(G<<8)|B. */
 /*******************************************************/
 
-void msImageProcessor::NonOptimizedFilter(float sigmaS, float sigmaR)
+void msImageProcessor::GetResultsARGB(unsigned int *outputImage, int stride, unsigned int alpha)
 {
 
-	// Declare Variables
-	int   iterationCount, i, j;
-	double mvAbs;
-	
-	//make sure that a lattice height and width have
-	//been defined...
-	if(!height)
+	//make sure that outputImage is not NULL
+	if(!outputImage)
 	{
-		ErrorHandler("msImageProcessor", "LFilter", "Lattice height and width are undefined.");
+		ErrorHandler("msImageProcessor", "GetResultsARGB", "Output image buffer is NULL.");
+		return;
+	}
+	if(stride < width)
+	{
+		ErrorHandler("msImageProcessor", "GetResultsARGB", "Output image stride is smaller than the image width.");
+		return;
+	}
+	if((N != 1)&&(N != 3))
+	{
+		ErrorHandler("msImageProcessor", "GetResultsARGB", "Unknown image type. Try using MeanShift::GetRawData().");
+		return;
+	}
+
+	alpha	<<= 24;
+	int		i, j, pxValue;
+
+	//segmented image: gather region colors by label
+	if(rawDataStale)
+	{
+		unsigned int	*colorTable	= new unsigned int [regionCount];
+		RegionColorTable(colorTable);
+		for(i = 0; i < regionCount; i++)
+			colorTable[i]	|= alpha;
+		for(i = 0; i < height; i++)
+			GatherRow(i, colorTable, &outputImage[i*stride]);
+		delete [] colorTable;
+		return;
+	}
+
+	byte	r, g, b;
+	float	*src	= msRawData;
+	for(i = 0; i < height; i++)
+	{
+		unsigned int *dst	= &outputImage[i*stride];
+		for(j = 0; j < width; j++, src += N)
+		{
+			if(N == 3)
+				LAB2RGB(src[0], src[1], src[2], r, g, b);
+			else
+			{
+				pxValue	= (int)(src[0]+0.5);
+				r = g = b = (byte)(pxValue < 0 ? 0 : (pxValue > 255 ? 255 : pxValue));
+			}
+			dst[j]	= alpha | (r << 16) | (g << 8) | b;
+		}
+	}
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Get Region Colors                                    */
+/*******************************************************/
+/*The color of each region mode is returned.           */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - colorTable is a pre-allocated array of       */
+/*        GetRegionCount() entries                     */
+/*Post:                                                */
+/*      - colorTable[i] holds the mode of region i as  */
+/*        (R<<16)|(G<<8)|B, the color GetResultsARGB() */
+/*        gives its pixels.                            */
+/*******************************************************/
+
+void msImageProcessor::GetRegionColors(unsigned int *colorTable)
+{
+
+	//make sure that colorTable is not NULL
+	if(!colorTable)
+	{
+		ErrorHandler("msImageProcessor", "GetRegionColors", "Output color table is NULL.");
+		return;
+	}
+	if(!class_state.OUTPUT_DEFINED)
+	{
+		ErrorHandler("msImageProcessor", "GetRegionColors", "The image has not been filtered or segmented.");
+		return;
+	}
+	if((N != 1)&&(N != 3))
+	{
+		ErrorHandler("msImageProcessor", "GetRegionColors", "Unknown image type.");
+		return;
+	}
+
+	RegionColorTable(colorTable);
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Get Results Planar                                   */
+/*******************************************************/
+/*The output image is returned as separate planes.     */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - red, green and blue are pre-allocated arrays */
+/*        of L bytes each (green and blue may be NULL  */
+/*        for a GREYSCALE image)                       */
+/*Post:                                                */
+/*      - the filtered or segmented image is stored by */
+/*        the output planes.                           */
+/*******************************************************/
+
+void msImageProcessor::GetResultsPlanar(byte *red, byte *green, byte *blue)
+{
+
+	//make sure that the output planes are not NULL
+	if((!red)||((N == 3)&&((!green)||(!blue))))
+	{
+		ErrorHandler("msImageProcessor", "GetResultsPlanar", "Output image buffer is NULL.");
+		return;
+	}
+
+	int	i, pxValue;
+
+	//segmented image: gather region colors by label
+	if((rawDataStale)&&((N == 1)||(N == 3)))
+	{
+		unsigned int	*colorTable	= new unsigned int [regionCount];
+		unsigned int	*row		= new unsigned int [width];
+		RegionColorTable(colorTable);
+		int j;
+		for(i = 0; i < height; i++)
+		{
+			GatherRow(i, colorTable, row);
+			for(j = 0; j < width; j++)
+			{
+				red[i*width+j]	= (byte)(row[j] >> 16);
+				if(green)	green[i*width+j]	= (byte)(row[j] >> 8);
+				if(blue)	blue[i*width+j]		= (byte)(row[j]);
+			}
+		}
+		delete [] row;
+		delete [] colorTable;
+		return;
+	}
+
+	if(N == 3)
+	{
+		for(i = 0; i < L; i++)
+			LAB2RGB(msRawData[3*i], msRawData[3*i+1], msRawData[3*i+2], red[i], green[i], blue[i]);
+	}
+	else if(N == 1)
+	{
+		for(i = 0; i < L; i++)
+		{
+			pxValue	= (int)(msRawData[i]+0.5);
+			red[i]	= (byte)(pxValue < 0 ? 0 : (pxValue > 255 ? 255 : pxValue));
+			if(green)	green[i]	= red[i];
+			if(blue)	blue[i]		= red[i];
+		}
+	}
+	else
+		ErrorHandler("msImageProcessor", "GetResultsPlanar", "Unknown image type. Try using MeanShift::GetRawData().");
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Get Results (View)                                   */
+/*******************************************************/
+/*The output image is written into a strided view.     */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - image views writable height x width pixels   */
+/*        in one of the ImageView layouts              */
+/*Post:                                                */
+/*      - the filtered or segmented image is stored by */
+/*        image in its pixel layout.                   */
+/*******************************************************/
+
+void msImageProcessor::GetResults(const ImageView& image)
+{
+
+	//make sure that the view matches the image
+	if(image.IsEmpty())
+	{
+		ErrorHandler("msImageProcessor", "GetResults", "Output image view is empty.");
+		return;
+	}
+	if((image.width != width)||(image.height != height))
+	{
+		ErrorHandler("msImageProcessor", "GetResults", "Output image view does not have the size of the image.");
+		return;
+	}
+	if((N != 1)&&(N != 3))
+	{
+		ErrorHandler("msImageProcessor", "GetResults", "Unknown image type. Try using MeanShift::GetRawData().");
+		return;
+	}
+
+	//packed pixels are written in place
+	if((image.layout == PIXEL_XRGB32)&&(image.stride > 0)&&(image.stride%sizeof(unsigned int) == 0))
+	{
+		GetResultsARGB((unsigned int *) image.data, (int)(image.stride/sizeof(unsigned int)));
+		return;
+	}
+
+	//otherwise each row is made as GetResultsARGB would
+	//make it and stored in the layout of the view
+	unsigned int	*colorTable	= NULL;
+	unsigned int	*row		= new unsigned int [width];
+	if(rawDataStale)
+	{
+		colorTable	= new unsigned int [regionCount];
+		RegionColorTable(colorTable);
+	}
+
+	int		i, j, pxValue;
+	byte	r, g, b;
+	float	*src	= msRawData;
+	for(i = 0; i < height; i++)
+	{
+		if(colorTable)
+			GatherRow(i, colorTable, row);
+		else
+		{
+			for(j = 0; j < width; j++, src += N)
+			{
+				if(N == 3)
+					LAB2RGB(src[0], src[1], src[2], r, g, b);
+				else
+				{
+					pxValue	= (int)(src[0]+0.5);
+					r = g = b = (byte)(pxValue < 0 ? 0 : (pxValue > 255 ? 255 : pxValue));
+				}
+				row[j]	= (r << 16) | (g << 8) | b;
+			}
+		}
+		image.WriteRow(i, row);
+	}
+
+	delete [] row;
+	if(colorTable)	delete [] colorTable;
+
+	//done.
+	return;
+
+}
+
+/*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
+/*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
+/*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@     PRIVATE METHODS     @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
+/*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
+/*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
+
+	/*/\/\/\/\/\/\/\/\/\*/
+	/*  Image Filtering */
+	/*\/\/\/\/\/\/\/\/\/*/
+
+/*******************************************************/
+/*Non Optimized Filter                                 */
+/*******************************************************/
+/*Performs mean shift filtering on the specified input */
+/*image using a user defined kernel.                   */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - the user defined kernel used to apply mean   */
+/*        shift filtering to the defined input image   */
+/*        has spatial bandwidth sigmaS and range band- */
+/*        width sigmaR                                 */
+/*      - a data set has been defined                  */
+/*      - the height and width of the lattice has been */
+/*        specified using method DefineLattice()       */
+/*Post:                                                */
+/*      - mean shift filtering has been applied to the */
+/*        input image using a user defined kernel      */
+/*      - the filtered image is stored in the private  */
+/*        data members of the msImageProcessor class.  */
+/*******************************************************/
+
+void msImageProcessor::NonOptimizedFilter(float sigmaS, float sigmaR)
+{
+
+	// Declare Variables
+	int   iterationCount, i, j;
+	double mvAbs;
+	
+	//make sure that a lattice height and width have
+	//been defined...
+	if(!height)
+	{
+		ErrorHandler("msImageProcessor", "LFilter", "Lattice height and width are undefined.");
 		return;
 	}
 
@@ -1399,8 +2006,8 @@ void msImageProcessor::NonOptimizedFilter(float sigmaS, float sigmaR)
 #endif
 	
 		// Check to see if the algorithm has been halted
-//		if((i%PROGRESS_RATE == 0)&&((ErrorStatus = msSys.Progress((float)(i/(float)(L))*(float)(0.8)))) == EL_HALT)
-//			break;
+		if((i%PROGRESS_RATE == 0)&&((ErrorStatus = CheckHalt()) == EL_HALT))
+			break;
 	}
 	
 	// Prompt user that filtering is completed
@@ -1683,8 +2290,8 @@ void msImageProcessor::OptimizedFilter1(float sigmaS, float sigmaR)
 #endif
 	
 		// Check to see if the algorithm has been halted
-//		if((i%PROGRESS_RATE == 0)&&((ErrorStatus = msSys.Progress((float)(i/(float)(L))*(float)(0.8)))) == EL_HALT)
-//			break;		
+		if((i%PROGRESS_RATE == 0)&&((ErrorStatus = CheckHalt()) == EL_HALT))
+			break;
 	}
 	
 	// Prompt user that filtering is completed
@@ -1979,8 +2586,8 @@ void msImageProcessor::OptimizedFilter2(float sigmaS, float sigmaR)
 #endif
 	
 		// Check to see if the algorithm has been halted
-//		if((i%PROGRESS_RATE == 0)&&((ErrorStatus = msSys.Progress((float)(i/(float)(L))*(float)(0.8)))) == EL_HALT)
-//			break;
+		if((i%PROGRESS_RATE == 0)&&((ErrorStatus = CheckHalt()) == EL_HALT))
+			break;
 		
 	}
 	
@@ -2025,6 +2632,8 @@ void msImageProcessor::OptimizedFilter2(float sigmaS, float sigmaR)
 void msImageProcessor::Connect( void )
 {
 
+	double	kernelStart	= KernelClock();
+
 	//define eight connected neighbors
 	neigh[0]	= 1;
 	neigh[1]	= 1-width;
@@ -2035,6 +2644,17 @@ void msImageProcessor::Connect( void )
 	neigh[6]	= width;
 	neigh[7]	= width+1;
 
+	//make sure there is room for one mode per data point and
+	//integer labels (compact mode may have shrunk both), and
+	//allocate the fill stack
+	ReserveModes();
+	ExpandLabels();
+	if(!(indexTable = new int [L]))
+	{
+		ErrorHandler("msImageProcessor", "Connect", "Not enough memory.");
+		return;
+	}
+
 	//initialize labels and modePointCounts
 	int i;
 	for(i = 0; i < width*height; i++)
@@ -2067,6 +2687,13 @@ void msImageProcessor::Connect( void )
 	//calculate region count using label
 	regionCount	= label+1;
 
+	//the fill stack is only needed while connecting
+	RecordMemory("connect", 0);
+	delete [] indexTable;
+	indexTable	= NULL;
+
+	RecordTiming("Connect", kernelStart);
+
 	//done.
 	return;
 }
@@ -2199,6 +2826,8 @@ void msImageProcessor::Fill(int regionLoc, int label)
 void msImageProcessor::BuildRAM( void )
 {
 
+	double	kernelStart	= KernelClock();
+
 	//Allocate memory for region adjacency matrix if it hasn't already been allocated
 	if((!raList)&&((!(raList = new RAList [regionCount]))||(!(raPool = new RAList [NODE_MULTIPLE*regionCount]))))
 	{
@@ -2360,6 +2989,14 @@ void msImageProcessor::BuildRAM( void )
 				freeRAList = oldRAFreeList;
 
 		}
+
+		//a region with many neighbors makes this loop slow, so
+		//check row by row if the algorithm has been halted
+		if((ErrorStatus = CheckHalt()) == EL_HALT)
+		{
+			RecordTiming("BuildRAM", kernelStart);
+			return;
+		}
 	}
 
 	//check only to the right neighbors of the bottom boundary
@@ -2410,6 +3047,8 @@ void msImageProcessor::BuildRAM( void )
 
 	}
 
+	RecordTiming("BuildRAM", kernelStart);
+
 	//done.
 	return;
 
@@ -2463,11 +3102,18 @@ void msImageProcessor::DestroyRAM( void )
 void msImageProcessor::TransitiveClosure( void )
 {
 
+	double	kernelStart	= KernelClock();
+
 	//Step (1):
 
 	// Build RAM using classifiction structure originally
 	// generated by the method GridTable::Connect()
 	BuildRAM();
+	if(ErrorStatus == EL_HALT)
+	{
+		RecordTiming("TransitiveClosure", kernelStart);
+		return;
+	}
 
 	//Step (1a):
 	//Compute weights of weight graph using confidence map
@@ -2653,6 +3299,8 @@ void msImageProcessor::TransitiveClosure( void )
 	delete [] MPC_buffer;
 	delete [] label_buffer;
 
+	RecordTiming("TransitiveClosure", kernelStart);
+
 	//done.
 	return;
 
@@ -2847,6 +3495,8 @@ void msImageProcessor::ComputeEdgeStrengths( void )
 
 void msImageProcessor::Prune(int minRegion)
 {
+
+	double	kernelStart	= KernelClock();
 	
 	//Allocate Memory for temporary buffers...
 	
@@ -2874,6 +3524,8 @@ void msImageProcessor::Prune(int minRegion)
 		// Build RAM using classifiction structure originally
 		// generated by the method GridTable::Connect()
 		BuildRAM();
+		if(ErrorStatus == EL_HALT)
+			break;
 		
 		// Step (2):
 		
@@ -2903,7 +3555,9 @@ void msImageProcessor::Prune(int minRegion)
 
 			//*******************************************************************************
 
-			if(modePointCounts[i] < minRegion)
+			//a region without neighbors covers the whole image (which is
+			//then smaller than minRegion) and has nothing to join
+			if((modePointCounts[i] < minRegion)&&(raList[i].next))
 			{
 				//update minRegionCount to indicate that a region
 				//having area less than minRegion was found
@@ -3064,155 +3718,302 @@ void msImageProcessor::Prune(int minRegion)
 			labels[i]	= label_buffer[raList[labels[i]].label];
 
 		
-	}	while(minRegionCount > 0);
+	}	while((minRegionCount > 0)&&((ErrorStatus = CheckHalt()) != EL_HALT));
 
 	//de-allocate memory
 	delete [] modes_buffer;
 	delete [] MPC_buffer;
 	delete [] label_buffer;
 	
+	RecordTiming("Prune", kernelStart);
+
 	//done.
 	return;
 	
 }
 
 /*******************************************************/
-/*Define Boundaries                                    */
+/*Rebuild Raw Data                                     */
 /*******************************************************/
-/*Defines the boundaries for each region of the segm-  */
-/*ented image storing the result into a region list    */
-/*object.                                              */
+/*Materializes the segmented image into msRawData.     */
 /*******************************************************/
-/*Pre:                                                 */
-/*      - the image has been segmented and a classifi- */
-/*        cation structure has been created for this   */
-/*        image                                        */
 /*Post:                                                */
-/*      - the boundaries of the segmented image have   */
-/*        been defined and the boundaries of each reg- */
-/*        ion has been stored into a region list obj-  */
-/*        ect.                                         */
+/*      - if msRawData was stale it now holds the mode */
+/*        of the region of every data point.           */
 /*******************************************************/
 
-void msImageProcessor::DefineBoundaries( void )
+void msImageProcessor::RebuildRawData( void )
 {
 
-	//declare and allocate memory for boundary map and count
-	int	*boundaryMap,	*boundaryCount;
-	if((!(boundaryMap = new int [L]))||(!(boundaryCount = new int [regionCount])))
-		ErrorHandler("msImageProcessor", "DefineBoundaries", "Not enough memory.");
+	if(!rawDataStale)
+		return;
 
-	//initialize boundary map and count
-	int i;
+	//output to msRawData
+	int i, j, label;
 	for(i = 0; i < L; i++)
-		boundaryMap[i]		= -1;
-	for(i = 0; i < regionCount; i++)
-		boundaryCount[i]	=  0;
-
-	//initialize and declare total boundary count -
-	//the total number of boundary pixels present in
-	//the segmented image
-	int	totalBoundaryCount	= 0;
+	{
+		label	= (labels16 ? labels16[i] : labels[i]);
+		for(j = 0; j < N; j++)
+			msRawData[N*i+j] = modes[N*label+j];
+	}
+	rawDataStale	= false;
 
-	//traverse the image checking the right and bottom
-	//four connected neighbors of each pixel marking
-	//boundary map with the boundaries of each region and
-	//incrementing boundaryCount using the label information
+	//done.
+	return;
 
-	//***********************************************************************
-	//***********************************************************************
+}
 
-	int		j, label, dataPoint;
+/*******************************************************/
+/*Region Color Table                                   */
+/*******************************************************/
+/*Converts the mode of every region to an output color.*/
+/*******************************************************/
+/*Pre:                                                 */
+/*      - colorTable holds regionCount entries         */
+/*      - N is 1 (GREYSCALE) or 3 (COLOR)              */
+/*Post:                                                */
+/*      - colorTable[l] holds the color of region l    */
+/*        packed as 0x00RRGGBB (grey value replicated  */
+/*        for GREYSCALE images), converted exactly as  */
+/*        GetResults() converts a single pixel.        */
+/*******************************************************/
 
-	//first row (every pixel is a boundary pixel)
-	for(i = 0; i < width; i++)
-	{
-			boundaryMap[i]		= label	= labels[i];
-			boundaryCount[label]++;
-			totalBoundaryCount++;
-	}
+void msImageProcessor::RegionColorTable(unsigned int *colorTable)
+{
 
-	//define boundaries for all rows except for the first
-	//and last one...
-	for(i = 1; i < height - 1; i++)
+	int		i, pxValue;
+	byte	r, g, b;
+	for(i = 0; i < regionCount; i++)
 	{
-		//mark the first pixel in an image row as an image boundary...
-		dataPoint				= i*width;
-		boundaryMap[dataPoint]	= label	= labels[dataPoint];
-		boundaryCount[label]++;
-		totalBoundaryCount++;
-
-		for(j = 1; j < width - 1; j++)
+		if(N == 3)
+			LAB2RGB(modes[3*i], modes[3*i+1], modes[3*i+2], r, g, b);
+		else
 		{
-			//define datapoint and its right and bottom
-			//four connected neighbors
-			dataPoint		= i*width+j;
-
-			//check four connected neighbors if they are
-			//different this pixel is a boundary pixel
-			label	= labels[dataPoint];
-			if((label != labels[dataPoint-1])    ||(label != labels[dataPoint+1])||
-			   (label != labels[dataPoint-width])||(label != labels[dataPoint+width]))
-			{
-				boundaryMap[dataPoint]		= label	= labels[dataPoint];
-				boundaryCount[label]++;
-				totalBoundaryCount++;
-			}
+			pxValue	= (int)(modes[i]+0.5);
+			r = g = b = (byte)(pxValue < 0 ? 0 : (pxValue > 255 ? 255 : pxValue));
 		}
+		colorTable[i]	= (r << 16) | (g << 8) | b;
+	}
+
+	//done.
+	return;
 
-		//mark the last pixel in an image row as an image boundary...
-		dataPoint				= (i+1)*width-1;
-		boundaryMap[dataPoint]	= label	= labels[dataPoint];
-		boundaryCount[label]++;
-		totalBoundaryCount++;
+}
 
-	}
+/*******************************************************/
+/*Gather Row                                           */
+/*******************************************************/
+/*Fills one row of packed colors by region label.      */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - colorTable holds regionCount packed colors   */
+/*      - dst holds width entries                      */
+/*Post:                                                */
+/*      - dst[j] = colorTable[label of (row, j)], read */
+/*        from the 32 or 16-bit labels in use.         */
+/*******************************************************/
 
-	//last row (every pixel is a boundary pixel) (i = height-1)
-	register int	start	= (height-1)*width, stop = height*width;
-	for(i = start; i < stop; i++)
+template <class LabelType>
+static void GatherColors(const LabelType *lab, const unsigned int *colorTable, unsigned int *dst, int count)
+{
+	int j;
+	for(j = 0; j + 4 <= count; j += 4)
 	{
-		boundaryMap[i]		= label	= labels[i];
-		boundaryCount[label]++;
-		totalBoundaryCount++;
+		dst[j  ]	= colorTable[lab[j  ]];
+		dst[j+1]	= colorTable[lab[j+1]];
+		dst[j+2]	= colorTable[lab[j+2]];
+		dst[j+3]	= colorTable[lab[j+3]];
 	}
+	for(; j < count; j++)
+		dst[j]		= colorTable[lab[j]];
+}
 
-	//***********************************************************************
+void msImageProcessor::GatherRow(int row, const unsigned int *colorTable, unsigned int *dst)
+{
+	if(labels16)
+		GatherColors(&labels16[row*width], colorTable, dst, width);
+	else
+		GatherColors(&labels[row*width], colorTable, dst, width);
+}
+
+/*******************************************************/
+/*Mark Boundary Row                                    */
+/*******************************************************/
+/*Flags the boundary pixels of a single image row.     */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - labels is a width x height label image       */
+/*      - row is in [0, height)                        */
+/*      - flags holds width bytes                      */
+/*Post:                                                */
+/*      - flags[j] is non-zero iff pixel (row, j) lies */
+/*        on the image border or differs from one of   */
+/*        its four connected neighbors.                */
+/*******************************************************/
+
+static void MarkBoundaryRow(const int *labels, int width, int height, int row, unsigned char *flags)
+{
+
+	//first and last rows are boundaries in their entirety
+	if((row == 0)||(row == height-1)||(width < 3))
+	{
+		memset(flags, 1, width);
+		return;
+	}
+
+	const int	*cur	= &labels[row*width];
+	const int	*up		= cur - width;
+	const int	*down	= cur + width;
+
+	//first and last pixels of a row are boundaries
+	flags[0]		= 1;
+	flags[width-1]	= 1;
+
+	int	j = 1;
+
+#ifdef MS_USE_SSE2
+	//compare four labels against their four connected
+	//neighbors at a time, packing the "not equal" lanes
+	//down to one byte per pixel
+	const __m128i	ones	= _mm_set1_epi32(-1);
+	for(; j + 4 <= width - 1; j += 4)
+	{
+		__m128i	c	= _mm_loadu_si128((const __m128i *) &cur[j]);
+		__m128i	eq	= _mm_and_si128(
+						_mm_and_si128(_mm_cmpeq_epi32(c, _mm_loadu_si128((const __m128i *) &cur[j-1])),
+									  _mm_cmpeq_epi32(c, _mm_loadu_si128((const __m128i *) &cur[j+1]))),
+						_mm_and_si128(_mm_cmpeq_epi32(c, _mm_loadu_si128((const __m128i *) &up[j])),
+									  _mm_cmpeq_epi32(c, _mm_loadu_si128((const __m128i *) &down[j]))));
+		__m128i	ne	= _mm_xor_si128(eq, ones);
+		ne			= _mm_packs_epi32(ne, ne);
+		ne			= _mm_packs_epi16(ne, ne);
+		int	packed	= _mm_cvtsi128_si32(ne);
+		memcpy(&flags[j], &packed, 4);
+	}
+#endif
+
+	//remaining pixels (or all of them without SSE2), branch free
+	for(; j < width - 1; j++)
+	{
+		int	label	= cur[j];
+		flags[j]	= (unsigned char)((label != cur[j-1])|(label != cur[j+1])|
+									  (label != up[j]) |(label != down[j]));
+	}
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Define Boundaries                                    */
+/*******************************************************/
+/*Defines the boundaries for each region of the segm-  */
+/*ented image storing the result into a region list    */
+/*object.                                              */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - the image has been segmented and a classifi- */
+/*        cation structure has been created for this   */
+/*        image                                        */
+/*Post:                                                */
+/*      - the boundaries of the segmented image have   */
+/*        been defined and the boundaries of each reg- */
+/*        ion has been stored into a region list obj-  */
+/*        ect as row broken (start, length) runs.      */
+/*******************************************************/
+
+void msImageProcessor::DefineBoundaries( void )
+{
+
+	//declare and allocate memory for per region run and
+	//point counts and a single row of boundary flags (no
+	//image sized map is needed since rows are processed
+	//independently)
+	int				*runCount, *boundaryCount, *runIndex;
+	unsigned char	*rowFlags;
+	if((!(runCount = new int [regionCount]))||(!(boundaryCount = new int [regionCount]))||
+	   (!(runIndex = new int [regionCount]))||(!(rowFlags = new unsigned char [width])))
+		ErrorHandler("msImageProcessor", "DefineBoundaries", "Not enough memory.");
+
+	//initialize counts
+	int i, j, k;
+	for(i = 0; i < regionCount; i++)
+		runCount[i]	= boundaryCount[i]	= 0;
+
+	//***********************************************************************
+	//***********************************************************************
+
+	//first pass: flag the boundary pixels of each row and count
+	//the maximal runs of equally labeled boundary pixels
+
+	//***********************************************************************
+	//***********************************************************************
+
+	int		label, *row, totalRunCount = 0;
+	for(i = 0; i < height; i++)
+	{
+		MarkBoundaryRow(labels, width, height, i, rowFlags);
+		row	= &labels[i*width];
+		for(j = 0; j < width; j = k)
+		{
+			if(!rowFlags[j])
+			{
+				k = j+1;
+				continue;
+			}
+			label	= row[j];
+			for(k = j+1; (k < width)&&(rowFlags[k])&&(row[k] == label); k++);
+			runCount[label]++;
+			boundaryCount[label]	+= k - j;
+			totalRunCount++;
+		}
+	}
+
+	//***********************************************************************
 	//***********************************************************************
 
-	//store boundary locations into a boundary buffer using
-	//boundary map and count
+	//second pass: store the runs of each region contiguously
+	//into a run buffer using the run counts
 
 	//***********************************************************************
 	//***********************************************************************
 
-	int	*boundaryBuffer	= new int [totalBoundaryCount], *boundaryIndex	= new int [regionCount];
+	int	*runBuffer	= new int [2*totalRunCount];
 
-	//use boundary count to initialize boundary index...
+	//use run count to initialize run index...
 	int counter = 0;
 	for(i = 0; i < regionCount; i++)
 	{
-		boundaryIndex[i]	= counter;
-		counter			   += boundaryCount[i];
+		runIndex[i]	= counter;
+		counter	   += runCount[i];
 	}
 
-	//traverse boundary map placing the boundary pixel
-	//locations into the boundaryBuffer
-	for(i = 0; i < L; i++)
+	int	*run;
+	for(i = 0; i < height; i++)
 	{
-		//if its a boundary pixel store it into
-		//the boundary buffer
-		if((label = boundaryMap[i]) >= 0)
+		MarkBoundaryRow(labels, width, height, i, rowFlags);
+		row	= &labels[i*width];
+		for(j = 0; j < width; j = k)
 		{
-			boundaryBuffer[boundaryIndex[label]] = i;
-			boundaryIndex[label]++;
+			if(!rowFlags[j])
+			{
+				k = j+1;
+				continue;
+			}
+			label	= row[j];
+			for(k = j+1; (k < width)&&(rowFlags[k])&&(row[k] == label); k++);
+			run		= &runBuffer[2*runIndex[label]];
+			run[0]	= i*width+j;
+			run[1]	= k-j;
+			runIndex[label]++;
 		}
 	}
 
 	//***********************************************************************
 	//***********************************************************************
 
-	//store the boundary locations stored by boundaryBuffer into
+	//store the boundary runs stored by runBuffer into
 	//the region list for each region
 
 	//***********************************************************************
@@ -3222,26 +4023,27 @@ void msImageProcessor::DefineBoundaries( void )
 	if(regionList)	delete regionList;
 
 	//create a new region list
-	if(!(regionList	= new RegionList(regionCount, totalBoundaryCount, N)))
+	if(!(regionList	= new RegionList(regionCount, L, N, totalRunCount)))
 		ErrorHandler("msImageProcessor", "DefineBoundaries", "Not enough memory.");
 
-	//add boundary locations for each region using the boundary
-	//buffer and boundary counts
+	//add boundary runs for each region using the run
+	//buffer and run counts
 	counter	= 0;
 	for(i = 0; i < regionCount; i++)
 	{
-		regionList->AddRegion(i, boundaryCount[i], &boundaryBuffer[counter]);
-		counter += boundaryCount[i];
+		regionList->AddRegionRuns(i, boundaryCount[i], runCount[i], &runBuffer[2*counter]);
+		counter += runCount[i];
 	}
 
 	//***********************************************************************
 	//***********************************************************************
 
-   // dealocate local used memory
- 	delete [] boundaryMap;
-   delete [] boundaryCount;
-	delete [] boundaryBuffer;
-   delete [] boundaryIndex;
+	// dealocate local used memory
+	delete [] runCount;
+	delete [] boundaryCount;
+	delete [] runIndex;
+	delete [] rowFlags;
+	delete [] runBuffer;
 
 	//done.
 	return;
@@ -3351,6 +4153,18 @@ float msImageProcessor::SqDistance(int mode1, int mode2)
 void msImageProcessor::InitializeOutput( void )
 {
 
+	//Keep the buffers of a previous image of the same size,
+	//so that a processor used for image after image does not
+	//allocate and fault them in again each time
+	if((msRawData)&&(modes)&&(labels)&&(modePointCounts)&&(!labels16)&&
+		(outputLength == L*N)&&(modeCapacity == L))
+	{
+		regionCount					= 0;
+		class_state.OUTPUT_DEFINED	= true;
+		rawDataStale				= false;
+		return;
+	}
+
 	//De-allocate memory if output was defined for previous image
 	DestroyOutput();
 
@@ -3361,24 +4175,20 @@ void msImageProcessor::InitializeOutput( void )
 		return;
 	}
 
-	//Allocate memory used to store image modes and their corresponding regions...
-	if((!(modes = new float [L*(N+2)]))||(!(labels = new int [L]))||(!(modePointCounts = new int [L]))||(!(indexTable	= new int [L])))
-	{
-		ErrorHandler("msImageProcessor", "Allocate", "Not enough memory");
-		return;
-	}
-
-	//Allocate memory for integer modes used to perform connected components
-	//(image labeling)...
-//	if(!(LUV_data = new	int [N*L]))
-   if (!(LUV_data = new float[N*L]))
+	//Allocate memory used to store image modes and their corresponding regions
+	//(the fill stack used by Connect() is allocated there, LUV_data refers to
+	//existing data)...
+	if((!(modes = new float [L*N]))||(!(labels = new int [L]))||(!(modePointCounts = new int [L])))
 	{
 		ErrorHandler("msImageProcessor", "Allocate", "Not enough memory");
 		return;
 	}
+	modeCapacity	= L;
+	outputLength	= L*N;
 
 	//indicate that the class output storage structure has been defined
 	class_state.OUTPUT_DEFINED	= true;
+	rawDataStale				= false;
 
 }
 
@@ -3408,19 +4218,22 @@ void msImageProcessor::DestroyOutput( void )
 	if (labels)				delete [] labels;
 	if (modePointCounts)	delete [] modePointCounts;
 	if (indexTable)			delete [] indexTable;
-	
-	//de-allocate memory for LUV_data
-	if (LUV_data)			delete [] LUV_data;
+	if (labels16)			delete [] labels16;
 		
 	//initialize data members for re-use...
 
 	//initialize output structures...
 	msRawData			= NULL;
+	LUV_data			= NULL;
+	indexTable			= NULL;
 
 	//re-initialize classification structure
 	modes						= NULL;
 	labels						= NULL;
+	labels16					= NULL;
 	modePointCounts				= NULL;
+	modeCapacity				= 0;
+	outputLength				= 0;
 	regionCount					= 0;
 
 	//indicate that the output has been destroyed
@@ -3429,6 +4242,225 @@ void msImageProcessor::DestroyOutput( void )
 	//done.
 	return;
 
+}
+
+	/*/\/\/\/\/\/\/\/\/\/\/\/\*/
+	/*  Compact Mode Storage  */
+	/*\/\/\/\/\/\/\/\/\/\/\/\/*/
+
+/*******************************************************/
+/*Compact Output                                       */
+/*******************************************************/
+/*Releases storage compact mode does not need to keep. */
+/*******************************************************/
+/*Post:                                                */
+/*      - if compact mode is on, modes and modePoint-  */
+/*        Counts hold exactly regionCount entries and, */
+/*        if regionCount < 65536, the labels are held  */
+/*        by labels16 (labels is NULL).                */
+/*******************************************************/
+
+void msImageProcessor::CompactOutput( void )
+{
+
+	if((!compactMode)||(!class_state.OUTPUT_DEFINED))
+		return;
+
+	//shrink mode storage to the number of regions
+	if(modeCapacity > regionCount)
+	{
+		float	*modes_	= new float [regionCount*N];
+		int		*MPC_	= new int [regionCount];
+		memcpy(modes_, modes, sizeof(float)*regionCount*N);
+		memcpy(MPC_, modePointCounts, sizeof(int)*regionCount);
+		delete [] modes;
+		delete [] modePointCounts;
+		modes			= modes_;
+		modePointCounts	= MPC_;
+		modeCapacity	= regionCount;
+	}
+
+	//narrow labels to 16 bits
+	if((labels)&&(regionCount < 65536))
+	{
+		labels16	= new unsigned short [L];
+		int i;
+		for(i = 0; i < L; i++)
+			labels16[i]	= (unsigned short)(labels[i]);
+		delete [] labels;
+		labels	= NULL;
+	}
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Expand Labels                                        */
+/*******************************************************/
+/*Post:                                                */
+/*      - the labels are held as integers by labels.   */
+/*******************************************************/
+
+void msImageProcessor::ExpandLabels( void )
+{
+
+	if(!labels16)
+		return;
+
+	labels	= new int [L];
+	int i;
+	for(i = 0; i < L; i++)
+		labels[i]	= labels16[i];
+	delete [] labels16;
+	labels16	= NULL;
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Reserve Modes                                        */
+/*******************************************************/
+/*Post:                                                */
+/*      - modes and modePointCounts can hold one entry */
+/*        per data point (their contents are undefined */
+/*        if they had to be re-allocated).             */
+/*******************************************************/
+
+void msImageProcessor::ReserveModes( void )
+{
+
+	if(modeCapacity >= L)
+		return;
+
+	delete [] modes;
+	delete [] modePointCounts;
+	modes			= new float [L*N];
+	modePointCounts	= new int [L];
+	modeCapacity	= L;
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Resident Bytes                                       */
+/*******************************************************/
+/*Post:                                                */
+/*      - the number of bytes currently held by the    */
+/*        input, output and classification buffers of */
+/*        the processor is returned (region lists are  */
+/*        not included).                               */
+/*******************************************************/
+
+size_t msImageProcessor::ResidentBytes( void )
+{
+
+	size_t	bytes	= 0;
+	if((data)&&(!dataBorrowed))	bytes	+= sizeof(float)*L*N;
+	if(weightMap)		bytes	+= sizeof(float)*L;
+	if(msRawData)		bytes	+= sizeof(float)*L*N;
+	if(modes)			bytes	+= sizeof(float)*modeCapacity*N;
+	if(modePointCounts)	bytes	+= sizeof(int)*modeCapacity;
+	if(labels)			bytes	+= sizeof(int)*L;
+	if(labels16)		bytes	+= sizeof(unsigned short)*L;
+	if(indexTable)		bytes	+= sizeof(int)*L;
+	if(modeTable)		bytes	+= sizeof(unsigned char)*L;
+	if(pointList)		bytes	+= sizeof(int)*L;
+	if(savedLabels)		bytes	+= sizeof(int)*L + (sizeof(float)*N + sizeof(int))*savedRegionCount;
+	return bytes;
+
+}
+
+/*******************************************************/
+/*Record Memory                                        */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - stage is a string literal naming the stage   */
+/*      - scratch is the number of temporary bytes in  */
+/*        use by the stage not held by the processor   */
+/*Post:                                                */
+/*      - the memory report entry for stage holds      */
+/*        ResidentBytes()+scratch.                     */
+/*******************************************************/
+
+void msImageProcessor::RecordMemory(const char *stage, size_t scratch)
+{
+
+	int i;
+	for(i = 0; (i < memoryStages)&&(strcmp(memoryReport[i].stage, stage)); i++);
+	if(i == MS_MEMORY_STAGES)
+		return;
+	if(i == memoryStages)
+		memoryStages++;
+
+	memoryReport[i].stage	= stage;
+	memoryReport[i].bytes	= ResidentBytes() + scratch;
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Kernel Clock                                         */
+/*******************************************************/
+/*Post:                                                */
+/*      - milliseconds of a steady clock are returned. */
+/*******************************************************/
+
+double msImageProcessor::KernelClock( void )
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*******************************************************/
+/*Record Timing                                        */
+/*******************************************************/
+/*Adds the time spent in a kernel to the timing report.*/
+/*******************************************************/
+/*Pre:                                                 */
+/*      - kernel is a string literal naming the kernel */
+/*      - start is the KernelClock() value taken when  */
+/*        the kernel was entered                       */
+/*Post:                                                */
+/*      - the timing report entry for kernel has been  */
+/*        charged the time since start and one call.   */
+/*      - the kernel hook, if any, has been called.    */
+/*******************************************************/
+
+void msImageProcessor::RecordTiming(const char *kernel, double start)
+{
+
+	double	end		= KernelClock();
+	double	elapsed	= end - start;
+	int i;
+	for(i = 0; (i < timingKernels)&&(strcmp(timingReport[i].kernel, kernel)); i++);
+	if(i == MS_TIMING_KERNELS)
+		return;
+	if(i == timingKernels)
+	{
+		timingKernels++;
+		timingReport[i].kernel	= kernel;
+		timingReport[i].ms		= 0;
+		timingReport[i].calls	= 0;
+	}
+
+	timingReport[i].ms		+= elapsed;
+	timingReport[i].calls++;
+
+	//read once, as another thread may set the hook meanwhile
+	msKernelHook hook	= kernelHook.load();
+	if(hook)
+		hook(kernel, start, end);
+
+	//done.
+	return;
+
 }
 
 // NEW
@@ -3532,6 +4564,7 @@ void msImageProcessor::NewOptimizedFilter1(float sigmaS, float sigmaR)
    buckets = new int[nBuck1*nBuck2*nBuck3];
    for(i=0; i<(nBuck1*nBuck2*nBuck3); i++)
       buckets[i] = -1;
+   filterScratchBytes = sizeof(*sdata)*lN*L + sizeof(int)*(L + nBuck1*nBuck2*nBuck3);
 
    idxs = 0;
    for(i=0; i<L; i++)
@@ -3889,8 +4922,8 @@ void msImageProcessor::NewOptimizedFilter1(float sigmaS, float sigmaR)
 #endif
 	
 		// Check to see if the algorithm has been halted
-//		if((i%PROGRESS_RATE == 0)&&((ErrorStatus = msSys.Progress((float)(i/(float)(L))*(float)(0.8)))) == EL_HALT)
-//			break;		
+		if((i%PROGRESS_RATE == 0)&&((ErrorStatus = CheckHalt()) == EL_HALT))
+			break;
 	}
 	
 	// Prompt user that filtering is completed
@@ -4014,6 +5047,7 @@ void msImageProcessor::NewOptimizedFilter2(float sigmaS, float sigmaR)
    buckets = new int[nBuck1*nBuck2*nBuck3];
    for(i=0; i<(nBuck1*nBuck2*nBuck3); i++)
       buckets[i] = -1;
+   filterScratchBytes = sizeof(*sdata)*lN*L + sizeof(int)*(L + nBuck1*nBuck2*nBuck3);
 
    idxs = 0;
    for(i=0; i<L; i++)
@@ -4392,8 +5426,8 @@ void msImageProcessor::NewOptimizedFilter2(float sigmaS, float sigmaR)
 #endif
 	
 		// Check to see if the algorithm has been halted
-//		if((i%PROGRESS_RATE == 0)&&((ErrorStatus = msSys.Progress((float)(i/(float)(L))*(float)(0.8)))) == EL_HALT)
-//			break;		
+		if((i%PROGRESS_RATE == 0)&&((ErrorStatus = CheckHalt()) == EL_HALT))
+			break;
 	}
 	
 	// Prompt user that filtering is completed
@@ -4416,12 +5450,39 @@ void msImageProcessor::NewOptimizedFilter2(float sigmaS, float sigmaR)
 
 }
 
-void msImageProcessor::NewNonOptimizedFilter(float sigmaS, float sigmaR)
-{
+/*******************************************************/
+/*Compact Optimized Filter 2                           */
+/*******************************************************/
+/*Performs mean shift filtering on the specified input */
+/*image using a user defined kernel, using the same    */
+/*window traversal speed up as NewOptimizedFilter2 but */
+/*a reduced working set.                               */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - the user defined kernel used to apply mean   */
+/*        shift filtering to the defined input image   */
+/*        has spatial bandwidth sigmaS and range band- */
+/*        width sigmaR                                 */
+/*      - a data set has been defined                  */
+/*      - the height and width of the lattice has been */
+/*        specified using method DefineLattice()       */
+/*Post:                                                */
+/*      - mean shift filtering has been applied to the */
+/*        input image using a user defined kernel      */
+/*      - the filtered image is stored in the private  */
+/*        data members of the msImageProcessor class.  */
+/*      - unlike NewOptimizedFilter2 the scaled copy   */
+/*        of the data only holds the range components, */
+/*        as 16-bit fixed point values (N shorts per   */
+/*        point instead of N+2 floats); spatial coord- */
+/*        inates are derived from the point index.     */
+/*******************************************************/
 
+void msImageProcessor::CompactOptimizedFilter2(float sigmaS, float sigmaR)
+{
 	// Declare Variables
-	int   iterationCount, i, j, k;
-	double mvAbs, diff, el;
+	int		iterationCount, i, j, k, modeCandidateX, modeCandidateY, modeCandidate_i, idxd;
+	double	mvAbs, diff, el;
 	
 	//make sure that a lattice height and width have
 	//been defined...
@@ -4441,44 +5502,354 @@ void msImageProcessor::NewNonOptimizedFilter(float sigmaS, float sigmaR)
 	//define input data dimension with lattice
 	int lN	= N + 2;
 	
-	// Traverse each data point applying mean shift
-	// to each data point
-	
 	// Allcocate memory for yk
 	double	*yk		= new double [lN];
 	
 	// Allocate memory for Mh
 	double	*Mh		= new double [lN];
 
-   // let's use some temporary data
-   double* sdata;
-   sdata = new double[lN*L];
-
-   // copy the scaled data
-   int idxs, idxd;
-   idxs = idxd = 0;
-   if (N==3)
-   {
-      for(i=0; i<L; i++)
-      {
-         sdata[idxs++] = (i%width)/sigmaS;
-         sdata[idxs++] = (i/width)/sigmaS;
-         sdata[idxs++] = data[idxd++]/sigmaR;
-         sdata[idxs++] = data[idxd++]/sigmaR;
-         sdata[idxs++] = data[idxd++]/sigmaR;
-      }
-   } else if (N==1)
+   // scaled range data in 16-bit fixed point; the scale is
+   // chosen so that the largest scaled magnitude fills the
+   // short range
+   float rmax = 0, rval;
+   for(i=0; i<L*N; i++)
    {
-      for(i=0; i<L; i++)
-      {
-         sdata[idxs++] = (i%width)/sigmaS;
-         sdata[idxs++] = (i/width)/sigmaS;
-         sdata[idxs++] = data[idxd++]/sigmaR;
-      }
-   } else
+      rval = (float) fabs(data[i]/sigmaR);
+      if (rval > rmax)
+         rmax = rval;
+   }
+   float rscale = (rmax > 0) ? 32767.0f/rmax : 1.0f;
+   float rinv   = 1.0f/rscale;
+
+   short* rdata;
+   rdata = new short[N*L];
+   for(i=0; i<L*N; i++)
    {
-      for(i=0; i<L; i++)
-      {
+      rval = (data[i]/sigmaR)*rscale;
+      rdata[i] = (short) ((rval < 0) ? (rval - 0.5f) : (rval + 0.5f));
+   }
+
+   // index the data in the 3d buckets (x, y, L)
+   int* buckets;
+   int* slist;
+   slist = new int[L];
+   int bucNeigh[27];
+
+   float sMins; // just for L
+   float sMaxs[3]; // for all
+   sMaxs[0] = width/sigmaS;
+   sMaxs[1] = height/sigmaS;
+   sMins = sMaxs[2] = rdata[0]*rinv;
+   float cval;
+   for(i=0; i<L; i++)
+   {
+      cval = rdata[N*i]*rinv;
+      if (cval < sMins)
+         sMins = cval;
+      else if (cval > sMaxs[2])
+         sMaxs[2] = cval;
+   }
+
+   int nBuck1, nBuck2, nBuck3;
+   int cBuck1, cBuck2, cBuck3, cBuck;
+   nBuck1 = (int) (sMaxs[0] + 3);
+   nBuck2 = (int) (sMaxs[1] + 3);
+   nBuck3 = (int) (sMaxs[2] - sMins + 3);
+   buckets = new int[nBuck1*nBuck2*nBuck3];
+   for(i=0; i<(nBuck1*nBuck2*nBuck3); i++)
+      buckets[i] = -1;
+   filterScratchBytes = sizeof(short)*N*L + sizeof(int)*(L + nBuck1*nBuck2*nBuck3);
+
+   for(i=0; i<L; i++)
+   {
+      // find bucket for current data and add it to the list
+      cBuck1 = (int) ((i%width)/sigmaS) + 1;
+      cBuck2 = (int) ((i/width)/sigmaS) + 1;
+      cBuck3 = (int) (rdata[N*i]*rinv - sMins) + 1;
+      cBuck = cBuck1 + nBuck1*(cBuck2 + nBuck2*cBuck3);
+
+      slist[i] = buckets[cBuck];
+      buckets[cBuck] = i;
+   }
+   // init bucNeigh
+   idxd = 0;
+   for (cBuck1=-1; cBuck1<=1; cBuck1++)
+   {
+      for (cBuck2=-1; cBuck2<=1; cBuck2++)
+      {
+         for (cBuck3=-1; cBuck3<=1; cBuck3++)
+         {
+            bucNeigh[idxd++] = cBuck1 + nBuck1*(cBuck2 + nBuck2*cBuck3);
+         }
+      }
+   }
+   double wsuml, weight;
+   double hiLTr = 80.0/sigmaR;
+   double px[5];
+   // done indexing/hashing
+
+	
+	// Initialize mode table used for basin of attraction
+	memset(modeTable, 0, width*height);
+
+	for(i = 0; i < L; i++)
+	{
+		// if a mode was already assigned to this data point
+		// then skip this point, otherwise proceed to
+		// find its mode by applying mean shift...
+		if (modeTable[i] == 1)
+			continue;
+
+		// initialize point list...
+		pointCount = 0;
+
+		// Assign window center
+      yk[0] = (i%width)/sigmaS;
+      yk[1] = (i/width)/sigmaS;
+      for (j=0; j<N; j++)
+         yk[j+2] = rdata[N*i+j]*rinv;
+
+		// Keep shifting window center until the magnitude squared of the
+		// mean shift vector calculated at the window center location is
+		// under a specified threshold (Epsilon)
+		iterationCount = 0;
+		mvAbs = EPSILON;
+		while((mvAbs >= EPSILON)&&(iterationCount < LIMIT))
+		{
+			if (iterationCount > 0)
+			{
+				// Shift window location
+				for(j = 0; j < lN; j++)
+					yk[j] += Mh[j];
+
+				// calculate the location of yk on the lattice
+				modeCandidateX	= (int) (sigmaS*yk[0]+0.5);
+				modeCandidateY	= (int) (sigmaS*yk[1]+0.5);
+				modeCandidate_i	= modeCandidateY*width + modeCandidateX;
+
+				// check the basin of attraction (see NewOptimizedFilter2)
+				if ((modeTable[modeCandidate_i] != 2) && (modeCandidate_i != i))
+				{
+					diff = 0;
+					for (k=0; k<N; k++)
+					{
+						el = rdata[N*modeCandidate_i+k]*rinv - yk[k+2];
+						diff += el*el;
+					}
+
+					if (diff < speedThreshold)
+					{
+						if (modeTable[modeCandidate_i] == 0)
+						{
+							pointList[pointCount++]		= modeCandidate_i;
+							modeTable[modeCandidate_i]	= 2;
+						} else
+						{
+							// store the mode info into yk using msRawData...
+							for (j = 0; j < N; j++)
+								yk[j+2] = msRawData[modeCandidate_i*N+j]/sigmaR;
+
+							modeTable[i] = 1;
+							mvAbs = -1;
+							break;
+						}
+					}
+				}
+			}
+
+			// Calculate the mean shift vector at the window
+			// location using the bucket grid
+			for(j = 0; j < lN; j++)
+				Mh[j] = 0;
+			wsuml = 0;
+			cBuck1 = (int) yk[0] + 1;
+			cBuck2 = (int) yk[1] + 1;
+			cBuck3 = (int) (yk[2] - sMins) + 1;
+			cBuck = cBuck1 + nBuck1*(cBuck2 + nBuck2*cBuck3);
+			for (j=0; j<27; j++)
+			{
+				idxd = buckets[cBuck+bucNeigh[j]];
+				while (idxd>=0)
+				{
+					// determine if inside search window
+					px[0] = (idxd%width)/sigmaS;
+					px[1] = (idxd/width)/sigmaS;
+					el = px[0]-yk[0];
+					diff = el*el;
+					el = px[1]-yk[1];
+					diff += el*el;
+
+					if (diff < 1.0)
+					{
+						for (k=0; k<N; k++)
+							px[k+2] = rdata[N*idxd+k]*rinv;
+						el = px[2]-yk[2];
+						if (yk[2] > hiLTr)
+							diff = 4*el*el;
+						else
+							diff = el*el;
+
+						if (N>1)
+						{
+							el = px[3]-yk[3];
+							diff += el*el;
+							el = px[4]-yk[4];
+							diff += el*el;
+						}
+
+						if (diff < 1.0)
+						{
+							weight = 1-weightMap[idxd];
+							for (k=0; k<lN; k++)
+								Mh[k] += weight*px[k];
+							wsuml += weight;
+
+							//set basin of attraction mode table
+							if (diff < speedThreshold)
+							{
+								if(modeTable[idxd] == 0)
+								{
+									pointList[pointCount++]	= idxd;
+									modeTable[idxd]	= 2;
+								}
+							}
+						}
+					}
+					idxd = slist[idxd];
+				}
+			}
+			if (wsuml > 0)
+			{
+				for(j = 0; j < lN; j++)
+					Mh[j] = Mh[j]/wsuml - yk[j];
+			}
+			else
+			{
+				for(j = 0; j < lN; j++)
+					Mh[j] = 0;
+			}
+
+			// Calculate its magnitude squared
+			mvAbs = (Mh[0]*Mh[0]+Mh[1]*Mh[1])*sigmaS*sigmaS;
+			if (N==3)
+				mvAbs += (Mh[2]*Mh[2]+Mh[3]*Mh[3]+Mh[4]*Mh[4])*sigmaR*sigmaR;
+			else
+				mvAbs += Mh[2]*Mh[2]*sigmaR*sigmaR;
+
+			// Increment iteration count
+			iterationCount++;
+		}
+
+		// if a mode was not associated with this data point
+		// yet associate it with yk...
+		if (mvAbs >= 0)
+		{
+			// Shift window location
+			for(j = 0; j < lN; j++)
+				yk[j] += Mh[j];
+			
+			modeTable[i] = 1;
+		}
+		
+      for (k=0; k<N; k++)
+         yk[k+2] *= sigmaR;
+
+		// associate the data point indexed by
+		// the point list with the mode stored
+		// by yk
+		for (j = 0; j < pointCount; j++)
+		{
+			modeCandidate_i = pointList[j];
+			modeTable[modeCandidate_i] = 1;
+			for(k = 0; k < N; k++)
+				msRawData[N*modeCandidate_i+k] = (float)(yk[k+2]);
+		}
+
+		//store result into msRawData...
+		for(j = 0; j < N; j++)
+			msRawData[N*i+j] = (float)(yk[j+2]);
+
+		// Check to see if the algorithm has been halted
+		if((i%PROGRESS_RATE == 0)&&((ErrorStatus = CheckHalt()) == EL_HALT))
+			break;
+	}
+	
+	// de-allocate memory
+   delete [] buckets;
+   delete [] slist;
+   delete [] rdata;
+
+	delete [] yk;
+	delete [] Mh;
+	
+	// done.
+	return;
+
+}
+
+void msImageProcessor::NewNonOptimizedFilter(float sigmaS, float sigmaR)
+{
+
+	// Declare Variables
+	int   iterationCount, i, j, k;
+	double mvAbs, diff, el;
+	
+	//make sure that a lattice height and width have
+	//been defined...
+	if(!height)
+	{
+		ErrorHandler("msImageProcessor", "LFilter", "Lattice height and width are undefined.");
+		return;
+	}
+
+	//re-assign bandwidths to sigmaS and sigmaR
+	if(((h[0] = sigmaS) <= 0)||((h[1] = sigmaR) <= 0))
+	{
+		ErrorHandler("msImageProcessor", "Segment", "sigmaS and/or sigmaR is zero or negative.");
+		return;
+	}
+	
+	//define input data dimension with lattice
+	int lN	= N + 2;
+	
+	// Traverse each data point applying mean shift
+	// to each data point
+	
+	// Allcocate memory for yk
+	double	*yk		= new double [lN];
+	
+	// Allocate memory for Mh
+	double	*Mh		= new double [lN];
+
+   // let's use some temporary data
+   double* sdata;
+   sdata = new double[lN*L];
+
+   // copy the scaled data
+   int idxs, idxd;
+   idxs = idxd = 0;
+   if (N==3)
+   {
+      for(i=0; i<L; i++)
+      {
+         sdata[idxs++] = (i%width)/sigmaS;
+         sdata[idxs++] = (i/width)/sigmaS;
+         sdata[idxs++] = data[idxd++]/sigmaR;
+         sdata[idxs++] = data[idxd++]/sigmaR;
+         sdata[idxs++] = data[idxd++]/sigmaR;
+      }
+   } else if (N==1)
+   {
+      for(i=0; i<L; i++)
+      {
+         sdata[idxs++] = (i%width)/sigmaS;
+         sdata[idxs++] = (i/width)/sigmaS;
+         sdata[idxs++] = data[idxd++]/sigmaR;
+      }
+   } else
+   {
+      for(i=0; i<L; i++)
+      {
          sdata[idxs++] = (i%width)/sigmaS;
          sdata[idxs++] = (i%width)/sigmaS;
          for (j=0; j<N; j++)
@@ -4517,6 +5888,7 @@ void msImageProcessor::NewNonOptimizedFilter(float sigmaS, float sigmaR)
    buckets = new int[nBuck1*nBuck2*nBuck3];
    for(i=0; i<(nBuck1*nBuck2*nBuck3); i++)
       buckets[i] = -1;
+   filterScratchBytes = sizeof(*sdata)*lN*L + sizeof(int)*(L + nBuck1*nBuck2*nBuck3);
 
    idxs = 0;
    for(i=0; i<L; i++)
@@ -4745,8 +6117,8 @@ void msImageProcessor::NewNonOptimizedFilter(float sigmaS, float sigmaR)
 #endif
 	
 		// Check to see if the algorithm has been halted
-//		if((i%PROGRESS_RATE == 0)&&((ErrorStatus = msSys.Progress((float)(i/(float)(L))*(float)(0.8)))) == EL_HALT)
-//			break;
+		if((i%PROGRESS_RATE == 0)&&((ErrorStatus = CheckHalt()) == EL_HALT))
+			break;
 	}
 	
 	// Prompt user that filtering is completed
@@ -4775,6 +6147,258 @@ void msImageProcessor::SetSpeedThreshold(float speedUpThreshold)
    speedThreshold = speedUpThreshold;
 }
 
+/*******************************************************/
+/*Set Compact Mode                                     */
+/*******************************************************/
+/*Post:                                                */
+/*      - compact storage is used by subsequent filte- */
+/*        ring, fusing and segmentation if compact is  */
+/*        true (see msImageProcessor.h).               */
+/*******************************************************/
+
+void msImageProcessor::SetCompactMode(bool compact)
+{
+	compactMode	= compact;
+
+	//leaving compact mode restores integer labels
+	if(!compactMode)
+		ExpandLabels();
+}
+
+bool msImageProcessor::GetCompactMode( void ) const
+{
+	return compactMode;
+}
+
+const unsigned short *msImageProcessor::GetLabels16View( void ) const
+{
+	return (class_state.OUTPUT_DEFINED ? labels16 : NULL);
+}
+
+/*******************************************************/
+/*Save Filter Result                                   */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - the image has been filtered and not yet      */
+/*        fused                                        */
+/*Post:                                                */
+/*      - a copy of the labels, modes and mode point   */
+/*        counts has been taken, replacing any taken   */
+/*        before.                                      */
+/*******************************************************/
+
+void msImageProcessor::SaveFilterResult( void )
+{
+
+	DiscardFilterResult();
+	if(!class_state.OUTPUT_DEFINED)
+	{
+		ErrorHandler("msImageProcessor", "SaveFilterResult", "No filtered image to save.");
+		return;
+	}
+
+	savedRegionCount		= regionCount;
+	savedLabels				= new int [L];
+	savedModes				= new float [regionCount*N];
+	savedModePointCounts	= new int [regionCount];
+
+	int i;
+	if(labels)
+		memcpy(savedLabels, labels, sizeof(int)*L);
+	else
+		for(i = 0; i < L; i++)
+			savedLabels[i]	= labels16[i];
+	memcpy(savedModes, modes, sizeof(float)*regionCount*N);
+	memcpy(savedModePointCounts, modePointCounts, sizeof(int)*regionCount);
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Restore Filter Result                                */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - SaveFilterResult() has been called since the */
+/*        image was last filtered                      */
+/*Post:                                                */
+/*      - the labels, modes and mode point counts are  */
+/*        those saved, so that FuseRegions() starts    */
+/*        again from the filtered image; the saved     */
+/*        copy is kept.                                */
+/*******************************************************/
+
+void msImageProcessor::RestoreFilterResult( void )
+{
+
+	if((!savedLabels)||(!class_state.OUTPUT_DEFINED))
+	{
+		ErrorHandler("msImageProcessor", "RestoreFilterResult", "No filter result has been saved.");
+		return;
+	}
+
+	//labels are restored as integers, compact mode narrows
+	//them again once the next operation ends
+	if(labels16)
+	{
+		delete [] labels16;
+		labels16	= NULL;
+	}
+	if(!labels)
+		labels	= new int [L];
+	memcpy(labels, savedLabels, sizeof(int)*L);
+
+	//fusing may have shrunk mode storage
+	if(modeCapacity < savedRegionCount)
+	{
+		delete [] modes;
+		delete [] modePointCounts;
+		modes			= new float [savedRegionCount*N];
+		modePointCounts	= new int [savedRegionCount];
+		modeCapacity	= savedRegionCount;
+	}
+	memcpy(modes, savedModes, sizeof(float)*savedRegionCount*N);
+	memcpy(modePointCounts, savedModePointCounts, sizeof(int)*savedRegionCount);
+	regionCount		= savedRegionCount;
+
+	//msRawData may have been rebuilt from fused modes
+	rawDataStale	= true;
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Discard Filter Result                                */
+/*******************************************************/
+/*Post:                                                */
+/*      - the copy taken by SaveFilterResult(), if     */
+/*        any, has been de-allocated.                  */
+/*******************************************************/
+
+void msImageProcessor::DiscardFilterResult( void )
+{
+
+	if(savedLabels)				delete [] savedLabels;
+	if(savedModes)				delete [] savedModes;
+	if(savedModePointCounts)	delete [] savedModePointCounts;
+	savedLabels				= NULL;
+	savedModes				= NULL;
+	savedModePointCounts	= NULL;
+	savedRegionCount		= 0;
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Get Memory Report                                    */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - report holds maxStages entries               */
+/*Post:                                                */
+/*      - the recorded stages (at most maxStages) have */
+/*        been copied into report and their number is  */
+/*        returned.                                    */
+/*******************************************************/
+
+int msImageProcessor::GetMemoryReport(msStageMemory *report, int maxStages)
+{
+	int i, count = (memoryStages < maxStages ? memoryStages : maxStages);
+	for(i = 0; i < count; i++)
+		report[i]	= memoryReport[i];
+	return count;
+}
+
+/*******************************************************/
+/*Get Timing Report                                    */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - report holds maxKernels entries              */
+/*Post:                                                */
+/*      - the timed kernels (at most maxKernels) have  */
+/*        been copied into report and their number is  */
+/*        returned.                                    */
+/*******************************************************/
+
+int msImageProcessor::GetTimingReport(msKernelTiming *report, int maxKernels)
+{
+	int i, count = (timingKernels < maxKernels ? timingKernels : maxKernels);
+	for(i = 0; i < count; i++)
+		report[i]	= timingReport[i];
+	return count;
+}
+
+/*******************************************************/
+/*Reset Timing Report                                  */
+/*******************************************************/
+/*Post:                                                */
+/*      - the timing report is empty.                  */
+/*******************************************************/
+
+void msImageProcessor::ResetTimingReport( void )
+{
+	timingKernels	= 0;
+}
+
+/*******************************************************/
+/*Set Kernel Hook                                      */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - hook is the function to call after each      */
+/*        kernel call, or NULL for none                */
+/*Post:                                                */
+/*      - RecordTiming() calls hook from now on, on    */
+/*        every thread.                                */
+/*******************************************************/
+
+void msImageProcessor::SetKernelHook(msKernelHook hook)
+{
+	kernelHook.store(hook);
+}
+
+/*******************************************************/
+/*Set Halt Conditions                                  */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - budget is the time in milliseconds that the  */
+/*        processing may take from now, <= 0 for no    */
+/*        limit                                        */
+/*      - cancel is a flag that halts the processing   */
+/*        once true, or NULL for none                  */
+/*Post:                                                */
+/*      - CheckHalt() returns EL_HALT once either      */
+/*        condition is met.                            */
+/*******************************************************/
+
+void msImageProcessor::SetHaltConditions(double budget, const std::atomic<bool> *cancel)
+{
+	haltDeadline	= (budget > 0 ? KernelClock() + budget : 0);
+	haltFlag		= cancel;
+}
+
+/*******************************************************/
+/*Check Halt                                           */
+/*******************************************************/
+/*Post:                                                */
+/*      - EL_HALT is returned if the cancel flag is set*/
+/*        or the deadline has passed, EL_OKAY if not.  */
+/*        With no conditions set nothing is read but   */
+/*        the two members.                             */
+/*******************************************************/
+
+ErrorLevel msImageProcessor::CheckHalt( void )
+{
+	if((haltFlag)&&(haltFlag->load(std::memory_order_relaxed)))
+		return EL_HALT;
+	if((haltDeadline > 0)&&(KernelClock() >= haltDeadline))
+		return EL_HALT;
+	return EL_OKAY;
+}
+
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@ END OF CLASS DEFINITION @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
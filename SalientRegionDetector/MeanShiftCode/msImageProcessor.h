@@ -50,6 +50,15 @@ Implemented by Chris M. Christoudias, Bogdan Georgescu
 //region pruning and transitive closure
 #include	"RAList.h"
 
+//size_t used by the memory report
+#include	<stddef.h>
+
+//cancellation flag of the halt conditions
+#include	<atomic>
+
+//strided views of caller owned images
+#include	"../ImageView.h"
+
 //define constants
 
 	//image pruning
@@ -57,6 +66,12 @@ Implemented by Chris M. Christoudias, Bogdan Georgescu
 #define BIG_NUM				0xffffffff	//BIG_NUM = 2^32-1
 #define NODE_MULTIPLE		10
 
+	//memory report
+#define MS_MEMORY_STAGES	8
+
+	//timing report
+#define MS_TIMING_KERNELS	8
+
 	//data space conversion...
 const double Xn			= 0.95050;
 const double Yn			= 1.00000;
@@ -79,10 +94,31 @@ const double RGB[3][3] = {	{  3.2405, -1.5371, -0.4985 },
 
 //define data types
 typedef unsigned char byte;
+typedef unsigned char BYTE;
 
 //define enumerations
 enum imageType {GRAYSCALE, COLOR};
 
+//define memory report entry: the number of bytes held by the
+//processor (resident buffers plus stage scratch) at a stage
+struct msStageMemory {
+	const char	*stage;
+	size_t		bytes;
+};
+
+//define timing report entry: the time spent in a kernel
+//and the number of times it ran
+struct msKernelTiming {
+	const char	*kernel;
+	double		ms;
+	int			calls;
+};
+
+//define kernel hook: called at the end of each kernel call
+//with the kernel name and the clock times (milliseconds of a
+//steady clock) at which the call started and ended
+typedef void (*msKernelHook)(const char *kernel, double start, double end);
+
 //define prototype
 class msImageProcessor: public MeanShift {
 
@@ -146,6 +182,79 @@ public:
   void DefineImage(byte*,imageType, int, int);
   void DefineBgImage(byte*, imageType , int , int );
 
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|				* Define Lab Image *                 |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Uploads a color image that has already been      |//
+  //|   converted to the Lab space, so that a caller     |//
+  //|   who needs the Lab planes for its own purposes    |//
+  //|   does not pay for a second conversion.            |//
+  //|                                                    |//
+  //|   <* l, a, b *>                                    |//
+  //|   Three planar arrays of (height x width) doubles  |//
+  //|   holding the L, a and b components in row-major   |//
+  //|   order, in the same scale as produced by RGB2LAB. |//
+  //|                                                    |//
+  //|   <* height *>                                     |//
+  //|   The image height.                                |//
+  //|                                                    |//
+  //|   <* width *>                                      |//
+  //|   The image width.                                 |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|		DefineLabImage(l, a, b, height, width)       |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+  void DefineLabImage(const double*, const double*, const double*, int, int);
+
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|			  * Define Image (View) *                |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Uploads an image given as an ImageView, in any   |//
+  //|   of its pixel layouts and row strides, without    |//
+  //|   first repacking it into interleaved RGB bytes.   |//
+  //|   A PIXEL_GRAY8 view defines a GREYSCALE image,    |//
+  //|   any other layout a COLOR image, converted as     |//
+  //|   DefineImage() converts its RGB bytes.            |//
+  //|                                                    |//
+  //|   <* image *>                                      |//
+  //|   The pixels; only read, and not kept after the    |//
+  //|   call returns.                                    |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|		DefineImage(image)                           |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+  void DefineImage(const ImageView&);
+
 
  /*/\/\/\/\/\/\*/
  /* Weight Map */
@@ -541,7 +650,9 @@ public:
   //|   Returns the boundaries of each region of the     |//
   //|   segmented image using a region list object,      |//
   //|   available after filtering or segmenting the      |//
-  //|   defined image.                                   |//
+  //|   defined image. Boundaries are run-length enco-   |//
+  //|   ded; use GetRegionRuns() or a RegionPoint-       |//
+  //|   Iterator to visit them.                          |//
   //|                                                    |//
   //<--------------------------------------------------->|//
   //|                                                    |//
@@ -554,6 +665,35 @@ public:
 
   RegionList *GetBoundaries( void );
 
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|				 *  Get Label Runs  *                |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Returns the label image of the segmented image   |//
+  //|   run-length encoded row by row, available after   |//
+  //|   filtering or segmenting the defined image. The   |//
+  //|   run list is owned by the processor and is valid  |//
+  //|   until the next call.                             |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|		labelRuns = GetLabelRuns()                   |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+  LabelRunList *GetLabelRuns( void );
+
   //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
   //<--------------------------------------------------->|//
   //|                                                    |//
@@ -623,7 +763,348 @@ public:
 
   int GetLabels(int* lab);//function added to simply get the labels and the number of labels
 
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|			     * Get Region Views *                |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Return read-only views of the labels (length L), |//
+  //|   modes (length regionCount*N) and modePointCounts |//
+  //|   (length regionCount) stored by the processor,    |//
+  //|   without copying them as GetRegions() and         |//
+  //|   GetLabels() do.                                  |//
+  //|                                                    |//
+  //|   NOTE: The views are owned by the processor and   |//
+  //|         remain valid until the image is re-defin-  |//
+  //|         ed, re-processed or the processor is dest- |//
+  //|         royed. NULL is returned if the image has   |//
+  //|         not been filtered or segmented, and by     |//
+  //|         GetLabelsView() while compact mode holds   |//
+  //|         the labels in 16 bits.                     |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|		labels = GetLabelsView()                     |//
+  //|		modes  = GetModesView()                      |//
+  //|		counts = GetModePointCountsView()            |//
+  //|		regionCount = GetRegionCount()               |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+  const int		*GetLabelsView( void ) const;
+  const float	*GetModesView( void ) const;
+  const int		*GetModePointCountsView( void ) const;
+  int			GetRegionCount( void ) const;
+
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|			  * Get Results (ARGB/Planar) *          |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Variants of GetResults() that write the filtered |//
+  //|   or segmented image straight into a caller supp-  |//
+  //|   lied buffer in the layout the caller uses, avo-  |//
+  //|   iding an interleaved byte copy and repack.       |//
+  //|                                                    |//
+  //|   <* outputImage *>                                |//
+  //|   Packed 32-bit pixels, (alpha<<24)|(R<<16)|(G<<8) |//
+  //|   |B, with rows stride pixels apart (stride >=     |//
+  //|   width).                                          |//
+  //|                                                    |//
+  //|   <* red, green, blue *>                           |//
+  //|   Three planes of L bytes each. For a GREYSCALE    |//
+  //|   image the value is written to each non-NULL      |//
+  //|   plane.                                           |//
+  //|                                                    |//
+  //|   <* colorTable *>                                 |//
+  //|   regionCount packed 0x00RRGGBB colors, one per    |//
+  //|   region mode; the segmented image is the color    |//
+  //|   of each pixel's label.                           |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|		GetResultsARGB(outputImage, stride [, alpha])|//
+  //|		GetResultsPlanar(red, green, blue)           |//
+  //|		GetRegionColors(colorTable)                  |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+  void GetResultsARGB(unsigned int*, int, unsigned int alpha = 0);
+  void GetResultsPlanar(byte*, byte*, byte*);
+  void GetRegionColors(unsigned int*);
+
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|			    * Get Results (View) *               |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Writes the filtered or segmented image into a    |//
+  //|   caller supplied ImageView in its own pixel lay-  |//
+  //|   out and row stride. A PIXEL_XRGB32 view with a   |//
+  //|   positive stride is written as GetResultsARGB()   |//
+  //|   writes it, with a zero top byte.                 |//
+  //|                                                    |//
+  //|   <* image *>                                      |//
+  //|   Writable pixels of the size of the image.        |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|		GetResults(image)                            |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+  void GetResults(const ImageView&);
+
   void SetSpeedThreshold(float);
+
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|			      * Set Compact Mode *               |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Trades a little accuracy for a smaller working   |//
+  //|   set. In compact mode:                            |//
+  //|                                                    |//
+  //|   - HIGH_SPEEDUP filtering keeps the scaled range  |//
+  //|     data as 16-bit fixed point and derives spatial |//
+  //|     coordinates from the point index;              |//
+  //|   - modes and modePointCounts are shrunk to        |//
+  //|     regionCount entries once an operation ends;    |//
+  //|   - labels are stored in 16 bits when regionCount  |//
+  //|     is below 65536 (see GetLabels16View()).        |//
+  //|                                                    |//
+  //|   Must be set before filtering or segmenting.      |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|		SetCompactMode(true)                         |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+  void SetCompactMode(bool);
+  bool GetCompactMode( void ) const;
+
+  //returns the 16-bit labels kept in compact mode, or NULL if
+  //labels are held as integers (use GetLabelsView() then)
+  const unsigned short *GetLabels16View( void ) const;
+
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|			     * Get Memory Report *               |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Copies up to maxStages entries of the memory     |//
+  //|   report into report and returns their number.     |//
+  //|   Stages are "define", "filter", "connect",        |//
+  //|   "output", "fuse" and "segment"; each entry holds |//
+  //|   the bytes last measured at that stage, including |//
+  //|   the filter's temporary buffers for "filter".     |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|		count = GetMemoryReport(report, maxStages)   |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+  int GetMemoryReport(msStageMemory*, int);
+
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|			     * Get Timing Report *               |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Copies up to maxKernels entries of the timing    |//
+  //|   report into report and returns their number.     |//
+  //|   Each entry holds the milliseconds spent in one   |//
+  //|   kernel and its number of calls since the image   |//
+  //|   was defined or ResetTimingReport() was called.   |//
+  //|   Kernels are the filter that ran (e.g. "NewOpti-  |//
+  //|   mizedFilter2"), "Connect", "BuildRAM", "Transi-  |//
+  //|   tiveClosure" and "Prune"; the last two include   |//
+  //|   the BuildRAM calls they make.                    |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|		count = GetTimingReport(report, maxKernels)  |//
+  //|		ResetTimingReport()                          |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+  int GetTimingReport(msKernelTiming*, int);
+  void ResetTimingReport( void );
+
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|			     * Set Kernel Hook *                 |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Installs a function called after every kernel    |//
+  //|   call recorded in the timing report, by any       |//
+  //|   processor, e.g. to trace each call on its own.   |//
+  //|   The hook runs on the thread that ran the kernel. |//
+  //|   Install it before images are processed; NULL     |//
+  //|   removes it.                                      |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|		msImageProcessor::SetKernelHook(hook)        |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+  static void SetKernelHook(msKernelHook);
+
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|			   * Set Halt Conditions *              |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Bounds the time that later calls to Filter(),    |//
+  //|   FuseRegions() and Segment() may take. The filter |//
+  //|   loops, each transitive closure iteration and     |//
+  //|   each pruning round check whether *cancel has     |//
+  //|   been set or the budget has run out; if so the    |//
+  //|   call stops, destroys its output and returns with |//
+  //|   ErrorStatus set to EL_HALT. The next call starts |//
+  //|   afresh with the same conditions.                 |//
+  //|                                                    |//
+  //|   <* budget *>                                     |//
+  //|   Milliseconds from this call after which the      |//
+  //|   processing halts; <= 0 for no limit (default).   |//
+  //|                                                    |//
+  //|   <* cancel *>                                     |//
+  //|   Halts the processing once true; it may be set    |//
+  //|   from any thread. NULL for none (default).        |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|		SetHaltConditions(budget, cancel)        |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+  void SetHaltConditions(double budget = 0, const std::atomic<bool> *cancel = NULL);
+
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|		* Save/Restore Filter Result *               |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Region fusing overwrites the labels and modes    |//
+  //|   that Filter() leaves behind. SaveFilterResult()  |//
+  //|   keeps a copy of them so that, after a call to    |//
+  //|   FuseRegions(), RestoreFilterResult() can put     |//
+  //|   them back and the same filtered image can be     |//
+  //|   fused again with another sigmaR or minRegion.    |//
+  //|   Filter() followed by FuseRegions(sigmaR,         |//
+  //|   minRegion) gives the same labels as Segment()    |//
+  //|   with those parameters.                           |//
+  //|                                                    |//
+  //|   The filtered image itself is not restored:       |//
+  //|   results read after a restore show the modes of   |//
+  //|   the restored regions.                            |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|		Filter(sigmaS, sigmaR, speedUpLevel)         |//
+  //|		SaveFilterResult()                           |//
+  //|		FuseRegions(sigmaR, minRegion1)              |//
+  //|		RestoreFilterResult()                        |//
+  //|		FuseRegions(sigmaR, minRegion2)              |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+  void SaveFilterResult( void );
+  void RestoreFilterResult( void );
+  void DiscardFilterResult( void );
 private:
 
   //========================
@@ -657,6 +1138,12 @@ private:
 											// Disadvantage	: not as accurate as previous filters
    void NewOptimizedFilter2(float, float);
 
+   void CompactOptimizedFilter2(float, float);	// NewOptimizedFilter2 using 16-bit fixed point range
+											// data and implicit spatial coordinates (compact mode)
+
+	void ApplyFilter(int, float, SpeedUpLevel);	// filters and connects the image (shared by Filter and
+											// Segment)
+
 	
 	/*/\/\/\/\/\/\/\/\/\/\/\*/
 	/* Image Classification */
@@ -718,6 +1205,39 @@ private:
 	void DestroyOutput( void );				//De-allocates memory needed by this class to perform image
 											//filtering and segmentation
 
+	/*/\/\/\/\/\/\/\/\/\/\/\/\*/
+	/*  Output Materialization  */
+	/*\/\/\/\/\/\/\/\/\/\/\/\/*/
+
+	void RebuildRawData( void );			// writes modes[labels[i]] into msRawData if it is stale
+
+	/*/\/\/\/\/\/\/\/\/\/\/\*/
+	/*  Compact Mode Storage  */
+	/*\/\/\/\/\/\/\/\/\/\/\/*/
+
+	void CompactOutput( void );				// shrinks modes/modePointCounts and narrows labels to 16 bits
+											// (compact mode only)
+
+	void ExpandLabels( void );				// restores integer labels before they are consumed by the
+											// classification algorithms
+
+	void ReserveModes( void );				// restores full size mode storage before Connect()
+
+	size_t ResidentBytes( void );			// bytes currently held by the processor's buffers
+
+	void RecordMemory(const char*, size_t);	// stores ResidentBytes()+scratch under a stage name
+
+	static double KernelClock( void );		// milliseconds from a steady clock, for the timing report
+
+	void RecordTiming(const char*, double);	// charges the time since a KernelClock() value to a kernel
+
+	ErrorLevel CheckHalt( void );			// EL_HALT once the conditions of SetHaltConditions() are met
+
+	void RegionColorTable(unsigned int*);	// converts the mode of each region to packed 0x00RRGGBB once
+											// (regionCount entries) so outputs can be filled by label
+
+	void GatherRow(int, const unsigned int*, unsigned int*);	// fills one image row from the color table by label
+
   //=============================
   // *** Private Data Members ***
   //=============================
@@ -729,6 +1249,9 @@ private:
 	/////////Image Boundaries/////////
 	RegionList		*regionList;			// stores the boundary locations for each region
 
+	/////////Run Length Labels/////////
+	LabelRunList	*labelRuns;				// stores the label image as row broken runs
+
 	/////////Image Regions////////
 	int				regionCount;			// stores the number of connected regions contained by the
 											// image
@@ -741,7 +1264,8 @@ private:
 
 	/////////LUV_data/////////////////
    //int            *LUV_data;           //stores modes in integer format on lattice
-	float				*LUV_data;				//stores modes in float format on lattice
+	float				*LUV_data;				//modes in float format on lattice; points at msRawData
+											//(or data when fusing) instead of holding a copy
    float          LUV_treshold;        //in float mode this determines what "close" means between modes
 
 
@@ -753,6 +1277,29 @@ private:
 	float			*msRawData;				// Raw data output of mean shift algorithm
 											// to the location of the data point on the lattice
 
+	bool			rawDataStale;			// true after segmentation/fusing: msRawData does not yet
+											// hold modes[labels[i]] and is only rebuilt on demand
+
+	////////Compact Mode////////
+	bool			compactMode;			// see SetCompactMode()
+	unsigned short	*labels16;				// 16-bit labels (compact mode, labels is NULL while in use)
+	int				modeCapacity;			// number of regions modes and modePointCounts can hold
+	int				outputLength;			// L*N when the output buffers were allocated, for reuse
+	size_t			filterScratchBytes;		// temporary storage used by the last filter run
+
+	////////Memory Report////////
+	msStageMemory	memoryReport[MS_MEMORY_STAGES];
+	int				memoryStages;
+
+	////////Timing Report////////
+	msKernelTiming	timingReport[MS_TIMING_KERNELS];
+	int				timingKernels;
+	static std::atomic<msKernelHook>	kernelHook;	// called by RecordTiming, shared by all processors and threads
+
+	////////Halt Conditions////////
+	double			haltDeadline;			// KernelClock() value at which to halt, 0 for none
+	const std::atomic<bool>	*haltFlag;		// halt once true, NULL for none
+
 	////////Data Modes////////
 	int				*labels;				// assigns a label to each data point associating it to
 											// a mode in modes (e.g. a data point having label l has
@@ -763,6 +1310,12 @@ private:
 	int				*modePointCounts;		// stores for each mode the number of point mapped to that mode,
 											// indexed by labels
 
+	////////Saved Filter Result////////
+	int				*savedLabels;			// copies of labels, modes and modePointCounts taken by
+	float			*savedModes;			// SaveFilterResult(), NULL if none was taken
+	int				*savedModePointCounts;
+	int				savedRegionCount;
+
    //##########################################
    //#######  REGION ADJACENCY MATRIX  ########
    //##########################################
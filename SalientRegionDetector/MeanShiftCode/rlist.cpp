@@ -31,10 +31,10 @@ and they are is available at:
 Implemented by Chris M. Christoudias, Bogdan Georgescu
 ********************************************************/
 
-#include	<stdafx.h>
 #include	"rlist.h"
 #include	<stdio.h>
 #include	<stdlib.h>
+#include	<string.h>
 
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
@@ -59,12 +59,14 @@ Implemented by Chris M. Christoudias, Bogdan Georgescu
 /*        ified by the region list class               */
 /*      - N is the dimension of the data set being cl- */
 /*        assified by the region list class            */
+/*      - maxRuns_ is the initial capacity of the run  */
+/*        table (zero selects a default)               */
 /*Post:                                                */
 /*      - a region list object has been properly init- */
 /*        ialized.                                     */
 /*******************************************************/
 
-RegionList::RegionList(int maxRegions_, int L_, int N_)
+RegionList::RegionList(int maxRegions_, int L_, int N_, int maxRuns_)
 {
 
 	//Obtain maximum number of regions that can be
@@ -81,10 +83,17 @@ RegionList::RegionList(int maxRegions_, int L_, int N_)
 	if((L = L_) <= 0)
 		ErrorHandler("RegionList", "Length of data set is zero or negative.", FATAL);
 
-	//Allocate memory for index table
-	if(!(indexTable = new int [L]))
+	//Allocate memory for run table (two integers per run); the
+	//table grows on demand so a modest default suffices
+	if((maxRuns = maxRuns_) <= 0)
+		maxRuns	= maxRegions;
+	if(!(runTable = new int [2*maxRuns]))
 		ErrorHandler("RegionList", "Not enough memory.", FATAL);
 
+	//Index buffer is only allocated if GetRegionIndeces() is used
+	indexBuffer		= NULL;
+	indexBufferSize	= 0;
+
 	//Allocate memory for region list array
 	if(!(regionList = new REGION [maxRegions]))
 		ErrorHandler("RegionList", "Not enough memory.", FATAL);
@@ -92,7 +101,8 @@ RegionList::RegionList(int maxRegions_, int L_, int N_)
 	//Initialize region list...
 	numRegions		= freeRegion = 0;
 
-	//Initialize indexTable
+	//Initialize run table
+	freeRunLoc		= 0;
 	freeBlockLoc	= 0;
 
 	//done.
@@ -114,7 +124,8 @@ RegionList::~RegionList( void )
 {
 	//de-allocate memory...
 	delete [] regionList;
-	delete [] indexTable;
+	delete [] runTable;
+	delete [] indexBuffer;
 
 	//done.
 	return;
@@ -142,6 +153,8 @@ RegionList::~RegionList( void )
 /*      - a new region labeled using label and contai- */
 /*        ning pointCount number of points has been    */
 /*        added to the region list.                    */
+/*      - runs of consecutive indeces are stored as a  */
+/*        single (start, length) pair.                 */
 /*******************************************************/
 
 void RegionList::AddRegion(int label, int pointCount, int *indeces)
@@ -161,19 +174,40 @@ void RegionList::AddRegion(int label, int pointCount, int *indeces)
 	if((freeBlockLoc + pointCount) > L)
 		ErrorHandler("AddRegion", "Adding more points than what is contained in data set.", FATAL);
 
+	//count the runs of consecutive indeces and make sure
+	//the run table can hold them
+	int i, runCount = 1;
+	for(i = 1; i < pointCount; i++)
+		runCount += (indeces[i] != indeces[i-1]+1);
+	if(freeRunLoc + runCount > maxRuns)
+		GrowRunTable(freeRunLoc + runCount);
+
 	//place new region into region list array using
 	//freeRegion index
 	regionList[freeRegion].label		= label;
 	regionList[freeRegion].pointCount	= pointCount;
-	regionList[freeRegion].region		= freeBlockLoc;
-
-	//copy indeces into indexTable using freeBlock...
-	int i;
-	for(i = 0; i < pointCount; i++)
-		indexTable[freeBlockLoc+i] = indeces[i];
+	regionList[freeRegion].region		= freeRunLoc;
+	regionList[freeRegion].runCount		= runCount;
+
+	//compress indeces into runs using freeRunLoc...
+	int	*run	= &runTable[2*freeRunLoc];
+	run[0]		= indeces[0];
+	run[1]		= 1;
+	for(i = 1; i < pointCount; i++)
+	{
+		if(indeces[i] == indeces[i-1]+1)
+			run[1]++;
+		else
+		{
+			run		+= 2;
+			run[0]	 = indeces[i];
+			run[1]	 = 1;
+		}
+	}
 
-	//increment freeBlock to point to the next free
-	//block
+	//increment freeRunLoc and freeBlock to point to the
+	//next free run
+	freeRunLoc		+= runCount;
 	freeBlockLoc	+= pointCount;
 
 	//increment freeRegion to point to the next free region
@@ -187,6 +221,67 @@ void RegionList::AddRegion(int label, int pointCount, int *indeces)
 
 }
 
+/*******************************************************/
+/*Add Region Runs                                      */
+/*******************************************************/
+/*Adds a run-length encoded region to the region list. */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - label is a positive integer used to uniquely */
+/*        identify a region                            */
+/*      - pointCount is the total length of the runs   */
+/*      - runCount is the number of runs, runs holds   */
+/*        2*runCount integers ordered as (start,       */
+/*        length) pairs                                */
+/*Post:                                                */
+/*      - a new region labeled using label and descri- */
+/*        bed by runs has been added to the region     */
+/*        list.                                        */
+/*******************************************************/
+
+void RegionList::AddRegionRuns(int label, int pointCount, int runCount, int *runs)
+{
+
+	//make sure that there is enough room for this new region 
+	//in the region list array...
+	if(numRegions >= maxRegions)
+		ErrorHandler("AddRegionRuns", "Not enough memory allocated.", FATAL);
+
+	//make sure that label is positive and point Count > 0...
+	if((label < 0)||(pointCount <= 0)||(runCount <= 0))
+		ErrorHandler("AddRegionRuns", "Label is negative or number of points in region is invalid.", FATAL);
+
+	//make sure that the region fits into the data set...
+	if((freeBlockLoc + pointCount) > L)
+		ErrorHandler("AddRegionRuns", "Adding more points than what is contained in data set.", FATAL);
+
+	//make sure the run table can hold the runs
+	if(freeRunLoc + runCount > maxRuns)
+		GrowRunTable(freeRunLoc + runCount);
+
+	//place new region into region list array using
+	//freeRegion index
+	regionList[freeRegion].label		= label;
+	regionList[freeRegion].pointCount	= pointCount;
+	regionList[freeRegion].region		= freeRunLoc;
+	regionList[freeRegion].runCount		= runCount;
+
+	//copy runs into the run table...
+	memcpy(&runTable[2*freeRunLoc], runs, 2*runCount*sizeof(int));
+
+	//advance free run and block locations
+	freeRunLoc		+= runCount;
+	freeBlockLoc	+= pointCount;
+
+	//increment freeRegion and numRegions
+	freeRegion++;
+	numRegions++;
+
+	//done.
+	return;
+
+}
+
 /*******************************************************/
 /*Reset                                                */
 /*******************************************************/
@@ -200,7 +295,7 @@ void RegionList::Reset( void )
 {
 
 	//reset region list
-	freeRegion = numRegions = freeBlockLoc = 0;
+	freeRegion = numRegions = freeBlockLoc = freeRunLoc = 0;
 
 	//done.
 	return;
@@ -278,12 +373,68 @@ int RegionList::GetRegionCount(int regionNum)
 /*      - the region indeces specifying the points     */
 /*        contained by the region specified by region- */
 /*        Num are returned.                            */
+/*      - the indeces are expanded from the run table  */
+/*        into a buffer owned by the region list that  */
+/*        remains valid until the next call; prefer    */
+/*        GetRegionRuns() or a RegionPointIterator.    */
 /*******************************************************/
 
 int *RegionList::GetRegionIndeces(int regionNum)
 {
+	//make sure the expansion buffer can hold the region
+	REGION	*region	= &regionList[regionNum];
+	if(region->pointCount > indexBufferSize)
+	{
+		delete [] indexBuffer;
+		if(!(indexBuffer = new int [indexBufferSize = region->pointCount]))
+			ErrorHandler("GetRegionIndeces", "Not enough memory.", FATAL);
+	}
+
+	//expand runs into point indeces
+	int	*run	= &runTable[2*region->region], *dst = indexBuffer;
+	int	i, j;
+	for(i = 0; i < region->runCount; i++, run += 2)
+		for(j = 0; j < run[1]; j++)
+			*(dst++)	= run[0] + j;
+
 	//return point indeces using regionNum
-	return &indexTable[regionList[regionNum].region];
+	return indexBuffer;
+}
+
+/*******************************************************/
+/*Get Region Run Count                                 */
+/*******************************************************/
+/*Returns the number of runs describing a region.      */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - regionNum is an index into the region list   */
+/*        array.                                       */
+/*Post:                                                */
+/*      - the number of (start, length) runs of the    */
+/*        specified region is returned.                */
+/*******************************************************/
+
+int RegionList::GetRegionRunCount(int regionNum)
+{
+	return regionList[regionNum].runCount;
+}
+
+/*******************************************************/
+/*Get Region Runs                                      */
+/*******************************************************/
+/*Returns the runs specifying a region.                */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - regionNum is an index into the region list   */
+/*        array.                                       */
+/*Post:                                                */
+/*      - a pointer to the 2*runCount (start, length)  */
+/*        integers of the region is returned.          */
+/*******************************************************/
+
+int *RegionList::GetRegionRuns(int regionNum)
+{
+	return &runTable[2*regionList[regionNum].region];
 }
 
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
@@ -292,6 +443,46 @@ int *RegionList::GetRegionIndeces(int regionNum)
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
 
+  /*/\/\/\/\/\/\/\/\/\/\/\*/
+  /*  Run Table Management */
+  /*\/\/\/\/\/\/\/\/\/\/\/*/
+
+/*******************************************************/
+/*Grow Run Table                                       */
+/*******************************************************/
+/*Enlarges the run table.                              */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - minRuns is the number of runs the table must */
+/*        be able to hold                              */
+/*Post:                                                */
+/*      - the run table holds at least minRuns runs,   */
+/*        stored runs have been preserved.             */
+/*******************************************************/
+
+void RegionList::GrowRunTable(int minRuns)
+{
+
+	//grow geometrically so that repeated additions
+	//remain linear overall
+	int	newMaxRuns	= 2*maxRuns;
+	if(newMaxRuns < minRuns)
+		newMaxRuns	= minRuns;
+
+	int	*newRunTable;
+	if(!(newRunTable = new int [2*newMaxRuns]))
+		ErrorHandler("GrowRunTable", "Not enough memory.", FATAL);
+	memcpy(newRunTable, runTable, 2*freeRunLoc*sizeof(int));
+
+	delete [] runTable;
+	runTable	= newRunTable;
+	maxRuns		= newMaxRuns;
+
+	//done.
+	return;
+
+}
+
   /*/\/\/\/\/\/\/\/\/\/\/\*/
   /*  Class Error Handler */
   /*\/\/\/\/\/\/\/\/\/\/\/*/
@@ -337,3 +528,216 @@ void RegionList::ErrorHandler(char *functName, char* errmsg, ErrorType status)
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@ END OF CLASS DEFINITION @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
 /*@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@*/
+
+/*******************************************************/
+/*Region Point Iterator                                */
+/*******************************************************/
+/*Walks the point indeces of a run-length encoded      */
+/*region without expanding them into an array.         */
+/*******************************************************/
+
+RegionPointIterator::RegionPointIterator(RegionList *regionList, int regionNum)
+{
+	runs		= regionList->GetRegionRuns(regionNum);
+	runCount	= regionList->GetRegionRunCount(regionNum);
+	Rewind();
+}
+
+RegionPointIterator::RegionPointIterator(int *runs_, int runCount_)
+{
+	runs		= runs_;
+	runCount	= runCount_;
+	Rewind();
+}
+
+void RegionPointIterator::Rewind( void )
+{
+	run		= 0;
+	offset	= 0;
+}
+
+/*******************************************************/
+/*Next                                                 */
+/*******************************************************/
+/*Post:                                                */
+/*      - if points remain, index holds the next point */
+/*        index and true is returned, otherwise false  */
+/*        is returned.                                 */
+/*******************************************************/
+
+bool RegionPointIterator::Next(int& index)
+{
+	//skip to the next run once the current run is exhausted
+	while((run < runCount)&&(offset >= runs[2*run+1]))
+	{
+		run++;
+		offset	= 0;
+	}
+	if(run >= runCount)
+		return false;
+
+	index	= runs[2*run] + offset;
+	offset++;
+	return true;
+}
+
+/*******************************************************/
+/*Label Run List                                       */
+/*******************************************************/
+/*Run-length encoded label image.                      */
+/*******************************************************/
+
+LabelRunList::LabelRunList( void )
+{
+	runLabel	= NULL;
+	runLength	= NULL;
+	rowOffset	= NULL;
+	runCount	= 0;
+	width		= height	= 0;
+}
+
+LabelRunList::~LabelRunList( void )
+{
+	delete [] runLabel;
+	delete [] runLength;
+	delete [] rowOffset;
+}
+
+/*******************************************************/
+/*Encode                                               */
+/*******************************************************/
+/*Encodes a label image into row broken runs.          */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - labels is a width x height label image       */
+/*        stored row major                             */
+/*Post:                                                */
+/*      - the label image has been stored as (label,   */
+/*        length) runs, previous contents discarded.   */
+/*******************************************************/
+
+void LabelRunList::Encode(int *labels, int width_, int height_)
+{
+
+	if((width_ <= 0)||(height_ <= 0))
+		ErrorHandler("Encode", "Image dimensions are zero or negative.", FATAL);
+
+	//discard previous contents
+	delete [] runLabel;
+	delete [] runLength;
+	delete [] rowOffset;
+	width	= width_;
+	height	= height_;
+
+	//count runs per row so that the run arrays are
+	//allocated exactly
+	if(!(rowOffset = new int [height+1]))
+		ErrorHandler("Encode", "Not enough memory.", FATAL);
+
+	int	i, j, *row;
+	runCount	= 0;
+	for(i = 0; i < height; i++)
+	{
+		rowOffset[i]	= runCount;
+		row				= &labels[i*width];
+		runCount++;
+		for(j = 1; j < width; j++)
+			runCount	+= (row[j] != row[j-1]);
+	}
+	rowOffset[height]	= runCount;
+
+	if((!(runLabel = new int [runCount]))||(!(runLength = new int [runCount])))
+		ErrorHandler("Encode", "Not enough memory.", FATAL);
+
+	//store runs
+	int	run	= 0, start;
+	for(i = 0; i < height; i++)
+	{
+		row		= &labels[i*width];
+		start	= 0;
+		for(j = 1; j <= width; j++)
+		{
+			if((j == width)||(row[j] != row[start]))
+			{
+				runLabel[run]	= row[start];
+				runLength[run]	= j - start;
+				run++;
+				start			= j;
+			}
+		}
+	}
+
+	//done.
+	return;
+
+}
+
+/*******************************************************/
+/*Expand Row                                           */
+/*******************************************************/
+/*Pre:                                                 */
+/*      - row is in [0, height), dst holds width ints  */
+/*Post:                                                */
+/*      - the labels of the specified row have been    */
+/*        written to dst.                              */
+/*******************************************************/
+
+void LabelRunList::ExpandRow(int row, int *dst)
+{
+	int	i, j;
+	for(i = rowOffset[row]; i < rowOffset[row+1]; i++)
+		for(j = 0; j < runLength[i]; j++)
+			*(dst++)	= runLabel[i];
+}
+
+void LabelRunList::ErrorHandler(char *functName, char* errmsg, ErrorType status)
+{
+	if(status == NONFATAL)
+		fprintf(stderr, "\n%s Error: %s\n", functName, errmsg);
+	else
+	{
+		fprintf(stderr, "\n%s Fatal Error: %s\n\nAborting Program.\n\n", functName, errmsg);
+		exit(1);
+	}
+}
+
+/*******************************************************/
+/*Label Run Iterator                                   */
+/*******************************************************/
+/*Walks a label run list run by run, reporting the row,*/
+/*starting column, length and label of each run.       */
+/*******************************************************/
+
+LabelRunIterator::LabelRunIterator(LabelRunList *runList_)
+{
+	runList	= runList_;
+	Rewind();
+}
+
+void LabelRunIterator::Rewind( void )
+{
+	row	= x	= run	= 0;
+}
+
+bool LabelRunIterator::Next(int& row_, int& x_, int& length, int& label)
+{
+	if(run >= runList->GetRunCount())
+		return false;
+
+	//runs never cross rows, so the column resets whenever
+	//the run index passes the end of the current row
+	while(run >= runList->GetRowOffset(row+1))
+	{
+		row++;
+		x	= 0;
+	}
+
+	row_	= row;
+	x_		= x;
+	length	= runList->GetRunLengths()[run];
+	label	= runList->GetRunLabels()[run];
+
+	x		+= length;
+	run++;
+	return true;
+}
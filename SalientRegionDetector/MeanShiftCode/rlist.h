@@ -42,7 +42,8 @@ Implemented by Chris M. Christoudias, Bogdan Georgescu
 struct REGION {
 	int			label;
 	int			pointCount;
-	int			region;
+	int			region;					//offset of the first run of this region in the run table
+	int			runCount;				//number of (start, length) runs describing this region
 
 };
 
@@ -83,16 +84,25 @@ public:
   //|   The dimension of the input data set being class- |//
   //|   ified by the region list object.                 |//
   //|                                                    |//
+  //|   <* maxRuns *>                                    |//
+  //|   Optional. The initial capacity of the run table; |//
+  //|   the table grows on demand when it is exceeded.   |//
+  //|                                                    |//
+  //|   Region points are stored run-length encoded as   |//
+  //|   (start, length) pairs of consecutive indeces,    |//
+  //|   so a boundary costs two integers per run rather  |//
+  //|   than one integer per pixel.                      |//
+  //|                                                    |//
   //<--------------------------------------------------->|//
   //|                                                    |//
   //|	Usage:      								     |//
   //|   ======      								     |//
-  //|     RegionList(maxRegions, L, N)                   |//
+  //|     RegionList(maxRegions, L, N [, maxRuns])       |//
   //|                                                    |//
   //<--------------------------------------------------->|//
   //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
 
-	RegionList(int, int, int);
+	RegionList(int, int, int, int maxRuns_ = 0);
 
 	// Class Destructor
 	~RegionList( void );
@@ -143,6 +153,49 @@ public:
 
 	void AddRegion(int, int, int*);
 
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|              *  Add Region Runs  *                 |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Adds a region that is already run-length enco-   |//
+  //|   ded to the region list.                          |//
+  //|                                                    |//
+  //|   Its arguments are:                               |//
+  //|                                                    |//
+  //|   <* label *>                                      |//
+  //|   A positive integer used to uniquely identify     |//
+  //|   a region.                                        |//
+  //|                                                    |//
+  //|   <* pointCount *>                                 |//
+  //|   The total number of points covered by the runs.  |//
+  //|                                                    |//
+  //|   <* runCount *>                                   |//
+  //|   The number of runs describing the region.        |//
+  //|                                                    |//
+  //|   <* runs *>                                       |//
+  //|   An integer array of 2*runCount entries holding   |//
+  //|   (start, length) pairs in increasing order.       |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|     AddRegionRuns(label, pointCount, runCount,     |//
+  //|                   runs)                            |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+	void AddRegionRuns(int, int, int, int*);
+
   //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
   //<--------------------------------------------------->|//
   //|                                                    |//
@@ -283,6 +336,60 @@ public:
 
 	int*GetRegionIndeces(int);
 
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|             *  Get Region Run Count  *             |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Returns the number of (start, length) runs that  |//
+  //|   describe a specified region.                     |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|     runCount = GetRegionRunCount(regionNumber)     |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+	int GetRegionRunCount(int);
+
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Method Name:								     |//
+  //|   ============								     |//
+  //|               *  Get Region Runs  *                |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Description:								     |//
+  //|	============								     |//
+  //|                                                    |//
+  //|   Returns a pointer to the 2*runCount integers     |//
+  //|   (start, length, start, length, ...) describing   |//
+  //|   a specified region. Unlike GetRegionIndeces()    |//
+  //|   no point indeces are materialized.               |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //|                                                    |//
+  //|	Usage:      								     |//
+  //|   ======      								     |//
+  //|     runs = GetRegionRuns(regionNumber)             |//
+  //|                                                    |//
+  //<--------------------------------------------------->|//
+  //--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//--\\||//
+
+	int*GetRegionRuns(int);
+
 private:
 
   /*/\/\/\/\/\/\/\/\/\/\/\*/
@@ -310,12 +417,19 @@ private:
 										//available region in the regionList
 
 	//#####################################
-	//###         INDEX TABLE           ###
+	//###          RUN TABLE            ###
 	//#####################################
 
-	int			*indexTable;			//an array of indexes that point into an external structure
-										//specifying which points belong to a region
-	int			freeBlockLoc;			//points to the next free block of memory in the indexTable
+	int			*runTable;				//an array of (start, length) pairs that point into an external
+										//structure specifying which points belong to a region
+	int			maxRuns;				//number of runs the run table can currently hold
+	int			freeRunLoc;				//points to the next free run in the runTable
+	int			freeBlockLoc;			//total number of points stored by the region list
+
+	int			*indexBuffer;			//scratch buffer used by GetRegionIndeces() to expand
+	int			indexBufferSize;		//the runs of a single region
+
+	void		GrowRunTable(int);		//makes room for at least the specified number of runs
 
 	//#####################################
 	//###     INPUT DATA PARAMETERS     ###
@@ -331,6 +445,103 @@ private:
 
 };
 
+//point iterator prototype...
+//
+//Walks the point indeces of a region stored by a region
+//list (or of any run-length encoded point set) one index
+//at a time, without materializing the index array:
+//
+//		RegionPointIterator it(regionList, regionNumber);
+//		int index;
+//		while(it.Next(index)) { ... }
+//
+class RegionPointIterator {
+
+public:
+
+	RegionPointIterator(RegionList*, int);
+	RegionPointIterator(int*, int);
+
+	bool	Next(int&);				//returns false once the region is exhausted
+	void	Rewind( void );
+
+private:
+
+	int		*runs;					//(start, length) pairs
+	int		runCount;
+	int		run;					//current run
+	int		offset;					//offset into the current run
+
+};
+
+//label run list prototype...
+//
+//Run-length encoded label image. Each image row is stored
+//as a sequence of (label, length) runs so that a label
+//image of L pixels costs two integers per run rather than
+//one integer per pixel. Runs never cross row boundaries.
+//
+class LabelRunList {
+
+public:
+
+	LabelRunList( void );
+	~LabelRunList( void );
+
+	//encodes a width x height label image (row major)
+	void	Encode(int*, int, int);
+
+	//query run list
+	int		GetWidth( void )		{ return width;  }
+	int		GetHeight( void )		{ return height; }
+	int		GetRunCount( void )		{ return runCount; }
+	int		GetRowOffset(int row)	{ return rowOffset[row]; }
+	int		GetRowRunCount(int row)	{ return rowOffset[row+1] - rowOffset[row]; }
+	int*	GetRunLabels( void )	{ return runLabel;  }
+	int*	GetRunLengths( void )	{ return runLength; }
+	int*	GetRowLabels(int row)	{ return &runLabel[rowOffset[row]];  }
+	int*	GetRowLengths(int row)	{ return &runLength[rowOffset[row]]; }
+
+	//decodes a single row into a caller supplied buffer of
+	//width integers
+	void	ExpandRow(int, int*);
+
+private:
+
+	void	ErrorHandler(char*, char*, ErrorType);
+
+	int		*runLabel;				//label of each run
+	int		*runLength;				//length of each run
+	int		*rowOffset;				//index of the first run of each row (height+1 entries)
+	int		runCount;
+	int		width, height;
+
+};
+
+//label run iterator prototype...
+//
+//Walks a label run list run by run:
+//
+//		LabelRunIterator it(labelRuns);
+//		int row, x, length, label;
+//		while(it.Next(row, x, length, label)) { ... }
+//
+class LabelRunIterator {
+
+public:
+
+	LabelRunIterator(LabelRunList*);
+
+	bool	Next(int&, int&, int&, int&);
+	void	Rewind( void );
+
+private:
+
+	LabelRunList	*runList;
+	int				row, x, run;
+
+};
+
 #endif
 
 
@@ -0,0 +1,57 @@
+// ParallelFor.cpp: implementation of ParallelFor.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "ParallelFor.h"
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <exception>
+
+//===========================================================================
+///	ParallelFor
+///
+/// The first exception thrown by body is rethrown on the calling thread
+/// once all threads have stopped; the remaining items are then skipped.
+//===========================================================================
+void ParallelFor(
+	const int&						count,
+	const int&						threads,
+	const function<void(int)>&		body)
+{
+	int numthreads = (threads < count) ? threads : count;
+	if( numthreads <= 1 )
+	{
+		for( int i = 0; i < count; i++ ) body(i);
+		return;
+	}
+
+	atomic<int> next(0);
+	atomic<bool> failed(false);
+	exception_ptr error;
+
+	function<void()> worker = [&]()
+	{
+		for(;;)
+		{
+			int i = next.fetch_add(1);
+			if( i >= count || failed.load() ) break;
+			try
+			{
+				body(i);
+			}
+			catch( ... )
+			{
+				// only the first failing thread gets to store its exception
+				if( !failed.exchange(true) ) error = current_exception();
+			}
+		}
+	};
+
+	vector<thread> pool;
+	for( int t = 1; t < numthreads; t++ ) pool.push_back(thread(worker));
+	worker();
+	for( size_t t = 0; t < pool.size(); t++ ) pool[t].join();
+
+	if( error ) rethrow_exception(error);
+}
@@ -0,0 +1,22 @@
+// ParallelFor.h: interface for ParallelFor.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Runs body(i) for every i in [0, count) on up to threads threads, the
+// calling thread included. The items are handed out one at a time, so the
+// split of the work among the threads varies from run to run; callers that
+// need reproducible results must combine per-item results in item order.
+//===========================================================================
+
+#if !defined(_PARALLELFOR_H_INCLUDED_)
+#define _PARALLELFOR_H_INCLUDED_
+
+#include <functional>
+using namespace std;
+
+void ParallelFor(
+	const int&						count,
+	const int&						threads,
+	const function<void(int)>&		body);
+
+#endif // !defined(_PARALLELFOR_H_INCLUDED_)
@@ -0,0 +1,149 @@
+// ParameterSweep.cpp: implementation of the ParameterSweep class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "ParameterSweep.h"
+#include "ParallelFor.h"
+#include "MeanShiftCode/msImageProcessor.h"
+#include <chrono>
+#include <cstdlib>
+
+typedef std::chrono::high_resolution_clock SweepClock;
+
+static double ElapsedMs(const SweepClock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(SweepClock::now() - start).count();
+}
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+ParameterSweep::ParameterSweep()
+{
+
+}
+
+ParameterSweep::~ParameterSweep()
+{
+
+}
+
+//===========================================================================
+///	Run
+///
+/// Each (sigmaS, sigmaR) pair gets its own mean shift processor, which is
+/// filtered once and then fused for every minRegion, restoring the filter
+/// result in between. The rows of a pair are written to their own slots
+/// of the table, so the table does not depend on the number of threads.
+//===========================================================================
+void ParameterSweep::Run(
+	const vector<UINT>&				inputimg,
+	const int&						width,
+	const int&						height,
+	const SweepGrid&				grid,
+	vector<SweepEntry>&				table,
+	SweepTimings&					timings,
+	const int&						threads,
+	const LabelsFunc&				labels)
+{
+	SweepClock::time_point start = SweepClock::now();
+	timings = SweepTimings();
+	const int sz		= width*height;
+	const int numS		= int(grid.sigmaS.size());
+	const int numR		= int(grid.sigmaR.size());
+	const int numMin	= int(grid.minRegion.size());
+	table.assign(size_t(numS)*numR*numMin, SweepEntry());
+	if( table.empty() ) return;
+
+	//----------------------------------
+	// Lab planes, shared by all pairs
+	//----------------------------------
+	SweepClock::time_point stage = SweepClock::now();
+	vector<double> lvec(0), avec(0), bvec(0);
+	Saliency sal;
+	sal.RGB2LAB(inputimg, lvec, avec, bvec);
+	timings.lab = ElapsedMs(stage);
+
+	vector<double> filterMs(size_t(numS)*numR, 0);
+	ParallelFor(numS*numR, threads, [&](int pair)
+	{
+		const int sigmaS	= grid.sigmaS[pair / numR];
+		const float sigmaR	= grid.sigmaR[pair % numR];
+
+		msImageProcessor mss;
+		mss.DefineLabImage(&lvec[0], &avec[0], &bvec[0], height, width);
+
+		SweepClock::time_point t0 = SweepClock::now();
+		mss.Filter(sigmaS, sigmaR, HIGH_SPEEDUP);
+		int filtered = mss.GetRegionCount();
+		if( numMin > 1 ) mss.SaveFilterResult();
+		filterMs[pair] = ElapsedMs(t0);
+
+		vector<int> rowlabels(0);
+		for( int m = 0; m < numMin; m++ )
+		{
+			t0 = SweepClock::now();
+			if( m > 0 ) mss.RestoreFilterResult();
+			mss.FuseRegions(sigmaR, grid.minRegion[m]);
+
+			SweepEntry& e		= table[size_t(pair)*numMin + m];
+			e.sigmaS			= sigmaS;
+			e.sigmaR			= sigmaR;
+			e.minRegion			= grid.minRegion[m];
+			e.numlabels			= mss.GetRegionCount();
+			e.filteredRegions	= filtered;
+			e.fuseMs			= ElapsedMs(t0);
+			if( labels )
+			{
+				const int* p_labels = mss.GetLabelsView();
+				rowlabels.assign(p_labels, p_labels + sz);
+				labels(e, rowlabels);
+			}
+		}
+	});
+
+	for( size_t r = 0; r < table.size(); r++ )
+	{
+		table[r].filterMs = filterMs[r / numMin];
+		timings.fuse += table[r].fuseMs;
+	}
+	for( size_t p = 0; p < filterMs.size(); p++ ) timings.filter += filterMs[p];
+	timings.total = ElapsedMs(start);
+}
+
+//---------------------------------------------------------------------------
+// Comma separated numbers; false if any of them is not a positive number
+// (minRegion may be zero).
+//---------------------------------------------------------------------------
+template<typename T>
+static bool ParseList(const string& text, const bool& allowzero, vector<T>& values)
+{
+	values.clear();
+	size_t pos(0);
+	while( pos <= text.size() )
+	{
+		size_t comma = text.find(',', pos);
+		if( comma == string::npos ) comma = text.size();
+		string item = text.substr(pos, comma - pos);
+		pos = comma + 1;
+
+		char* end(NULL);
+		double v = strtod(item.c_str(), &end);
+		if( item.empty() || *end != '\0' || v < 0 || (0 == v && !allowzero) ) return false;
+		values.push_back(T(v));
+	}
+	return !values.empty();
+}
+
+bool ParameterSweep::ParseGrid(
+	const string&					text,
+	SweepGrid&						grid)
+{
+	size_t c1 = text.find(':');
+	size_t c2 = (c1 == string::npos) ? string::npos : text.find(':', c1 + 1);
+	if( c2 == string::npos ) return false;
+	return ParseList(text.substr(0, c1), false, grid.sigmaS) &&
+		   ParseList(text.substr(c1 + 1, c2 - c1 - 1), false, grid.sigmaR) &&
+		   ParseList(text.substr(c2 + 1), true, grid.minRegion);
+}
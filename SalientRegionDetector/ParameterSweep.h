@@ -0,0 +1,86 @@
+// ParameterSweep.h: interface for the ParameterSweep class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Mean shift segmentation of one image over a grid of (sigmaS, sigmaR,
+// minRegion) settings, for parameter searches. The work shared between
+// settings is done once: the Lab conversion for the whole sweep, and the
+// mean shift filtering (with its bucket index, which is scaled by both
+// bandwidths) for each (sigmaS, sigmaR) pair. Each minRegion is then only
+// a region fusing step on the saved filter result, and gives the same
+// labels as a full segmentation with those settings.
+//===========================================================================
+
+#if !defined(_PARAMETERSWEEP_H_INCLUDED_)
+#define _PARAMETERSWEEP_H_INCLUDED_
+
+#include <vector>
+#include <functional>
+#include "SaliencyPipeline.h"
+using namespace std;
+
+struct SweepGrid
+{
+	vector<int>			sigmaS;
+	vector<float>		sigmaR;
+	vector<int>			minRegion;
+};
+
+//---------------------------------------------------------------------------
+// One row of the result table. filterMs is the time of the filtering
+// shared by all rows of the same (sigmaS, sigmaR) pair; fuseMs is this
+// row's own fusing time.
+//---------------------------------------------------------------------------
+struct SweepEntry
+{
+	int					sigmaS;
+	float				sigmaR;
+	int					minRegion;
+	int					numlabels;
+	int					filteredRegions;	// regions before fusing
+	double				filterMs;
+	double				fuseMs;
+
+	SweepEntry() : sigmaS(0), sigmaR(0), minRegion(0), numlabels(0), filteredRegions(0), filterMs(0), fuseMs(0) {}
+};
+
+struct SweepTimings
+{
+	double				lab;
+	double				filter;				// summed over the pairs
+	double				fuse;				// summed over the rows
+	double				total;				// wall clock
+
+	SweepTimings() : lab(0), filter(0), fuse(0), total(0) {}
+};
+
+class ParameterSweep
+{
+public:
+	// Called with each row and its labels (width*height values, numlabels
+	// regions). Rows of different pairs may be reported from different
+	// threads at once; those of one pair come in minRegion order.
+	typedef function<void(const SweepEntry&, const vector<int>&)>	LabelsFunc;
+
+	ParameterSweep();
+	virtual ~ParameterSweep();
+
+	// One row per grid point, ordered by sigmaS, then sigmaR, then
+	// minRegion as listed in the grid. The pairs are spread over threads.
+	void Run(
+		const vector<UINT>&				inputimg,
+		const int&						width,
+		const int&						height,
+		const SweepGrid&				grid,
+		vector<SweepEntry>&				table,				//OUTPUT
+		SweepTimings&					timings,			//OUTPUT
+		const int&						threads = 1,
+		const LabelsFunc&				labels = LabelsFunc());
+
+	// "7:6,10,14:10,20,50" - lists of sigmaS, sigmaR and minRegion values.
+	static bool ParseGrid(
+		const string&					text,
+		SweepGrid&						grid);
+};
+
+#endif // !defined(_PARAMETERSWEEP_H_INCLUDED_)
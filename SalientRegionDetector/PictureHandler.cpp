@@ -18,12 +18,14 @@
 //=================================================================================
 
 PictureHandler::PictureHandler()
+	: m_openBitmap(NULL)
 {
 	StartUpGdiPlus();
 }
 
 PictureHandler::~PictureHandler()
 {
+	ClosePicture();
 	ShutDownGdiPlus();
 }
 
@@ -60,10 +62,18 @@ void PictureHandler::ShutDownGdiPlus()
 //	GetEncoderClsid()
 //
 //	The encoder CLSID provided depends on the format string provided;
-//	L"image/jpeg" for JPEG CLSID and L"image/bmp" for BMP CLSID
+//	L"image/jpeg" for JPEG CLSID and L"image/bmp" for BMP CLSID. The encoders
+//	are only enumerated the first time a format is asked for.
 //=================================================================================
 int PictureHandler::GetEncoderClsid(const WCHAR* format, CLSID* pClsid)
 {
+   map<wstring, CLSID>::const_iterator found = m_encoders.find(format);
+   if( found != m_encoders.end() )
+   {
+      *pClsid = found->second;
+      return 0;
+   }
+
    UINT  num = 0;          // number of image encoders
    UINT  size = 0;         // size of the image encoder array in bytes
 
@@ -84,6 +94,7 @@ int PictureHandler::GetEncoderClsid(const WCHAR* format, CLSID* pClsid)
       if( wcscmp(pImageCodecInfo[j].MimeType, format) == 0 )
       {
          *pClsid = pImageCodecInfo[j].Clsid;
+         m_encoders[format] = *pClsid;
          free(pImageCodecInfo);
          return j;  // Success
       }    
@@ -189,18 +200,54 @@ void PictureHandler::GetPictureBuffer(
 		PixelFormat32bppARGB,
 		bmpData);
 
-	_ASSERT( bmpData->Stride/4 == width );
-
 	imgBuffer.resize(imgSize);
 
-	//memcpy( imgBuffer, (UINT*)bmpData.get()->Scan0, imgSize*sizeof(UINT) );
-	UINT* tempBuff = (UINT*)bmpData->Scan0;
-	for( int p = 0; p < imgSize; p++ ) imgBuffer[p] = tempBuff[p];
+	// row by row, GDI+ may pad the rows or store them bottom-up
+	for( int y = 0; y < height; y++ )
+	{
+		memcpy( &imgBuffer[y*width], (BYTE*)bmpData->Scan0 + y*bmpData->Stride, width*sizeof(UINT) );
+	}
 
 	bmp->UnlockBits(bmpData);
 	delete bmpData;
 	bmpData = NULL;
+	delete bmp;
+}
 
+//=================================================================================
+//	OpenPicture
+//
+//	Decodes the picture and locks its pixels as 32bpp for as long as the view
+//	is used, so that they are read where GDI+ decoded them instead of being
+//	copied into a buffer first.
+//=================================================================================
+bool PictureHandler::OpenPicture(
+	const string&		filename,
+	ImageView&			view)
+{
+	ClosePicture();
+	view = ImageView();
+
+	Bitmap* bmp = Bitmap::FromFile((Narrow2Wide(filename)).c_str());
+	if( NULL == bmp ) return false;
+	Rect rect(0, 0, bmp->GetWidth(), bmp->GetHeight());
+	if( Ok != bmp->GetLastStatus() ||
+		Ok != bmp->LockBits(&rect, ImageLockModeRead | ImageLockModeWrite, PixelFormat32bppARGB, &m_openData) )
+	{
+		delete bmp;
+		return false;
+	}
+	m_openBitmap = bmp;
+	view = ImageView(m_openData.Scan0, int(m_openData.Width), int(m_openData.Height), PIXEL_XRGB32, m_openData.Stride);
+	return true;
+}
+
+void PictureHandler::ClosePicture()
+{
+	if( NULL == m_openBitmap ) return;
+	m_openBitmap->UnlockBits(&m_openData);
+	delete m_openBitmap;
+	m_openBitmap = NULL;
 }
 
 
@@ -219,20 +266,9 @@ void PictureHandler::SavePicture(
 	int					format,
 	const string&		str)// 0 is for BMP and 1 for JPEG
 {
-	int sz = width*height;
-	UINT* uintBuffer = new UINT[sz];
-
-	for( int p = 0; p < sz; p++ ) uintBuffer[p] = imgBuffer[p];
-
-	Bitmap bmp(width, height, width*sizeof(UINT), PixelFormat32bppARGB, (unsigned char *)uintBuffer);
-
 	//-----------------------------------------
 	// Prepare path and save the result images
 	//-----------------------------------------
-	CLSID picClsid;
-	if( 1 == format ) GetEncoderClsid(L"image/jpeg", &picClsid);
-	if( 0 == format ) GetEncoderClsid(L"image/bmp",  &picClsid);
-
 	//string path = "C:\\Temp\\";
 	string path = saveLocation;
 	//string fpath = Wide2Narrow(outFilename);
@@ -247,11 +283,76 @@ void PictureHandler::SavePicture(
 	if( 1 == format ) path.append(".jpg");
 	if( 0 == format ) path.append(".bmp");
 
-	wstring wholepath = Narrow2Wide(path);
-	const WCHAR* wp = wholepath.c_str();
+	bool saved = SaveImage(imgBuffer, width, height, path, format);
+	_ASSERT( saved );
+}
+
+//=================================================================================
+//	SaveImage
+//
+//	Saves the buffer under the given path as a BMP (0), JPEG (1) or PNG (2)
+//	image. The bitmap is wrapped around the buffer without a copy; the unused
+//	top byte of each pixel is ignored. Returns false if GDI+ could not write
+//	the file.
+//=================================================================================
+bool PictureHandler::SaveImage(
+	const vector<UINT>&	imgBuffer,
+	const int&			width,
+	const int&			height,
+	const string&		path,
+	const int&			format,
+	const int&			quality)
+{
+	if( width <= 0 || height <= 0 || imgBuffer.size() < size_t(width)*height ) return false;
+
+	return SaveImage(ImageView(&imgBuffer[0], width, height), path, format, quality);
+}
+
+//=================================================================================
+//	SaveImage
+//
+//	The same for a view. 32bpp pixels, and BGR pixels with rows aligned to
+//	four bytes, are wrapped as they are; other layouts are converted first.
+//=================================================================================
+bool PictureHandler::SaveImage(
+	const ImageView&	image,
+	const string&		path,
+	const int&			format,
+	const int&			quality)
+{
+	if( image.IsEmpty() ) return false;
+
+	ImageView pixels(image);
+	vector<UINT> converted(0);
+	PixelFormat pixfmt = PixelFormat32bppRGB;
+	bool wrap = (0 == image.stride % 4);
+	if( PIXEL_BGR24 == image.layout )	pixfmt = PixelFormat24bppRGB;
+	else if( PIXEL_XRGB32 != image.layout ) wrap = false;
+	if( !wrap )
+	{
+		image.CopyTo(converted);
+		pixels = ImageView(&converted[0], image.width, image.height);
+		pixfmt = PixelFormat32bppRGB;
+	}
+
+	Bitmap bmp(pixels.width, pixels.height, INT(pixels.stride), pixfmt, pixels.data);
 
-	Status st = bmp.Save( wp, &picClsid, NULL );
-	_ASSERT( st == Ok );
+	CLSID picClsid;
+	const WCHAR* mime = L"image/jpeg";
+	if( 0 == format ) mime = L"image/bmp";
+	if( 2 == format ) mime = L"image/png";
+	if( GetEncoderClsid(mime, &picClsid) < 0 ) return false;
+
+	EncoderParameters params;
+	ULONG q = ULONG(quality);
+	params.Count = 1;
+	params.Parameter[0].Guid			= EncoderQuality;
+	params.Parameter[0].Type			= EncoderParameterValueTypeLong;
+	params.Parameter[0].NumberOfValues	= 1;
+	params.Parameter[0].Value			= &q;
+	bool useQuality = (1 == format && quality >= 0 && quality <= 100);
 
-	if(uintBuffer) delete [] uintBuffer;
-}
\ No newline at end of file
+	wstring wholepath = Narrow2Wide(path);
+	Status st = bmp.Save( wholepath.c_str(), &picClsid, useQuality ? &params : NULL );
+	return st == Ok;
+}
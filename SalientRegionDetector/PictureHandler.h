@@ -15,6 +15,9 @@
 #include <gdiplus.h>
 #include <vector>
 #include <algorithm>
+#include <map>
+#include <string>
+#include "ImageView.h"
 
 namespace Gdiplus	{
 					class  Bitmap;
@@ -39,6 +42,15 @@ public:
 										int&				width,
 										int&				height);
 
+	// Decodes the picture and views its pixels where GDI+ keeps them, without
+	// a copy. The view stays valid until ClosePicture() or the next
+	// OpenPicture(); false if the file cannot be read.
+	bool							OpenPicture(
+										const string&		filename,
+										ImageView&			view);
+
+	void							ClosePicture();
+
 	void							SavePicture(
 										vector<UINT>&		imgBuffer,
 										int					width,
@@ -48,6 +60,20 @@ public:
 										int					format,
 										const string&		str = "");        // 0 is for BMP and 1 for JPEG
 
+	bool							SaveImage(
+										const vector<UINT>&	imgBuffer,
+										const int&			width,
+										const int&			height,
+										const string&		path,
+										const int&			format,				// 0 BMP, 1 JPEG, 2 PNG
+										const int&			quality = -1);		// JPEG quality 0-100, -1 for the default
+
+	bool							SaveImage(
+										const ImageView&	image,
+										const string&		path,
+										const int&			format,
+										const int&			quality = -1);
+
 	wstring							Narrow2Wide(
 										const string&		narrowString);
 
@@ -65,6 +91,9 @@ private:
 private:
 	ULONG_PTR						m_gdiplusToken;
 	GdiplusStartupInput*			m_gdiplusStartupInput;
+	map<wstring, CLSID>				m_encoders;			// CLSIDs found so far, by MIME type
+	Bitmap*							m_openBitmap;		// locked by OpenPicture()
+	BitmapData						m_openData;
 
 };
 
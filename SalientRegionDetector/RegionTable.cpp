@@ -0,0 +1,225 @@
+// RegionTable.cpp: implementation of the RegionTable class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "RegionTable.h"
+#include "ParallelFor.h"
+
+//---------------------------------------------------------------------------
+// Statistics of one region within one band of rows. The coordinate and
+// colour sums are whole numbers well below 2^53, so they add up exactly.
+//---------------------------------------------------------------------------
+struct RegionPartial
+{
+	int					area;
+	int					minx;
+	int					miny;
+	int					maxx;
+	int					maxy;
+	bool				touchesBorder;
+	double				sumx;
+	double				sumy;
+	double				salSum;
+	double				salMax;
+	double				sumr;
+	double				sumg;
+	double				sumb;
+};
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+RegionTable::RegionTable()
+	: m_width(0), m_height(0)
+{
+
+}
+
+RegionTable::~RegionTable()
+{
+
+}
+
+void RegionTable::Clear()
+{
+	m_width = m_height = 0;
+	vector<RegionInfo>().swap(m_regions);
+	vector<int>().swap(m_pixels);
+}
+
+//===========================================================================
+///	Build
+///
+/// Each band of rows gathers the statistics of every region into its own
+/// partial table; the partials are then merged in band order. The prefix
+/// sum of the areas gives each region its slice of the index array and,
+/// within it, each band its part of the slice, so that the bands can
+/// scatter their pixel indices in parallel. Within a slice the indices stay
+/// in row-major order.
+//===========================================================================
+void RegionTable::Build(
+	const int*						labels,
+	const int&						width,
+	const int&						height,
+	const int&						numlabels,
+	const double*					salmap,
+	const unsigned int*				img,
+	const int&						threads)
+{
+	Build(labels, width, height, numlabels, salmap, img ? ImageView(img, width, height) : ImageView(), threads);
+}
+
+void RegionTable::Build(
+	const int*						labels,
+	const int&						width,
+	const int&						height,
+	const int&						numlabels,
+	const double*					salmap,
+	const ImageView&				image,
+	const int&						threads)
+{
+	const bool haveimg = !image.IsEmpty();
+	m_width  = width;
+	m_height = height;
+	int sz = width*height;
+
+	//-----------------------------------------------------------------
+	// At most 16 bands of at least 64 rows, and no more partial tables
+	// than a quarter of the pixel count, to keep their memory small.
+	//-----------------------------------------------------------------
+	int bandrows = (height + 15)/16;
+	if( bandrows < 64 ) bandrows = 64;
+	int numbands = (height + bandrows - 1)/bandrows;
+	while( numbands > 1 && size_t(numbands)*size_t(numlabels) > size_t(sz)/4 ) numbands--;
+	if( numbands < 1 ) numbands = 1;
+	bandrows = (height + numbands - 1)/numbands;
+
+	RegionPartial init;
+	init.area			= 0;
+	init.minx			= width;
+	init.miny			= height;
+	init.maxx			= -1;
+	init.maxy			= -1;
+	init.touchesBorder	= false;
+	init.sumx = init.sumy = init.salSum = init.salMax = 0;
+	init.sumr = init.sumg = init.sumb = 0;
+	vector<RegionPartial> partial(size_t(numbands)*numlabels, init);
+
+	//---------------------------------
+	// One pass over the labels
+	//---------------------------------
+	ParallelFor(numbands, threads, [&](int band)
+	{
+		RegionPartial* part = &partial[size_t(band)*numlabels];
+		int jstart = band*bandrows;
+		int jend = jstart + bandrows;
+		if( jend > height ) jend = height;
+		vector<unsigned int> scratch(haveimg ? width : 0);
+		for( int j = jstart; j < jend; j++ )
+		{
+			int i = j*width;
+			bool borderrow = (0 == j || height-1 == j);
+			const unsigned int* img = haveimg ? image.ReadRow(j, &scratch[0]) : NULL;
+			for( int k = 0; k < width; k++, i++ )
+			{
+				RegionPartial& r = part[labels[i]];
+				if( k < r.minx ) r.minx = k;
+				if( k > r.maxx ) r.maxx = k;
+				if( j < r.miny ) r.miny = j;
+				if( j > r.maxy ) r.maxy = j;
+				r.area++;
+				r.sumx += k;
+				r.sumy += j;
+				if( borderrow || 0 == k || width-1 == k ) r.touchesBorder = true;
+				if( salmap )
+				{
+					r.salSum += salmap[i];
+					if( salmap[i] > r.salMax ) r.salMax = salmap[i];
+				}
+				if( img )
+				{
+					r.sumr += (img[k] >> 16) & 0xff;
+					r.sumg += (img[k] >>  8) & 0xff;
+					r.sumb += (img[k]      ) & 0xff;
+				}
+			}
+		}
+	});
+
+	//---------------------------------
+	// Merge the bands
+	//---------------------------------
+	m_regions.resize(numlabels);
+	int offset(0);
+	for( int n = 0; n < numlabels; n++ )
+	{
+		RegionPartial m = init;
+		for( int b = 0; b < numbands; b++ )
+		{
+			RegionPartial& p = partial[size_t(b)*numlabels + n];
+			if( p.minx < m.minx ) m.minx = p.minx;
+			if( p.maxx > m.maxx ) m.maxx = p.maxx;
+			if( p.miny < m.miny ) m.miny = p.miny;
+			if( p.maxy > m.maxy ) m.maxy = p.maxy;
+			if( p.salMax > m.salMax ) m.salMax = p.salMax;
+			m.touchesBorder = m.touchesBorder || p.touchesBorder;
+			m.sumx		+= p.sumx;
+			m.sumy		+= p.sumy;
+			m.salSum	+= p.salSum;
+			m.sumr		+= p.sumr;
+			m.sumg		+= p.sumg;
+			m.sumb		+= p.sumb;
+			// from here on the partial area is this band's place in the slice
+			int area = p.area;
+			p.area = offset + m.area;
+			m.area += area;
+		}
+
+		RegionInfo& r = m_regions[n];
+		r.label			= n;
+		r.area			= m.area;
+		r.minx			= m.minx;
+		r.miny			= m.miny;
+		r.maxx			= m.maxx;
+		r.maxy			= m.maxy;
+		r.touchesBorder	= m.touchesBorder;
+		r.salSum		= m.salSum;
+		r.maxSaliency	= m.salMax;
+		r.cx = r.cy = r.meanSaliency = 0;
+		r.meanColor		= 0;
+		if( m.area > 0 )
+		{
+			r.cx			= m.sumx / m.area;
+			r.cy			= m.sumy / m.area;
+			r.meanSaliency	= m.salSum / m.area;
+			int red   = int(m.sumr / m.area + 0.5);
+			int green = int(m.sumg / m.area + 0.5);
+			int blue  = int(m.sumb / m.area + 0.5);
+			r.meanColor = red << 16 | green << 8 | blue;
+		}
+		r.first = offset;
+		offset += m.area;
+	}
+
+	//----------------------------------------
+	// Counting sort of the pixels by label
+	//----------------------------------------
+	m_pixels.resize(sz);
+	ParallelFor(numbands, threads, [&](int band)
+	{
+		RegionPartial* part = &partial[size_t(band)*numlabels];
+		int istart = band*bandrows*width;
+		int iend = istart + bandrows*width;
+		if( iend > sz ) iend = sz;
+		for( int i = istart; i < iend; i++ )
+		{
+			m_pixels[part[labels[i]].area++] = i;
+		}
+	});
+}
+
+const int* RegionTable::GetRegionPixels(const int& label) const
+{
+	return m_pixels.empty() ? NULL : &m_pixels[m_regions[label].first];
+}
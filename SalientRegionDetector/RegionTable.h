@@ -0,0 +1,87 @@
+// RegionTable.h: interface for the RegionTable class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Per-region statistics of a label image: area, bounding box, centroid,
+// border contact and, when given, mean and max saliency and mean colour,
+// together with the indices of the region's pixels. The pixel indices of
+// all regions are kept in one array grouped by label (a counting sort of
+// the pixel positions), so the table takes O(pixels + regions) memory
+// however many regions the segmentation produced.
+//
+// The statistics are gathered in one pass over the labels, split into
+// bands of rows that may run on several threads. The bands depend only on
+// the image size and the region count and are merged in order, so the
+// table is the same whatever the number of threads.
+//===========================================================================
+
+#if !defined(_REGIONTABLE_H_INCLUDED_)
+#define _REGIONTABLE_H_INCLUDED_
+
+#include <vector>
+#include <stddef.h>
+#include "ImageView.h"
+using namespace std;
+
+struct RegionInfo
+{
+	int					label;
+	int					area;			// pixel count
+	int					minx;			// bounding box, inclusive
+	int					miny;
+	int					maxx;
+	int					maxy;
+	double				cx;				// centroid
+	double				cy;
+	bool				touchesBorder;	// has a pixel in the first or last row or column
+	double				salSum;			// saliency summed over the region
+	double				meanSaliency;
+	double				maxSaliency;
+	unsigned int		meanColor;		// 0x00RRGGBB
+	int					first;			// offset of the region's pixels in the index array
+};
+
+class RegionTable
+{
+public:
+	RegionTable();
+	virtual ~RegionTable();
+
+	void Build(
+		const int*						labels,				//INPUT: label per pixel, row-major
+		const int&						width,
+		const int&						height,
+		const int&						numlabels,			//labels are in [0, numlabels)
+		const double*					salmap = NULL,		//INPUT: optional saliency per pixel
+		const unsigned int*				img = NULL,			//INPUT: optional 0x00RRGGBB image
+		const int&						threads = 1);
+
+	// the mean colours from an image in any layout; an empty view for none
+	void Build(
+		const int*						labels,
+		const int&						width,
+		const int&						height,
+		const int&						numlabels,
+		const double*					salmap,
+		const ImageView&				image,
+		const int&						threads = 1);
+
+	void Clear();
+
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+	int GetRegionCount() const { return int(m_regions.size()); }
+	const RegionInfo& GetRegion(const int& label) const { return m_regions[label]; }
+
+	// row-major pixel indices of a region, GetRegion(label).area of them
+	const int* GetRegionPixels(const int& label) const;
+
+private:
+
+	int									m_width;
+	int									m_height;
+	vector<RegionInfo>					m_regions;
+	vector<int>							m_pixels;
+};
+
+#endif // !defined(_REGIONTABLE_H_INCLUDED_)
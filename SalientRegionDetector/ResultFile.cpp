@@ -0,0 +1,537 @@
+// ResultFile.cpp: implementation of the ResultFile and ResultFileReader classes.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "ResultFile.h"
+#include "BoundaryMask.h"
+#include <cstdio>
+#include <cstring>
+
+static const char resultMagic[4] = {'S', 'R', 'D', 'R'};
+
+static size_t Align8(const size_t& n)
+{
+	return (n + 7) & ~size_t(7);
+}
+
+//===========================================================================
+///	Serialize
+///
+/// The labels are stored as runs when that is smaller than 16-bit (or, with
+/// more than 65536 labels, 32-bit) values, which is the case for any
+/// segmentation with fewer than about one run per four pixels.
+//===========================================================================
+void ResultFile::Serialize(
+	const vector<UINT>&				inputimg,
+	const SaliencyResult&			result,
+	const string&					source,
+	vector<unsigned char>&			bytes,
+	const double&					salientFactor,
+	const ResultLabelEncoding&		encoding)
+{
+	Serialize(ImageView::Of(inputimg, result.width, result.height), result, source, bytes, salientFactor, encoding);
+}
+
+void ResultFile::Serialize(
+	const ImageView&				input,
+	const SaliencyResult&			result,
+	const string&					source,
+	vector<unsigned char>&			bytes,
+	const double&					salientFactor,
+	const ResultLabelEncoding&		encoding)
+{
+	const int width		= result.width;
+	const int height	= result.height;
+	const int sz		= width*height;
+	const int numlabels	= result.regions.GetRegionCount();
+	const int numboxes	= int(result.boxes.size());
+
+	//---------------------------------
+	// Label runs, row by row
+	//---------------------------------
+	vector<uint32_t> rowruns(height+1, 0);
+	vector<ResultLabelRun> runs(0);
+	for( int y = 0; y < height; y++ )
+	{
+		const int* row = &result.labels[size_t(y)*width];
+		for( int x = 0; x < width; x++ )
+		{
+			if( x > 0 && row[x] == row[x-1] )
+			{
+				runs.back().length++;
+				continue;
+			}
+			ResultLabelRun run;
+			run.label	= row[x];
+			run.length	= 1;
+			runs.push_back(run);
+		}
+		rowruns[y+1] = uint32_t(runs.size());
+	}
+	size_t rlebytes = (height+1)*sizeof(uint32_t) + runs.size()*sizeof(ResultLabelRun);
+	size_t rawbytes = size_t(sz)*(numlabels <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t));
+
+	ResultLabelEncoding enc = encoding;
+	if( RESULT_LABELS_AUTO == enc ) enc = (rlebytes < rawbytes) ? RESULT_LABELS_RLE : RESULT_LABELS_U16;
+	if( RESULT_LABELS_U16 == enc && numlabels > 65536 ) enc = RESULT_LABELS_U32;
+
+	//---------------------------------
+	// Layout
+	//---------------------------------
+	ResultFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, resultMagic, sizeof(header.magic));
+	header.version			= RESULT_FILE_VERSION;
+	header.headerSize		= sizeof(ResultFileHeader);
+	header.labelEncoding	= enc;
+	header.width			= width;
+	header.height			= height;
+	header.numlabels		= numlabels;
+	header.numboxes			= numboxes;
+	header.numsections		= RESULT_SECTION_COUNT;
+
+	size_t sizes[RESULT_SECTION_COUNT];
+	sizes[RESULT_SECTION_SALIENCY]	= sz;
+	sizes[RESULT_SECTION_LABELS]	= (RESULT_LABELS_RLE == enc) ? rlebytes :
+									  size_t(sz)*(RESULT_LABELS_U16 == enc ? sizeof(uint16_t) : sizeof(uint32_t));
+	sizes[RESULT_SECTION_REGIONS]	= numlabels*sizeof(ResultRegionRecord);
+	sizes[RESULT_SECTION_BOXES]		= numboxes*sizeof(ResultBoxRecord);
+	sizes[RESULT_SECTION_SOURCE]	= source.size();
+
+	size_t offset = Align8(sizeof(ResultFileHeader));
+	for( int s = 0; s < RESULT_SECTION_COUNT; s++ )
+	{
+		header.sections[s].offset	= offset;
+		header.sections[s].size		= sizes[s];
+		offset = Align8(offset + sizes[s]);
+	}
+	bytes.assign(offset, 0);
+	memcpy(&bytes[0], &header, sizeof(header));
+
+	//---------------------------------
+	// Saliency
+	//---------------------------------
+	unsigned char* sal = &bytes[size_t(header.sections[RESULT_SECTION_SALIENCY].offset)];
+	for( int i = 0; i < sz; i++ )
+	{
+		int val = int(result.salmap[i] + 0.5);
+		sal[i] = (unsigned char)(val < 0 ? 0 : (val > 255 ? 255 : val));
+	}
+
+	//---------------------------------
+	// Labels
+	//---------------------------------
+	unsigned char* lab = &bytes[size_t(header.sections[RESULT_SECTION_LABELS].offset)];
+	if( RESULT_LABELS_RLE == enc )
+	{
+		memcpy(lab, &rowruns[0], rowruns.size()*sizeof(uint32_t));
+		if( !runs.empty() ) memcpy(lab + rowruns.size()*sizeof(uint32_t), &runs[0], runs.size()*sizeof(ResultLabelRun));
+	}
+	else if( RESULT_LABELS_U16 == enc )
+	{
+		uint16_t* p = (uint16_t*)lab;
+		for( int i = 0; i < sz; i++ ) p[i] = uint16_t(result.labels[i]);
+	}
+	else
+	{
+		uint32_t* p = (uint32_t*)lab;
+		for( int i = 0; i < sz; i++ ) p[i] = uint32_t(result.labels[i]);
+	}
+
+	//---------------------------------
+	// Regions
+	//---------------------------------
+	vector<bool> chosen(0);
+	if( numlabels > 0 ) SaliencyPipeline::ChooseSalientSegments(result.regions, chosen, salientFactor);
+
+	vector<double> lvec(0), avec(0), bvec(0);
+	bool haveinput = !input.IsEmpty() && input.width == width && input.height == height;
+	if( haveinput )
+	{
+		Saliency converter;
+		converter.RGB2LAB(input, lvec, avec, bvec);
+	}
+
+	ResultRegionRecord* rec = (ResultRegionRecord*)&bytes[size_t(header.sections[RESULT_SECTION_REGIONS].offset)];
+	for( int n = 0; n < numlabels; n++ )
+	{
+		const RegionInfo& r = result.regions.GetRegion(n);
+		rec[n].area			= r.area;
+		rec[n].minx			= r.minx;
+		rec[n].miny			= r.miny;
+		rec[n].maxx			= r.maxx;
+		rec[n].maxy			= r.maxy;
+		rec[n].meanSaliency	= float(r.meanSaliency);
+		rec[n].meanColor	= r.meanColor;
+		rec[n].flags		= (chosen[n] ? RESULT_REGION_CHOSEN : 0) | (r.touchesBorder ? RESULT_REGION_BORDER : 0);
+		rec[n].meanL = rec[n].meanA = rec[n].meanB = 0;
+		if( haveinput && r.area > 0 )
+		{
+			double suml(0), suma(0), sumb(0);
+			const int* pixels = result.regions.GetRegionPixels(n);
+			for( int p = 0; p < r.area; p++ )
+			{
+				suml += lvec[pixels[p]];
+				suma += avec[pixels[p]];
+				sumb += bvec[pixels[p]];
+			}
+			rec[n].meanL = float(suml/r.area);
+			rec[n].meanA = float(suma/r.area);
+			rec[n].meanB = float(sumb/r.area);
+		}
+	}
+
+	//---------------------------------
+	// Boxes and source
+	//---------------------------------
+	ResultBoxRecord* box = (ResultBoxRecord*)&bytes[size_t(header.sections[RESULT_SECTION_BOXES].offset)];
+	for( int b = 0; b < numboxes; b++ )
+	{
+		const SaliencyBox& sb = result.boxes[b];
+		box[b].label		= sb.label;
+		box[b].x			= sb.x;
+		box[b].y			= sb.y;
+		box[b].width		= sb.width;
+		box[b].height		= sb.height;
+		box[b].pointCount	= sb.pointCount;
+	}
+	if( !source.empty() )
+	{
+		memcpy(&bytes[size_t(header.sections[RESULT_SECTION_SOURCE].offset)], source.data(), source.size());
+	}
+}
+
+//===========================================================================
+///	Write
+//===========================================================================
+bool ResultFile::Write(
+	const string&					path,
+	const vector<UINT>&				inputimg,
+	const SaliencyResult&			result,
+	const string&					source,
+	const double&					salientFactor,
+	const ResultLabelEncoding&		encoding)
+{
+	return Write(path, ImageView::Of(inputimg, result.width, result.height), result, source, salientFactor, encoding);
+}
+
+bool ResultFile::Write(
+	const string&					path,
+	const ImageView&				input,
+	const SaliencyResult&			result,
+	const string&					source,
+	const double&					salientFactor,
+	const ResultLabelEncoding&		encoding)
+{
+	vector<unsigned char> bytes(0);
+	Serialize(input, result, source, bytes, salientFactor, encoding);
+
+	FILE* fp = fopen(path.c_str(), "wb");
+	if( !fp ) return false;
+	bool ok = (fwrite(&bytes[0], 1, bytes.size(), fp) == bytes.size());
+	if( fclose(fp) != 0 ) ok = false;
+	if( !ok ) remove(path.c_str());
+	return ok;
+}
+
+//////////////////////////////////////////////////////////////////////
+// ResultFileReader
+//////////////////////////////////////////////////////////////////////
+
+ResultFileReader::ResultFileReader()
+	: m_data(NULL), m_size(0)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+ResultFileReader::~ResultFileReader()
+{
+
+}
+
+bool ResultFileReader::Open(const string& path)
+{
+	Close();
+	if( !m_file.Open(path) )
+	{
+		m_error = path + ": cannot open or map the file";
+		return false;
+	}
+	return Attach(m_file.GetData(), m_file.GetSize());
+}
+
+bool ResultFileReader::Attach(const void* data, const size_t& size)
+{
+	m_data = (const unsigned char*)data;
+	m_size = size;
+	m_error.clear();
+	if( Validate() ) return true;
+
+	string error(m_error);
+	Close();
+	m_error = error;
+	return false;
+}
+
+void ResultFileReader::Close()
+{
+	m_file.Close();
+	m_data = NULL;
+	m_size = 0;
+	memset(&m_header, 0, sizeof(m_header));
+	m_error.clear();
+}
+
+//===========================================================================
+///	Validate
+///
+/// Checks the header and the section bounds, and the structure of the
+/// label runs, so that the accessors cannot read outside the file. The
+/// label values themselves are only checked by Render().
+//===========================================================================
+bool ResultFileReader::Validate()
+{
+	const size_t fixedsize = offsetof(ResultFileHeader, sections);
+	if( NULL == m_data || m_size < fixedsize || memcmp(m_data, resultMagic, sizeof(resultMagic)) != 0 )
+	{
+		m_error = "not a result file";
+		return false;
+	}
+	ResultFileHeader h;
+	memcpy(&h, m_data, fixedsize);
+	if( h.version != RESULT_FILE_VERSION )
+	{
+		m_error = "unsupported result file version";
+		return false;
+	}
+	if( h.headerSize > m_size || h.headerSize < fixedsize + uint64_t(h.numsections)*sizeof(ResultFileSection) )
+	{
+		m_error = "truncated header";
+		return false;
+	}
+	int numsections = (h.numsections < RESULT_SECTION_COUNT) ? int(h.numsections) : RESULT_SECTION_COUNT;
+	memset(h.sections, 0, sizeof(h.sections));
+	memcpy(h.sections, m_data + fixedsize, numsections*sizeof(ResultFileSection));
+	for( int s = 0; s < numsections; s++ )
+	{
+		if( h.sections[s].offset % 8 != 0 || h.sections[s].offset > m_size || h.sections[s].size > m_size - h.sections[s].offset )
+		{
+			m_error = "section outside the file";
+			return false;
+		}
+	}
+
+	if( h.width <= 0 || h.height <= 0 || h.numlabels < 0 || h.numboxes < 0 ||
+		uint64_t(h.width)*uint64_t(h.height) > uint64_t(0x7fffffff) )
+	{
+		m_error = "bad image size";
+		return false;
+	}
+	uint64_t sz = uint64_t(h.width)*h.height;
+	if( h.sections[RESULT_SECTION_SALIENCY].size != sz ||
+		h.sections[RESULT_SECTION_REGIONS].size != uint64_t(h.numlabels)*sizeof(ResultRegionRecord) ||
+		h.sections[RESULT_SECTION_BOXES].size != uint64_t(h.numboxes)*sizeof(ResultBoxRecord) )
+	{
+		m_error = "section sizes do not match the header";
+		return false;
+	}
+
+	const ResultFileSection& labsec = h.sections[RESULT_SECTION_LABELS];
+	if( RESULT_LABELS_U16 == h.labelEncoding || RESULT_LABELS_U32 == h.labelEncoding )
+	{
+		if( labsec.size != sz*(RESULT_LABELS_U16 == h.labelEncoding ? 2 : 4) )
+		{
+			m_error = "label section size does not match the image";
+			return false;
+		}
+	}
+	else if( RESULT_LABELS_RLE == h.labelEncoding )
+	{
+		uint64_t tablebytes = uint64_t(h.height+1)*sizeof(uint32_t);
+		if( labsec.size < tablebytes )
+		{
+			m_error = "truncated label runs";
+			return false;
+		}
+		const uint32_t* rowruns = (const uint32_t*)(m_data + labsec.offset);
+		const ResultLabelRun* runs = (const ResultLabelRun*)(m_data + labsec.offset + tablebytes);
+		uint64_t numruns = (labsec.size - tablebytes)/sizeof(ResultLabelRun);
+		if( rowruns[0] != 0 || rowruns[h.height] != numruns )
+		{
+			m_error = "bad label run table";
+			return false;
+		}
+		for( int y = 0; y < h.height; y++ )
+		{
+			// checked before the runs of the row are read, which could
+			// otherwise lie past the end of the file
+			if( rowruns[y+1] < rowruns[y] || rowruns[y+1] > numruns )
+			{
+				m_error = "bad label run table";
+				return false;
+			}
+			uint64_t len(0);
+			for( uint32_t r = rowruns[y]; r < rowruns[y+1]; r++ ) len += runs[r].length;
+			if( len != uint64_t(h.width) )
+			{
+				m_error = "label runs do not cover the row";
+				return false;
+			}
+		}
+	}
+	else
+	{
+		m_error = "unknown label encoding";
+		return false;
+	}
+
+	m_header = h;
+	return true;
+}
+
+const unsigned char* ResultFileReader::Section(const ResultSection& s) const
+{
+	if( NULL == m_data || 0 == m_header.sections[s].size ) return NULL;
+	return m_data + m_header.sections[s].offset;
+}
+
+string ResultFileReader::GetSource() const
+{
+	const unsigned char* p = Section(RESULT_SECTION_SOURCE);
+	if( NULL == p ) return string();
+	return string((const char*)p, size_t(m_header.sections[RESULT_SECTION_SOURCE].size));
+}
+
+const void* ResultFileReader::GetRawLabels() const
+{
+	if( RESULT_LABELS_RLE == m_header.labelEncoding ) return NULL;
+	return Section(RESULT_SECTION_LABELS);
+}
+
+//===========================================================================
+///	GetLabelRow
+//===========================================================================
+void ResultFileReader::GetLabelRow(const int& y, int* row) const
+{
+	const int width = m_header.width;
+	const unsigned char* lab = Section(RESULT_SECTION_LABELS);
+	if( RESULT_LABELS_U16 == m_header.labelEncoding )
+	{
+		const uint16_t* p = (const uint16_t*)lab + size_t(y)*width;
+		for( int x = 0; x < width; x++ ) row[x] = p[x];
+	}
+	else if( RESULT_LABELS_U32 == m_header.labelEncoding )
+	{
+		const uint32_t* p = (const uint32_t*)lab + size_t(y)*width;
+		for( int x = 0; x < width; x++ ) row[x] = int(p[x]);
+	}
+	else
+	{
+		const uint32_t* rowruns = (const uint32_t*)lab;
+		const ResultLabelRun* runs = (const ResultLabelRun*)(lab + (m_header.height+1)*sizeof(uint32_t));
+		int x(0);
+		for( uint32_t r = rowruns[y]; r < rowruns[y+1]; r++ )
+		{
+			for( uint32_t k = 0; k < runs[r].length; k++ ) row[x++] = runs[r].label;
+		}
+	}
+}
+
+void ResultFileReader::GetLabels(vector<int>& labels) const
+{
+	labels.resize(size_t(m_header.width)*m_header.height);
+	for( int y = 0; y < m_header.height; y++ ) GetLabelRow(y, &labels[size_t(y)*m_header.width]);
+}
+
+//===========================================================================
+///	Render
+///
+/// The same images the pipeline produces, from the stored data. The region
+/// table is rebuilt from the labels; the salient segments are the ones
+/// flagged in the file.
+//===========================================================================
+bool ResultFileReader::Render(
+	const vector<UINT>&				inputimg,
+	const SaliencyParams&			params,
+	SaliencyResult&					result) const
+{
+	const int width		= m_header.width;
+	const int height	= m_header.height;
+	const int sz		= width*height;
+	const int numlabels	= m_header.numlabels;
+	const unsigned int outputs = params.outputs;
+	const bool haveinput = (int(inputimg.size()) == sz);
+
+	result = SaliencyResult();
+	result.width		= width;
+	result.height		= height;
+	result.numlabels	= numlabels;
+
+	GetLabels(result.labels);
+	for( int i = 0; i < sz; i++ )
+	{
+		if( result.labels[i] < 0 || result.labels[i] >= numlabels ) return false;
+	}
+	const unsigned char* sal = GetSaliency();
+	result.salmap.resize(sz);
+	for( int i = 0; i < sz; i++ ) result.salmap[i] = sal[i];
+
+	result.regions.Build(&result.labels[0], width, height, numlabels, &result.salmap[0],
+		haveinput ? &inputimg[0] : NULL, params.threads);
+
+	const ResultBoxRecord* boxes = GetBoxes();
+	result.boxes.resize(m_header.numboxes);
+	for( int b = 0; b < m_header.numboxes; b++ )
+	{
+		result.boxes[b].label		= boxes[b].label;
+		result.boxes[b].x			= boxes[b].x;
+		result.boxes[b].y			= boxes[b].y;
+		result.boxes[b].width		= boxes[b].width;
+		result.boxes[b].height		= boxes[b].height;
+		result.boxes[b].pointCount	= boxes[b].pointCount;
+	}
+
+	//---------------------------------
+	// Images
+	//---------------------------------
+	const ResultRegionRecord* regions = GetRegions();
+	if( outputs & OUTPUT_SALMAP )
+	{
+		result.salimg.resize(sz);
+		for( int i = 0; i < sz; i++ ) result.salimg[i] = UINT(sal[i]) << 16 | UINT(sal[i]) << 8 | sal[i];
+	}
+	if( outputs & (OUTPUT_MEANSHIFT | OUTPUT_MEANSHIFT_BORDERED) )
+	{
+		result.segimg.resize(sz);
+		for( int i = 0; i < sz; i++ ) result.segimg[i] = regions[result.labels[i]].meanColor;
+	}
+	if( haveinput && (outputs & (OUTPUT_OBJECT | OUTPUT_OBJECT_BORDERED)) )
+	{
+		result.segobj.assign(sz, 0);
+		for( int i = 0; i < sz; i++ )
+		{
+			if( regions[result.labels[i]].flags & RESULT_REGION_CHOSEN ) result.segobj[i] = inputimg[i];
+		}
+	}
+	if( outputs & (OUTPUT_MEANSHIFT_BORDERED | OUTPUT_OBJECT_BORDERED) )
+	{
+		vector<unsigned char> boundary(0);
+		ComputeBoundaryMask(result.labels, width, height, boundary);
+		if( (outputs & OUTPUT_MEANSHIFT_BORDERED) && !result.segimg.empty() )
+		{
+			CompositeBoundaryMask(result.segimg, boundary, params.contourColor, result.segimgbordered);
+		}
+		if( (outputs & OUTPUT_OBJECT_BORDERED) && !result.segobj.empty() )
+		{
+			CompositeBoundaryMask(result.segobj, boundary, params.contourColor, result.segobjbordered);
+		}
+	}
+	if( !(outputs & OUTPUT_MEANSHIFT) )	vector<UINT>().swap(result.segimg);
+	if( !(outputs & OUTPUT_OBJECT) )	vector<UINT>().swap(result.segobj);
+	if( haveinput && (outputs & OUTPUT_BOXES) )
+	{
+		result.boximg = inputimg;
+		SaliencyPipeline::DrawBoxes(result.boximg, width, height, result.boxes, params.boxColor);
+	}
+	return true;
+}
@@ -0,0 +1,202 @@
+// ResultFile.h: interface for the ResultFile and ResultFileReader classes.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Binary container for the data behind the result images, so that
+// downstream tools do not have to decode the JPEG outputs (lossily) to get
+// it back. A file holds a fixed header followed by sections, each starting
+// on an 8-byte boundary:
+//
+//   saliency   width*height bytes, the saliency map rounded to 0-255
+//   labels     the label image, as 16-bit or 32-bit labels, or as runs
+//              of equal labels within each row (RESULT_LABELS_RLE: a table
+//              of height+1 run offsets, then ResultLabelRun records)
+//   regions    one ResultRegionRecord per label
+//   boxes      one ResultBoxRecord per salient region box
+//   source     the input image path, not terminated
+//
+// All fields are little-endian and naturally aligned, so that a mapped
+// file can be read in place: ResultFileReader only validates the header
+// and hands out pointers into the mapping. Readers must reject a file
+// whose version they do not know; new sections are added at the end of
+// the table and older readers ignore them.
+//===========================================================================
+
+#if !defined(_RESULTFILE_H_INCLUDED_)
+#define _RESULTFILE_H_INCLUDED_
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "SaliencyPipeline.h"
+#include "MappedFile.h"
+using namespace std;
+
+#define RESULT_FILE_VERSION		1
+
+enum ResultLabelEncoding
+{
+	RESULT_LABELS_AUTO = 0,			// writer only: the smallest of the others
+	RESULT_LABELS_U16,
+	RESULT_LABELS_U32,
+	RESULT_LABELS_RLE
+};
+
+enum ResultSection
+{
+	RESULT_SECTION_SALIENCY = 0,
+	RESULT_SECTION_LABELS,
+	RESULT_SECTION_REGIONS,
+	RESULT_SECTION_BOXES,
+	RESULT_SECTION_SOURCE,
+	RESULT_SECTION_COUNT
+};
+
+struct ResultFileSection
+{
+	uint64_t			offset;			// from the start of the file
+	uint64_t			size;			// bytes
+};
+
+struct ResultFileHeader
+{
+	char				magic[4];		// "SRDR"
+	uint32_t			version;
+	uint32_t			headerSize;		// sizeof(ResultFileHeader) of the writer
+	uint32_t			labelEncoding;	// ResultLabelEncoding
+	int32_t				width;
+	int32_t				height;
+	int32_t				numlabels;
+	int32_t				numboxes;
+	uint32_t			numsections;
+	uint32_t			reserved;
+	ResultFileSection	sections[RESULT_SECTION_COUNT];
+};
+
+#define RESULT_REGION_CHOSEN	0x1		// selected as salient
+#define RESULT_REGION_BORDER	0x2		// touches the image border
+
+struct ResultRegionRecord
+{
+	int32_t				area;
+	int32_t				minx;			// bounding box, inclusive
+	int32_t				miny;
+	int32_t				maxx;
+	int32_t				maxy;
+	float				meanL;			// mean CIE Lab of the input pixels
+	float				meanA;
+	float				meanB;
+	float				meanSaliency;	// in [0,255]
+	uint32_t			meanColor;		// 0x00RRGGBB
+	uint32_t			flags;			// RESULT_REGION_ flags
+};
+
+struct ResultBoxRecord
+{
+	int32_t				label;
+	int32_t				x;
+	int32_t				y;
+	int32_t				width;
+	int32_t				height;
+	int32_t				pointCount;
+};
+
+struct ResultLabelRun
+{
+	int32_t				label;
+	uint32_t			length;
+};
+
+class ResultFile
+{
+public:
+	// The file image of a result. input gives the mean colours and may be
+	// empty; the chosen flags are those of salientFactor.
+	static void Serialize(
+		const ImageView&				input,
+		const SaliencyResult&			result,
+		const string&					source,
+		vector<unsigned char>&			bytes,						//OUTPUT
+		const double&					salientFactor = 2.0,
+		const ResultLabelEncoding&		encoding = RESULT_LABELS_AUTO);
+
+	static void Serialize(
+		const vector<UINT>&				inputimg,
+		const SaliencyResult&			result,
+		const string&					source,
+		vector<unsigned char>&			bytes,						//OUTPUT
+		const double&					salientFactor = 2.0,
+		const ResultLabelEncoding&		encoding = RESULT_LABELS_AUTO);
+
+	// Serialize() and write; false if the file cannot be written.
+	static bool Write(
+		const string&					path,
+		const ImageView&				input,
+		const SaliencyResult&			result,
+		const string&					source,
+		const double&					salientFactor = 2.0,
+		const ResultLabelEncoding&		encoding = RESULT_LABELS_AUTO);
+
+	static bool Write(
+		const string&					path,
+		const vector<UINT>&				inputimg,
+		const SaliencyResult&			result,
+		const string&					source,
+		const double&					salientFactor = 2.0,
+		const ResultLabelEncoding&		encoding = RESULT_LABELS_AUTO);
+};
+
+class ResultFileReader
+{
+public:
+	ResultFileReader();
+	virtual ~ResultFileReader();
+
+	// Maps the file; false, with GetError() set, if it is not a valid result file.
+	bool Open(const string& path);
+	// Reads a file image held in memory, which must outlive the reader.
+	bool Attach(const void* data, const size_t& size);
+	void Close();
+
+	const string& GetError() const { return m_error; }
+
+	bool IsOpen() const { return NULL != m_data; }
+	int GetWidth() const { return m_header.width; }
+	int GetHeight() const { return m_header.height; }
+	int GetRegionCount() const { return m_header.numlabels; }
+	int GetBoxCount() const { return m_header.numboxes; }
+	ResultLabelEncoding GetLabelEncoding() const { return ResultLabelEncoding(m_header.labelEncoding); }
+	string GetSource() const;
+
+	// In place, valid while the reader is open.
+	const unsigned char* GetSaliency() const { return Section(RESULT_SECTION_SALIENCY); }
+	const ResultRegionRecord* GetRegions() const { return (const ResultRegionRecord*)Section(RESULT_SECTION_REGIONS); }
+	const ResultBoxRecord* GetBoxes() const { return (const ResultBoxRecord*)Section(RESULT_SECTION_BOXES); }
+	// uint16_t or uint32_t per pixel, or NULL for run-length labels
+	const void* GetRawLabels() const;
+
+	// Decoded labels of one row (width values) or of the whole image.
+	void GetLabelRow(const int& y, int* row) const;
+	void GetLabels(vector<int>& labels) const;
+
+	// Rebuilds a SaliencyResult and renders the images selected by
+	// params.outputs. The object and box images need the input image and
+	// are left empty without it; the segmented image is drawn with the
+	// mean colour of each region. False if a label is out of range.
+	bool Render(
+		const vector<UINT>&				inputimg,
+		const SaliencyParams&			params,
+		SaliencyResult&					result) const;
+
+private:
+	bool Validate();
+	const unsigned char* Section(const ResultSection& s) const;
+
+	MappedFile							m_file;
+	const unsigned char*				m_data;
+	size_t								m_size;
+	ResultFileHeader					m_header;		// sections the file lacks are empty
+	string								m_error;
+};
+
+#endif // !defined(_RESULTFILE_H_INCLUDED_)
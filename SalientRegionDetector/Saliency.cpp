@@ -5,9 +5,9 @@
 //	Copyright (c) 2011 Radhakrishna Achanta [EPFL] 
 //===========================================================================
 
-#include "stdafx.h"
 #include <cmath>
 #include "Saliency.h"
+#include "Trace.h"
 
 
 
@@ -27,9 +27,70 @@ Saliency::~Saliency()
 
 
 //===========================================================================
-///	RGB2LAB
+///	LabFromRGB
 ///
-/// This is the re-written version of the sRGB to CIELAB conversion
+/// This is the re-written version of the sRGB to CIELAB conversion, for
+/// one 0x00RRGGBB pixel
+//===========================================================================
+static inline void LabFromRGB(
+	const UINT&						pixel,
+	double&							lval,
+	double&							aval,
+	double&							bval)
+{
+	int sR = (pixel >> 16) & 0xFF;
+	int sG = (pixel >>  8) & 0xFF;
+	int sB = (pixel      ) & 0xFF;
+	//------------------------
+	// sRGB to XYZ conversion
+	// (D65 illuminant assumption)
+	//------------------------
+	double R = sR/255.0;
+	double G = sG/255.0;
+	double B = sB/255.0;
+
+	double r, g, b;
+
+	if(R <= 0.04045)	r = R/12.92;
+	else				r = pow((R+0.055)/1.055,2.4);
+	if(G <= 0.04045)	g = G/12.92;
+	else				g = pow((G+0.055)/1.055,2.4);
+	if(B <= 0.04045)	b = B/12.92;
+	else				b = pow((B+0.055)/1.055,2.4);
+
+	double X = r*0.4124564 + g*0.3575761 + b*0.1804375;             // RGBתXYZɫռ
+	double Y = r*0.2126729 + g*0.7151522 + b*0.0721750;
+	double Z = r*0.0193339 + g*0.1191920 + b*0.9503041;
+	//------------------------
+	// XYZ to LAB conversion
+	// ת㷨μ https://blog.csdn.net/lz0499/article/details/77345166
+	//------------------------
+	double epsilon = 0.008856;	//actual CIE standard
+	double kappa   = 903.3;		//actual CIE standard
+
+	double Xr = 0.950456;	//reference white
+	double Yr = 1.0;		//reference white
+	double Zr = 1.088754;	//reference white
+
+	double xr = X/Xr;
+	double yr = Y/Yr;
+	double zr = Z/Zr;
+
+	double fx, fy, fz;
+	if(xr > epsilon)	fx = pow(xr, 1.0/3.0);
+	else				fx = (kappa*xr + 16.0)/116.0;
+	if(yr > epsilon)	fy = pow(yr, 1.0/3.0);
+	else				fy = (kappa*yr + 16.0)/116.0;
+	if(zr > epsilon)	fz = pow(zr, 1.0/3.0);
+	else				fz = (kappa*zr + 16.0)/116.0;
+
+	lval = 116.0*fy-16.0;
+	aval = 500.0*(fx-fy);
+	bval = 200.0*(fy-fz);
+}
+
+//===========================================================================
+///	RGB2LAB
 //===========================================================================
 void Saliency::RGB2LAB(
 	const vector<UINT>&				ubuff,
@@ -38,61 +99,36 @@ void Saliency::RGB2LAB(
 	vector<double>&					bvec)
 {
 	int sz = int(ubuff.size());
+	RGB2LAB(ImageView(sz ? &ubuff[0] : NULL, sz, 1), lvec, avec, bvec);
+}
+
+//===========================================================================
+///	RGB2LAB
+///
+/// תXRGBֵתһеĻ
+//===========================================================================
+void Saliency::RGB2LAB(
+	const ImageView&				image,
+	vector<double>&					lvec,
+	vector<double>&					avec,
+	vector<double>&					bvec)
+{
+	TRACE_SCOPE("RGB2LAB", "saliency");
+	int sz = image.IsEmpty() ? 0 : image.width*image.height;
 	lvec.resize(sz);
 	avec.resize(sz);
 	bvec.resize(sz);
+	if( 0 == sz ) return;
 
-	for( int j = 0; j < sz; j++ )
+	vector<UINT> scratch(image.width);
+	int j(0);
+	for( int y = 0; y < image.height; y++ )
 	{
-		int sR = (ubuff[j] >> 16) & 0xFF;
-		int sG = (ubuff[j] >>  8) & 0xFF;
-		int sB = (ubuff[j]      ) & 0xFF;
-		//------------------------
-		// sRGB to XYZ conversion
-		// (D65 illuminant assumption)
-		//------------------------
-		double R = sR/255.0;
-		double G = sG/255.0;
-		double B = sB/255.0;
-
-		double r, g, b;
-
-		if(R <= 0.04045)	r = R/12.92;
-		else				r = pow((R+0.055)/1.055,2.4);
-		if(G <= 0.04045)	g = G/12.92;
-		else				g = pow((G+0.055)/1.055,2.4);
-		if(B <= 0.04045)	b = B/12.92;
-		else				b = pow((B+0.055)/1.055,2.4);
-
-		double X = r*0.4124564 + g*0.3575761 + b*0.1804375;             // RGBתXYZɫռ
-		double Y = r*0.2126729 + g*0.7151522 + b*0.0721750;
-		double Z = r*0.0193339 + g*0.1191920 + b*0.9503041;
-		//------------------------
-		// XYZ to LAB conversion
-		// ת㷨μ https://blog.csdn.net/lz0499/article/details/77345166
-		//------------------------
-		double epsilon = 0.008856;	//actual CIE standard
-		double kappa   = 903.3;		//actual CIE standard
-
-		double Xr = 0.950456;	//reference white
-		double Yr = 1.0;		//reference white
-		double Zr = 1.088754;	//reference white
-
-		double xr = X/Xr;
-		double yr = Y/Yr;
-		double zr = Z/Zr;
-
-		double fx, fy, fz;
-		if(xr > epsilon)	fx = pow(xr, 1.0/3.0);
-		else				fx = (kappa*xr + 16.0)/116.0;
-		if(yr > epsilon)	fy = pow(yr, 1.0/3.0);
-		else				fy = (kappa*yr + 16.0)/116.0;
-		if(zr > epsilon)	fz = pow(zr, 1.0/3.0);
-		else				fz = (kappa*zr + 16.0)/116.0;
-
-		lvec[j] = 116.0*fy-16.0;
-		avec[j] = 500.0*(fx-fy);
-		bvec[j] = 200.0*(fy-fz);
+		const UINT* row = image.ReadRow(y, &scratch[0]);
+		for( int x = 0; x < image.width; x++, j++ )
+		{
+			LabFromRGB(row[x], lvec[j], avec[j], bvec[j]);
+		}
 	}
 }
 
@@ -108,6 +144,7 @@ void Saliency::GaussianSmooth(
 	const vector<double>&			kernel,
 	vector<double>&					smoothImg)
 {
+	TRACE_SCOPE("blur", "saliency");
 	int center = int(kernel.size())/2;
 
 	int sz = width*height;
@@ -175,14 +212,44 @@ void Saliency::GetSaliencyMap(
 	const int&						height,
 	vector<double>&					salmap,
 	const bool&						normflag) 
+{
+	GetSaliencyMap(ImageView::Of(inputimg, width, height), salmap, normflag);
+}
+
+//===========================================================================
+///	GetSaliencyMap
+/// ͼͼͼ
+//===========================================================================
+void Saliency::GetSaliencyMap(
+	const ImageView&				image,
+	vector<double>&					salmap,
+	const bool&						normflag) 
+{
+	vector<double> lvec(0), avec(0), bvec(0);
+	RGB2LAB(image, lvec, avec, bvec);
+
+	GetSaliencyMap(lvec, avec, bvec, image.width, image.height, salmap, normflag);
+}
+
+//===========================================================================
+///	GetSaliencyMap
+/// Labƽͼ
+/// Same as above, but takes the image already converted by RGB2LAB so the
+/// conversion can be shared with the segmentation stage.
+//===========================================================================
+void Saliency::GetSaliencyMap(
+	const vector<double>&			lvec,
+	const vector<double>&			avec,
+	const vector<double>&			bvec,
+	const int&						width,
+	const int&						height,
+	vector<double>&					salmap,
+	const bool&						normflag) 
 {
 	int sz = width*height;
 	salmap.clear();
 	salmap.resize(sz);
 
-	vector<double> lvec(0), avec(0), bvec(0);
-	RGB2LAB(inputimg, lvec, avec, bvec);
-
 	//--------------------------
 	// Obtain Lab average values
 	//--------------------------
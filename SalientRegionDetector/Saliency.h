@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <cfloat>
+#include "ImageView.h"
 using namespace std;
 
 class Saliency  
@@ -27,8 +28,21 @@ public:
 		vector<double>&					salmap,                //OUTPUT: Floating point buffer in row-major order
 		const bool&						normalizeflag = true); //false if normalization is not needed
 
+	// ΪⲼֵͼͼ
+	void GetSaliencyMap(
+		const ImageView&				image,                 //INPUT: pixels in any layout, see ImageView
+		vector<double>&					salmap,                //OUTPUT: Floating point buffer in row-major order
+		const bool&						normalizeflag = true); //false if normalization is not needed
 
-private:
+	// תõLabƽ棬ֵƯƷָͬһɫת
+	void GetSaliencyMap(
+		const vector<double>&			lvec,                  //INPUT: L, a and b planes in row-major order
+		const vector<double>&			avec,                  //       (as produced by RGB2LAB)
+		const vector<double>&			bvec,
+		const int&						width,
+		const int&						height,
+		vector<double>&					salmap,                //OUTPUT: Floating point buffer in row-major order
+		const bool&						normalizeflag = true); //false if normalization is not needed
 
 	void RGB2LAB(
 		const vector<UINT>&				ubuff,
@@ -36,6 +50,14 @@ private:
 		vector<double>&					avec,
 		vector<double>&					bvec);
 
+	// жȡͼƽ水˳
+	void RGB2LAB(
+		const ImageView&				image,
+		vector<double>&					lvec,
+		vector<double>&					avec,
+		vector<double>&					bvec);
+
+	// ɷƽˣGetSaliencyMapʹ[1 2 1]Ա㵥׼
 	void GaussianSmooth(
 		const vector<double>&			inputImg,
 		const int&						width,
@@ -43,6 +65,8 @@ private:
 		const vector<double>&			kernel,
 		vector<double>&					smoothImg);
 
+private:
+
 	//==============================================================================
 	///	Normalize
 	//==============================================================================
@@ -0,0 +1,952 @@
+// SaliencyPipeline.cpp: implementation of the SaliencyPipeline class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// This code implements the saliency detection and segmentation method described in:
+// R. Achanta, S. Hemami, F. Estrada and S. Susstrunk, Frequency-tuned Salient Region Detection,
+// IEEE International Conference on Computer Vision and Pattern Recognition (CVPR), 2009
+//===========================================================================
+
+#include "SaliencyPipeline.h"
+#include "BoundaryMask.h"
+#include "StageCache.h"
+#include "Trace.h"
+#include "MeanShiftCode/msImageProcessor.h"
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include <cmath>
+
+//===========================================================================
+///	ElapsedMs
+///
+/// Milliseconds elapsed since start; used for the per-stage timings.
+//===========================================================================
+typedef std::chrono::high_resolution_clock PipelineClock;
+
+static double ElapsedMs(const PipelineClock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(PipelineClock::now() - start).count();
+}
+
+// result.cached when the Lab conversion is not needed
+static const unsigned int s_cachedAll = CACHED_SALIENCY | CACHED_SEGMENTATION;
+
+//===========================================================================
+///	SegmenterError
+///
+/// Message of a segmentation that failed (out of memory, for one) rather
+/// than halted; its labels are then missing or those of an earlier image.
+//===========================================================================
+static string SegmenterError(const msImageProcessor& mss)
+{
+	return string("mean shift segmentation failed: ") + (mss.ErrorMessage ? mss.ErrorMessage : "unknown error");
+}
+
+//===========================================================================
+///	RunStage
+///
+/// Body of a stage thread: an exception is kept in error for the thread
+/// that joins it, as ParallelFor does, instead of terminating the process.
+//===========================================================================
+static void RunStage(const std::function<void()>& stage, std::exception_ptr& error)
+{
+	try
+	{
+		stage();
+	}
+	catch( ... )
+	{
+		error = std::current_exception();
+	}
+}
+
+namespace
+{
+	// Share of the segmentation budget by which each quality must be done;
+	// the last one is not timed out.
+	const double s_qualityShare[] = {0.5, 0.75, 0.9};
+
+	// HIGH_SPEEDUP threshold of SEGMENT_EXACT, the EDISON default, and of
+	// the qualities below it
+	const float s_exactThreshold	= 0.1f;
+	const float s_fastThreshold		= 0.5f;
+
+	// SEGMENT_SMALL_SCALE scales down by at least 4, and to about this many pixels
+	const int s_smallScalePixels = 256*256;
+
+	//-----------------------------------------------------------------------
+	// Milliseconds per megapixel that each quality took in this process, so
+	// that one which cannot finish in its share of the budget is skipped
+	// instead of being run until it times out. A run that timed out raises
+	// its estimate to at least the time it was given. An estimate only
+	// lowered by finished runs could keep a quality skipped for good, so a
+	// skip lowers it a little and the quality is tried again later. The
+	// settings are not part of the estimate: they seldom change in a
+	// process.
+	//-----------------------------------------------------------------------
+	class SegmentCostModel
+	{
+	public:
+		SegmentCostModel() { for( int q = 0; q <= SEGMENT_SMALL_SCALE; q++ ) m_msPerMP[q] = 0; }
+
+		// true if quality is expected to take more than allowance ms
+		bool TooSlow(const int& quality, const int& pixels, const double& allowance)
+		{
+			lock_guard<mutex> lk(m_lock);
+			double& rate = m_msPerMP[quality];
+			if( rate*pixels*1e-6 <= allowance ) return false;
+			rate *= 0.9;
+			return true;
+		}
+
+		void Observe(const int& quality, const int& pixels, const double& ms, const bool& finished)
+		{
+			if( pixels <= 0 ) return;
+			double rate = ms/(pixels*1e-6);
+			lock_guard<mutex> lk(m_lock);
+			double& estimate = m_msPerMP[quality];
+			if( !finished )				estimate = max(estimate, rate);
+			else if( estimate > 0 )		estimate = 0.7*estimate + 0.3*rate;
+			else						estimate = rate;
+		}
+
+	private:
+		mutex					m_lock;
+		double					m_msPerMP[SEGMENT_SMALL_SCALE + 1];
+	};
+
+	SegmentCostModel s_costModel;
+
+	//-----------------------------------------------------------------------
+	// Mean of each factor x factor block, the blocks of the last row and
+	// column being cut by the image border.
+	//-----------------------------------------------------------------------
+	void ScaleDownPlane(const vector<double>& src, const int& width, const int& height, const int& factor, vector<double>& dst)
+	{
+		const int sw = (width + factor - 1)/factor;
+		const int sh = (height + factor - 1)/factor;
+		dst.resize(size_t(sw)*sh);
+		for( int sy = 0; sy < sh; sy++ )
+		{
+			const int y1 = min(height, (sy + 1)*factor);
+			for( int sx = 0; sx < sw; sx++ )
+			{
+				const int x1 = min(width, (sx + 1)*factor);
+				double sum(0);
+				for( int y = sy*factor; y < y1; y++ )
+				{
+					for( int x = sx*factor; x < x1; x++ ) sum += src[size_t(y)*width + x];
+				}
+				dst[size_t(sy)*sw + sx] = sum/((y1 - sy*factor)*(x1 - sx*factor));
+			}
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+SaliencyPipeline::SaliencyPipeline()
+	: m_cache(NULL), m_cancel(NULL), m_workspace(NULL)
+{
+
+}
+
+SaliencyPipeline::SaliencyPipeline(const SaliencyParams& params)
+	: m_params(params), m_cache(NULL), m_cancel(NULL), m_workspace(NULL)
+{
+
+}
+
+SaliencyPipeline::~SaliencyPipeline()
+{
+
+}
+
+SaliencyWorkspace::SaliencyWorkspace()
+	: segmenter(new msImageProcessor)
+{
+
+}
+
+SaliencyWorkspace::~SaliencyWorkspace()
+{
+	delete segmenter;
+}
+
+//===========================================================================
+///	Process
+///
+///	Runs the whole pipeline on one image. The Lab conversion is done once
+/// and shared by the saliency and the mean shift stages. With more than one
+/// thread the saliency map is computed while the image is segmented, and
+/// the boxes are found while the segments are chosen and outlined; the
+/// results are the same as with one thread. With a cache, the stages found
+/// there are skipped, and so is the Lab conversion if both are.
+//===========================================================================
+
+void SaliencyPipeline::Process(
+	const vector<UINT>&				inputimg,
+	const int&						width,
+	const int&						height,
+	SaliencyResult&					result)
+{
+	Process(ImageView(inputimg.empty() ? NULL : &inputimg[0], width, height), result);
+}
+
+void SaliencyPipeline::Process(
+	const ImageView&				input,
+	SaliencyResult&					result)
+{
+	TRACE_SCOPE("process");
+	PipelineClock::time_point start = PipelineClock::now();
+
+	result = SaliencyResult();
+	result.width  = input.width;
+	result.height = input.height;
+
+	SaliencyLab locallab;
+	SaliencyLab& lab = m_workspace ? m_workspace->lab : locallab;
+	lab.imageKey = 0;
+	CacheLookup(input, lab, result);
+	if( result.cached != s_cachedAll ) LabStage(input, lab, result);
+
+	// an exception on the saliency thread is rethrown here once it is joined,
+	// so that it fails the image rather than the process
+	exception_ptr salerror;
+	thread salthread;
+	if( m_params.threads > 1 )	salthread = thread(RunStage, [&]() { SaliencyStage(lab, result); }, ref(salerror));
+	else						SaliencyStage(lab, result);
+
+	try
+	{
+		SegmentationStage(lab, result);
+	}
+	catch( ... )
+	{
+		if( salthread.joinable() ) salthread.join();
+		throw;
+	}
+
+	if( salthread.joinable() ) salthread.join();
+	if( salerror ) rethrow_exception(salerror);
+
+	FinishStages(input, result);
+
+	result.timings.total = ElapsedMs(start);
+}
+
+//===========================================================================
+///	ProcessSaliency
+///
+///	First half of Process(): Lab conversion and saliency map. The Lab planes
+/// are kept in lab for ProcessSegmentation(), which may run on another
+/// thread, so that an image can move between the workers of a staged
+/// pipeline.
+//===========================================================================
+void SaliencyPipeline::ProcessSaliency(
+	const vector<UINT>&				inputimg,
+	const int&						width,
+	const int&						height,
+	SaliencyLab&					lab,
+	SaliencyResult&					result)
+{
+	ProcessSaliency(ImageView(inputimg.empty() ? NULL : &inputimg[0], width, height), lab, result);
+}
+
+void SaliencyPipeline::ProcessSaliency(
+	const ImageView&				input,
+	SaliencyLab&					lab,
+	SaliencyResult&					result)
+{
+	TRACE_SCOPE("process saliency");
+	PipelineClock::time_point start = PipelineClock::now();
+
+	result = SaliencyResult();
+	result.width  = input.width;
+	result.height = input.height;
+
+	CacheLookup(input, lab, result);
+	if( result.cached != s_cachedAll ) LabStage(input, lab, result);
+	SaliencyStage(lab, result);
+
+	result.timings.total = ElapsedMs(start);
+}
+
+//===========================================================================
+///	ProcessSegmentation
+///
+///	Second half of Process(): mean shift segmentation, segment selection,
+/// contours and boxes. The Lab planes are released once segmented.
+//===========================================================================
+void SaliencyPipeline::ProcessSegmentation(
+	const vector<UINT>&				inputimg,
+	SaliencyLab&					lab,
+	SaliencyResult&					result)
+{
+	ProcessSegmentation(ImageView(inputimg.empty() ? NULL : &inputimg[0], result.width, result.height), lab, result);
+}
+
+void SaliencyPipeline::ProcessSegmentation(
+	const ImageView&				input,
+	SaliencyLab&					lab,
+	SaliencyResult&					result)
+{
+	TRACE_SCOPE("process segmentation");
+	PipelineClock::time_point start = PipelineClock::now();
+
+	SegmentationStage(lab, result);
+	lab = SaliencyLab();
+
+	FinishStages(input, result);
+
+	result.timings.total += ElapsedMs(start);
+}
+
+//===========================================================================
+///	CacheLookup
+///
+/// Reads the saliency map and the segmentation from the cache, if there is
+/// one, and draws the segmented image from the cached region colours.
+//===========================================================================
+void SaliencyPipeline::CacheLookup(
+	const ImageView&				input,
+	SaliencyLab&					lab,
+	SaliencyResult&					result)
+{
+	if( NULL == m_cache ) return;
+	TRACE_SCOPE("cache");
+	PipelineClock::time_point stage = PipelineClock::now();
+	const int width		= result.width;
+	const int height	= result.height;
+
+	lab.imageKey = StageCache::ImageKey(input);
+	if( m_cache->LoadSaliency(StageCache::SaliencyKey(lab.imageKey), width, height, result.salmap) )
+	{
+		result.cached |= CACHED_SALIENCY;
+	}
+	StageSegmentation seg;
+	if( m_cache->LoadSegmentation(StageCache::SegmentationKey(lab.imageKey, m_params), width, height, seg) )
+	{
+		result.cached |= CACHED_SEGMENTATION;
+		result.labels.swap(seg.labels);
+		result.numlabels = seg.numlabels;
+		if( m_params.outputs & (OUTPUT_MEANSHIFT | OUTPUT_MEANSHIFT_BORDERED) )
+		{
+			int sz = width*height;
+			result.segimg.resize(sz);
+			for( int i = 0; i < sz; i++ ) result.segimg[i] = seg.colors[result.labels[i]];
+		}
+	}
+	result.timings.cache = ElapsedMs(stage);
+}
+
+//===========================================================================
+///	LabStage
+//===========================================================================
+void SaliencyPipeline::LabStage(
+	const ImageView&				input,
+	SaliencyLab&					lab,
+	SaliencyResult&					result)
+{
+	TRACE_SCOPE("lab");
+	PipelineClock::time_point stage = PipelineClock::now();
+	Saliency sal;
+	sal.RGB2LAB(input, lab.lvec, lab.avec, lab.bvec);
+	result.timings.lab = ElapsedMs(stage);
+}
+
+//===========================================================================
+///	SegmentationStage
+///
+/// Segment the image using mean-shift algo. Segmented image in segimg.
+/// Only segmentations of SEGMENT_EXACT quality are cached.
+//===========================================================================
+void SaliencyPipeline::SegmentationStage(
+	const SaliencyLab&				lab,
+	SaliencyResult&					result)
+{
+	if( result.cached & CACHED_SEGMENTATION ) return;
+	TRACE_SPAN(span, "segmentation");
+	PipelineClock::time_point stage = PipelineClock::now();
+	bool needsegimg = 0 != (m_params.outputs & (OUTPUT_MEANSHIFT | OUTPUT_MEANSHIFT_BORDERED));
+	if( NULL == m_cache )
+	{
+		result.quality = DoMeanShiftSegmentation(lab.lvec, lab.avec, lab.bvec, result.width, result.height,
+			needsegimg ? &result.segimg : NULL, result.labels, result.numlabels);
+	}
+	else
+	{
+		StageSegmentation seg;
+		result.quality = DoMeanShiftSegmentation(lab.lvec, lab.avec, lab.bvec, result.width, result.height,
+			needsegimg ? &result.segimg : NULL, result.labels, result.numlabels, &seg.modes, &seg.colors);
+		if( !result.IsDegraded() )
+		{
+			seg.labels.swap(result.labels);
+			seg.numlabels = result.numlabels;
+			m_cache->StoreSegmentation(StageCache::SegmentationKey(lab.imageKey, m_params), result.width, result.height, seg);
+			seg.labels.swap(result.labels);
+		}
+	}
+	span.SetArg("regions", result.numlabels);
+	span.SetDetail(QualityName(result.quality));
+	result.timings.segmentation = ElapsedMs(stage);
+}
+
+//===========================================================================
+///	FinishStages
+///
+/// Everything that needs the labels: region statistics, then selection,
+/// contours and boxes.
+//===========================================================================
+void SaliencyPipeline::FinishStages(
+	const ImageView&				input,
+	SaliencyResult&					result)
+{
+	RegionStage(input, result);
+
+	exception_ptr boxerror;
+	thread boxthread;
+	if( m_params.threads > 1 ) boxthread = thread(RunStage, [&]() { BoxStage(input, result); }, ref(boxerror));
+
+	try
+	{
+		SelectionStage(input, result);
+		ContourStage(result);
+	}
+	catch( ... )
+	{
+		if( boxthread.joinable() ) boxthread.join();
+		throw;
+	}
+
+	if( boxthread.joinable() )	boxthread.join();
+	else						BoxStage(input, result);
+	if( boxerror ) rethrow_exception(boxerror);
+}
+
+//===========================================================================
+///	SaliencyStage
+///
+/// Saliency map, unless it came from the cache, and, if selected, its grey
+/// level image.
+//===========================================================================
+void SaliencyPipeline::SaliencyStage(
+	const SaliencyLab&				lab,
+	SaliencyResult&					result)
+{
+	TRACE_SCOPE("saliency");
+	PipelineClock::time_point stage = PipelineClock::now();
+	int sz = result.width*result.height;
+
+	if( !(result.cached & CACHED_SALIENCY) )
+	{
+		Saliency sal;
+		sal.GetSaliencyMap(lab.lvec, lab.avec, lab.bvec, result.width, result.height, result.salmap, true);
+		if( m_cache ) m_cache->StoreSaliency(StageCache::SaliencyKey(lab.imageKey), result.width, result.height, result.salmap);
+	}
+	if( m_params.outputs & OUTPUT_SALMAP )
+	{
+		result.salimg.resize(sz);
+		for( int i = 0; i < sz; i++ )
+		{
+			int val = int(result.salmap[i] + 0.5);
+			result.salimg[i] = val << 16 | val << 8 | val;
+		}
+	}
+	result.timings.saliency = ElapsedMs(stage);
+}
+
+//===========================================================================
+///	RegionStage
+///
+/// Region table with saliency and colour statistics, used by the selection
+/// and the boxes.
+//===========================================================================
+void SaliencyPipeline::RegionStage(
+	const ImageView&				input,
+	SaliencyResult&					result)
+{
+	TRACE_SCOPE("regions");
+	PipelineClock::time_point stage = PipelineClock::now();
+	result.regions.Build(
+		result.labels.empty() ? NULL : &result.labels[0], result.width, result.height, result.numlabels,
+		result.salmap.empty() ? NULL : &result.salmap[0],
+		input,
+		m_params.threads);
+	result.timings.regions = ElapsedMs(stage);
+}
+
+//===========================================================================
+///	SelectionStage
+///
+/// Salient object image: the input pixels of the chosen segments, copied
+/// region by region from the pixel lists of the table.
+//===========================================================================
+void SaliencyPipeline::SelectionStage(
+	const ImageView&				input,
+	SaliencyResult&					result)
+{
+	TRACE_SCOPE("selection");
+	PipelineClock::time_point stage = PipelineClock::now();
+	int sz = result.width*result.height;
+
+	if( m_params.outputs & (OUTPUT_OBJECT | OUTPUT_OBJECT_BORDERED) )
+	{
+		vector<bool> segtochoose(0);
+		ChooseSalientSegments(result.regions, segtochoose, m_params.salientFactor);
+		result.segobj.assign(sz, 0);
+		const UINT* packed = input.IsContiguousXRGB() ? (const UINT*)input.data : NULL;
+		for( int n = 0; n < result.regions.GetRegionCount(); n++ )
+		{
+			if( !segtochoose[n] ) continue;
+			const int* pixels = result.regions.GetRegionPixels(n);
+			int area = result.regions.GetRegion(n).area;
+			for( int p = 0; p < area; p++ )
+			{
+				int i = pixels[p];
+				result.segobj[i] = packed ? packed[i] : input.GetPixel(i % result.width, i / result.width);
+			}
+		}
+	}
+	result.timings.selection = ElapsedMs(stage);
+}
+
+//===========================================================================
+///	ContourStage
+///
+/// Bordered versions of the segmented and object images. The contours are
+/// found once from the labels and drawn onto both; an image that is only
+/// wanted bordered is drawn on in place instead of being copied.
+//===========================================================================
+void SaliencyPipeline::ContourStage(
+	SaliencyResult&					result)
+{
+	TRACE_SCOPE("contours");
+	PipelineClock::time_point stage = PipelineClock::now();
+	const unsigned int outputs = m_params.outputs;
+
+	if( outputs & (OUTPUT_MEANSHIFT_BORDERED | OUTPUT_OBJECT_BORDERED) )
+	{
+		vector<unsigned char> boundary(0);
+		ComputeBoundaryMask(result.labels, result.width, result.height, boundary);
+		TRACE_SCOPE("draw contours");
+		if( outputs & OUTPUT_MEANSHIFT_BORDERED )
+		{
+			if( outputs & OUTPUT_MEANSHIFT )
+			{
+				CompositeBoundaryMask(result.segimg, boundary, m_params.contourColor, result.segimgbordered);
+			}
+			else
+			{
+				result.segimgbordered.swap(result.segimg);
+				CompositeBoundaryMask(result.segimgbordered, boundary, m_params.contourColor, result.segimgbordered);
+			}
+		}
+		if( outputs & OUTPUT_OBJECT_BORDERED )
+		{
+			if( outputs & OUTPUT_OBJECT )
+			{
+				CompositeBoundaryMask(result.segobj, boundary, m_params.contourColor, result.segobjbordered);
+			}
+			else
+			{
+				result.segobjbordered.swap(result.segobj);
+				CompositeBoundaryMask(result.segobjbordered, boundary, m_params.contourColor, result.segobjbordered);
+			}
+		}
+	}
+	// the plain images may only have been needed for the bordered ones
+	if( !(outputs & OUTPUT_MEANSHIFT) )	vector<UINT>().swap(result.segimg);
+	if( !(outputs & OUTPUT_OBJECT) )	vector<UINT>().swap(result.segobj);
+	result.timings.contours = ElapsedMs(stage);
+}
+
+//===========================================================================
+///	BoxStage
+///
+/// Boxes around the salient areas and, if selected, the image showing them.
+//===========================================================================
+void SaliencyPipeline::BoxStage(
+	const ImageView&				input,
+	SaliencyResult&					result)
+{
+	TRACE_SCOPE("boxes");
+	PipelineClock::time_point stage = PipelineClock::now();
+
+	FindSalientBoxes(result.regions, result.boxes, m_params.minBoxArea, m_params.maxBoxArea);
+	if( m_params.outputs & OUTPUT_BOXES )
+	{
+		TRACE_SCOPE("draw boxes");
+		input.CopyTo(result.boximg);
+		DrawBoxes(result.boximg, result.width, result.height, result.boxes, m_params.boxColor);
+	}
+	result.timings.boxes = ElapsedMs(stage);
+}
+
+//===========================================================================
+///	DoMeanShiftSegmentation
+///
+/// Without a budget, the image at the requested settings. With one, each
+/// quality in turn until one finishes in its share of the budget (see
+/// SegmentationQuality); returns the quality of the labels.
+//===========================================================================
+SegmentationQuality SaliencyPipeline::DoMeanShiftSegmentation(
+	const vector<double>&			lvec,
+	const vector<double>&			avec,
+	const vector<double>&			bvec,
+	const int&						width,
+	const int&						height,
+	vector<UINT>*					segimg,
+	vector<int>&					labels,
+	int&							numlabels,
+	vector<float>*					modes,
+	vector<UINT>*					colors)
+{
+	const int sz = width*height;
+	const double budget = m_params.segmentBudget;
+	PipelineClock::time_point start = PipelineClock::now();
+
+	for( int q = SEGMENT_EXACT; ; q++ )
+	{
+		const SegmentationQuality quality = SegmentationQuality(q);
+		const bool last = (budget <= 0) || (SEGMENT_SMALL_SCALE == quality);
+		double allowance(0);
+		if( !last )
+		{
+			allowance = s_qualityShare[q]*budget - ElapsedMs(start);
+			if( allowance <= 0 || s_costModel.TooSlow(q, sz, allowance) ) continue;
+		}
+
+		PipelineClock::time_point attempt = PipelineClock::now();
+		bool finished = SegmentAtQuality(quality, allowance, lvec, avec, bvec, width, height,
+			segimg, labels, numlabels, modes, colors);
+		if( budget > 0 ) s_costModel.Observe(q, sz, ElapsedMs(attempt), finished);
+		if( finished ) return quality;
+
+		// only the cancel flag stops the last quality
+		if( last || (m_cancel && m_cancel->load()) ) throw SaliencyCanceled();
+	}
+}
+
+//===========================================================================
+///	SegmentAtQuality
+///
+/// One segmentation of the image at a given quality, stopped after
+/// allowance ms if not 0 or once the cancel flag is set; false if stopped.
+/// A scaled down image is segmented with sigmaS and minRegion scaled down
+/// with it, and each pixel takes the label of the block it fell in.
+//===========================================================================
+bool SaliencyPipeline::SegmentAtQuality(
+	const SegmentationQuality&		quality,
+	const double&					allowance,
+	const vector<double>&			lvec,
+	const vector<double>&			avec,
+	const vector<double>&			bvec,
+	const int&						width,
+	const int&						height,
+	vector<UINT>*					segimg,
+	vector<int>&					labels,
+	int&							numlabels,
+	vector<float>*					modes,
+	vector<UINT>*					colors)
+{
+	TRACE_SPAN(span, "segment attempt");
+	span.SetDetail(QualityName(quality));
+	int sz = width*height;
+
+	int factor(1);
+	if( SEGMENT_HALF_SCALE == quality )		factor = 2;
+	if( SEGMENT_SMALL_SCALE == quality )	factor = max(4, int(ceil(sqrt(double(sz)/s_smallScalePixels))));
+
+	unique_ptr<msImageProcessor> owned(m_workspace ? NULL : new msImageProcessor);
+	msImageProcessor& mss = owned ? *owned : *m_workspace->segmenter;
+	mss.SetHaltConditions(allowance, m_cancel);
+	mss.SetSpeedThreshold(SEGMENT_EXACT == quality ? s_exactThreshold : s_fastThreshold);
+
+	if( 1 == factor )
+	{
+		mss.DefineLabImage(&lvec[0], &avec[0], &bvec[0], height, width);
+		mss.Segment(m_params.sigmaS, m_params.sigmaR, m_params.minRegion, HIGH_SPEEDUP);
+		if( EL_HALT == mss.ErrorStatus ) return false;
+		if( EL_ERROR == mss.ErrorStatus ) throw runtime_error(SegmenterError(mss));
+
+		if( segimg )
+		{
+			segimg->resize(sz);
+			mss.GetResultsARGB(&(*segimg)[0], width);
+		}
+
+		const int* p_labels = mss.GetLabelsView();
+		numlabels = mss.GetRegionCount();
+		labels.assign(p_labels, p_labels + sz);
+	}
+	else
+	{
+		const int sw = (width + factor - 1)/factor;
+		const int sh = (height + factor - 1)/factor;
+		{
+			vector<double> sl, sa, sb;
+			ScaleDownPlane(lvec, width, height, factor, sl);
+			ScaleDownPlane(avec, width, height, factor, sa);
+			ScaleDownPlane(bvec, width, height, factor, sb);
+			mss.DefineLabImage(&sl[0], &sa[0], &sb[0], sh, sw);
+		}
+		// regions of one or two scaled pixels are mostly left over by the averaging
+		const int sigmaS	= max(1, int(double(m_params.sigmaS)/factor + 0.5));
+		const int minRegion	= max(m_params.minRegion/(factor*factor), min(m_params.minRegion, 3));
+		mss.Segment(sigmaS, m_params.sigmaR, minRegion, HIGH_SPEEDUP);
+		if( EL_HALT == mss.ErrorStatus ) return false;
+		if( EL_ERROR == mss.ErrorStatus ) throw runtime_error(SegmenterError(mss));
+
+		const int* p_labels = mss.GetLabelsView();
+		numlabels = mss.GetRegionCount();
+		labels.resize(sz);
+		for( int y = 0; y < height; y++ )
+		{
+			const int* srow = p_labels + size_t(y/factor)*sw;
+			int* row = &labels[size_t(y)*width];
+			for( int x = 0; x < width; x++ ) row[x] = srow[x/factor];
+		}
+
+		if( segimg )
+		{
+			vector<UINT> table(numlabels);
+			if( numlabels ) mss.GetRegionColors(&table[0]);
+			segimg->resize(sz);
+			for( int i = 0; i < sz; i++ ) (*segimg)[i] = table[labels[i]];
+		}
+	}
+
+	if( modes )
+	{
+		const float* p_modes = mss.GetModesView();
+		modes->assign(p_modes, p_modes + 3*numlabels);
+	}
+	if( colors )
+	{
+		colors->resize(numlabels);
+		if( numlabels ) mss.GetRegionColors(&(*colors)[0]);
+	}
+	return true;
+}
+
+//=================================================================================
+// ChooseSalientPixelsToShow
+//=================================================================================
+void SaliencyPipeline::ChooseSalientPixelsToShow(
+	const vector<double>&			salmap,
+	const int&						width,
+	const int&						height,
+	const vector<int>&				labels,
+	const int&						numlabels,
+	vector<bool>&					choose)
+{
+	int sz = width*height;
+	RegionTable regions;
+	regions.Build(labels.empty() ? NULL : &labels[0], width, height, numlabels,
+		salmap.empty() ? NULL : &salmap[0]);
+
+	vector<bool> segtochoose(0);
+	ChooseSalientSegments(regions, segtochoose);
+
+	choose.assign(sz, false);
+	for( int s = 0; s < sz; s++ )
+	{
+		choose[s] = segtochoose[labels[s]];
+	}
+}
+
+//=================================================================================
+/// ChooseSalientSegments
+///
+/// Segments touching the image border count as not salient. Only the region
+/// table is visited, so this costs O(regions).
+//=================================================================================
+void SaliencyPipeline::ChooseSalientSegments(
+	const RegionTable&				regions,
+	vector<bool>&					segtochoose,
+	const double&					factor)
+{
+	int numlabels = regions.GetRegionCount();
+	int sz = regions.GetWidth()*regions.GetHeight();
+
+	//----------------------------------
+	// Find average saliency per segment
+	//----------------------------------
+	vector<double> salperseg(numlabels,0);
+	double avgimgsal(0);
+	{for( int n = 0; n < numlabels; n++ )
+	{
+		const RegionInfo& r = regions.GetRegion(n);
+		if( false == r.touchesBorder && r.area > 0 )
+		{
+			avgimgsal += r.salSum;
+			salperseg[n] = r.salSum / r.area;
+		}
+	}}
+
+	//--------------------------------------
+	// Compute average saliency of the image
+	//--------------------------------------
+	if( sz > 0 ) avgimgsal /= sz;
+
+	//----------------------------------------------------------------------------
+	// Choose segments that have average saliency twice (factor times) the
+	// average image saliency
+	//----------------------------------------------------------------------------
+	segtochoose.assign(numlabels, false);
+	bool atleastonesegmentchosen(false);
+	double cutoff = factor*avgimgsal;
+	{for( int n = 0; n < numlabels; n++ )
+	{
+		if( salperseg[n] > cutoff )
+		{
+			segtochoose[n] = true;
+			atleastonesegmentchosen = true;
+		}
+	}}
+
+	//----------------------------------------------------------------------------
+	// If not a single segment has been chosen, then take the brightest one available
+	//----------------------------------------------------------------------------
+	if( false == atleastonesegmentchosen )
+	{
+		int maxsalindex(-1);
+		double maxsal(DBL_MIN);
+		for( int n = 0; n < numlabels; n++ )
+		{
+			if( maxsal < salperseg[n] )
+			{
+				maxsal = salperseg[n];
+				maxsalindex = n;
+			}
+		}
+		if( maxsalindex >= 0 ) segtochoose[maxsalindex] = true;
+	}
+}
+
+//=================================================================================
+/// FindSalientBoxes
+///
+/// Bounding box of every segment but the last one whose pixel count lies
+/// strictly between 0.5% and 50% of the image (minArea and maxArea). Small
+/// and very large boxes are not worth showing.
+//=================================================================================
+void SaliencyPipeline::FindSalientBoxes(
+	const vector<int>&				labels,
+	const int&						width,
+	const int&						height,
+	const int&						numlabels,
+	vector<SaliencyBox>&			boxes)
+{
+	RegionTable regions;
+	regions.Build(labels.empty() ? NULL : &labels[0], width, height, numlabels);
+	FindSalientBoxes(regions, boxes);
+}
+
+void SaliencyPipeline::FindSalientBoxes(
+	const RegionTable&				regions,
+	vector<SaliencyBox>&			boxes,
+	const double&					minArea,
+	const double&					maxArea)
+{
+	int sz = regions.GetWidth()*regions.GetHeight();
+	boxes.clear();
+
+	for( int flag = 0; flag < regions.GetRegionCount()-1; flag++ )
+	{
+		const RegionInfo& r = regions.GetRegion(flag);
+		if( r.area > (minArea*sz) && r.area < (maxArea*sz) )
+		{
+			SaliencyBox box;
+			box.label		= flag;
+			box.x			= r.minx;
+			box.y			= r.miny;
+			box.width		= r.maxx - r.minx + 1;
+			box.height		= r.maxy - r.miny + 1;
+			box.pointCount	= r.area;
+			boxes.push_back(box);
+		}
+	}
+}
+
+//=================================================================================
+/// DrawBoxes
+///
+/// One pixel wide outline from (x, y) to (x+width, y+height), i.e. the right and
+/// bottom edges lie just outside the box, clipped to the image.
+//=================================================================================
+void SaliencyPipeline::DrawBoxes(
+	vector<UINT>&					img,
+	const int&						width,
+	const int&						height,
+	const vector<SaliencyBox>&		boxes,
+	const UINT&						color)
+{
+	int numboxes = int(boxes.size());
+	for( int n = 0; n < numboxes; n++ )
+	{
+		int x0 = boxes[n].x;
+		int y0 = boxes[n].y;
+		int x1 = x0 + boxes[n].width;
+		int y1 = y0 + boxes[n].height;
+		int cx0 = (x0 < 0) ? 0 : x0;
+		int cx1 = (x1 < width) ? x1 : width-1;
+		int cy0 = (y0 < 0) ? 0 : y0;
+		int cy1 = (y1 < height) ? y1 : height-1;
+
+		for( int x = cx0; x <= cx1; x++ )
+		{
+			if( y0 >= 0 && y0 < height ) img[y0*width + x] = color;
+			if( y1 >= 0 && y1 < height ) img[y1*width + x] = color;
+		}
+		for( int y = cy0; y <= cy1; y++ )
+		{
+			if( x0 >= 0 && x0 < width ) img[y*width + x0] = color;
+			if( x1 >= 0 && x1 < width ) img[y*width + x1] = color;
+		}
+	}
+}
+
+//=================================================================================
+/// OutputSuffix
+///
+/// File name suffix used for each output image.
+//=================================================================================
+string SaliencyPipeline::OutputSuffix(
+	const SaliencyOutput&			output)
+{
+	switch( output )
+	{
+	case OUTPUT_SALMAP:				return "_1_SalMap";
+	case OUTPUT_MEANSHIFT:			return "_2_MeanShift";
+	case OUTPUT_OBJECT:				return "_3_SalientObject";
+	case OUTPUT_MEANSHIFT_BORDERED:	return "_2_MeanShiftbordered";
+	case OUTPUT_OBJECT_BORDERED:	return "_3_SalientObjectbordered";
+	case OUTPUT_BOXES:				return "_4_LvKuang";
+	default:						return "";
+	}
+}
+
+//=================================================================================
+/// QualityName
+//=================================================================================
+const char* SaliencyPipeline::QualityName(
+	const SegmentationQuality&		quality)
+{
+	switch( quality )
+	{
+	case SEGMENT_EXACT:				return "exact";
+	case SEGMENT_FAST:				return "fast";
+	case SEGMENT_HALF_SCALE:		return "half";
+	case SEGMENT_SMALL_SCALE:		return "small";
+	default:						return "";
+	}
+}
@@ -0,0 +1,364 @@
+// SaliencyPipeline.h: interface for the SaliencyPipeline class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// GUI-free version of the processing done by the dialog: frequency-tuned
+// saliency, mean shift segmentation, salient segment selection, contour
+// drawing and salient region boxes. It depends only on the standard library,
+// Saliency and MeanShiftCode, so it can be built as a library on any platform.
+//===========================================================================
+
+#if !defined(_SALIENCYPIPELINE_H_INCLUDED_)
+#define _SALIENCYPIPELINE_H_INCLUDED_
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <stdexcept>
+#include <stdint.h>
+#include "Saliency.h"
+#include "RegionTable.h"
+#include "ImageView.h"
+using namespace std;
+
+class StageCache;
+class msImageProcessor;
+
+//---------------------------------------------------------------------------
+// Outputs that Process() should produce. The saliency map, labels and boxes
+// are always computed; these flags only select which images are rendered.
+//---------------------------------------------------------------------------
+enum SaliencyOutput
+{
+	OUTPUT_SALMAP				= 0x01,		// "_1_SalMap"
+	OUTPUT_MEANSHIFT			= 0x02,		// "_2_MeanShift"
+	OUTPUT_OBJECT				= 0x04,		// "_3_SalientObject"
+	OUTPUT_MEANSHIFT_BORDERED	= 0x08,		// "_2_MeanShiftbordered"
+	OUTPUT_OBJECT_BORDERED		= 0x10,		// "_3_SalientObjectbordered"
+	OUTPUT_BOXES				= 0x20,		// "_4_LvKuang"
+	OUTPUT_ALL					= 0x3f
+};
+
+struct SaliencyParams
+{
+	int					sigmaS;			// mean shift spatial bandwidth
+	float				sigmaR;			// mean shift range bandwidth
+	int					minRegion;		// smallest region kept by the segmenter
+	unsigned int		outputs;		// combination of SaliencyOutput flags
+	UINT				contourColor;	// colour of the segment contours
+	UINT				boxColor;		// colour of the salient region boxes
+	int					threads;		// threads one image may use
+	double				salientFactor;	// segments above this multiple of the mean saliency are chosen
+	double				minBoxArea;		// boxes are kept for segments strictly between these
+	double				maxBoxArea;		// fractions of the image area
+	double				segmentBudget;	// ms the segmentation may take, 0 for no limit (see SegmentationQuality)
+
+	SaliencyParams()
+		: sigmaS(7), sigmaR(10), minRegion(20), outputs(OUTPUT_ALL),
+		  contourColor(0xffffff), boxColor(0x00ff00), threads(1),
+		  salientFactor(2.0), minBoxArea(0.005), maxBoxArea(0.5), segmentBudget(0) {}
+};
+
+//---------------------------------------------------------------------------
+// How the labels of a result were obtained. With a segmentation budget the
+// segmenter goes down this list until a setting finishes in time, skipping
+// those that its past runs say cannot; the last one is not timed out, and
+// at 64K pixels or so it takes a few tens of milliseconds whatever the
+// image size. Scaled down segmentations are scaled back up to the image, so
+// that the labels always have one entry per pixel.
+//---------------------------------------------------------------------------
+enum SegmentationQuality
+{
+	SEGMENT_EXACT				= 0,		// the requested settings
+	SEGMENT_FAST				= 1,		// coarser HIGH_SPEEDUP threshold (0.5)
+	SEGMENT_HALF_SCALE			= 2,		// and half the width and height
+	SEGMENT_SMALL_SCALE			= 3			// and scaled down to about 256x256 pixels
+};
+
+//---------------------------------------------------------------------------
+// Thrown by Process() and ProcessSegmentation() when the cancel flag of the
+// pipeline is set while an image is segmented.
+//---------------------------------------------------------------------------
+class SaliencyCanceled : public runtime_error
+{
+public:
+	SaliencyCanceled() : runtime_error("segmentation canceled") {}
+};
+
+//---------------------------------------------------------------------------
+// Wall clock time spent in each stage of Process(), in milliseconds.
+//---------------------------------------------------------------------------
+struct SaliencyTimings
+{
+	double				lab;
+	double				saliency;
+	double				segmentation;
+	double				regions;
+	double				selection;
+	double				contours;
+	double				boxes;
+	double				cache;			// hashing the image and reading cached stages
+	double				total;
+
+	SaliencyTimings()
+		: lab(0), saliency(0), segmentation(0), regions(0), selection(0), contours(0), boxes(0), cache(0), total(0) {}
+};
+
+//---------------------------------------------------------------------------
+// Bounding box of a salient region. (x, y) is the top left pixel, the box
+// covers width x height pixels.
+//---------------------------------------------------------------------------
+struct SaliencyBox
+{
+	int					label;
+	int					x;
+	int					y;
+	int					width;
+	int					height;
+	int					pointCount;
+};
+
+struct SaliencyResult
+{
+	int					width;
+	int					height;
+
+	vector<double>		salmap;			// saliency in [0,255], row-major
+	vector<int>			labels;			// mean shift label per pixel
+	int					numlabels;
+	RegionTable			regions;		// per-label statistics and pixels
+	vector<SaliencyBox>	boxes;			// boxes drawn on boximg
+
+	// images in 0x00RRGGBB, filled only when selected by params.outputs
+	vector<UINT>		salimg;
+	vector<UINT>		segimg;
+	vector<UINT>		segobj;
+	vector<UINT>		segimgbordered;
+	vector<UINT>		segobjbordered;
+	vector<UINT>		boximg;
+
+	SaliencyTimings		timings;
+	unsigned int		cached;			// CachedStage flags of the stages read from the cache
+	SegmentationQuality	quality;		// SEGMENT_EXACT unless the segmentation budget ran short
+
+	SaliencyResult() : width(0), height(0), numlabels(0), cached(0), quality(SEGMENT_EXACT) {}
+
+	bool IsDegraded() const { return quality != SEGMENT_EXACT; }
+};
+
+enum CachedStage
+{
+	CACHED_SALIENCY				= 0x1,
+	CACHED_SEGMENTATION			= 0x2
+};
+
+//---------------------------------------------------------------------------
+// Lab planes of the input image, shared by the saliency and mean shift
+// stages, and its cache key (see StageCache) when a cache is used.
+//---------------------------------------------------------------------------
+struct SaliencyLab
+{
+	vector<double>		lvec;
+	vector<double>		avec;
+	vector<double>		bvec;
+	uint64_t			imageKey;
+
+	SaliencyLab() : imageKey(0) {}
+};
+
+//---------------------------------------------------------------------------
+// Buffers kept from one image to the next by a pipeline that processes
+// image after image on one thread (see SaliencyPipeline::SetWorkspace): the
+// Lab planes, and the mean shift processor, whose output buffers are used
+// again when the next image has the same size.
+//---------------------------------------------------------------------------
+class SaliencyWorkspace
+{
+public:
+	SaliencyWorkspace();
+	virtual ~SaliencyWorkspace();
+
+	SaliencyLab			lab;
+	msImageProcessor*	segmenter;
+
+private:
+	SaliencyWorkspace(const SaliencyWorkspace&);
+	SaliencyWorkspace& operator=(const SaliencyWorkspace&);
+};
+
+class SaliencyPipeline
+{
+public:
+	SaliencyPipeline();
+	SaliencyPipeline(const SaliencyParams& params);
+	virtual ~SaliencyPipeline();
+
+	void SetParams(const SaliencyParams& params) { m_params = params; }
+	const SaliencyParams& GetParams() const { return m_params; }
+
+	// Saliency maps and segmentations are read from and written to cache,
+	// which may be shared by several pipelines; NULL (the default) for none.
+	void SetCache(StageCache* cache) { m_cache = cache; }
+	StageCache* GetCache() const { return m_cache; }
+
+	// Segmentations stop as soon as *cancel is set, from any thread, and
+	// Process() throws SaliencyCanceled; NULL (the default) for none.
+	void SetCancelFlag(const atomic<bool>* cancel) { m_cancel = cancel; }
+
+	// Process() and ProcessSegmentation() use the buffers of workspace
+	// instead of allocating their own, so the pipeline must then process
+	// one image at a time; NULL (the default) for none.
+	void SetWorkspace(SaliencyWorkspace* workspace) { m_workspace = workspace; }
+
+	void Process(
+		const vector<UINT>&				inputimg,              //INPUT: A RGB buffer in row-major order
+		const int&						width,
+		const int&						height,
+		SaliencyResult&					result);               //OUTPUT
+
+	// The pixels are read where they are, in any layout (see ImageView), so
+	// a decoded image is not copied into a 0x00RRGGBB buffer first; only
+	// the box image is a copy of the input.
+	void Process(
+		const ImageView&				input,
+		SaliencyResult&					result);
+
+	// Process() split in two, for callers that run the halves on different threads
+	void ProcessSaliency(
+		const vector<UINT>&				inputimg,
+		const int&						width,
+		const int&						height,
+		SaliencyLab&					lab,                   //OUTPUT: kept for ProcessSegmentation
+		SaliencyResult&					result);
+
+	void ProcessSegmentation(
+		const vector<UINT>&				inputimg,
+		SaliencyLab&					lab,                   //INPUT: released on return
+		SaliencyResult&					result);
+
+	// the same on a view, which must stay valid until both halves are done
+	void ProcessSaliency(
+		const ImageView&				input,
+		SaliencyLab&					lab,
+		SaliencyResult&					result);
+
+	void ProcessSegmentation(
+		const ImageView&				input,
+		SaliencyLab&					lab,
+		SaliencyResult&					result);
+
+	static void ChooseSalientPixelsToShow(
+		const vector<double>&			salmap,
+		const int&						width,
+		const int&						height,
+		const vector<int>&				labels,
+		const int&						numlabels,
+		vector<bool>&					choose);
+
+	// Segments whose mean saliency is more than factor times the image
+	// average, or the most salient one if there is none. Needs a table
+	// built with the saliency map.
+	static void ChooseSalientSegments(
+		const RegionTable&				regions,
+		vector<bool>&					segtochoose,
+		const double&					factor = 2.0);
+
+	static void FindSalientBoxes(
+		const vector<int>&				labels,
+		const int&						width,
+		const int&						height,
+		const int&						numlabels,
+		vector<SaliencyBox>&			boxes);
+
+	static void FindSalientBoxes(
+		const RegionTable&				regions,
+		vector<SaliencyBox>&			boxes,
+		const double&					minArea = 0.005,	// fractions of the image area
+		const double&					maxArea = 0.5);
+
+	static void DrawBoxes(
+		vector<UINT>&					img,
+		const int&						width,
+		const int&						height,
+		const vector<SaliencyBox>&		boxes,
+		const UINT&						color);
+
+	static string OutputSuffix(
+		const SaliencyOutput&			output);
+
+	// "exact", "fast", "half" or "small"
+	static const char* QualityName(
+		const SegmentationQuality&		quality);
+
+private:
+
+	void CacheLookup(
+		const ImageView&				input,
+		SaliencyLab&					lab,
+		SaliencyResult&					result);
+
+	void LabStage(
+		const ImageView&				input,
+		SaliencyLab&					lab,
+		SaliencyResult&					result);
+
+	void SaliencyStage(
+		const SaliencyLab&				lab,
+		SaliencyResult&					result);
+
+	void SegmentationStage(
+		const SaliencyLab&				lab,
+		SaliencyResult&					result);
+
+	void FinishStages(
+		const ImageView&				input,
+		SaliencyResult&					result);
+
+	void RegionStage(
+		const ImageView&				input,
+		SaliencyResult&					result);
+
+	void SelectionStage(
+		const ImageView&				input,
+		SaliencyResult&					result);
+
+	void ContourStage(
+		SaliencyResult&					result);
+
+	void BoxStage(
+		const ImageView&				input,
+		SaliencyResult&					result);
+
+	SegmentationQuality DoMeanShiftSegmentation(
+		const vector<double>&			lvec,
+		const vector<double>&			avec,
+		const vector<double>&			bvec,
+		const int&						width,
+		const int&						height,
+		vector<UINT>*					segimg,
+		vector<int>&					labels,
+		int&							numlabels,
+		vector<float>*					modes = NULL,
+		vector<UINT>*					colors = NULL);
+
+	bool SegmentAtQuality(
+		const SegmentationQuality&		quality,
+		const double&					allowance,			// ms, 0 for no limit
+		const vector<double>&			lvec,
+		const vector<double>&			avec,
+		const vector<double>&			bvec,
+		const int&						width,
+		const int&						height,
+		vector<UINT>*					segimg,
+		vector<int>&					labels,
+		int&							numlabels,
+		vector<float>*					modes,
+		vector<UINT>*					colors);
+
+	SaliencyParams		m_params;
+	StageCache*			m_cache;
+	const atomic<bool>*	m_cancel;
+	SaliencyWorkspace*	m_workspace;
+};
+
+#endif // !defined(_SALIENCYPIPELINE_H_INCLUDED_)
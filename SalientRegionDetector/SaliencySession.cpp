@@ -0,0 +1,111 @@
+// SaliencySession.cpp: implementation of the SaliencySession class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "SaliencySession.h"
+#include <chrono>
+
+typedef std::chrono::high_resolution_clock SessionClock;
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+SaliencySession::SaliencySession()
+	: m_queryMs(0)
+{
+
+}
+
+SaliencySession::~SaliencySession()
+{
+
+}
+
+//===========================================================================
+///	Run
+///
+/// Only the region table is needed afterwards, so the pipeline is asked for
+/// no images; the object image can be rendered from the mask.
+//===========================================================================
+void SaliencySession::Run(
+	const SaliencyParams&			params,
+	const vector<UINT>&				inputimg,
+	const int&						width,
+	const int&						height)
+{
+	SaliencyParams p = params;
+	p.outputs = 0;
+	SaliencyPipeline pipeline(p);
+	SaliencyResult result;
+	pipeline.Process(inputimg, width, height, result);
+	Attach(inputimg, result, SaliencyThresholds(params));
+}
+
+//===========================================================================
+///	Attach
+//===========================================================================
+void SaliencySession::Attach(
+	const vector<UINT>&				inputimg,
+	SaliencyResult&					result,
+	const SaliencyThresholds&		thresholds)
+{
+	m_inputimg = inputimg;
+	m_result = SaliencyResult();
+	swap(m_result, result);
+
+	int sz = m_result.width*m_result.height;
+	m_chosen.assign(m_result.regions.GetRegionCount(), false);
+	m_mask.assign(sz, 0);
+	m_boxes.clear();
+	SetThresholds(thresholds);
+}
+
+//===========================================================================
+///	SetThresholds
+///
+/// The segments are chosen again from the region table, then the mask is
+/// cleared or filled over the pixel lists of the segments that changed.
+//===========================================================================
+void SaliencySession::SetThresholds(
+	const SaliencyThresholds&		thresholds)
+{
+	SessionClock::time_point start = SessionClock::now();
+	m_thresholds = thresholds;
+
+	const RegionTable& regions = m_result.regions;
+	vector<bool> chosen(0);
+	SaliencyPipeline::ChooseSalientSegments(regions, chosen, thresholds.salientFactor);
+
+	int numlabels = regions.GetRegionCount();
+	for( int n = 0; n < numlabels; n++ )
+	{
+		if( chosen[n] == m_chosen[n] ) continue;
+		unsigned char val = chosen[n] ? 255 : 0;
+		const int* pixels = regions.GetRegionPixels(n);
+		int area = regions.GetRegion(n).area;
+		for( int p = 0; p < area; p++ )
+		{
+			m_mask[pixels[p]] = val;
+		}
+	}
+	m_chosen.swap(chosen);
+
+	SaliencyPipeline::FindSalientBoxes(regions, m_boxes, thresholds.minBoxArea, thresholds.maxBoxArea);
+
+	m_queryMs = std::chrono::duration<double, std::milli>(SessionClock::now() - start).count();
+}
+
+//===========================================================================
+///	GetObjectImage
+//===========================================================================
+void SaliencySession::GetObjectImage(
+	vector<UINT>&					segobj) const
+{
+	int sz = int(m_mask.size());
+	segobj.assign(sz, 0);
+	for( int p = 0; p < sz; p++ )
+	{
+		if( m_mask[p] ) segobj[p] = m_inputimg[p];
+	}
+}
@@ -0,0 +1,79 @@
+// SaliencySession.h: interface for the SaliencySession class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Keeps the saliency map, labels and region table of one pipeline run so
+// that the selection thresholds can be changed without processing the
+// image again. A new set of thresholds costs O(regions) for the chosen
+// segments and the boxes; the object mask is updated in place by visiting
+// only the pixels of the segments whose choice changed, so scrubbing a
+// threshold touches little of the image.
+//===========================================================================
+
+#if !defined(_SALIENCYSESSION_H_INCLUDED_)
+#define _SALIENCYSESSION_H_INCLUDED_
+
+#include <vector>
+#include "SaliencyPipeline.h"
+using namespace std;
+
+struct SaliencyThresholds
+{
+	double				salientFactor;	// see SaliencyParams
+	double				minBoxArea;
+	double				maxBoxArea;
+
+	SaliencyThresholds() : salientFactor(2.0), minBoxArea(0.005), maxBoxArea(0.5) {}
+	SaliencyThresholds(const SaliencyParams& params)
+		: salientFactor(params.salientFactor), minBoxArea(params.minBoxArea), maxBoxArea(params.maxBoxArea) {}
+};
+
+class SaliencySession
+{
+public:
+	SaliencySession();
+	virtual ~SaliencySession();
+
+	// Processes the image and applies the thresholds of params.
+	void Run(
+		const SaliencyParams&			params,
+		const vector<UINT>&				inputimg,
+		const int&						width,
+		const int&						height);
+
+	// Takes over a result computed elsewhere (result is left empty) together
+	// with the image it was computed from.
+	void Attach(
+		const vector<UINT>&				inputimg,
+		SaliencyResult&					result,
+		const SaliencyThresholds&		thresholds = SaliencyThresholds());
+
+	void SetThresholds(
+		const SaliencyThresholds&		thresholds);
+
+	const SaliencyThresholds& GetThresholds() const { return m_thresholds; }
+	const SaliencyResult& GetResult() const { return m_result; }
+
+	const vector<bool>& GetChosenSegments() const { return m_chosen; }
+	const vector<unsigned char>& GetObjectMask() const { return m_mask; }	// 255 on chosen segments
+	const vector<SaliencyBox>& GetBoxes() const { return m_boxes; }
+
+	// input pixels of the chosen segments, black elsewhere; O(pixels)
+	void GetObjectImage(
+		vector<UINT>&					segobj) const;
+
+	// time taken by the last SetThresholds(), in milliseconds
+	double GetQueryMs() const { return m_queryMs; }
+
+private:
+
+	vector<UINT>						m_inputimg;
+	SaliencyResult						m_result;
+	SaliencyThresholds					m_thresholds;
+	vector<bool>						m_chosen;
+	vector<unsigned char>				m_mask;
+	vector<SaliencyBox>					m_boxes;
+	double								m_queryMs;
+};
+
+#endif // !defined(_SALIENCYSESSION_H_INCLUDED_)
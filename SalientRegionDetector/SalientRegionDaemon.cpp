@@ -0,0 +1,114 @@
+// SalientRegionDaemon.cpp : the segmentation service as a process
+//
+//===========================================================================
+// Runs SegmentationService until SIGINT or SIGTERM, then finishes or
+// cancels the jobs in hand and prints what it served. Clients connect with
+// ServiceClient (see ServiceLoadGenerator for one).
+//
+// Usage:
+//   SalientRegionDaemon [options]
+//
+// With more than one worker, one is reserved for interactive jobs by
+// default, so that an interactive request never waits for a bulk image to
+// finish; --reserved 0 lets every worker take any job.
+//===========================================================================
+
+#include "SegmentationService.h"
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+
+using namespace std;
+
+static SegmentationService* s_service(NULL);
+
+static void StopService(int)
+{
+	if( s_service ) s_service->RequestStop();
+}
+
+static void PrintUsage(const char* prog)
+{
+	cerr << "Usage: " << prog << " [options]\n"
+		 << "Options:\n"
+		 << "  --socket <path>      Unix domain socket (default /tmp/salientregion.sock)\n"
+		 << "  -j <n>               worker threads (default 1)\n"
+		 << "  --reserved <n>       workers taking interactive jobs only (default 1 with -j 2 or more)\n"
+		 << "  --queue <n>          jobs waiting before requests are refused (default 256)\n"
+		 << "  --max-megapixels <n> largest image accepted (default 64)\n"
+		 << "  -q                   no statistics at exit\n";
+}
+
+static void PrintClass(const char* name, const ServiceClassStats& stats)
+{
+	int ran = stats.jobs - stats.rejected - stats.failed;
+	printf("%-12s jobs=%d busy=%d failed=%d degraded=%d", name, stats.jobs, stats.rejected, stats.failed, stats.degraded);
+	if( ran > 0 )
+	{
+		printf(" queue=%.1fms (max %.1fms) process=%.1fms",
+			stats.queueMs/ran, stats.maxQueueMs, stats.processMs/ran);
+	}
+	printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	ServiceSettings settings;
+	int reserved(-1);
+	bool quiet(false);
+
+	for( int a = 1; a < argc; a++ )
+	{
+		string arg(argv[a]);
+		bool hasvalue = a + 1 < argc;
+		if( arg == "--socket" && hasvalue )					settings.socketPath = argv[++a];
+		else if( arg == "-j" && hasvalue )					settings.workers = atoi(argv[++a]);
+		else if( arg == "--reserved" && hasvalue )			reserved = atoi(argv[++a]);
+		else if( arg == "--queue" && hasvalue )				settings.maxQueued = atoi(argv[++a]);
+		else if( arg == "--max-megapixels" && hasvalue )	settings.maxMegapixels = atof(argv[++a]);
+		else if( arg == "-q" )								quiet = true;
+		else
+		{
+			cerr << "unknown or incomplete option " << arg << endl;
+			PrintUsage(argv[0]);
+			return 2;
+		}
+	}
+	if( settings.workers < 1 || settings.maxQueued < 1 || !(settings.maxMegapixels > 0) ||
+		reserved >= settings.workers )
+	{
+		PrintUsage(argv[0]);
+		return 2;
+	}
+	settings.reserved = reserved >= 0 ? reserved : (settings.workers > 1 ? 1 : 0);
+
+	SegmentationService service(settings);
+	if( !service.Start() )
+	{
+		cerr << service.GetError() << endl;
+		return 1;
+	}
+	s_service = &service;
+	signal(SIGINT, StopService);
+	signal(SIGTERM, StopService);
+	if( !quiet )
+	{
+		cerr << "listening on " << settings.socketPath << " with " << settings.workers << " workers ("
+			 << settings.reserved << " reserved for interactive jobs)" << endl;
+	}
+
+	service.Run();
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	s_service = NULL;
+
+	if( !quiet )
+	{
+		ServiceStats stats = service.GetStats();
+		printf("connections=%d\n", stats.connections);
+		PrintClass("interactive", stats.interactive);
+		PrintClass("bulk", stats.bulk);
+	}
+	return 0;
+}
@@ -0,0 +1,834 @@
+// SalientRegionDetectorCli.cpp : command line front end
+//
+//===========================================================================
+// Runs the same processing as the dialog (see SaliencyPipeline) over a list
+// of images without any GUI, so that it can be used on batch servers.
+//
+// Usage:
+//   SalientRegionDetectorCli [options] <image | directory | @listfile> ...
+//
+// A directory is expanded to the images it contains, a @listfile holds one
+// path per line. Result files (.srd, see ResultFile) given as inputs are
+// converted back to the selected image outputs instead of being processed. Images are processed in parallel within a memory budget
+// (see BatchScheduler) and their outputs are encoded on background writer
+// threads (see ImageWriterPool). Per image timings are printed on stdout.
+// With --decode-scale or --preview, JPEG and PNG images are decoded at a
+// fraction of their size (see ImageDecoder) and everything is computed and
+// written at that size.
+//===========================================================================
+
+#include "SaliencyPipeline.h"
+#include "BatchScheduler.h"
+#include "StagedPipeline.h"
+#include "ImageWriterPool.h"
+#include "ResultFile.h"
+#include "ParameterSweep.h"
+#include "StageCache.h"
+#include "Trace.h"
+#include "ImageDecoder.h"
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+typedef std::chrono::high_resolution_clock CliClock;
+
+static double ElapsedMs(const CliClock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(CliClock::now() - start).count();
+}
+
+//=================================================================================
+///	PrintUsage
+//=================================================================================
+static void PrintUsage(const char* prog)
+{
+	cerr << "Usage: " << prog << " [options] <image | directory | @listfile> ...\n"
+		 << "Options:\n"
+		 << "  -o <folder>      output folder, must exist (default ./data/)\n"
+		 << "  -s <sigmaS>      mean shift spatial bandwidth (default 7)\n"
+		 << "  -r <sigmaR>      mean shift range bandwidth (default 10)\n"
+		 << "  -m <minRegion>   minimum region area (default 20)\n"
+		 << "  --budget <ms>    time the segmentation of an image may take; past its\n"
+		 << "                   share of it a coarser and then a scaled down setting is\n"
+		 << "                   used, and the image is reported with quality=<setting>\n"
+		 << "                   (default: no limit)\n"
+		 << "  -f <jpg|bmp|png> default output image format (default jpg)\n"
+		 << "  --quality <q>    default JPEG quality 0-100 or PNG compression 0-9\n"
+		 << "                   (default: the encoder's)\n"
+		 << "  --salient <k>    choose segments above k times the mean saliency (default 2)\n"
+		 << "  --box-area <min,max> keep boxes of segments between these fractions of\n"
+		 << "                   the image area (default 0.005,0.5)\n"
+		 << "  --outputs <list> comma separated subset of salmap, meanshift, object,\n"
+		 << "                   meanshiftbordered, objectbordered, boxes, all, none,\n"
+		 << "                   each optionally followed by :format[:quality], e.g.\n"
+		 << "                   object:png,boxes:jpg:80 (default all)\n"
+		 << "  -j <workers>     images processed at once (default: number of cores)\n"
+		 << "  --save-result    also write the labels, saliency, regions and boxes of\n"
+		 << "                   each image to <name>.srd in the output folder\n"
+		 << "  -w <writers>     background image writer threads (default 2, 0 to write\n"
+		 << "                   on the processing threads)\n"
+		 << "  --memory <MB>    memory budget for the images in flight (default 2048,\n"
+		 << "                   0 for no limit)\n"
+		 << "  --stages <d,s,m,e> stream the images through decode, saliency, mean shift\n"
+		 << "                   and encode stages with the given numbers of workers\n"
+		 << "                   instead of scheduling whole images\n"
+		 << "  --cache <folder> keep saliency maps and segmentations in folder and reuse\n"
+		 << "                   them when the same image is processed again with the\n"
+		 << "                   same sigmaS, sigmaR and minRegion\n"
+		 << "  --cache-size <MB> size cap of the cache, least recently used entries are\n"
+		 << "                   deleted first (default 1024)\n"
+		 << "  --sweep <s:r:m>  segment each image for every combination of the comma\n"
+		 << "                   separated sigmaS, sigmaR and minRegion lists, e.g.\n"
+		 << "                   7:6,10,14:10,20,50, and print a table of region\n"
+		 << "                   counts and timings instead of writing images\n"
+		 << "  --decode-scale <n> decode the images at 1/n of their size (2, 4 or 8): JPEG\n"
+		 << "                   by DCT scaling, PNG by averaging n x n boxes as the rows\n"
+		 << "                   are read; the outputs are at that size\n"
+		 << "  --preview <pixels> decode each image at the largest such scale that keeps\n"
+		 << "                   this many pixels on its longer side\n"
+		 << "  --trace <file>   record the stages of every image on every thread and\n"
+		 << "                   write them to file in Chrome trace_event JSON format\n"
+		 << "  -q               only print the summary\n";
+}
+
+//=================================================================================
+///	IsImageFile
+//=================================================================================
+static bool IsImageFile(const string& path)
+{
+	static const char* exts[] = {".jpg", ".jpeg", ".png", ".bmp", ".tif", ".tiff", ".ppm", ".pgm"};
+	size_t dot = path.find_last_of('.');
+	if( dot == string::npos ) return false;
+	string ext = path.substr(dot);
+	for( size_t i = 0; i < ext.size(); i++ ) ext[i] = (char)tolower((unsigned char)ext[i]);
+	for( size_t i = 0; i < sizeof(exts)/sizeof(exts[0]); i++ )
+	{
+		if( ext == exts[i] ) return true;
+	}
+	return false;
+}
+
+//=================================================================================
+///	IsResultFile
+//=================================================================================
+static bool IsResultFile(const string& path)
+{
+	return path.size() > 4 && path.compare(path.size() - 4, 4, ".srd") == 0;
+}
+
+//=================================================================================
+///	BaseName
+///
+///	File name without folder and extension, the same part that SavePicture uses.
+//=================================================================================
+static string BaseName(const string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	string name = (slash == string::npos) ? path : path.substr(slash + 1);
+	size_t dot = name.find_last_of('.');
+	if( dot != string::npos ) name.erase(dot);
+	return name;
+}
+
+//=================================================================================
+///	CollectInputs
+///
+///	Expands directories and list files into picvec.
+//=================================================================================
+static void CollectInputs(const string& arg, vector<string>& picvec)
+{
+	if( !arg.empty() && arg[0] == '@' )
+	{
+		ifstream list(arg.c_str() + 1);
+		if( !list.is_open() )
+		{
+			cerr << "cannot open list file " << arg.substr(1) << endl;
+			return;
+		}
+		string line;
+		while( getline(list, line) )
+		{
+			if( !line.empty() && line[line.size()-1] == '\r' ) line.erase(line.size()-1);
+			if( !line.empty() ) picvec.push_back(line);	// images or result files
+		}
+		return;
+	}
+
+	if( IsImageFile(arg) || IsResultFile(arg) )
+	{
+		picvec.push_back(arg);
+		return;
+	}
+
+	// anything else is treated as a folder
+	vector<cv::String> files;
+	try
+	{
+		cv::glob(arg, files, false);
+	}
+	catch( const cv::Exception& )
+	{
+		files.clear();
+	}
+	size_t before = picvec.size();
+	for( size_t i = 0; i < files.size(); i++ )
+	{
+		string f(files[i]);
+		if( IsImageFile(f) ) picvec.push_back(f);
+	}
+	if( picvec.size() == before ) cerr << "no images found in " << arg << endl;
+}
+
+//=================================================================================
+///	DecodeSpec
+///
+///	How far images are scaled down as they are decoded: by scale, or, with
+///	previewSide, by the largest scale that keeps previewSide pixels on the
+///	longer side of each image.
+//=================================================================================
+struct DecodeSpec
+{
+	int						scale;
+	int						previewSide;
+
+	DecodeSpec() : scale(1), previewSide(0) {}
+
+	int ScaleFor(const string& path) const
+	{
+		int width(0);
+		int height(0);
+		if( previewSide <= 0 ) return scale;
+		if( !BatchScheduler::PeekImageSize(path, width, height) ) return 1;
+		return ImageDecoder::ScaleFor(width, height, previewSide);
+	}
+};
+
+//=================================================================================
+///	LoadImage
+///
+///	Decodes an image at 1/scale of its size and views its BGR pixels in the
+///	Mat, without a copy; the view is valid while mat is. Scaled JPEG and PNG
+///	images are streamed from ImageDecoder into the Mat, so their full
+///	resolution pixels are never held; other formats use OpenCV's reduced
+///	decode.
+//=================================================================================
+static bool LoadImage(const string& path, cv::Mat& mat, ImageView& view, const int& scale)
+{
+	TRACE_SPAN(span, "decode");
+	span.SetDetail(path);
+	if( scale > 1 )
+	{
+		ImageDecoder decoder;
+		if( decoder.Open(path, scale) )
+		{
+			mat = cv::Mat(decoder.GetHeight(), decoder.GetWidth(), CV_8UC3);
+			view = ImageView(mat.data, mat.cols, mat.rows, PIXEL_BGR24, ptrdiff_t(mat.step));
+			return decoder.ReadRows(view);
+		}
+		int flag = (scale >= 8) ? cv::IMREAD_REDUCED_COLOR_8 : (scale >= 4) ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_REDUCED_COLOR_2;
+		mat = cv::imread(path, flag);
+	}
+	else mat = cv::imread(path, cv::IMREAD_COLOR);
+	if( mat.empty() ) return false;
+
+	view = ImageView(mat.data, mat.cols, mat.rows, PIXEL_BGR24, ptrdiff_t(mat.step));
+	return true;
+}
+
+//=================================================================================
+///	LoadImage
+///
+///	Reads an image into a 0x00RRGGBB buffer as PictureHandler does.
+//=================================================================================
+static bool LoadImage(const string& path, vector<UINT>& img, int& width, int& height, const int& scale)
+{
+	cv::Mat mat;
+	ImageView view;
+	if( !LoadImage(path, mat, view, scale) ) return false;
+
+	width  = view.width;
+	height = view.height;
+	view.CopyTo(img);
+	return true;
+}
+
+//=================================================================================
+///	EncodeImage
+///
+///	Writes one ImageWriteRequest with OpenCV. Safe to call from any thread.
+//=================================================================================
+static bool EncodeImage(const ImageWriteRequest& request)
+{
+	ImageView src = ImageView::Of(request.img, request.width, request.height);
+	if( src.IsEmpty() ) return false;
+	cv::Mat mat(request.height, request.width, CV_8UC3);
+	ImageView::Convert(src, ImageView(mat.data, mat.cols, mat.rows, PIXEL_BGR24, ptrdiff_t(mat.step)));
+	vector<int> params;
+	if( request.quality >= 0 && IMAGE_JPEG == request.format )
+	{
+		params.push_back(cv::IMWRITE_JPEG_QUALITY);
+		params.push_back(request.quality);
+	}
+	if( request.quality >= 0 && IMAGE_PNG == request.format )
+	{
+		params.push_back(cv::IMWRITE_PNG_COMPRESSION);
+		params.push_back(request.quality > 9 ? 9 : request.quality);
+	}
+	try
+	{
+		return cv::imwrite(request.path, mat, params);
+	}
+	catch( const cv::Exception& )
+	{
+		return false;
+	}
+}
+
+//=================================================================================
+///	BatchTotals
+///
+///	Sums over all images; updated by the worker threads under the lock.
+//=================================================================================
+struct BatchTotals
+{
+	mutex				lock;
+	SaliencyTimings		sum;
+	double				io;
+	int					processed;
+	int					failures;
+	int					degraded;		// segmented at less than SEGMENT_EXACT quality
+
+	BatchTotals() : io(0), processed(0), failures(0), degraded(0) {}
+};
+
+//=================================================================================
+///	ReportWriteFailures
+///
+///	Prints the images that could not be written and counts each input with
+///	failed writes once.
+//=================================================================================
+static void ReportWriteFailures(ImageWriterPool& writer, BatchTotals& totals)
+{
+	vector<ImageWriteFailure> failures;
+	writer.TakeFailures(failures);
+	lock_guard<mutex> lk(totals.lock);
+	for( size_t f = 0; f < failures.size(); f++ )
+	{
+		cerr << failures[f].path << ": cannot write image" << endl;
+		bool counted(false);
+		for( size_t g = 0; g < f; g++ )
+		{
+			if( failures[g].source == failures[f].source ) counted = true;
+		}
+		if( !counted ) totals.failures++;
+	}
+}
+
+//=================================================================================
+///	ReportImage
+///
+///	Prints the timing line of one image and adds it to the totals.
+//=================================================================================
+static void ReportImage(
+	const string&			filename,
+	const SaliencyResult&	result,
+	const int&				threads,
+	const double&			io,
+	const bool&				quiet,
+	BatchTotals&			totals)
+{
+	lock_guard<mutex> lk(totals.lock);
+	const SaliencyTimings& t = result.timings;
+	if( !quiet )
+	{
+		printf("%s %dx%d threads=%d regions=%d boxes=%d lab=%.1fms saliency=%.1fms segment=%.1fms "
+			"regions=%.1fms select=%.1fms contours=%.1fms boxes=%.1fms total=%.1fms io=%.1fms",
+			filename.c_str(), result.width, result.height, threads, result.numlabels, int(result.boxes.size()),
+			t.lab, t.saliency, t.segmentation, t.regions, t.selection, t.contours, t.boxes, t.total, io);
+		if( t.cache > 0 )
+		{
+			printf(" cache=%.1fms cached=%s%s", t.cache,
+				(result.cached & CACHED_SALIENCY) ? "S" : "-", (result.cached & CACHED_SEGMENTATION) ? "M" : "-");
+		}
+		if( result.IsDegraded() ) printf(" quality=%s", SaliencyPipeline::QualityName(result.quality));
+		printf("\n");
+		fflush(stdout);
+	}
+	totals.sum.lab			+= t.lab;
+	totals.sum.saliency		+= t.saliency;
+	totals.sum.segmentation	+= t.segmentation;
+	totals.sum.regions		+= t.regions;
+	totals.sum.selection	+= t.selection;
+	totals.sum.contours		+= t.contours;
+	totals.sum.boxes		+= t.boxes;
+	totals.sum.total		+= t.total;
+	totals.io				+= io;
+	totals.processed++;
+	if( result.IsDegraded() ) totals.degraded++;
+}
+
+//=================================================================================
+///	ProcessImage
+///
+///	Loads one image, runs the pipeline on it and queues the selected outputs.
+//=================================================================================
+static void ProcessImage(
+	const string&			filename,
+	const SaliencyParams&	params,
+	const string&			saveLocation,
+	const vector<OutputSpec>&	outputs,
+	ImageWriterPool&		writer,
+	const bool&				saveResult,
+	StageCache*				cache,
+	const DecodeSpec&		decode,
+	const bool&				quiet,
+	BatchTotals&			totals)
+{
+	CliClock::time_point iostart = CliClock::now();
+	cv::Mat mat;
+	ImageView img;
+	if( !LoadImage(filename, mat, img, decode.ScaleFor(filename)) )
+	{
+		lock_guard<mutex> lk(totals.lock);
+		cerr << filename << ": cannot read image" << endl;
+		totals.failures++;
+		return;
+	}
+	double io = ElapsedMs(iostart);
+
+	SaliencyPipeline pipeline(params);
+	pipeline.SetCache(cache);
+	SaliencyResult result;
+	pipeline.Process(img, result);
+
+	iostart = CliClock::now();
+	string base = saveLocation + BaseName(filename);
+	if( saveResult && !ResultFile::Write(base + ".srd", img, result, filename, params.salientFactor) )
+	{
+		lock_guard<mutex> lk(totals.lock);
+		cerr << base << ".srd: cannot write result file" << endl;
+		totals.failures++;
+	}
+	writer.SubmitResult(base, filename, result, outputs);
+	io += ElapsedMs(iostart);
+
+	ReportImage(filename, result, params.threads, io, quiet, totals);
+}
+
+//=================================================================================
+///	ConvertResult
+///
+///	Renders the selected outputs from a result file. The object and box
+///	images also need the input image, which is read from the path stored in
+///	the file, at the scale the result was made at; they are skipped if it
+///	cannot be read.
+//=================================================================================
+static void ConvertResult(
+	const string&			filename,
+	const SaliencyParams&	params,
+	const string&			saveLocation,
+	const vector<OutputSpec>&	outputs,
+	ImageWriterPool&		writer,
+	const bool&				quiet,
+	BatchTotals&			totals)
+{
+	ResultFileReader reader;
+	if( !reader.Open(filename) )
+	{
+		cerr << filename << ": " << reader.GetError() << endl;
+		totals.failures++;
+		return;
+	}
+
+	vector<UINT> img(0);
+	if( params.outputs & (OUTPUT_OBJECT | OUTPUT_OBJECT_BORDERED | OUTPUT_BOXES) )
+	{
+		string source = reader.GetSource();
+		int width(0);
+		int height(0);
+		int scale(1);
+		if( BatchScheduler::PeekImageSize(source, width, height) )
+		{
+			while( scale < 8 && (width + scale - 1)/scale > reader.GetWidth() ) scale *= 2;
+		}
+		if( !LoadImage(source, img, width, height, scale) || width != reader.GetWidth() || height != reader.GetHeight() )
+		{
+			cerr << filename << ": cannot read the input image " << source << ", object and box images skipped" << endl;
+			img.clear();
+		}
+	}
+
+	SaliencyResult result;
+	if( !reader.Render(img, params, result) )
+	{
+		cerr << filename << ": label out of range" << endl;
+		totals.failures++;
+		return;
+	}
+	if( !quiet )
+	{
+		printf("%s %dx%d regions=%d boxes=%d converted\n",
+			filename.c_str(), result.width, result.height, result.numlabels, int(result.boxes.size()));
+	}
+	writer.SubmitResult(saveLocation + BaseName(filename), filename, result, outputs);
+	totals.processed++;
+}
+
+//=================================================================================
+///	SweepImage
+///
+///	Runs a parameter sweep on one image and prints its table. unshared is
+///	what the rows would have cost with a full segmentation each.
+//=================================================================================
+static void SweepImage(
+	const string&			filename,
+	const SweepGrid&		grid,
+	const int&				threads,
+	const DecodeSpec&		decode,
+	const bool&				quiet,
+	BatchTotals&			totals)
+{
+	vector<UINT> img(0);
+	int width(0);
+	int height(0);
+	if( !LoadImage(filename, img, width, height, decode.ScaleFor(filename)) )
+	{
+		cerr << filename << ": cannot read image" << endl;
+		totals.failures++;
+		return;
+	}
+
+	ParameterSweep sweep;
+	vector<SweepEntry> table;
+	SweepTimings t;
+	sweep.Run(img, width, height, grid, table, t, threads);
+
+	double unshared(0);
+	for( size_t r = 0; r < table.size(); r++ )
+	{
+		const SweepEntry& e = table[r];
+		unshared += t.lab + e.filterMs + e.fuseMs;
+		if( quiet ) continue;
+		printf("%s sigmaS=%d sigmaR=%g minRegion=%d regions=%d filtered=%d filter=%.1fms fuse=%.1fms\n",
+			filename.c_str(), e.sigmaS, e.sigmaR, e.minRegion, e.numlabels, e.filteredRegions, e.filterMs, e.fuseMs);
+	}
+	printf("%s %dx%d settings=%d lab=%.1fms filter=%.1fms fuse=%.1fms total=%.1fms unshared=%.1fms\n",
+		filename.c_str(), width, height, int(table.size()), t.lab, t.filter, t.fuse, t.total, unshared);
+	fflush(stdout);
+	totals.processed++;
+}
+
+//=================================================================================
+///	ParseStages
+///
+///	"decode,saliency,segmentation,encode" worker counts, e.g. 1,1,3,1.
+//=================================================================================
+static bool ParseStages(const string& list, int workers[STAGE_COUNT])
+{
+	int n = sscanf(list.c_str(), "%d,%d,%d,%d", &workers[0], &workers[1], &workers[2], &workers[3]);
+	if( n != STAGE_COUNT ) return false;
+	for( int s = 0; s < STAGE_COUNT; s++ )
+	{
+		if( workers[s] < 1 ) return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	SaliencyParams params;
+	string saveLocation = "./data/";
+	string format = "jpg";
+	string outputList = "all";
+	int quality(-1);
+	int writers(2);
+	bool quiet(false);
+	bool staged(false);
+	bool saveResult(false);
+	bool sweep(false);
+	SweepGrid grid;
+	int stageWorkers[STAGE_COUNT] = {1, 1, 1, 1};
+	int workers(0);
+	size_t memoryMB(2048);
+	string cacheFolder;
+	size_t cacheMB(1024);
+	string traceFile;
+	DecodeSpec decode;
+	vector<string> picvec(0);
+
+	for( int a = 1; a < argc; a++ )
+	{
+		string arg(argv[a]);
+		bool hasvalue = (a + 1 < argc);
+		if( arg == "-h" || arg == "--help" )
+		{
+			PrintUsage(argv[0]);
+			return 0;
+		}
+		else if( arg == "-q" )					quiet = true;
+		else if( arg == "--save-result" )		saveResult = true;
+		else if( arg == "-o" && hasvalue )		saveLocation = argv[++a];
+		else if( arg == "-s" && hasvalue )		params.sigmaS = atoi(argv[++a]);
+		else if( arg == "-r" && hasvalue )		params.sigmaR = (float)atof(argv[++a]);
+		else if( arg == "-m" && hasvalue )		params.minRegion = atoi(argv[++a]);
+		else if( arg == "--budget" && hasvalue )	params.segmentBudget = atof(argv[++a]);
+		else if( arg == "-f" && hasvalue )		format = argv[++a];
+		else if( arg == "--quality" && hasvalue )	quality = atoi(argv[++a]);
+		else if( arg == "-w" && hasvalue )		writers = atoi(argv[++a]);
+		else if( arg == "--salient" && hasvalue )	params.salientFactor = atof(argv[++a]);
+		else if( arg == "--box-area" && hasvalue )
+		{
+			if( 2 != sscanf(argv[++a], "%lf,%lf", &params.minBoxArea, &params.maxBoxArea) )
+			{
+				cerr << "--box-area expects two fractions, e.g. 0.005,0.5" << endl;
+				return 2;
+			}
+		}
+		else if( arg == "-j" && hasvalue )		workers = atoi(argv[++a]);
+		else if( arg == "--memory" && hasvalue )	memoryMB = (size_t)atol(argv[++a]);
+		else if( arg == "--cache" && hasvalue )		cacheFolder = argv[++a];
+		else if( arg == "--cache-size" && hasvalue )	cacheMB = (size_t)atol(argv[++a]);
+		else if( arg == "--trace" && hasvalue )		traceFile = argv[++a];
+		else if( arg == "--decode-scale" && hasvalue )	decode.scale = atoi(argv[++a]);
+		else if( arg == "--preview" && hasvalue )	decode.previewSide = atoi(argv[++a]);
+		else if( arg == "--stages" && hasvalue )
+		{
+			staged = true;
+			if( !ParseStages(argv[++a], stageWorkers) )
+			{
+				cerr << "--stages expects four positive worker counts, e.g. 1,1,3,1" << endl;
+				return 2;
+			}
+		}
+		else if( arg == "--outputs" && hasvalue )	outputList = argv[++a];
+		else if( arg == "--sweep" && hasvalue )
+		{
+			sweep = true;
+			if( !ParameterSweep::ParseGrid(argv[++a], grid) )
+			{
+				cerr << "--sweep expects sigmaS:sigmaR:minRegion lists, e.g. 7:6,10,14:10,20,50" << endl;
+				return 2;
+			}
+		}
+		else if( !arg.empty() && arg[0] == '-' && arg != "-" )
+		{
+			cerr << "unknown or incomplete option " << arg << endl;
+			PrintUsage(argv[0]);
+			return 2;
+		}
+		else CollectInputs(arg, picvec);
+	}
+
+	if( picvec.empty() )
+	{
+		PrintUsage(argv[0]);
+		return 2;
+	}
+	if( params.sigmaS <= 0 || params.sigmaR <= 0 || params.minRegion < 0 )
+	{
+		cerr << "sigmaS and sigmaR must be positive, minRegion non-negative" << endl;
+		return 2;
+	}
+	if( params.segmentBudget < 0 )
+	{
+		cerr << "the segmentation budget must be non-negative" << endl;
+		return 2;
+	}
+	if( (decode.scale != 1 && decode.scale != 2 && decode.scale != 4 && decode.scale != 8) || decode.previewSide < 0 )
+	{
+		cerr << "the decode scale must be 1, 2, 4 or 8 and the preview size non-negative" << endl;
+		return 2;
+	}
+	ImageFormat defaultFormat;
+	if( !ImageWriterPool::ParseFormat(format, defaultFormat) )
+	{
+		cerr << "unsupported output format " << format << endl;
+		return 2;
+	}
+	if( quality < -1 || quality > 100 || writers < 0 )
+	{
+		cerr << "quality must be in 0-100 and the writer count non-negative" << endl;
+		return 2;
+	}
+	vector<OutputSpec> outputs;
+	if( !ImageWriterPool::ParseOutputSpecs(outputList, defaultFormat, quality, outputs) )
+	{
+		cerr << "unknown output or format, or quality out of range for the format, in " << outputList << endl;
+		PrintUsage(argv[0]);
+		return 2;
+	}
+	params.outputs = ImageWriterPool::OutputMask(outputs);      // nothing else is rendered
+	char last = saveLocation[saveLocation.size()-1];
+	if( last != '/' && last != '\\' ) saveLocation += '/';
+
+	StageCache cache;
+	if( !cacheFolder.empty() && !cache.Open(cacheFolder, uint64_t(cacheMB) << 20) )
+	{
+		cerr << "cannot use cache folder " << cacheFolder << endl;
+		return 2;
+	}
+	StageCache* cachePtr = cache.IsOpen() ? &cache : NULL;
+	if( !traceFile.empty() )
+	{
+		Trace::Enable(true);
+		Trace::SetThreadName("main");
+	}
+
+	BatchTotals totals;
+
+	//------------------------------------------------------
+	// result files are only converted back to images
+	//------------------------------------------------------
+	vector<string> results(0);
+	for( size_t k = 0; k < picvec.size(); )
+	{
+		if( !IsResultFile(picvec[k]) ) k++;
+		else
+		{
+			results.push_back(picvec[k]);
+			picvec.erase(picvec.begin() + k);
+		}
+	}
+	if( !results.empty() )
+	{
+		ImageWriterPool writer([](int, const ImageWriteRequest& request) { return EncodeImage(request); }, writers);
+		for( size_t k = 0; k < results.size(); k++ )
+		{
+			ConvertResult(results[k], params, saveLocation, outputs, writer, quiet, totals);
+		}
+		writer.Flush();
+		ReportWriteFailures(writer, totals);
+	}
+
+	if( sweep )
+	{
+		//------------------------------------------------------
+		// one image at a time, its settings spread over threads
+		//------------------------------------------------------
+		int threads = workers > 0 ? workers : int(thread::hardware_concurrency());
+		if( threads < 1 ) threads = 1;
+		for( size_t k = 0; k < picvec.size(); k++ ) SweepImage(picvec[k], grid, threads, decode, quiet, totals);
+	}
+	else if( staged && !picvec.empty() )
+	{
+		//------------------------------------------------------
+		// decode -> saliency -> segmentation -> encode stages
+		//------------------------------------------------------
+		StagedPipeline::IoFunc decoder = [&](StageWork& work)
+		{
+			return LoadImage(work.filename, work.img, work.width, work.height, decode.ScaleFor(work.filename));
+		};
+		// the encode stage is already a pool of writer threads
+		StagedPipeline::IoFunc encoder = [&](StageWork& work)
+		{
+			vector<ImageWriteRequest> requests;
+			string base = saveLocation + BaseName(work.filename);
+			ImageWriterPool::MakeRequests(base, work.filename, work.result, outputs, requests);
+			bool ok(true);
+			if( saveResult && !ResultFile::Write(base + ".srd", work.img, work.result, work.filename, params.salientFactor) )
+			{
+				work.error += base + ".srd: cannot write result file\n";
+				ok = false;
+			}
+			for( size_t r = 0; r < requests.size(); r++ )
+			{
+				if( EncodeImage(requests[r]) ) continue;
+				work.error += requests[r].path + ": cannot write image\n";
+				ok = false;
+			}
+			return ok;
+		};
+		StagedPipeline::DoneFunc done = [&](StageWork& work)
+		{
+			if( work.failed )
+			{
+				lock_guard<mutex> lk(totals.lock);
+				cerr << work.filename << ": " << work.error << endl;
+				totals.failures++;
+				if( work.result.labels.empty() ) return;
+			}
+			ReportImage(work.filename, work.result, 1, work.decodeMs + work.encodeMs, quiet, totals);
+		};
+
+		StagedPipeline pipeline(params, decoder, encoder);
+		pipeline.SetCache(cachePtr);
+		for( int s = 0; s < STAGE_COUNT; s++ ) pipeline.SetWorkers(PipelineStage(s), stageWorkers[s]);
+		vector<StageStats> stagestats;
+		double wall(0);
+		pipeline.Run(picvec, done, stagestats, wall);
+
+		for( int s = 0; s < STAGE_COUNT; s++ )
+		{
+			const StageStats& st = stagestats[s];
+			printf("stage=%s workers=%d items=%d busy=%.1fms utilization=%.0f%% queue=%lu max_depth=%lu mean_depth=%.2f\n",
+				st.name, st.workers, st.items, st.busyMs, 100.0*st.utilization,
+				(unsigned long)st.queueCapacity, (unsigned long)st.maxQueueDepth, st.meanQueueDepth);
+		}
+		printf("wall=%.1fms\n", wall);
+	}
+	else if( !picvec.empty() )
+	{
+		ImageWriterPool writer([](int, const ImageWriteRequest& request) { return EncodeImage(request); }, writers);
+		vector<BatchJob> jobs(picvec.size());
+		for( size_t k = 0; k < picvec.size(); k++ )
+		{
+			BatchScheduler::PeekImageSize(picvec[k], jobs[k].width, jobs[k].height);
+			string filename = picvec[k];
+			// memory is estimated at the size the image is decoded at
+			int scale = decode.ScaleFor(filename);
+			jobs[k].width	= (jobs[k].width + scale - 1)/scale;
+			jobs[k].height	= (jobs[k].height + scale - 1)/scale;
+			jobs[k].run = [=, &outputs, &writer, &totals](int threads)
+			{
+				SaliencyParams p(params);
+				p.threads = threads;
+				ProcessImage(filename, p, saveLocation, outputs, writer, saveResult, cachePtr, decode, quiet, totals);
+			};
+		}
+
+		BatchScheduler scheduler(workers, memoryMB << 20, params);
+		BatchStats stats;
+		scheduler.Run(jobs, stats);
+		writer.Flush();
+		ReportWriteFailures(writer, totals);
+		ImageWriterStats ws = writer.GetStats();
+		printf("writers=%d written=%d failed=%d encode=%.1fms blocked=%.1fms max_pending=%lu\n",
+			writer.GetThreads(), ws.written, ws.failed, ws.encodeMs, ws.blockedMs, (unsigned long)ws.maxPending);
+		printf("workers=%d budget=%luMB wall=%.1fms max_concurrent=%d exclusive=%d peak_estimate=%.1fMB\n",
+			scheduler.GetWorkers(), (unsigned long)memoryMB, stats.elapsedMs, stats.maxConcurrent,
+			stats.exclusive, stats.peakReserved/1048576.0);
+	}
+
+	const SaliencyTimings& sum = totals.sum;
+	printf("processed=%d failed=%d lab=%.1fms saliency=%.1fms segment=%.1fms regions=%.1fms select=%.1fms "
+		"contours=%.1fms boxes=%.1fms total=%.1fms io=%.1fms\n",
+		totals.processed, totals.failures, sum.lab, sum.saliency, sum.segmentation, sum.regions, sum.selection,
+		sum.contours, sum.boxes, sum.total, totals.io);
+	if( params.segmentBudget > 0 ) printf("budget=%.1fms degraded=%d\n", params.segmentBudget, totals.degraded);
+	if( cachePtr )
+	{
+		StageCacheStats cs = cache.GetStats();
+		printf("cache hits=%d misses=%d stores=%d evictions=%d entries=%d size=%.1fMB\n",
+			cs.hits, cs.misses, cs.stores, cs.evictions, cs.entries, double(cs.bytes)/(1 << 20));
+	}
+	if( !traceFile.empty() )
+	{
+		if( Trace::WriteChromeJson(traceFile) ) printf("trace=%s spans=%lu\n", traceFile.c_str(), (unsigned long)Trace::GetSpanCount());
+		else
+		{
+			cerr << "cannot write trace " << traceFile << endl;
+			totals.failures++;
+		}
+	}
+	return totals.failures ? 1 : 0;
+}
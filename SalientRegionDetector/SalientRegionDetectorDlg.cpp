@@ -31,8 +31,10 @@
 #include "SalientRegionDetector.h"
 #include "SalientRegionDetectorDlg.h"
 #include "PictureHandler.h"
-#include "Saliency.h"
-#include "MeanShiftCode/msImageProcessor.h"
+#include "SaliencyPipeline.h"
+#include "BatchScheduler.h"
+#include "ImageWriterPool.h"
+#include "Trace.h"
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 #include <iostream>
@@ -143,9 +145,11 @@ void CSalientRegionDetectorDlg::GetPictures(vector<string>& picvec)
 
 	//cfd.PostMessage(WM_COMMAND, 40964, NULL);
 	
+	// ѡʱļд2048ַֻʮļ
+	const int maxFileChars = 65536;
 	CString strFileNames;
-	cfd.m_ofn.lpstrFile = strFileNames.GetBuffer(2048);
-	cfd.m_ofn.nMaxFile = 2048;
+	cfd.m_ofn.lpstrFile = strFileNames.GetBuffer(maxFileChars);
+	cfd.m_ofn.nMaxFile = maxFileChars;
 
 	BOOL bResult = cfd.DoModal() == IDOK ? TRUE : FALSE;
 	strFileNames.ReleaseBuffer();
@@ -193,297 +197,6 @@ bool CSalientRegionDetectorDlg::BrowseForFolder(string& folderpath)
 	return true;
 }
 
-//===========================================================================
-///	DoMeanShiftSegmentation   оֵƯƷָ
-//===========================================================================
-void CSalientRegionDetectorDlg::DoMeanShiftSegmentation(
-	const vector<UINT>&						inputImg,
-	const int&								width,
-	const int&								height,
-	vector<UINT>&							segimg,
-	const int&								sigmaS,
-	const float&							sigmaR,
-	const int&								minRegion,
-	vector<int>&							labels,
-	int&									numlabels)
-{
-	int sz = width*height;
-	BYTE* bytebuff = new BYTE[sz*3];
-	{int i(0);
-	for( int p = 0; p < sz; p++ )
-	{
-		bytebuff[i+0] = inputImg[p] >> 16 & 0xff;       // 2ֽڽȡ
-		bytebuff[i+1] = inputImg[p] >>  8 & 0xff;       // 1ֽڽȡ
-		bytebuff[i+2] = inputImg[p]       & 0xff;       // ֱ     ȡ
-		i += 3;                                         // 3ֽ3ֽλ
-	}}
-	msImageProcessor mss;
-	mss.DefineImage(bytebuff, COLOR, height, width);		
-	mss.Segment(sigmaS, sigmaR, minRegion, HIGH_SPEEDUP);
-	mss.GetResults(bytebuff);
-
-	int* p_labels = new int[sz];
-	numlabels = mss.GetLabels(p_labels);
-	labels.resize(sz);
-	for( int n = 0; n < sz; n++ ) labels[n] = p_labels[n];
-	if(p_labels) delete [] p_labels;
-
-	segimg.resize(sz);
-	int bsz = sz*3;
-	{int i(0);
-	for( int p = 0; p < bsz; p += 3 )
-	{
-		segimg[i] = bytebuff[p] << 16 | bytebuff[p+1] << 8 | bytebuff[p+2];
-		i++;
-	}}
-	if(bytebuff) delete [] bytebuff;
-}
-
-//=================================================================================
-/// DrawContoursAroundSegments
-//=================================================================================
-void CSalientRegionDetectorDlg::DrawContoursAroundSegments(
-	vector<UINT>&							segmentedImage,
-	const int&								width,
-	const int&								height,
-	const UINT&								color)
-{
-	// Pixel offsets around the centre pixels starting from left, going clockwise
-	const int dx8[8] = {-1, -1,  0,  1, 1, 1, 0, -1};
-	const int dy8[8] = { 0, -1, -1, -1, 0, 1, 1,  1};
-
-	int sz = segmentedImage.size();
-	vector<bool> istaken(sz, false);
-	int mainindex(0);
-	for( int j = 0; j < height; j++ )
-	{
-		for( int k = 0; k < width; k++ )
-		{
-			int np(0);
-			for( int i = 0; i < 8; i++ )
-			{
-				int x = k + dx8[i];
-				int y = j + dy8[i];
-
-				if( (x >= 0 && x < width) && (y >= 0 && y < height) )
-				{
-					int index = y*width + x;
-					if( false == istaken[index] )
-					{
-						if( (int)segmentedImage[mainindex] != (int)segmentedImage[index] ) np++;
-					}
-				}
-			}
-			if( np > 2 )//1 for thicker lines and 2 for thinner lines
-			{
-				segmentedImage[j*width + k] = color;
-				istaken[mainindex] = true;
-			}
-			mainindex++;
-		}
-	}
-}
-
-
-//=================================================================================
-// ChooseSalientPixelsToShow
-//=================================================================================
-void CSalientRegionDetectorDlg::ChooseSalientPixelsToShow(
-	const vector<double>&					salmap,
-	const int&								width,
-	const int&								height,
-	const vector<int>&						labels,
-	const int&								numlabels,
-	vector<bool>&							choose)
-{
-	int sz = width*height;
-	//----------------------------------
-	// Find average saliency per segment
-	//----------------------------------
-	vector<double> salperseg(numlabels,0);
-	vector<int> segsz(numlabels,0);
-	vector<bool> touchborders(numlabels, false);
-	{int i(0);
-	for( int j = 0; j < height; j++ )
-	{
-		for( int k = 0; k < width; k++ )
-		{
-			salperseg[labels[i]] += salmap[i];
-			segsz[labels[i]]++;
-			
-			if(false == touchborders[labels[i]] && (j == height-1 || j == 0 || k == width-1 || k == 0) )
-			{
-				touchborders[labels[i]] = true;
-			}
-			i++;
-		}
-	}}
-
-	double avgimgsal(0);
-	{for( int n = 0; n < numlabels; n++ )
-	{
-		if(true == touchborders[n])
-		{
-			salperseg[n] = 0;
-		}
-		else
-		{
-			avgimgsal += salperseg[n];
-			salperseg[n] /= segsz[n];
-		}
-	}}
-
-	//--------------------------------------
-	// Compute average saliency of the image
-	//--------------------------------------
-	avgimgsal /= sz;
-
-
-	//----------------------------------------------------------------------------
-	// Choose segments that have average saliency twice the average image saliency
-	//----------------------------------------------------------------------------
-	vector<bool> segtochoose(numlabels, false);
-	{for( int n = 0; n < numlabels; n++ )
-	{
-		if( salperseg[n] > (avgimgsal+avgimgsal) ) segtochoose[n] = true;
-	}}
-
-	choose.resize(sz, false);
-	bool atleastonesegmentchosent(false);
-	{for( int s = 0; s < sz; s++ )
-	{
-		//if( salperseg[labels[s]] > (avgsal+avgsal) )
-		//if(true == segtochoose[labels[s]])
-		{
-			choose[s] = segtochoose[labels[s]];
-			atleastonesegmentchosent = choose[s];
-		}
-	}}
-
-	//----------------------------------------------------------------------------
-	// If not a single segment has been chosen, then take the brightest one available
-	//----------------------------------------------------------------------------
-	if( false == atleastonesegmentchosent )
-	{
-		int maxsalindex(-1);
-		double maxsal(DBL_MIN);
-		for( int n = 0; n < numlabels; n++ )
-		{
-			if( maxsal < salperseg[n] )
-			{
-				maxsal = salperseg[n];
-				maxsalindex = n;
-			}
-		}
-		for( int s = 0; s < sz; s++ )
-		{
-			if(maxsalindex == labels[s]) choose[s] = true;
-		}
-	}
-}
-
-//===========================================================================
-///	DoMeanShiftSegmentationBasedProcessing
-/// лھֵƯƷָĴ
-///
-///	Do the segmentation of salient region based on K-Means segmentation
-/// лK-meansָָ
-//===========================================================================
-void CSalientRegionDetectorDlg::DoMeanShiftSegmentationBasedProcessing(
-	const vector<UINT>&						inputImg,
-	const int&								width,
-	const int&								height,
-	const string&							filename,
-	const vector<double>&					salmap,
-	const int&								sigmaS,
-	const float&							sigmaR,
-	const int&								minRegion,
-	vector<UINT>&							segimg,
-	vector<UINT>&							segobj,
-	vector<vector<UINT>>&                    imgclustering)
-{
-	int sz = width*height;
-	//--------------------------------------------------------------------
-	// Segment the image using mean-shift algo. Segmented image in segimg.
-	//--------------------------------------------------------------------
-	vector<int> labels(0);
-	int numlabels(0);
-	/*vector<bool> touchborders(numlabels, false);*/
-	
-	DoMeanShiftSegmentation(inputImg, width, height, segimg, sigmaS, sigmaR, minRegion, labels, numlabels);
-	//-----------------
-	// Form img cluster
-	//-----------------
-	/////////          int kmax(0);
-	/////////          for (int i = 0; i < sz; i++)
-	/////////          {
-	/////////          	if (kmax < labels[i])
-	/////////          		kmax = labels[i];
-	/////////          }
-
-
-	vector<vector<UINT>> imgclustering_(numlabels, vector<uint>(sz, 0));
-	{int i(0); 
-	int j = 0;
-	int k = 0;
-	for (j=0; j < height; j++)
-	{
-		for (k = 0; k < width; k++)
-		{
-			/*vector<int>::iterator it;
-			it = imgclustering[labels[i]].begin();
-			it = imgclustering[labels[i]].insert(it+i, 1);*/
-			imgclustering_[labels[i]][i] = 255;
-			/*if (false == touchborders[labels[i]] && (j == height - 1 || j == 0 || k == width - 1 || k == 0))
-			{
-				touchborders[labels[i]] = true;
-			}*/
-			i++;
-		}
-	}
-	}
-
-	//       ofstream Fs("D:\\test1.xls");
-	//       if (!Fs.is_open())
-	//       {
-	//       	cout << "error!" << endl;
-	//       	return;
-	//       }
-	//       
-	//       
-	//       {int ii(0);
-	//       
-	//       for (int i = 0; i<height; i++)
-	//       {
-	//       	for (int j = 0; j<width; j++)
-	//       	{
-	//       		Fs << imgclustering_[2][ii] << '\t';
-	//       	}
-	//       	Fs << endl;
-	//       }
-	//       
-	//       }
-	//       Fs.close();
-	imgclustering = imgclustering_;
-	//-----------------
-	// Choose segments
-	//-----------------
-	vector<bool> choose(0);
-	ChooseSalientPixelsToShow(salmap, width, height, labels, numlabels, choose);
-	//-----------------------------------------------------------------------------
-	// Take up only those pixels that are allowed by finalPixelMap
-	//-----------------------------------------------------------------------------
-	segobj.resize(sz, 0);
-	for( int p = 0; p < sz; p++ )
-	{
-		if( choose[p] )
-		{
-			segobj[p] = inputImg[p];
-		}
-	}
-}
-
-
 //===========================================================================
 ///	OnBnClickedButtonDetectSaliency
 ///
@@ -491,7 +204,6 @@ void CSalientRegionDetectorDlg::DoMeanShiftSegmentationBasedProcessing(
 //===========================================================================
 void CSalientRegionDetectorDlg::OnBnClickedButtonDetectSaliency()
 {
-	PictureHandler picHand;
 	vector<string> picvec(0);
 	picvec.resize(0);
 	string saveLocation = "./data/";                             // ע⣺һԼǰdataļУᱨ
@@ -501,94 +213,78 @@ void CSalientRegionDetectorDlg::OnBnClickedButtonDetectSaliency()
 
 	int numPics( picvec.size() );                                // ͼͼ
 
+	// SRD_TRACEΪļ·ʱ¼׶Ρ̵߳ĺʱ󱣴ΪChrome trace_event JSON
+	const char* traceFile = getenv("SRD_TRACE");
+	if( traceFile ) Trace::Enable(true);
+
+	//  SaliencyPipeline ʵ֣а汾ãԻֻͼͱ
+	SaliencyParams params;                                       // sigmaS = 7, sigmaR = 10, minRegion = 20
+
+	// 潻̨̣߳ÿ߳ԼPictureHandlerCLSIDֻһ
+	const int writerThreads = 2;
+	vector<PictureHandler*> writers(writerThreads);
+	for( int w = 0; w < writerThreads; w++ ) writers[w] = new PictureHandler;
+	ImageWriterPool writerPool([&](int worker, const ImageWriteRequest& request)
+	{
+		int format = (IMAGE_BMP == request.format) ? 0 : (IMAGE_PNG == request.format) ? 2 : 1;
+		return writers[worker]->SaveImage(request.img, request.width, request.height, request.path, format, request.quality);
+	}, writerThreads);
+
+	vector<OutputSpec> outputs;                                  // ǰ浽dataļУ̿ͼԭͼԱ
+	outputs.push_back(OutputSpec(OUTPUT_SALMAP));
+	outputs.push_back(OutputSpec(OUTPUT_MEANSHIFT));
+	outputs.push_back(OutputSpec(OUTPUT_OBJECT));
+	outputs.push_back(OutputSpec(OUTPUT_MEANSHIFT_BORDERED));
+	outputs.push_back(OutputSpec(OUTPUT_OBJECT_BORDERED));
+	params.outputs = ImageWriterPool::OutputMask(outputs) | OUTPUT_BOXES;
+
+	// ͼдͼСڴ棬ԤͬʱСͼͼʹȫ߳
+	vector<BatchJob> jobs(numPics);
 	for( int k = 0; k < numPics; k++ )
 	{
-		vector<UINT> img(0);// or UINT* imgBuffer;
-		int width(0);
-		int height(0);
-
-		picHand.GetPictureBuffer( picvec[k], img, width, height );   // ƲȡͼϢ
-		int sz = width*height;                                       // size: ص
-
-		Saliency sal;
-		vector<double> salmap(0);                                    // ʼͼ
-		sal.GetSaliencyMap(img, width, height, salmap, true);        // ԭͼ, , ߶, ͼ, йһ
-		
-		vector<UINT> outimg(sz);                                     // 㲢ͼoutimg
-		for( int i = 0; i < sz; i++ )
+		BatchScheduler::PeekImageSize(picvec[k], jobs[k].width, jobs[k].height);
+		string filename = picvec[k];
+		jobs[k].run = [=, &writerPool](int threads)
 		{
-			int val = salmap[i] + 0.5;                                    // 
-			outimg[i] = val << 16 | val << 8 | val;                       // ƴݣλ16λλ8λԭͼ
-		}
-		picHand.SavePicture(outimg, width, height, picvec[k], saveLocation, 1, "_1_SalMap");// 0 is for BMP and 1 for JPEG)
-		
-		//if(m_segmentationflag)          // ע͵жϣΪ˲checkҲֵܼƯ
-		//{
-			vector<UINT> segimg, segobj;
-			vector<vector<UINT>> imgclustering;
-			DoMeanShiftSegmentationBasedProcessing(img, width, height, picvec[k], salmap, 7, 10, 20, segimg, segobj, imgclustering);
-			                                  // ͼߣļͼsigmaSsigmaRminRegion
-			cout << imgclustering[0][2] << endl;            // ʾõĸ
-			vector<UINT> segimgbordered = segimg;
-			vector<UINT> segobjbordered = segobj;
-			
-			
-			DrawContoursAroundSegments(segimgbordered, width, height, 0xffffff);       //ڷָ߽续ߣʾ
-			DrawContoursAroundSegments(segobjbordered, width, height, 0xffffff);
-			picHand.SavePicture(segimg, width, height, picvec[k], saveLocation, 1, "_2_MeanShift");        // ֵƯͼ
-			picHand.SavePicture(segobj, width, height, picvec[k], saveLocation, 1, "_3_SalientObject");    // Ŀͼ
-			picHand.SavePicture(segimgbordered, width, height, picvec[k], saveLocation, 1, "_2_MeanShiftbordered");        // ֵƯͼ
-			picHand.SavePicture(segobjbordered, width, height, picvec[k], saveLocation, 1, "_3_SalientObjectbordered");    // Ŀͼ
-		//}
-
-
-
-		// ̿
-		namedWindow("test");
-		Mat dest2 = Mat(height, width, CV_8UC4, img.data());               // ʼ̿ͼ
-
-		for (int flag = 0; flag < (imgclustering.size()-1); flag++)      // flagʾ̿
-		{
-			vector<cv::Point> points;          // ʼ㼯
-			int i = 0;
-			for (i = 0; i < sz;)
-		{   
-			int j = 0;
-			int k = 0;
-			  for (j = 0; j < height; j++)
-			  {
-				for (k = 0; k < width; k++)
-				{
-					cv::Point point;           // 
-					if (imgclustering[flag][i]>0)       // imgclusteringʾͼ[][ص]
-					{
-						point.x = k;
-						point.y = j;
-						points.push_back(point);
-					}
-					i++;
-				 }
-			  }
-			}
-			cv::Rect box = boundingRect(points);
-			if (points.size()>(0.005*sz) && points.size()<(0.5*sz))       // жϵռصĶŻѡ̿
-			{   // Ľ˵Ľ˿еʤСĿ͹Ŀʾ
-				rectangle(dest2, box.tl(), box.br(), Scalar(0, 255, 0));
-				imshow("test", dest2);                                   // ̿
-				waitKey(1);
+			PictureHandler picHand;
+			ImageView img;
+			{
+				TRACE_SPAN(span, "decode");
+				span.SetDetail(filename);
+				picHand.OpenPicture( filename, img );                    // 룬ֱʹGDI+أ
 			}
-				
-		}
-		string path,tempStr;                                       // 챣·뱣
-		tempStr = picvec[k];
-		tempStr.erase(tempStr.end() - 4, tempStr.end());    // ȡļ
-		path = tempStr+ "_4_LvKuang.jpg";
-		//char* filename;
-		//strcpy(filename, path.c_str());
-		imwrite(path, dest2);                                        // ̿ͼ
-	
-		
-
+			const int width(img.width);
+			const int height(img.height);
+
+			SaliencyParams p(params);
+			p.threads = threads;
+			SaliencyPipeline pipeline(p);
+			SaliencyResult result;
+			pipeline.Process(img, result);                              // ͼֵƯơĿꡢ߽̿
+			picHand.ClosePicture();
+
+			char fname[_MAX_FNAME];
+			_splitpath(filename.c_str(), NULL, NULL, fname, NULL);
+			writerPool.SubmitResult(saveLocation + fname, filename, result, outputs);  // 浽dataļУJPEG
+
+			// ̿
+			ImageWriteRequest boxes;
+			boxes.path = filename;
+			boxes.path.erase(boxes.path.end() - 4, boxes.path.end());    // ȡļ
+			boxes.path += "_4_LvKuang.jpg";                              // 챣·뱣
+			boxes.img.swap(result.boximg);
+			boxes.width = width;
+			boxes.height = height;
+			boxes.source = filename;
+			writerPool.Submit(boxes);                                    // ̿ͼ
+		};
 	}
+
+	BatchScheduler scheduler(0, size_t(1024) << 20, params);    // ȫģ1GBڴԤ
+	BatchStats stats;
+	scheduler.Run(jobs, stats);
+	writerPool.Flush();
+	for( int w = 0; w < writerThreads; w++ ) delete writers[w];
+	if( traceFile ) Trace::WriteChromeJson(traceFile);           // chrome://tracingPerfetto
 	AfxMessageBox(L"Done!", 0, 0);
 }
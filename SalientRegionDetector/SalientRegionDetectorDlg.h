@@ -68,44 +68,6 @@ private:
 	void							GetPictures(vector<string>& picvec);
 
 	bool							BrowseForFolder(string& folderpath);
-
-	void DoMeanShiftSegmentation(
-		const vector<UINT>&						inputImg,
-		const int&								width,
-		const int&								height,
-		vector<UINT>&							segimg,
-		const int&								sigmaS,
-		const float&							sigmaR,
-		const int&								minRegion,
-		vector<int>&							labels,
-		int&									numlabels);
-
-	void DrawContoursAroundSegments(
-		vector<UINT>&							segmentedImage,
-		const int&								width,
-		const int&								height,
-		const UINT&								color);
-
-	void ChooseSalientPixelsToShow(
-		const vector<double>&					salmap,
-		const int&								width,
-		const int&								height,
-		const vector<int>&						labels,
-		const int&								numlabels,
-		vector<bool>&							choose);
-
-	void DoMeanShiftSegmentationBasedProcessing(
-		const vector<UINT>&						inputImg,
-		const int&								width,
-		const int&								height,
-		const string&							filename,
-		const vector<double>&					salmap,
-		const int&								sigmaS,
-		const float&							sigmaR,
-		const int&								minRegion,
-		vector<UINT>&							segimg,
-		vector<UINT>&							segobj,
-		vector<vector<UINT>>&                   imgclustering);
 public:
 	afx_msg void OnBnClickedCheckSegmentationFlag();
 };
@@ -0,0 +1,635 @@
+// ScalingBenchmark.cpp : time and memory of each pipeline stage against image size
+//
+//===========================================================================
+// Runs the stages of the saliency pipeline on synthetic images over a
+// sweep of sizes, and reports for each stage its time and its peak
+// resident memory, and how both grow with the number of pixels, so that
+// the stage that goes superlinear first can be found before it is met on
+// a real 100 megapixel photo.
+//
+// Usage:
+//   ScalingBenchmark [options]
+//
+// The images come from MakeSyntheticImage with a fixed number of colour
+// regions (or a fixed number per megapixel), noise and texture, so only
+// the size changes along the sweep. The stages are those of
+// SaliencyPipeline run one after the other on one thread: RGB2LAB, the
+// saliency map, the mean shift segmentation, the region table, the
+// selection of the salient segments, the contours and the boxes. The mean
+// shift kernels are also listed on their own from the processor's timing
+// report, with their call counts, since TransitiveClosure and Prune are
+// the ones expected to depend on the region count rather than the size.
+//
+// The peak memory of a stage is the process high water mark over the
+// stage, reset before it where the system allows (Linux); "delta" is that
+// peak less the memory resident when the stage started, i.e. what the
+// stage itself needed. Between consecutive sizes the report gives the
+// local exponent log(t2/t1)/log(n2/n1), and at the end the exponent of a
+// least squares fit over the whole sweep: 1 is linear in the pixels.
+//===========================================================================
+
+#include "Saliency.h"
+#include "SaliencyPipeline.h"
+#include "RegionTable.h"
+#include "BoundaryMask.h"
+#include "SyntheticImage.h"
+#include "MeanShiftCode/msImageProcessor.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <chrono>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif !defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double ElapsedMs(const BenchClock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+//=================================================================================
+///	Resident memory of the process
+///
+///	ResetPeakRss returns false where the high water mark cannot be reset;
+///	PeakRss is then the peak of the whole run so far.
+//=================================================================================
+#if defined(_WIN32)
+static bool ResetPeakRss() { return false; }
+
+static size_t CurrentRss()
+{
+	PROCESS_MEMORY_COUNTERS pmc;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)) ? pmc.WorkingSetSize : 0;
+}
+
+static size_t PeakRss()
+{
+	PROCESS_MEMORY_COUNTERS pmc;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)) ? pmc.PeakWorkingSetSize : 0;
+}
+#elif defined(__linux__)
+static size_t StatusField(const char* field)
+{
+	FILE* f = fopen("/proc/self/status", "r");
+	if( NULL == f ) return 0;
+	char line[256];
+	size_t kb(0), len = strlen(field);
+	while( fgets(line, sizeof(line), f) )
+	{
+		if( 0 == strncmp(line, field, len) && line[len] == ':' )
+		{
+			kb = strtoul(line + len + 1, NULL, 10);
+			break;
+		}
+	}
+	fclose(f);
+	return kb*1024;
+}
+
+// writing 5 to clear_refs sets the high water mark to the current size
+static bool ResetPeakRss()
+{
+	FILE* f = fopen("/proc/self/clear_refs", "w");
+	if( NULL == f ) return false;
+	bool ok = fputs("5", f) >= 0;
+	return 0 == fclose(f) && ok;
+}
+
+static size_t CurrentRss()	{ return StatusField("VmRSS"); }
+static size_t PeakRss()		{ return StatusField("VmHWM"); }
+#else
+static bool ResetPeakRss() { return false; }
+
+static size_t CurrentRss() { return 0; }
+
+static size_t PeakRss()
+{
+	struct rusage usage;
+	if( getrusage(RUSAGE_SELF, &usage) ) return 0;
+#if defined(__APPLE__)
+	return size_t(usage.ru_maxrss);
+#else
+	return size_t(usage.ru_maxrss)*1024;
+#endif
+}
+#endif
+
+//=================================================================================
+///	StageResult
+///
+///	One stage at one size. Kernels of the mean shift have no memory of
+///	their own (hasMemory false).
+//=================================================================================
+struct StageResult
+{
+	string				stage;
+	bool				hasMemory;
+	int					calls;			// per sample
+	vector<double>		samples;		// milliseconds
+	size_t				peak;			// largest over the samples
+	size_t				delta;
+
+	StageResult() : hasMemory(true), calls(1), peak(0), delta(0) {}
+
+	double Median() const
+	{
+		if( samples.empty() ) return 0;
+		vector<double> sorted(samples);
+		sort(sorted.begin(), sorted.end());
+		size_t n = sorted.size();
+		return (n & 1) ? sorted[n/2] : 0.5*(sorted[n/2-1] + sorted[n/2]);
+	}
+};
+
+//=================================================================================
+///	SizeResult
+//=================================================================================
+struct SizeResult
+{
+	int					width;
+	int					height;
+	int					regions;		// generated
+	int					segments;		// left by the mean shift
+	size_t				filterBytes;	// processor memory over the filter, bucket grid included
+	vector<StageResult>	stages;
+
+	SizeResult() : width(0), height(0), regions(0), segments(0), filterBytes(0) {}
+
+	double Pixels() const { return double(width)*height; }
+
+	StageResult& Stage(const string& name)
+	{
+		for( size_t i = 0; i < stages.size(); i++ )
+		{
+			if( stages[i].stage == name ) return stages[i];
+		}
+		stages.push_back(StageResult());
+		stages.back().stage = name;
+		return stages.back();
+	}
+	const StageResult* Find(const string& name) const
+	{
+		for( size_t i = 0; i < stages.size(); i++ )
+		{
+			if( stages[i].stage == name ) return &stages[i];
+		}
+		return NULL;
+	}
+};
+
+//=================================================================================
+///	BenchOptions
+//=================================================================================
+struct BenchOptions
+{
+	vector<double>		megapixels;
+	int					aspectW;
+	int					aspectH;
+	int					regions;
+	double				density;		// regions per megapixel, 0 for a fixed count
+	double				noise;
+	double				texture;
+	unsigned int		seed;
+	int					repeat;
+	int					sigmaS;
+	float				sigmaR;
+	int					minRegion;
+	string				format;			// text, json or csv
+	string				output;			// file, empty for stdout
+	bool				peakReset;		// found out on the first stage
+
+	BenchOptions() : aspectW(4), aspectH(3), regions(64), density(0), noise(8), texture(0.25), seed(1),
+		repeat(1), sigmaS(7), sigmaR(10), minRegion(20), format("text"), peakReset(true) {}
+};
+
+//=================================================================================
+///	PrintUsage
+//=================================================================================
+static void PrintUsage(const char* prog)
+{
+	cerr << "Usage: " << prog << " [options]\n"
+		 << "Options:\n"
+		 << "  --megapixels <list>  comma separated image sizes in megapixels\n"
+		 << "                       (default 0.1,0.3,1,3,10; 30 and 100 need tens of GB)\n"
+		 << "  --aspect <W:H>       aspect ratio of the images (default 4:3)\n"
+		 << "  --regions <n>        colour regions per image (default 64)\n"
+		 << "  --region-density <n> colour regions per megapixel instead of a fixed count\n"
+		 << "  --noise <sigma>      noise per channel in grey levels (default 8)\n"
+		 << "  --texture <0..1>     texture amplitude (default 0.25)\n"
+		 << "  --seed <n>           image generator seed (default 1)\n"
+		 << "  --repeat <n>         runs per size; times are medians (default 1)\n"
+		 << "  -s <sigmaS> -r <sigmaR> -m <minRegion>  mean shift settings (7, 10, 20)\n"
+		 << "  --format <text|json|csv>  report format (default text)\n"
+		 << "  -o <file>            write the report to file instead of stdout\n";
+}
+
+//=================================================================================
+///	SplitList
+//=================================================================================
+static vector<string> SplitList(const string& text)
+{
+	vector<string> items;
+	stringstream ss(text);
+	string item;
+	while( getline(ss, item, ',') )
+	{
+		if( !item.empty() ) items.push_back(item);
+	}
+	return items;
+}
+
+//=================================================================================
+///	MeasureStage
+///
+///	Runs body once as a sample of stage, with the high water mark reset
+///	before it.
+//=================================================================================
+static void MeasureStage(BenchOptions& opt, SizeResult& size, const string& stage, const function<void()>& body)
+{
+	if( opt.peakReset ) opt.peakReset = ResetPeakRss();
+	size_t before = CurrentRss();
+	BenchClock::time_point start = BenchClock::now();
+	body();
+	double ms = ElapsedMs(start);
+	size_t peak = PeakRss();
+
+	StageResult& r = size.Stage(stage);
+	r.samples.push_back(ms);
+	r.peak	= max(r.peak, peak);
+	r.delta	= max(r.delta, peak > before ? peak - before : size_t(0));
+}
+
+//=================================================================================
+///	BenchSize
+///
+///	The whole pipeline, opt.repeat times, on one synthetic image. Every
+///	run starts from the image alone, as SaliencyPipeline::Process does.
+//=================================================================================
+static void BenchSize(BenchOptions& opt, const double& megapixels, SizeResult& size)
+{
+	double pixels = megapixels*1e6;
+	size.width	= max(2, int(sqrt(pixels*opt.aspectW/opt.aspectH) + 0.5));
+	size.height	= max(2, int(pixels/size.width + 0.5));
+	const int width		= size.width;
+	const int height	= size.height;
+	const int sz		= width*height;
+
+	SyntheticSpec spec;
+	spec.width		= width;
+	spec.height		= height;
+	spec.regions	= opt.density > 0 ? max(1, int(opt.density*size.Pixels()/1e6 + 0.5)) : opt.regions;
+	spec.noise		= opt.noise;
+	spec.texture	= opt.texture;
+	spec.seed		= opt.seed;
+	vector<UINT> img;
+	size.regions = MakeSyntheticImage(spec, img);
+
+	for( int run = 0; run < opt.repeat; run++ )
+	{
+		Saliency sal;
+		vector<double> lvec, avec, bvec, salmap;
+		vector<int> labels;
+		int numlabels(0);
+		RegionTable regions;
+		vector<UINT> segobj;
+		vector<unsigned char> mask;
+		vector<SaliencyBox> boxes;
+
+		MeasureStage(opt, size, "lab", [&]() { sal.RGB2LAB(img, lvec, avec, bvec); });
+		MeasureStage(opt, size, "saliency", [&]() { sal.GetSaliencyMap(lvec, avec, bvec, width, height, salmap, true); });
+
+		msKernelTiming report[MS_TIMING_KERNELS];
+		int kernels(0);
+		MeasureStage(opt, size, "meanshift", [&]()
+		{
+			msImageProcessor mss;
+			mss.DefineLabImage(&lvec[0], &avec[0], &bvec[0], height, width);
+			mss.Segment(opt.sigmaS, opt.sigmaR, opt.minRegion, HIGH_SPEEDUP);
+			const int* p_labels = mss.GetLabelsView();
+			numlabels = mss.GetRegionCount();
+			labels.assign(p_labels, p_labels + sz);
+			kernels = mss.GetTimingReport(report, MS_TIMING_KERNELS);
+
+			msStageMemory memory[MS_MEMORY_STAGES];
+			int stages = mss.GetMemoryReport(memory, MS_MEMORY_STAGES);
+			for( int i = 0; i < stages; i++ )
+			{
+				if( 0 == strcmp(memory[i].stage, "filter") ) size.filterBytes = memory[i].bytes;
+			}
+		});
+		for( int i = 0; i < kernels; i++ )
+		{
+			StageResult& r = size.Stage(string("  ") + report[i].kernel);
+			r.hasMemory	= false;
+			r.calls		= report[i].calls;
+			r.samples.push_back(report[i].ms);
+		}
+		size.segments = numlabels;
+
+		MeasureStage(opt, size, "regions", [&]()
+		{
+			regions.Build(&labels[0], width, height, numlabels, &salmap[0], &img[0]);
+		});
+		MeasureStage(opt, size, "selection", [&]()
+		{
+			vector<bool> segtochoose(0);
+			SaliencyPipeline::ChooseSalientSegments(regions, segtochoose);
+			segobj.assign(sz, 0);
+			for( int n = 0; n < regions.GetRegionCount(); n++ )
+			{
+				if( !segtochoose[n] ) continue;
+				const int* pixels = regions.GetRegionPixels(n);
+				int area = regions.GetRegion(n).area;
+				for( int p = 0; p < area; p++ ) segobj[pixels[p]] = img[pixels[p]];
+			}
+		});
+		MeasureStage(opt, size, "contours", [&]() { ComputeBoundaryMask(labels, width, height, mask); });
+		MeasureStage(opt, size, "boxes", [&]() { SaliencyPipeline::FindSalientBoxes(regions, boxes); });
+	}
+
+	// the whole pipeline: the stages summed, run by run
+	StageResult total;
+	total.stage = "total";
+	for( int run = 0; run < opt.repeat; run++ )
+	{
+		double ms(0);
+		for( size_t i = 0; i < size.stages.size(); i++ )
+		{
+			if( size.stages[i].hasMemory ) ms += size.stages[i].samples[run];
+		}
+		total.samples.push_back(ms);
+	}
+	for( size_t i = 0; i < size.stages.size(); i++ )
+	{
+		if( !size.stages[i].hasMemory ) continue;
+		total.peak	= max(total.peak, size.stages[i].peak);
+		total.delta	= max(total.delta, size.stages[i].delta);
+	}
+	size.stages.push_back(total);
+}
+
+//=================================================================================
+///	Exponents
+///
+///	LocalExponent compares a stage with the previous size; FitExponent is
+///	the slope of the least squares line through log(value) against
+///	log(pixels) over the sweep. Both are 0 when there is nothing to fit.
+//=================================================================================
+static double LocalExponent(const double& v1, const double& n1, const double& v2, const double& n2)
+{
+	if( v1 <= 0 || v2 <= 0 || n1 <= 0 || n2 <= n1 ) return 0;
+	return log(v2/v1)/log(n2/n1);
+}
+
+static double FitExponent(const vector<double>& pixels, const vector<double>& values)
+{
+	double sx(0), sy(0), sxx(0), sxy(0);
+	int n(0);
+	for( size_t i = 0; i < pixels.size(); i++ )
+	{
+		if( pixels[i] <= 0 || values[i] <= 0 ) continue;
+		double x = log(pixels[i]);
+		double y = log(values[i]);
+		sx += x;	sy += y;	sxx += x*x;		sxy += x*y;
+		n++;
+	}
+	double den = n*sxx - sx*sx;
+	if( n < 2 || fabs(den) < 1e-12 ) return 0;
+	return (n*sxy - sx*sy)/den;
+}
+
+struct StageFit
+{
+	string				stage;
+	double				time;
+	double				memory;
+};
+
+static vector<StageFit> FitStages(const vector<SizeResult>& sizes)
+{
+	vector<StageFit> fits;
+	if( sizes.empty() ) return fits;
+	for( size_t s = 0; s < sizes[0].stages.size(); s++ )
+	{
+		StageFit fit;
+		fit.stage = sizes[0].stages[s].stage;
+		vector<double> pixels, times, deltas;
+		for( size_t i = 0; i < sizes.size(); i++ )
+		{
+			const StageResult* r = sizes[i].Find(fit.stage);
+			if( NULL == r ) continue;
+			pixels.push_back(sizes[i].Pixels());
+			times.push_back(r->Median());
+			deltas.push_back(r->hasMemory ? double(r->delta) : 0.0);
+		}
+		fit.time	= FitExponent(pixels, times);
+		fit.memory	= FitExponent(pixels, deltas);
+		fits.push_back(fit);
+	}
+	return fits;
+}
+
+static string Trim(const string& text)
+{
+	size_t first = text.find_first_not_of(' ');
+	return first == string::npos ? string() : text.substr(first);
+}
+
+//=================================================================================
+///	WriteReport
+//=================================================================================
+static void WriteReport(const BenchOptions& opt, const vector<SizeResult>& sizes, FILE* out)
+{
+	char stamp[32];
+	time_t now = time(NULL);
+	strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+	vector<StageFit> fits = FitStages(sizes);
+	const double MB = 1024.0*1024.0;
+
+	if( opt.format == "json" )
+	{
+		fprintf(out, "{\n  \"benchmark\": \"scaling\",\n  \"time\": \"%s\",\n  \"repeat\": %d,\n"
+			"  \"sigmaS\": %d,\n  \"sigmaR\": %g,\n  \"minRegion\": %d,\n  \"noise\": %g,\n  \"texture\": %g,\n"
+			"  \"seed\": %u,\n  \"peak_reset\": %s,\n  \"sizes\": [\n",
+			stamp, opt.repeat, opt.sigmaS, opt.sigmaR, opt.minRegion, opt.noise, opt.texture, opt.seed,
+			opt.peakReset ? "true" : "false");
+		for( size_t i = 0; i < sizes.size(); i++ )
+		{
+			const SizeResult& s = sizes[i];
+			fprintf(out, "    {\"width\": %d, \"height\": %d, \"megapixels\": %.4f, \"regions\": %d, \"segments\": %d, "
+				"\"filter_bytes\": %llu, \"stages\": [\n",
+				s.width, s.height, s.Pixels()/1e6, s.regions, s.segments, (unsigned long long)s.filterBytes);
+			for( size_t k = 0; k < s.stages.size(); k++ )
+			{
+				const StageResult& r = s.stages[k];
+				double exponent = i ? LocalExponent(sizes[i-1].Find(r.stage) ? sizes[i-1].Find(r.stage)->Median() : 0,
+					sizes[i-1].Pixels(), r.Median(), s.Pixels()) : 0;
+				fprintf(out, "      {\"stage\": \"%s\", \"calls\": %d, \"median_ms\": %.4f, \"ns_per_pixel\": %.3f, "
+					"\"time_exponent\": %.3f", Trim(r.stage).c_str(), r.calls, r.Median(), r.Median()*1e6/s.Pixels(), exponent);
+				if( r.hasMemory ) fprintf(out, ", \"peak_bytes\": %llu, \"delta_bytes\": %llu", (unsigned long long)r.peak, (unsigned long long)r.delta);
+				fprintf(out, "}%s\n", k + 1 < s.stages.size() ? "," : "");
+			}
+			fprintf(out, "    ]}%s\n", i + 1 < sizes.size() ? "," : "");
+		}
+		fprintf(out, "  ],\n  \"fits\": [\n");
+		for( size_t k = 0; k < fits.size(); k++ )
+		{
+			fprintf(out, "    {\"stage\": \"%s\", \"time_exponent\": %.3f, \"memory_exponent\": %.3f}%s\n",
+				Trim(fits[k].stage).c_str(), fits[k].time, fits[k].memory, k + 1 < fits.size() ? "," : "");
+		}
+		fprintf(out, "  ]\n}\n");
+	}
+	else if( opt.format == "csv" )
+	{
+		fprintf(out, "time,width,height,megapixels,regions,segments,stage,calls,median_ms,ns_per_pixel,peak_bytes,delta_bytes,time_exponent\n");
+		for( size_t i = 0; i < sizes.size(); i++ )
+		{
+			const SizeResult& s = sizes[i];
+			for( size_t k = 0; k < s.stages.size(); k++ )
+			{
+				const StageResult& r = s.stages[k];
+				const StageResult* prev = i ? sizes[i-1].Find(r.stage) : NULL;
+				fprintf(out, "%s,%d,%d,%.4f,%d,%d,%s,%d,%.4f,%.3f,%llu,%llu,%.3f\n",
+					stamp, s.width, s.height, s.Pixels()/1e6, s.regions, s.segments, Trim(r.stage).c_str(), r.calls,
+					r.Median(), r.Median()*1e6/s.Pixels(), (unsigned long long)r.peak, (unsigned long long)r.delta,
+					prev ? LocalExponent(prev->Median(), sizes[i-1].Pixels(), r.Median(), s.Pixels()) : 0.0);
+			}
+		}
+	}
+	else
+	{
+		for( size_t i = 0; i < sizes.size(); i++ )
+		{
+			const SizeResult& s = sizes[i];
+			fprintf(out, "%dx%d (%.2f MP), %d colour regions, %d segments, filter memory %.1f MB\n",
+				s.width, s.height, s.Pixels()/1e6, s.regions, s.segments, s.filterBytes/MB);
+			fprintf(out, "  %-24s %6s %11s %9s %10s %10s %9s\n",
+				"stage", "calls", "median_ms", "ns/pixel", "peak_MB", "delta_MB", "exponent");
+			for( size_t k = 0; k < s.stages.size(); k++ )
+			{
+				const StageResult& r = s.stages[k];
+				const StageResult* prev = i ? sizes[i-1].Find(r.stage) : NULL;
+				char exponent[16] = "-";
+				if( prev ) sprintf(exponent, "%.2f", LocalExponent(prev->Median(), sizes[i-1].Pixels(), r.Median(), s.Pixels()));
+				if( r.hasMemory )
+				{
+					fprintf(out, "  %-24s %6d %11.3f %9.2f %10.1f %10.1f %9s\n",
+						r.stage.c_str(), r.calls, r.Median(), r.Median()*1e6/s.Pixels(), r.peak/MB, r.delta/MB, exponent);
+				}
+				else
+				{
+					fprintf(out, "  %-24s %6d %11.3f %9.2f %10s %10s %9s\n",
+						r.stage.c_str(), r.calls, r.Median(), r.Median()*1e6/s.Pixels(), "", "", exponent);
+				}
+			}
+			fprintf(out, "\n");
+		}
+		if( sizes.size() > 1 )
+		{
+			fprintf(out, "Exponents of a log-log fit over %.2f to %.2f MP (1 = linear in the pixels):\n",
+				sizes.front().Pixels()/1e6, sizes.back().Pixels()/1e6);
+			fprintf(out, "  %-24s %9s %9s\n", "stage", "time", "memory");
+			for( size_t k = 0; k < fits.size(); k++ )
+			{
+				char memory[16] = "-";
+				if( fits[k].memory != 0 ) sprintf(memory, "%.2f", fits[k].memory);
+				fprintf(out, "  %-24s %9.2f %9s%s\n", fits[k].stage.c_str(), fits[k].time, memory,
+					fits[k].time > 1.15 ? "  superlinear" : "");
+			}
+		}
+		if( !opt.peakReset )
+		{
+			fprintf(out, "The peak memory could not be reset between stages: peaks are of the run so far.\n");
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions opt;
+	string megapixels = "0.1,0.3,1,3,10";
+
+	for( int a = 1; a < argc; a++ )
+	{
+		string arg(argv[a]);
+		bool hasvalue = a + 1 < argc;
+		if( arg == "--megapixels" && hasvalue )				megapixels = argv[++a];
+		else if( arg == "--aspect" && hasvalue )
+		{
+			if( 2 != sscanf(argv[++a], "%d:%d", &opt.aspectW, &opt.aspectH) ) opt.aspectW = 0;
+		}
+		else if( arg == "--regions" && hasvalue )			opt.regions = atoi(argv[++a]);
+		else if( arg == "--region-density" && hasvalue )	opt.density = atof(argv[++a]);
+		else if( arg == "--noise" && hasvalue )				opt.noise = atof(argv[++a]);
+		else if( arg == "--texture" && hasvalue )			opt.texture = atof(argv[++a]);
+		else if( arg == "--seed" && hasvalue )				opt.seed = unsigned(strtoul(argv[++a], NULL, 10));
+		else if( arg == "--repeat" && hasvalue )			opt.repeat = atoi(argv[++a]);
+		else if( arg == "--format" && hasvalue )			opt.format = argv[++a];
+		else if( arg == "-o" && hasvalue )					opt.output = argv[++a];
+		else if( arg == "-s" && hasvalue )					opt.sigmaS = atoi(argv[++a]);
+		else if( arg == "-r" && hasvalue )					opt.sigmaR = (float)atof(argv[++a]);
+		else if( arg == "-m" && hasvalue )					opt.minRegion = atoi(argv[++a]);
+		else
+		{
+			cerr << "unknown or incomplete option " << arg << endl;
+			PrintUsage(argv[0]);
+			return 2;
+		}
+	}
+	if( opt.repeat < 1 || opt.sigmaS <= 0 || opt.sigmaR <= 0 || opt.minRegion < 0 ||
+		opt.aspectW <= 0 || opt.aspectH <= 0 || opt.regions < 1 || opt.density < 0 ||
+		opt.noise < 0 || opt.texture < 0 ||
+		(opt.format != "text" && opt.format != "json" && opt.format != "csv") )
+	{
+		PrintUsage(argv[0]);
+		return 2;
+	}
+
+	vector<string> list = SplitList(megapixels);
+	for( size_t i = 0; i < list.size(); i++ )
+	{
+		double mp = atof(list[i].c_str());
+		// labels and offsets are int: stay well below 2^31 pixels
+		if( mp <= 0 || mp > 1000 )
+		{
+			cerr << "bad size " << list[i] << endl;
+			return 2;
+		}
+		opt.megapixels.push_back(mp);
+	}
+	sort(opt.megapixels.begin(), opt.megapixels.end());
+
+	FILE* out = stdout;
+	if( !opt.output.empty() && NULL == (out = fopen(opt.output.c_str(), "w")) )
+	{
+		cerr << "cannot write " << opt.output << endl;
+		return 1;
+	}
+
+	vector<SizeResult> sizes;
+	for( size_t i = 0; i < opt.megapixels.size(); i++ )
+	{
+		cerr << "running " << opt.megapixels[i] << " MP ..." << endl;
+		sizes.push_back(SizeResult());
+		BenchSize(opt, opt.megapixels[i], sizes.back());
+	}
+
+	WriteReport(opt, sizes, out);
+	if( out != stdout ) fclose(out);
+	return 0;
+}
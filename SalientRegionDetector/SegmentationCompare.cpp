@@ -0,0 +1,173 @@
+// SegmentationCompare.cpp: implementation of the segmentation agreement measures.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "SegmentationCompare.h"
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+namespace
+{
+	double Pairs(const double& n) { return 0.5*n*(n - 1); }
+
+	double Entropy(const vector<double>& counts, const double& total)
+	{
+		double h(0);
+		for( size_t i = 0; i < counts.size(); i++ )
+		{
+			if( counts[i] > 0 ) h -= counts[i]/total*log(counts[i]/total);
+		}
+		return h;
+	}
+
+	//-----------------------------------------------------------------------
+	// A pixel is on a boundary if its right or lower neighbour is in
+	// another region, so a boundary between two regions is one pixel wide.
+	//-----------------------------------------------------------------------
+	void BoundaryPixels(const int* labels, const int& width, const int& height, vector<unsigned char>& mask)
+	{
+		mask.assign(size_t(width)*height, 0);
+		for( int y = 0; y < height; y++ )
+		{
+			const int* row = labels + size_t(y)*width;
+			unsigned char* out = &mask[size_t(y)*width];
+			for( int x = 0; x < width; x++ )
+			{
+				if( (x + 1 < width && row[x] != row[x+1]) || (y + 1 < height && row[x] != row[x+width]) ) out[x] = 1;
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------
+	// Fraction of the boundary pixels of from that have a boundary pixel
+	// of to at one of the offsets; 1 if from has none.
+	//-----------------------------------------------------------------------
+	double MatchedFraction(
+		const vector<unsigned char>&	from,
+		const vector<unsigned char>&	to,
+		const int&						width,
+		const int&						height,
+		const vector<int>&				dx,
+		const vector<int>&				dy)
+	{
+		double total(0), matched(0);
+		for( int y = 0; y < height; y++ )
+		{
+			for( int x = 0; x < width; x++ )
+			{
+				if( !from[size_t(y)*width + x] ) continue;
+				total++;
+				for( size_t k = 0; k < dx.size(); k++ )
+				{
+					int xx = x + dx[k], yy = y + dy[k];
+					if( xx < 0 || yy < 0 || xx >= width || yy >= height ) continue;
+					if( to[size_t(yy)*width + xx] )
+					{
+						matched++;
+						break;
+					}
+				}
+			}
+		}
+		return total > 0 ? matched/total : 1.0;
+	}
+}
+
+//===========================================================================
+///	CompareSegmentations
+///
+/// The contingency table is built by sorting the label pairs of the
+/// pixels, so it costs O(n log n) time and 8 bytes per pixel whatever the
+/// number of labels.
+//===========================================================================
+void CompareSegmentations(
+	const int*						test,
+	const int&						numtest,
+	const int*						reference,
+	const int&						numreference,
+	const int&						width,
+	const int&						height,
+	const int&						tolerance,
+	SegmentationAgreement&			agreement)
+{
+	agreement = SegmentationAgreement();
+	const int sz = width*height;
+	if( sz <= 0 ) return;
+	const double n = sz;
+
+	//--------------------------------------------------
+	// Region measures, from the table of label pairs
+	//--------------------------------------------------
+	vector<double> testCounts(numtest, 0), refCounts(numreference, 0);
+	vector<uint64_t> keys(sz);
+	for( int i = 0; i < sz; i++ )
+	{
+		testCounts[test[i]]++;
+		refCounts[reference[i]]++;
+		keys[i] = uint64_t(uint32_t(test[i])) << 32 | uint32_t(reference[i]);
+	}
+	sort(keys.begin(), keys.end());
+
+	double jointEntropy(0), jointPairs(0);
+	for( int i = 0; i < sz; )
+	{
+		int j = i + 1;
+		while( j < sz && keys[j] == keys[i] ) j++;
+		double count = j - i;
+		jointEntropy	-= count/n*log(count/n);
+		jointPairs		+= Pairs(count);
+		i = j;
+	}
+	agreement.vi = 2*jointEntropy - Entropy(testCounts, n) - Entropy(refCounts, n);
+	if( agreement.vi < 0 ) agreement.vi = 0;	// rounding
+
+	double testPairs(0), refPairs(0);
+	for( size_t i = 0; i < testCounts.size(); i++ )	testPairs += Pairs(testCounts[i]);
+	for( size_t i = 0; i < refCounts.size(); i++ )	refPairs += Pairs(refCounts[i]);
+	double allPairs = Pairs(n);
+	if( allPairs > 0 )
+	{
+		agreement.rand = (allPairs + 2*jointPairs - testPairs - refPairs)/allPairs;
+		double expected	= testPairs*refPairs/allPairs;
+		double maximum	= 0.5*(testPairs + refPairs);
+		agreement.adjustedRand = maximum > expected ? (jointPairs - expected)/(maximum - expected) : 1.0;
+	}
+
+	//--------------------------------------------------
+	// Boundary measure
+	//--------------------------------------------------
+	vector<int> dx, dy;
+	for( int y = -tolerance; y <= tolerance; y++ )
+	{
+		for( int x = -tolerance; x <= tolerance; x++ )
+		{
+			if( x*x + y*y > tolerance*tolerance ) continue;
+			dx.push_back(x);
+			dy.push_back(y);
+		}
+	}
+	vector<unsigned char> testMask, refMask;
+	BoundaryPixels(test, width, height, testMask);
+	BoundaryPixels(reference, width, height, refMask);
+	agreement.boundaryPrecision	= MatchedFraction(testMask, refMask, width, height, dx, dy);
+	agreement.boundaryRecall	= MatchedFraction(refMask, testMask, width, height, dx, dy);
+	double pr = agreement.boundaryPrecision + agreement.boundaryRecall;
+	agreement.boundaryF = pr > 0 ? 2*agreement.boundaryPrecision*agreement.boundaryRecall/pr : 0;
+}
+
+//===========================================================================
+///	MaskIoU
+//===========================================================================
+double MaskIoU(
+	const vector<bool>&				test,
+	const vector<bool>&				reference)
+{
+	size_t both(0), either(0);
+	for( size_t i = 0; i < test.size() && i < reference.size(); i++ )
+	{
+		if( test[i] && reference[i] )	both++;
+		if( test[i] || reference[i] )	either++;
+	}
+	return either ? double(both)/either : 1.0;
+}
@@ -0,0 +1,59 @@
+// SegmentationCompare.h: interface for the segmentation agreement measures.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Measures of how far a segmentation is from a reference one of the same
+// image, for checking a faster mean shift setting or engine against the
+// exact filter, or a segmentation against the ground truth of a synthetic
+// image. Labels need not correspond between the two: the region measures
+// work on the contingency table of the label pairs, the boundary measure
+// on where the labels change.
+//
+//   variation of information   H(A|B) + H(B|A) in nats, 0 when the two
+//                              partitions are the same
+//   Rand index                 fraction of pixel pairs on which they agree
+//                              (same region in both or different in both),
+//                              and its adjusted form, 0 for chance and 1
+//                              for the same partition
+//   boundary precision/recall  fraction of the boundary pixels of one that
+//                              lie within tolerance pixels of a boundary
+//                              pixel of the other, and their F-measure
+//===========================================================================
+
+#if !defined(_SEGMENTATIONCOMPARE_H_INCLUDED_)
+#define _SEGMENTATIONCOMPARE_H_INCLUDED_
+
+#include <vector>
+using namespace std;
+
+struct SegmentationAgreement
+{
+	double				vi;					// variation of information
+	double				rand;				// Rand index
+	double				adjustedRand;
+	double				boundaryPrecision;	// of the test boundaries
+	double				boundaryRecall;		// of the reference boundaries
+	double				boundaryF;
+
+	SegmentationAgreement() : vi(0), rand(1), adjustedRand(1), boundaryPrecision(1), boundaryRecall(1), boundaryF(1) {}
+};
+
+// test and reference are label images of width*height pixels with labels
+// in [0, numtest) and [0, numreference).
+void CompareSegmentations(
+	const int*						test,
+	const int&						numtest,
+	const int*						reference,
+	const int&						numreference,
+	const int&						width,
+	const int&						height,
+	const int&						tolerance,			//boundary match distance in pixels
+	SegmentationAgreement&			agreement);			//OUTPUT
+
+// Intersection over union of two pixel masks of the same size; 1 when
+// both are empty.
+double MaskIoU(
+	const vector<bool>&				test,
+	const vector<bool>&				reference);
+
+#endif // !defined(_SEGMENTATIONCOMPARE_H_INCLUDED_)
@@ -0,0 +1,667 @@
+// SegmentationService.cpp: implementation of the SegmentationService class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "SegmentationService.h"
+#include "SaliencyPipeline.h"
+#include "Trace.h"
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// objects kept open per client; a client cycling through more names starts over
+#define SERVICE_MAX_REGIONS		16
+
+namespace
+{
+	// milliseconds of a steady clock, the time base of the queue times
+	double ServiceNow()
+	{
+		return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// false on end of file or error
+	bool ReadFull(const int& fd, void* buffer, const size_t& size)
+	{
+		char* p = (char*)buffer;
+		size_t done(0);
+		while( done < size )
+		{
+			ssize_t n = recv(fd, p + done, size - done, 0);
+			if( n < 0 && errno == EINTR ) continue;
+			if( n <= 0 ) return false;
+			done += size_t(n);
+		}
+		return true;
+	}
+
+	// MSG_NOSIGNAL: a client gone away is an error, not a SIGPIPE
+	bool WriteFull(const int& fd, const void* buffer, const size_t& size)
+	{
+		const char* p = (const char*)buffer;
+		size_t done(0);
+		while( done < size )
+		{
+			ssize_t n = send(fd, p + done, size - done, MSG_NOSIGNAL);
+			if( n < 0 && errno == EINTR ) continue;
+			if( n <= 0 ) return false;
+			done += size_t(n);
+		}
+		return true;
+	}
+
+	// pread and pwrite of the whole buffer; false on an error or when the
+	// object ends before it
+	bool ReadAt(const int& fd, void* buffer, const size_t& size, const size_t& offset)
+	{
+		char* p = (char*)buffer;
+		size_t done(0);
+		while( done < size )
+		{
+			ssize_t n = pread(fd, p + done, size - done, off_t(offset + done));
+			if( n < 0 && errno == EINTR ) continue;
+			if( n <= 0 ) return false;
+			done += size_t(n);
+		}
+		return true;
+	}
+
+	bool WriteAt(const int& fd, const void* buffer, const size_t& size, const size_t& offset)
+	{
+		const char* p = (const char*)buffer;
+		size_t done(0);
+		while( done < size )
+		{
+			ssize_t n = pwrite(fd, p + done, size - done, off_t(offset + done));
+			if( n < 0 && errno == EINTR ) continue;
+			if( n <= 0 ) return false;
+			done += size_t(n);
+		}
+		return true;
+	}
+
+	void CopyText(char* destination, const size_t& size, const string& text)
+	{
+		size_t n = min(text.size(), size - 1);
+		memcpy(destination, text.c_str(), n);
+		destination[n] = 0;
+	}
+
+	void InitResponse(ServiceResponse& response, const uint64_t& id)
+	{
+		memset(&response, 0, sizeof(response));
+		response.magic	= SERVICE_MAGIC;
+		response.status	= SERVICE_OK;
+		response.id		= id;
+	}
+}
+
+//---------------------------------------------------------------------------
+// A shared memory object of a client, open until the last job using it has
+// finished. It is never mapped: the client can resize it at any time, and
+// a load or store past its new end would be a SIGBUS in the service.
+//---------------------------------------------------------------------------
+struct SegmentationService::SharedRegion
+{
+	int					fd;
+
+	SharedRegion(const int& f) : fd(f) {}
+	~SharedRegion() { close(fd); }
+};
+
+//---------------------------------------------------------------------------
+// A client. closed is set when it disconnects or the service stops, and is
+// the cancel flag of the segmentations of its jobs. The socket is closed
+// once the reader and every job of the client are done with it.
+//---------------------------------------------------------------------------
+struct SegmentationService::Connection
+{
+	int					fd;
+	mutex				writeLock;		// responses come from the workers
+	atomic<bool>		closed;
+	map<string, shared_ptr<SharedRegion> >	regions;	// used by the reader only
+
+	Connection(const int& f) : fd(f), closed(false) {}
+	~Connection() { close(fd); }
+};
+
+SegmentationService::SegmentationService(const ServiceSettings& settings)
+	: m_settings(settings), m_listener(-1), m_stopping(false), m_order(0), m_readers(0)
+{
+	// at least one worker must be left for the bulk jobs
+	m_settings.reserved = max(0, min(m_settings.reserved, m_settings.workers - 1));
+}
+
+SegmentationService::~SegmentationService()
+{
+	{
+		lock_guard<mutex> lk(m_queueLock);
+		m_stopping.store(true);
+	}
+	m_queueReady.notify_all();
+	for( size_t w = 0; w < m_workers.size(); w++ )
+	{
+		if( m_workers[w].joinable() ) m_workers[w].join();
+	}
+	if( m_listener >= 0 )
+	{
+		close(m_listener);
+		unlink(m_settings.socketPath.c_str());
+	}
+}
+
+//===========================================================================
+///	Start
+//===========================================================================
+bool SegmentationService::Start()
+{
+	if( m_settings.workers < 1 || m_settings.maxQueued < 1 || !(m_settings.maxMegapixels > 0) )
+	{
+		m_error = "bad service settings";
+		return false;
+	}
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if( m_settings.socketPath.empty() || m_settings.socketPath.size() >= sizeof(addr.sun_path) )
+	{
+		m_error = "bad socket path " + m_settings.socketPath;
+		return false;
+	}
+	strcpy(addr.sun_path, m_settings.socketPath.c_str());
+
+	// the file of a service that is still answering is not taken over
+	int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	if( probe >= 0 )
+	{
+		bool running = 0 == connect(probe, (const sockaddr*)&addr, sizeof(addr));
+		close(probe);
+		if( running )
+		{
+			m_error = "a service is already running on " + m_settings.socketPath;
+			return false;
+		}
+	}
+	unlink(addr.sun_path);
+
+	m_listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if( m_listener < 0 ||
+		bind(m_listener, (const sockaddr*)&addr, sizeof(addr)) ||
+		listen(m_listener, 64) )
+	{
+		m_error = "cannot listen on " + m_settings.socketPath + ": " + strerror(errno);
+		if( m_listener >= 0 ) close(m_listener);
+		m_listener = -1;
+		return false;
+	}
+
+	for( int w = 0; w < m_settings.workers; w++ )
+	{
+		m_workers.push_back(thread(&SegmentationService::Worker, this, w));
+	}
+	return true;
+}
+
+//===========================================================================
+///	Run
+///
+/// The listener is polled so that a stop requested from a signal handler
+/// is seen within a fifth of a second.
+//===========================================================================
+void SegmentationService::Run()
+{
+	while( m_listener >= 0 && !m_stopping.load() )
+	{
+		pollfd p;
+		p.fd		= m_listener;
+		p.events	= POLLIN;
+		p.revents	= 0;
+		if( poll(&p, 1, 200) <= 0 ) continue;
+
+		int fd = accept(m_listener, NULL, NULL);
+		if( fd < 0 ) continue;
+		shared_ptr<Connection> connection = make_shared<Connection>(fd);
+		{
+			lock_guard<mutex> lk(m_connectionLock);
+			size_t kept(0);
+			for( size_t c = 0; c < m_connections.size(); c++ )
+			{
+				if( !m_connections[c].expired() ) m_connections[kept++] = m_connections[c];
+			}
+			m_connections.resize(kept);
+			m_connections.push_back(connection);
+			m_readers++;
+		}
+		{
+			lock_guard<mutex> lk(m_statsLock);
+			m_stats.connections++;
+		}
+		thread(&SegmentationService::Reader, this, connection).detach();
+	}
+
+	if( m_listener >= 0 )
+	{
+		close(m_listener);
+		unlink(m_settings.socketPath.c_str());
+		m_listener = -1;
+	}
+
+	// readers queue nothing once m_stopping is set, so this empties the queue
+	vector<Job> canceled;
+	{
+		lock_guard<mutex> lk(m_queueLock);
+		m_stopping.store(true);
+		while( !m_queue.empty() )
+		{
+			canceled.push_back(m_queue.top());
+			m_queue.pop();
+		}
+	}
+	m_queueReady.notify_all();
+	for( size_t j = 0; j < canceled.size(); j++ )
+	{
+		ServiceResponse response;
+		InitResponse(response, canceled[j].request.id);
+		response.status = SERVICE_CANCELED;
+		CopyText(response.error, sizeof(response.error), "the service is stopping");
+		Respond(*canceled[j].connection, response, canceled[j].request);
+	}
+
+	// stops the running segmentations and wakes the readers; the running
+	// jobs can still send their SERVICE_CANCELED
+	{
+		lock_guard<mutex> lk(m_connectionLock);
+		for( size_t c = 0; c < m_connections.size(); c++ )
+		{
+			shared_ptr<Connection> connection = m_connections[c].lock();
+			if( !connection ) continue;
+			connection->closed.store(true);
+			shutdown(connection->fd, SHUT_RD);
+		}
+	}
+	for( size_t w = 0; w < m_workers.size(); w++ )
+	{
+		m_workers[w].join();
+	}
+	m_workers.clear();
+
+	unique_lock<mutex> lk(m_connectionLock);
+	m_readersDone.wait(lk, [this] { return 0 == m_readers; });
+}
+
+//===========================================================================
+///	GetStats
+//===========================================================================
+ServiceStats SegmentationService::GetStats()
+{
+	lock_guard<mutex> lk(m_statsLock);
+	return m_stats;
+}
+
+//===========================================================================
+///	Reader
+///
+/// Reads the requests of one client and queues them, answering at once
+/// those that cannot be run. A request that is not one of this protocol
+/// ends the connection, since the stream cannot be trusted after it.
+//===========================================================================
+void SegmentationService::Reader(shared_ptr<Connection> connection)
+{
+	ServiceRequest request;
+	while( ReadFull(connection->fd, &request, sizeof(request)) )
+	{
+		ServiceResponse response;
+		InitResponse(response, request.id);
+		if( request.magic != SERVICE_MAGIC || request.version != SERVICE_VERSION )
+		{
+			response.status = SERVICE_BAD_REQUEST;
+			CopyText(response.error, sizeof(response.error), "not a request of this protocol version");
+			Respond(*connection, response, request);
+			break;
+		}
+
+		string error;
+		shared_ptr<SharedRegion> region;
+		if( !CheckRequest(request, error) )
+		{
+			response.status = SERVICE_BAD_REQUEST;
+		}
+		else if( !(region = OpenRegion(*connection, request, error)) )
+		{
+			response.status = SERVICE_SHM_ERROR;
+		}
+		else
+		{
+			Job job;
+			job.request		= request;
+			job.connection	= connection;
+			job.region		= region;
+			job.queued		= ServiceNow();
+
+			lock_guard<mutex> lk(m_queueLock);
+			if( m_stopping.load() )
+			{
+				response.status = SERVICE_CANCELED;
+				error = "the service is stopping";
+			}
+			else if( int(m_queue.size()) >= m_settings.maxQueued )
+			{
+				response.status = SERVICE_BUSY;
+				error = "the queue is full";
+			}
+			else
+			{
+				job.order = m_order++;
+				m_queue.push(job);
+				// reserved workers may not take it, so wake them all
+				m_queueReady.notify_all();
+			}
+		}
+		if( response.status != SERVICE_OK )
+		{
+			CopyText(response.error, sizeof(response.error), error);
+			Respond(*connection, response, request);
+		}
+	}
+
+	connection->closed.store(true);
+	connection.reset();
+	lock_guard<mutex> lk(m_connectionLock);
+	m_readers--;
+	m_readersDone.notify_all();
+}
+
+//===========================================================================
+///	Worker
+///
+/// A reserved worker only takes the top of the queue when it is an
+/// interactive job, and otherwise waits; the others take any job.
+//===========================================================================
+void SegmentationService::Worker(int index)
+{
+	char name[32];
+	sprintf(name, "service worker %d", index + 1);
+	Trace::SetThreadName(name);
+
+	const bool reserved = index < m_settings.reserved;
+	SaliencyWorkspace workspace;
+	SaliencyPipeline pipeline;
+	pipeline.SetWorkspace(&workspace);
+	vector<UINT> img;
+	vector<unsigned char> scratch;
+
+	for(;;)
+	{
+		Job job;
+		{
+			unique_lock<mutex> lk(m_queueLock);
+			m_queueReady.wait(lk, [&] {
+				return m_stopping.load() || (!m_queue.empty() &&
+					(!reserved || m_queue.top().request.priority >= SERVICE_PRIORITY_INTERACTIVE));
+			});
+			if( m_stopping.load() ) return;
+			job = m_queue.top();
+			m_queue.pop();
+		}
+		Execute(job, pipeline, img, scratch);
+	}
+}
+
+//===========================================================================
+///	Execute
+///
+/// Runs one job and writes the selected results into the client's object.
+/// img and scratch are the worker's buffers for the input and the results
+/// on their way to the object, kept from job to job.
+//===========================================================================
+void SegmentationService::Execute(Job& job, SaliencyPipeline& pipeline, vector<UINT>& img, vector<unsigned char>& scratch)
+{
+	TRACE_SPAN(span, "service job");
+	const ServiceRequest& request = job.request;
+	ServiceResponse response;
+	InitResponse(response, request.id);
+	response.queueMs = ServiceNow() - job.queued;
+
+	if( job.connection->closed.load() )
+	{
+		response.status = SERVICE_CANCELED;
+		CopyText(response.error, sizeof(response.error), "canceled");
+		Respond(*job.connection, response, request);
+		return;
+	}
+
+	const int width = request.width, height = request.height;
+	const size_t sz = size_t(width)*size_t(height);
+	const ServiceLayout layout(width, height, request.maxBoxes);
+	const int fd = job.region->fd;
+	double start = ServiceNow();
+
+	// the pixels are copied in, so that what the client does with its object
+	// meanwhile cannot reach the pipeline
+	img.resize(sz);
+	if( !ReadAt(fd, &img[0], 4*sz, layout.input) )
+	{
+		response.status = SERVICE_SHM_ERROR;
+		CopyText(response.error, sizeof(response.error), "cannot read the image from the shared memory object");
+		Respond(*job.connection, response, request);
+		return;
+	}
+
+	SaliencyParams params;
+	params.sigmaS			= request.sigmaS;
+	params.sigmaR			= request.sigmaR;
+	params.minRegion		= request.minRegion;
+	params.salientFactor	= request.salientFactor;
+	params.segmentBudget	= request.budget;
+	params.outputs			= 0;
+	params.threads			= 1;
+	pipeline.SetParams(params);
+	pipeline.SetCancelFlag(&job.connection->closed);
+
+	SaliencyResult result;
+	try
+	{
+		pipeline.Process(img, width, height, result);
+	}
+	catch( const SaliencyCanceled& )
+	{
+		response.status = SERVICE_CANCELED;
+		CopyText(response.error, sizeof(response.error), "canceled");
+	}
+	catch( const exception& e )
+	{
+		response.status = SERVICE_FAILED;
+		CopyText(response.error, sizeof(response.error), e.what());
+	}
+	pipeline.SetCancelFlag(NULL);
+
+	// results are not written past the end of an object the client has
+	// shrunk meanwhile, which would grow it again
+	struct stat st;
+	if( SERVICE_OK == response.status && (fstat(fd, &st) || uint64_t(st.st_size) < layout.total) )
+	{
+		response.status = SERVICE_SHM_ERROR;
+		CopyText(response.error, sizeof(response.error), "the shared memory object has shrunk");
+	}
+	if( SERVICE_OK == response.status )
+	{
+		response.numlabels	= result.numlabels;
+		response.numboxes	= int(result.boxes.size());
+		response.quality	= result.quality;
+
+		bool written(true);
+		if( request.results & SERVICE_RESULT_LABELS )
+		{
+			written = WriteAt(fd, &result.labels[0], 4*sz, layout.labels) && written;
+		}
+		if( request.results & SERVICE_RESULT_SALMAP )
+		{
+			scratch.resize(4*sz);
+			float* salmap = (float*)&scratch[0];
+			for( size_t i = 0; i < sz; i++ ) salmap[i] = float(result.salmap[i]);
+			written = WriteAt(fd, salmap, 4*sz, layout.salmap) && written;
+		}
+		if( request.results & SERVICE_RESULT_MASK )
+		{
+			scratch.assign(sz, 0);
+			unsigned char* mask = &scratch[0];
+			vector<bool> segtochoose(0);
+			SaliencyPipeline::ChooseSalientSegments(result.regions, segtochoose, request.salientFactor);
+			for( int n = 0; n < result.regions.GetRegionCount(); n++ )
+			{
+				if( !segtochoose[n] ) continue;
+				const int* pixels = result.regions.GetRegionPixels(n);
+				int area = result.regions.GetRegion(n).area;
+				for( int p = 0; p < area; p++ ) mask[pixels[p]] = 255;
+			}
+			written = WriteAt(fd, mask, sz, layout.mask) && written;
+		}
+		if( request.results & SERVICE_RESULT_BOXES )
+		{
+			int count = min(response.numboxes, request.maxBoxes);
+			scratch.resize(sizeof(ServiceBox)*size_t(max(count, 1)));
+			ServiceBox* boxes = (ServiceBox*)&scratch[0];
+			for( int b = 0; b < count; b++ )
+			{
+				const SaliencyBox& box = result.boxes[b];
+				boxes[b].label		= box.label;
+				boxes[b].x			= box.x;
+				boxes[b].y			= box.y;
+				boxes[b].width		= box.width;
+				boxes[b].height		= box.height;
+				boxes[b].pointCount	= box.pointCount;
+			}
+			written = WriteAt(fd, boxes, sizeof(ServiceBox)*size_t(count), layout.boxes) && written;
+		}
+		if( !written )
+		{
+			response.status = SERVICE_SHM_ERROR;
+			CopyText(response.error, sizeof(response.error), "cannot write the results into the shared memory object");
+		}
+	}
+	response.processMs = ServiceNow() - start;
+	span.SetArg("pixels", int64_t(sz));
+	Respond(*job.connection, response, request);
+}
+
+//===========================================================================
+///	CheckRequest
+//===========================================================================
+bool SegmentationService::CheckRequest(const ServiceRequest& request, string& error) const
+{
+	if( request.width <= 0 || request.height <= 0 )
+	{
+		error = "bad image size";
+	}
+	else if( double(request.width)*double(request.height) > m_settings.maxMegapixels*1e6 )
+	{
+		error = "image too large for the service";
+	}
+	else if( request.sigmaS < 1 || !(request.sigmaR > 0) || request.minRegion < 0 ||
+			 !(request.salientFactor > 0) || !(request.budget >= 0) )
+	{
+		error = "bad parameters";
+	}
+	else if( request.results & ~uint32_t(SERVICE_RESULT_ALL) )
+	{
+		error = "unknown result flags";
+	}
+	else if( request.maxBoxes < 0 || request.maxBoxes > (1 << 20) )
+	{
+		error = "bad box count";
+	}
+	else if( NULL == memchr(request.shmName, 0, sizeof(request.shmName)) ||
+			 request.shmName[0] != '/' || request.shmName[1] == 0 || strchr(request.shmName + 1, '/') )
+	{
+		error = "bad shared memory name";
+	}
+	else if( request.shmSize < ServiceLayout(request.width, request.height, request.maxBoxes).total )
+	{
+		error = "shared memory object too small for the image";
+	}
+	return error.empty();
+}
+
+//===========================================================================
+///	OpenRegion
+///
+/// The object is opened on the first request naming it and kept open for
+/// the next ones; NULL, with error, if it cannot be opened or is smaller
+/// than the request says. It may still shrink before the job runs, which
+/// Execute() answers with SERVICE_SHM_ERROR.
+//===========================================================================
+shared_ptr<SegmentationService::SharedRegion> SegmentationService::OpenRegion(
+	Connection&						connection,
+	const ServiceRequest&			request,
+	string&							error)
+{
+	const string name(request.shmName);
+	shared_ptr<SharedRegion> region;
+	map<string, shared_ptr<SharedRegion> >::iterator found = connection.regions.find(name);
+	if( found != connection.regions.end() )
+	{
+		region = found->second;
+	}
+	else
+	{
+		int fd = shm_open(name.c_str(), O_RDWR, 0);
+		if( fd < 0 )
+		{
+			error = "cannot open " + name + ": " + strerror(errno);
+			return shared_ptr<SharedRegion>();
+		}
+		// jobs still queued keep their own reference to the regions dropped here
+		if( connection.regions.size() >= SERVICE_MAX_REGIONS ) connection.regions.clear();
+		region = make_shared<SharedRegion>(fd);
+		connection.regions[name] = region;
+	}
+
+	struct stat st;
+	if( fstat(region->fd, &st) || uint64_t(st.st_size) < request.shmSize )
+	{
+		error = name + " is smaller than its request says";
+		return shared_ptr<SharedRegion>();
+	}
+	return region;
+}
+
+//===========================================================================
+///	Respond
+//===========================================================================
+void SegmentationService::Respond(Connection& connection, ServiceResponse& response, const ServiceRequest& request)
+{
+	{
+		lock_guard<mutex> lk(connection.writeLock);
+		WriteFull(connection.fd, &response, sizeof(response));
+	}
+	Count(request, response);
+}
+
+//===========================================================================
+///	Count
+//===========================================================================
+void SegmentationService::Count(const ServiceRequest& request, const ServiceResponse& response)
+{
+	lock_guard<mutex> lk(m_statsLock);
+	ServiceClassStats& stats = request.priority >= SERVICE_PRIORITY_INTERACTIVE ? m_stats.interactive : m_stats.bulk;
+	stats.jobs++;
+	if( SERVICE_BUSY == response.status )		stats.rejected++;
+	else if( SERVICE_OK != response.status )	stats.failed++;
+	else
+	{
+		if( SEGMENT_EXACT != response.quality ) stats.degraded++;
+		stats.queueMs		+= response.queueMs;
+		stats.maxQueueMs	= max(stats.maxQueueMs, response.queueMs);
+		stats.processMs		+= response.processMs;
+	}
+}
@@ -0,0 +1,149 @@
+// SegmentationService.h: interface for the SegmentationService class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Long running segmentation service for the programs of one machine: the
+// saliency pipeline behind a Unix domain socket, with the pixels and the
+// results passed through POSIX shared memory (see ServiceProtocol.h), so
+// that a caller pays neither the start of a process nor file I/O per
+// batch. POSIX only.
+//
+// The workers are started once and each keeps a SaliencyWorkspace, so an
+// image of the size of the one before is processed without allocating the
+// Lab planes or the mean shift output again. Jobs wait in one queue ordered
+// by priority; some workers can be reserved for interactive jobs, so that
+// one arriving while every other worker is busy with a long bulk image
+// starts at once. A full queue answers SERVICE_BUSY instead of letting the
+// wait grow. The jobs of a client that disconnects are dropped, and its
+// running segmentation is stopped through the pipeline's cancel flag.
+//===========================================================================
+
+#if !defined(_SEGMENTATIONSERVICE_H_INCLUDED_)
+#define _SEGMENTATIONSERVICE_H_INCLUDED_
+
+#include <vector>
+#include <string>
+#include <queue>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include "ServiceProtocol.h"
+using namespace std;
+
+class SaliencyPipeline;
+
+struct ServiceSettings
+{
+	string				socketPath;
+	int					workers;		// threads processing jobs
+	int					reserved;		// of these, the ones that only take interactive jobs
+	int					maxQueued;		// jobs waiting; more are answered SERVICE_BUSY
+	double				maxMegapixels;	// larger images are refused
+
+	ServiceSettings()
+		: socketPath("/tmp/salientregion.sock"), workers(1), reserved(0), maxQueued(256), maxMegapixels(64) {}
+};
+
+// counts of the jobs of one class since the start
+struct ServiceClassStats
+{
+	int					jobs;			// answered, whatever the status
+	int					rejected;		// SERVICE_BUSY
+	int					failed;			// any other status but SERVICE_OK
+	int					degraded;		// segmented below SEGMENT_EXACT quality
+	double				queueMs;		// sums over the jobs that ran
+	double				maxQueueMs;
+	double				processMs;
+
+	ServiceClassStats() : jobs(0), rejected(0), failed(0), degraded(0), queueMs(0), maxQueueMs(0), processMs(0) {}
+};
+
+struct ServiceStats
+{
+	int					connections;
+	ServiceClassStats	interactive;	// priority SERVICE_PRIORITY_INTERACTIVE or above
+	ServiceClassStats	bulk;
+
+	ServiceStats() : connections(0) {}
+};
+
+class SegmentationService
+{
+public:
+	SegmentationService(const ServiceSettings& settings);
+	virtual ~SegmentationService();
+
+	// Binds the socket, replacing the file of a service that is no longer
+	// running, and starts the workers; false, with GetError(), if it cannot.
+	bool Start();
+
+	// Accepts clients until RequestStop(), then answers the jobs still
+	// queued with SERVICE_CANCELED, stops the running ones and returns once
+	// every thread has finished.
+	void Run();
+
+	// Only sets a flag, so it may be called from a signal handler.
+	void RequestStop() { m_stopping.store(true); }
+
+	ServiceStats GetStats();
+	const string& GetError() const { return m_error; }
+	const ServiceSettings& GetSettings() const { return m_settings; }
+
+private:
+	SegmentationService(const SegmentationService&);
+	SegmentationService& operator=(const SegmentationService&);
+
+	struct SharedRegion;
+	struct Connection;
+
+	struct Job
+	{
+		ServiceRequest					request;
+		shared_ptr<Connection>			connection;
+		shared_ptr<SharedRegion>		region;
+		double							queued;			// ms of the service clock
+		uint64_t						order;			// first come first served within a priority
+	};
+
+	// top of the queue: highest priority, then oldest
+	struct JobOrder
+	{
+		bool operator()(const Job& a, const Job& b) const
+		{
+			if( a.request.priority != b.request.priority ) return a.request.priority < b.request.priority;
+			return a.order > b.order;
+		}
+	};
+
+	void Reader(shared_ptr<Connection> connection);
+	void Worker(int index);
+	void Execute(Job& job, SaliencyPipeline& pipeline, vector<unsigned int>& img, vector<unsigned char>& scratch);
+
+	bool CheckRequest(const ServiceRequest& request, string& error) const;
+	shared_ptr<SharedRegion> OpenRegion(Connection& connection, const ServiceRequest& request, string& error);
+	void Respond(Connection& connection, ServiceResponse& response, const ServiceRequest& request);
+	void Count(const ServiceRequest& request, const ServiceResponse& response);
+
+	ServiceSettings						m_settings;
+	string								m_error;
+	int									m_listener;
+	atomic<bool>						m_stopping;
+
+	mutex								m_queueLock;
+	condition_variable					m_queueReady;
+	priority_queue<Job, vector<Job>, JobOrder>	m_queue;
+	uint64_t							m_order;
+	vector<thread>						m_workers;
+
+	mutex								m_connectionLock;
+	condition_variable					m_readersDone;
+	vector<weak_ptr<Connection> >		m_connections;
+	int									m_readers;
+
+	mutex								m_statsLock;
+	ServiceStats						m_stats;
+};
+
+#endif // !defined(_SEGMENTATIONSERVICE_H_INCLUDED_)
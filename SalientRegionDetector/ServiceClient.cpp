@@ -0,0 +1,261 @@
+// ServiceClient.cpp: implementation of the ServiceClient class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "ServiceClient.h"
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+	// objects of one process are told apart by a counter
+	atomic<unsigned int>	s_objectCount(0);
+
+	bool ReadFull(const int& fd, void* buffer, const size_t& size)
+	{
+		char* p = (char*)buffer;
+		size_t done(0);
+		while( done < size )
+		{
+			ssize_t n = recv(fd, p + done, size - done, 0);
+			if( n < 0 && errno == EINTR ) continue;
+			if( n <= 0 ) return false;
+			done += size_t(n);
+		}
+		return true;
+	}
+
+	bool WriteFull(const int& fd, const void* buffer, const size_t& size)
+	{
+		const char* p = (const char*)buffer;
+		size_t done(0);
+		while( done < size )
+		{
+			ssize_t n = send(fd, p + done, size - done, MSG_NOSIGNAL);
+			if( n < 0 && errno == EINTR ) continue;
+			if( n <= 0 ) return false;
+			done += size_t(n);
+		}
+		return true;
+	}
+}
+
+ServiceClient::ServiceClient()
+	: m_socket(-1), m_shmFd(-1), m_base(NULL), m_size(0), m_nextId(1)
+{
+}
+
+ServiceClient::~ServiceClient()
+{
+	Close();
+}
+
+//===========================================================================
+///	Connect
+//===========================================================================
+bool ServiceClient::Connect(const string& socketPath)
+{
+	Close();
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if( socketPath.empty() || socketPath.size() >= sizeof(addr.sun_path) )
+	{
+		m_error = "bad socket path " + socketPath;
+		return false;
+	}
+	strcpy(addr.sun_path, socketPath.c_str());
+
+	m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if( m_socket < 0 || connect(m_socket, (const sockaddr*)&addr, sizeof(addr)) )
+	{
+		m_error = "cannot connect to " + socketPath + ": " + strerror(errno);
+		if( m_socket >= 0 ) close(m_socket);
+		m_socket = -1;
+		return false;
+	}
+	return true;
+}
+
+//===========================================================================
+///	Close
+//===========================================================================
+void ServiceClient::Close()
+{
+	if( m_socket >= 0 ) close(m_socket);
+	m_socket = -1;
+	ReleaseShared();
+}
+
+//===========================================================================
+///	ReleaseShared
+///
+/// The service keeps its own descriptor of the object until it drops the
+/// connection; unlinking only removes the name.
+//===========================================================================
+void ServiceClient::ReleaseShared()
+{
+	if( m_base ) munmap(m_base, m_size);
+	if( m_shmFd >= 0 )
+	{
+		close(m_shmFd);
+		shm_unlink(m_shmName.c_str());
+	}
+	m_base	= NULL;
+	m_size	= 0;
+	m_shmFd	= -1;
+	m_shmName.clear();
+}
+
+//===========================================================================
+///	GetInputBuffer
+///
+/// The object is grown in steps of a megabyte, so that images of slightly
+/// different sizes do not make the service map it again each time.
+//===========================================================================
+uint32_t* ServiceClient::GetInputBuffer(const int& width, const int& height, const int& maxBoxes)
+{
+	if( width <= 0 || height <= 0 || maxBoxes < 0 )
+	{
+		m_error = "bad image size";
+		return NULL;
+	}
+	const size_t needed = ServiceLayout(width, height, maxBoxes).total;
+	if( needed <= m_size ) return (uint32_t*)m_base;
+
+	if( m_shmFd < 0 )
+	{
+		char name[SERVICE_SHM_NAME_SIZE];
+		sprintf(name, "/srd-%d-%u", int(getpid()), s_objectCount.fetch_add(1));
+		m_shmFd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if( m_shmFd < 0 )
+		{
+			m_error = string("cannot create ") + name + ": " + strerror(errno);
+			return NULL;
+		}
+		m_shmName = name;
+	}
+	if( m_base ) munmap(m_base, m_size);
+	m_base = NULL;
+	m_size = 0;
+
+	const size_t step = size_t(1) << 20;
+	const size_t size = (needed + step - 1)/step*step;
+	void* base = MAP_FAILED;
+	if( 0 == ftruncate(m_shmFd, off_t(size)) )
+	{
+		base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_shmFd, 0);
+	}
+	if( MAP_FAILED == base )
+	{
+		m_error = "cannot grow " + m_shmName + ": " + strerror(errno);
+		ReleaseShared();
+		return NULL;
+	}
+	m_base = (unsigned char*)base;
+	m_size = size;
+	return (uint32_t*)m_base;
+}
+
+//===========================================================================
+///	Process
+//===========================================================================
+bool ServiceClient::Process(
+	const ServiceJob&				job,
+	const vector<unsigned int>&		img,
+	const int&						width,
+	const int&						height,
+	ServiceReply&					reply)
+{
+	if( width <= 0 || height <= 0 || img.size() != size_t(width)*size_t(height) )
+	{
+		m_error = "image and size do not agree";
+		return false;
+	}
+	uint32_t* input = GetInputBuffer(width, height, job.maxBoxes);
+	if( NULL == input ) return false;
+	memcpy(input, &img[0], 4*img.size());
+	return Process(job, width, height, reply);
+}
+
+bool ServiceClient::Process(
+	const ServiceJob&				job,
+	const int&						width,
+	const int&						height,
+	ServiceReply&					reply)
+{
+	reply = ServiceReply();
+	const ServiceLayout layout(width, height, job.maxBoxes);
+	if( !IsConnected() )
+	{
+		m_error = "not connected";
+		return false;
+	}
+	if( width <= 0 || height <= 0 || job.maxBoxes < 0 || NULL == m_base || layout.total > m_size )
+	{
+		m_error = "no input buffer for an image of this size";
+		return false;
+	}
+
+	ServiceRequest request;
+	memset(&request, 0, sizeof(request));
+	request.magic			= SERVICE_MAGIC;
+	request.version			= SERVICE_VERSION;
+	request.id				= m_nextId++;
+	request.priority		= job.priority;
+	request.results			= job.results;
+	request.width			= width;
+	request.height			= height;
+	request.sigmaS			= job.sigmaS;
+	request.sigmaR			= job.sigmaR;
+	request.minRegion		= job.minRegion;
+	request.maxBoxes		= job.maxBoxes;
+	request.salientFactor	= job.salientFactor;
+	request.budget			= job.budget;
+	request.shmSize			= m_size;
+	strcpy(request.shmName, m_shmName.c_str());
+
+	chrono::steady_clock::time_point sent = chrono::steady_clock::now();
+	ServiceResponse response;
+	bool received = WriteFull(m_socket, &request, sizeof(request));
+	// only one request is in flight, but skip any stray answer all the same
+	while( received && (received = ReadFull(m_socket, &response, sizeof(response))) && response.id != request.id ) {}
+	if( !received || response.magic != SERVICE_MAGIC )
+	{
+		m_error = received ? "not a response of this protocol" : "connection to the service lost";
+		Close();
+		return false;
+	}
+	reply.roundTripMs = chrono::duration<double, milli>(chrono::steady_clock::now() - sent).count();
+
+	response.error[SERVICE_ERROR_SIZE - 1] = 0;
+	reply.status	= int(response.status);
+	reply.error		= response.error;
+	reply.queueMs	= response.queueMs;
+	reply.processMs	= response.processMs;
+	if( SERVICE_OK != response.status ) return true;
+
+	reply.numlabels	= response.numlabels;
+	reply.numboxes	= response.numboxes;
+	reply.quality	= response.quality;
+	if( job.results & SERVICE_RESULT_LABELS )	reply.labels	= (const int*)(m_base + layout.labels);
+	if( job.results & SERVICE_RESULT_SALMAP )	reply.salmap	= (const float*)(m_base + layout.salmap);
+	if( job.results & SERVICE_RESULT_MASK )		reply.mask		= m_base + layout.mask;
+	if( job.results & SERVICE_RESULT_BOXES )
+	{
+		const ServiceBox* boxes = (const ServiceBox*)(m_base + layout.boxes);
+		reply.boxes.assign(boxes, boxes + min(response.numboxes, job.maxBoxes));
+	}
+	return true;
+}
@@ -0,0 +1,116 @@
+// ServiceClient.h: interface for the ServiceClient class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Client of SegmentationService, for programs that segment images without
+// starting a process or writing files per image. POSIX only.
+//
+//   ServiceClient client;
+//   client.Connect("/tmp/salientregion.sock");
+//   uint32_t* pixels = client.GetInputBuffer(width, height, job.maxBoxes);
+//   ... write the 0x00RRGGBB pixels, or pass a vector to Process() ...
+//   ServiceReply reply;
+//   if( client.Process(job, width, height, reply) && SERVICE_OK == reply.status )
+//       ... reply.labels[y*width + x] ...
+//
+// The client owns one shared memory object, grown as needed, which it
+// removes on Close(); the result pointers of a reply point into it and are
+// valid until the next request. A client is meant for one thread; a program
+// that wants requests in flight together opens a client per thread.
+//===========================================================================
+
+#if !defined(_SERVICECLIENT_H_INCLUDED_)
+#define _SERVICECLIENT_H_INCLUDED_
+
+#include <vector>
+#include <string>
+#include "ServiceProtocol.h"
+using namespace std;
+
+struct ServiceJob
+{
+	int					priority;		// ServicePriority or any value between
+	unsigned int		results;		// ServiceResultFlag combination
+	int					sigmaS;			// see SaliencyParams
+	float				sigmaR;
+	int					minRegion;
+	double				salientFactor;
+	double				budget;			// segmentation budget in ms, 0 for none
+	int					maxBoxes;		// boxes returned at most
+
+	ServiceJob()
+		: priority(SERVICE_PRIORITY_BULK), results(SERVICE_RESULT_ALL), sigmaS(7), sigmaR(10), minRegion(20),
+		  salientFactor(2.0), budget(0), maxBoxes(256) {}
+};
+
+struct ServiceReply
+{
+	int					status;			// ServiceStatus
+	string				error;
+	int					numlabels;
+	int					numboxes;		// found, of which boxes holds at most maxBoxes
+	int					quality;		// SegmentationQuality
+	double				queueMs;		// as measured by the service
+	double				processMs;
+	double				roundTripMs;	// as measured by the client
+
+	// into the shared memory object, NULL when not requested or not SERVICE_OK
+	const int*			labels;
+	const float*		salmap;
+	const unsigned char* mask;
+	vector<ServiceBox>	boxes;
+
+	ServiceReply()
+		: status(SERVICE_OK), numlabels(0), numboxes(0), quality(0), queueMs(0), processMs(0), roundTripMs(0),
+		  labels(NULL), salmap(NULL), mask(NULL) {}
+};
+
+class ServiceClient
+{
+public:
+	ServiceClient();
+	virtual ~ServiceClient();
+
+	bool Connect(const string& socketPath);
+	void Close();
+	bool IsConnected() const { return m_socket >= 0; }
+
+	// Input area of the shared memory object, made large enough for an image
+	// of this size and its results; NULL, with GetError(), if it cannot be.
+	uint32_t* GetInputBuffer(const int& width, const int& height, const int& maxBoxes);
+
+	// Sends the image written with GetInputBuffer() and waits for the reply.
+	// false, with GetError(), when the service cannot be reached, after which
+	// the client is disconnected; otherwise see reply.status.
+	bool Process(
+		const ServiceJob&				job,
+		const int&						width,
+		const int&						height,
+		ServiceReply&					reply);
+
+	// copies img into the object first
+	bool Process(
+		const ServiceJob&				job,
+		const vector<unsigned int>&		img,
+		const int&						width,
+		const int&						height,
+		ServiceReply&					reply);
+
+	const string& GetError() const { return m_error; }
+
+private:
+	ServiceClient(const ServiceClient&);
+	ServiceClient& operator=(const ServiceClient&);
+
+	void ReleaseShared();
+
+	int					m_socket;
+	int					m_shmFd;
+	string				m_shmName;
+	unsigned char*		m_base;
+	size_t				m_size;
+	uint64_t			m_nextId;
+	string				m_error;
+};
+
+#endif // !defined(_SERVICECLIENT_H_INCLUDED_)
@@ -0,0 +1,286 @@
+// ServiceLoadGenerator.cpp : load of bulk and interactive clients on the segmentation service
+//
+//===========================================================================
+// Drives a running SalientRegionDaemon with two classes of clients for a
+// fixed time and reports, per class, the throughput and the latency
+// distribution, to check that interactive requests are not held behind
+// bulk ones and to size the workers and the reserve of a deployment.
+//
+// Usage:
+//   ServiceLoadGenerator [options]
+//
+// Bulk clients run a closed loop: each sends its next large image as soon
+// as the last one is answered, keeping the workers busy. Interactive
+// clients run an open loop: requests for small images arrive at Poisson
+// times at the given total rate, and the latency of a request is measured
+// from the time it was due rather than from the time it could be sent, so
+// a slow service is not hidden by the client waiting on it. The images
+// come from MakeSyntheticImage, one per client.
+//===========================================================================
+
+#include "ServiceClient.h"
+#include "SyntheticImage.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+typedef chrono::steady_clock LoadClock;
+
+struct LoadOptions
+{
+	string				socketPath;
+	double				duration;			// seconds
+	int					bulkClients;
+	int					bulkWidth;
+	int					bulkHeight;
+	int					interactiveClients;
+	double				interactiveRate;	// requests per second, all clients together
+	int					interactiveWidth;
+	int					interactiveHeight;
+	double				budget;				// ms, interactive requests only
+	unsigned int		seed;
+
+	LoadOptions()
+		: socketPath("/tmp/salientregion.sock"), duration(10), bulkClients(1), bulkWidth(1024), bulkHeight(768),
+		  interactiveClients(1), interactiveRate(4), interactiveWidth(320), interactiveHeight(240),
+		  budget(0), seed(1) {}
+};
+
+//=================================================================================
+///	ClassResult
+///
+///	Requests of one class; latencies are those of the requests answered
+///	SERVICE_OK, in milliseconds.
+//=================================================================================
+struct ClassResult
+{
+	int					requests;
+	int					busy;
+	int					failed;				// other statuses, and lost connections
+	int					degraded;
+	double				queueMs;
+	double				processMs;
+	vector<double>		latencies;
+
+	ClassResult() : requests(0), busy(0), failed(0), degraded(0), queueMs(0), processMs(0) {}
+
+	void Add(const ClassResult& other)
+	{
+		requests	+= other.requests;
+		busy		+= other.busy;
+		failed		+= other.failed;
+		degraded	+= other.degraded;
+		queueMs		+= other.queueMs;
+		processMs	+= other.processMs;
+		latencies.insert(latencies.end(), other.latencies.begin(), other.latencies.end());
+	}
+};
+
+static void PrintUsage(const char* prog)
+{
+	cerr << "Usage: " << prog << " [options]\n"
+		 << "Options:\n"
+		 << "  --socket <path>            socket of the service (default /tmp/salientregion.sock)\n"
+		 << "  --duration <s>             length of the run (default 10)\n"
+		 << "  --bulk-clients <n>         closed loop clients (default 1)\n"
+		 << "  --bulk-size <WxH>          their images (default 1024x768)\n"
+		 << "  --interactive-clients <n>  open loop clients (default 1)\n"
+		 << "  --interactive-rate <r>     their requests per second in all (default 4)\n"
+		 << "  --interactive-size <WxH>   their images (default 320x240)\n"
+		 << "  --budget <ms>              segmentation budget of the interactive requests (default none)\n"
+		 << "  --seed <n>                 image and arrival seed (default 1)\n";
+}
+
+static bool ParseSize(const char* text, int& width, int& height)
+{
+	return 2 == sscanf(text, "%dx%d", &width, &height) && width > 0 && height > 0;
+}
+
+static double ElapsedMs(const LoadClock::time_point& from, const LoadClock::time_point& to)
+{
+	return chrono::duration<double, milli>(to - from).count();
+}
+
+static void MakeImage(const int& width, const int& height, const unsigned int& seed, vector<UINT>& img)
+{
+	SyntheticSpec spec;
+	spec.width		= width;
+	spec.height		= height;
+	spec.regions	= 24;
+	spec.noise		= 6;
+	spec.texture	= 0.2;
+	spec.seed		= seed;
+	MakeSyntheticImage(spec, img);
+}
+
+static void Record(const bool& sent, const ServiceReply& reply, const double& latency, ClassResult& result)
+{
+	result.requests++;
+	if( !sent )									result.failed++;
+	else if( SERVICE_BUSY == reply.status )		result.busy++;
+	else if( SERVICE_OK != reply.status )		result.failed++;
+	else
+	{
+		if( reply.quality != 0 ) result.degraded++;
+		result.queueMs		+= reply.queueMs;
+		result.processMs	+= reply.processMs;
+		result.latencies.push_back(latency);
+	}
+}
+
+//=================================================================================
+///	BulkClient
+//=================================================================================
+static void BulkClient(const LoadOptions& opt, const int& index, const LoadClock::time_point& end, ClassResult& result)
+{
+	vector<UINT> img;
+	MakeImage(opt.bulkWidth, opt.bulkHeight, opt.seed*1000 + index, img);
+
+	ServiceClient client;
+	if( !client.Connect(opt.socketPath) )
+	{
+		cerr << client.GetError() << endl;
+		return;
+	}
+	ServiceJob job;
+	job.priority = SERVICE_PRIORITY_BULK;
+
+	while( LoadClock::now() < end )
+	{
+		ServiceReply reply;
+		bool sent = client.Process(job, img, opt.bulkWidth, opt.bulkHeight, reply);
+		Record(sent, reply, reply.roundTripMs, result);
+		if( !sent && !client.Connect(opt.socketPath) ) break;
+	}
+}
+
+//=================================================================================
+///	InteractiveClient
+///
+///	Arrivals at exponential intervals; a request due while the last one is
+///	still out is sent when that one is answered, late, and counted from
+///	when it was due.
+//=================================================================================
+static void InteractiveClient(const LoadOptions& opt, const int& index, const LoadClock::time_point& end, ClassResult& result)
+{
+	vector<UINT> img;
+	MakeImage(opt.interactiveWidth, opt.interactiveHeight, opt.seed*1000 + 500 + index, img);
+
+	ServiceClient client;
+	if( !client.Connect(opt.socketPath) )
+	{
+		cerr << client.GetError() << endl;
+		return;
+	}
+	ServiceJob job;
+	job.priority	= SERVICE_PRIORITY_INTERACTIVE;
+	job.budget		= opt.budget;
+
+	mt19937 random(opt.seed*7919 + index);
+	exponential_distribution<double> interval(opt.interactiveRate/opt.interactiveClients);
+	LoadClock::time_point due = LoadClock::now();
+	for(;;)
+	{
+		due += chrono::duration_cast<LoadClock::duration>(chrono::duration<double>(interval(random)));
+		if( due >= end ) break;
+		this_thread::sleep_until(due);
+
+		ServiceReply reply;
+		bool sent = client.Process(job, img, opt.interactiveWidth, opt.interactiveHeight, reply);
+		Record(sent, reply, ElapsedMs(due, LoadClock::now()), result);
+		if( !sent && !client.Connect(opt.socketPath) ) break;
+	}
+}
+
+static double Percentile(const vector<double>& sorted, const double& p)
+{
+	if( sorted.empty() ) return 0;
+	size_t i = size_t(p*(sorted.size() - 1) + 0.5);
+	return sorted[min(i, sorted.size() - 1)];
+}
+
+static void PrintClass(const char* name, ClassResult& result, const double& seconds)
+{
+	vector<double>& l = result.latencies;
+	sort(l.begin(), l.end());
+	int ok = int(l.size());
+	printf("%-12s requests=%d ok=%d busy=%d failed=%d degraded=%d rate=%.2f/s\n",
+		name, result.requests, ok, result.busy, result.failed, result.degraded, ok/seconds);
+	if( ok > 0 )
+	{
+		printf("%-12s latency p50=%.1fms p90=%.1fms p99=%.1fms max=%.1fms, mean queue=%.1fms process=%.1fms\n",
+			"", Percentile(l, 0.5), Percentile(l, 0.9), Percentile(l, 0.99), l.back(),
+			result.queueMs/ok, result.processMs/ok);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	LoadOptions opt;
+
+	for( int a = 1; a < argc; a++ )
+	{
+		string arg(argv[a]);
+		bool hasvalue = a + 1 < argc;
+		bool good(true);
+		if( arg == "--socket" && hasvalue )						opt.socketPath = argv[++a];
+		else if( arg == "--duration" && hasvalue )				opt.duration = atof(argv[++a]);
+		else if( arg == "--bulk-clients" && hasvalue )			opt.bulkClients = atoi(argv[++a]);
+		else if( arg == "--bulk-size" && hasvalue )				good = ParseSize(argv[++a], opt.bulkWidth, opt.bulkHeight);
+		else if( arg == "--interactive-clients" && hasvalue )	opt.interactiveClients = atoi(argv[++a]);
+		else if( arg == "--interactive-rate" && hasvalue )		opt.interactiveRate = atof(argv[++a]);
+		else if( arg == "--interactive-size" && hasvalue )		good = ParseSize(argv[++a], opt.interactiveWidth, opt.interactiveHeight);
+		else if( arg == "--budget" && hasvalue )				opt.budget = atof(argv[++a]);
+		else if( arg == "--seed" && hasvalue )					opt.seed = unsigned(strtoul(argv[++a], NULL, 10));
+		else good = false;
+		if( !good )
+		{
+			cerr << "unknown, incomplete or bad option " << arg << endl;
+			PrintUsage(argv[0]);
+			return 2;
+		}
+	}
+	if( !(opt.duration > 0) || opt.bulkClients < 0 || opt.interactiveClients < 0 ||
+		opt.bulkClients + opt.interactiveClients < 1 || !(opt.budget >= 0) ||
+		(opt.interactiveClients > 0 && !(opt.interactiveRate > 0)) )
+	{
+		PrintUsage(argv[0]);
+		return 2;
+	}
+
+	vector<ClassResult> bulk(opt.bulkClients), interactive(opt.interactiveClients);
+	vector<thread> clients;
+	LoadClock::time_point start = LoadClock::now();
+	LoadClock::time_point end = start + chrono::duration_cast<LoadClock::duration>(chrono::duration<double>(opt.duration));
+	for( int c = 0; c < opt.bulkClients; c++ )
+	{
+		clients.push_back(thread(BulkClient, cref(opt), c, end, ref(bulk[c])));
+	}
+	for( int c = 0; c < opt.interactiveClients; c++ )
+	{
+		clients.push_back(thread(InteractiveClient, cref(opt), c, end, ref(interactive[c])));
+	}
+	for( size_t c = 0; c < clients.size(); c++ ) clients[c].join();
+	double seconds = ElapsedMs(start, LoadClock::now())/1000.0;
+
+	ClassResult bulkTotal, interactiveTotal;
+	for( size_t c = 0; c < bulk.size(); c++ )			bulkTotal.Add(bulk[c]);
+	for( size_t c = 0; c < interactive.size(); c++ )	interactiveTotal.Add(interactive[c]);
+
+	printf("%.1fs, %d bulk clients at %dx%d, %d interactive clients at %dx%d and %.2f/s",
+		seconds, opt.bulkClients, opt.bulkWidth, opt.bulkHeight,
+		opt.interactiveClients, opt.interactiveWidth, opt.interactiveHeight, opt.interactiveRate);
+	if( opt.budget > 0 ) printf(", budget %.0fms", opt.budget);
+	printf("\n");
+	if( opt.interactiveClients > 0 )	PrintClass("interactive", interactiveTotal, seconds);
+	if( opt.bulkClients > 0 )			PrintClass("bulk", bulkTotal, seconds);
+	return 0;
+}
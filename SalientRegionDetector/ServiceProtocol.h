@@ -0,0 +1,147 @@
+// ServiceProtocol.h: messages of the segmentation service.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// What SegmentationService and ServiceClient exchange over the Unix domain
+// socket of the service. Both ends run on the same machine, so the messages
+// are fixed size structures in the host's byte order; the pixels do not go
+// through the socket but through a POSIX shared memory object created by
+// the client:
+//
+//   client                                 service
+//   writes the image into its object
+//   ServiceRequest (object name, size) -->
+//                                          opens the object (kept open for
+//                                          the next requests of the client),
+//                                          queues the job by priority, reads
+//                                          the image from the object and
+//                                          writes the selected results into
+//                                          it
+//                                     <--  ServiceResponse (counts, status)
+//   reads the results in place
+//
+// The object is laid out by ServiceLayout: the input pixels, then the
+// labels, the saliency map, the mask of the salient segments and the boxes,
+// each area starting on a 64 byte boundary. A client may send several
+// requests before reading the responses, which carry the request id and
+// come back in the order the jobs finish; a request must then use its own
+// object, since the results are written into it. Since the service keeps
+// the objects open by name, a client must not give a new object the name
+// of one it has used before. The service only reads and writes the object
+// through its descriptor and never maps it, so a client that shrinks its
+// object while the job runs gets SERVICE_SHM_ERROR and harms nobody else.
+//===========================================================================
+
+#if !defined(_SERVICEPROTOCOL_H_INCLUDED_)
+#define _SERVICEPROTOCOL_H_INCLUDED_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SERVICE_MAGIC				0x53524453u		// "SDRS"
+#define SERVICE_VERSION				1
+#define SERVICE_SHM_NAME_SIZE		64
+#define SERVICE_ERROR_SIZE			96
+
+//---------------------------------------------------------------------------
+// Jobs of a higher priority are started first, those of the same priority
+// in the order they came. Workers reserved for interactive jobs (see
+// ServiceSettings) only take jobs of SERVICE_PRIORITY_INTERACTIVE or above.
+//---------------------------------------------------------------------------
+enum ServicePriority
+{
+	SERVICE_PRIORITY_BULK			= 0,
+	SERVICE_PRIORITY_INTERACTIVE	= 10
+};
+
+// results written into the shared memory object
+enum ServiceResultFlag
+{
+	SERVICE_RESULT_LABELS			= 0x1,		// int32 label per pixel
+	SERVICE_RESULT_SALMAP			= 0x2,		// float saliency in [0,255] per pixel
+	SERVICE_RESULT_MASK				= 0x4,		// 255 on the salient segments, 0 elsewhere
+	SERVICE_RESULT_BOXES			= 0x8,		// ServiceBox per salient region box
+	SERVICE_RESULT_ALL				= 0xf
+};
+
+enum ServiceStatus
+{
+	SERVICE_OK						= 0,
+	SERVICE_BAD_REQUEST				= 1,		// malformed request or parameters
+	SERVICE_SHM_ERROR				= 2,		// the object cannot be opened, read or written, or is too small
+	SERVICE_BUSY					= 3,		// the queue is full, try again later
+	SERVICE_CANCELED				= 4,		// the service is stopping
+	SERVICE_FAILED					= 5			// the processing failed, see error
+};
+
+struct ServiceRequest
+{
+	uint32_t			magic;
+	uint32_t			version;
+	uint64_t			id;						// echoed in the response
+	int32_t				priority;				// ServicePriority or any value between
+	uint32_t			results;				// ServiceResultFlag combination
+	int32_t				width;
+	int32_t				height;
+	int32_t				sigmaS;					// see SaliencyParams
+	float				sigmaR;
+	int32_t				minRegion;
+	int32_t				maxBoxes;				// room for boxes in the object
+	double				salientFactor;
+	double				budget;					// segmentation budget in ms, 0 for none
+	uint64_t			shmSize;				// size of the object, at least ServiceLayout().total
+	char				shmName[SERVICE_SHM_NAME_SIZE];	// "/name", NUL terminated
+};
+
+struct ServiceResponse
+{
+	uint32_t			magic;
+	uint32_t			status;					// ServiceStatus
+	uint64_t			id;
+	int32_t				numlabels;
+	int32_t				numboxes;				// boxes found, of which at most maxBoxes written
+	int32_t				quality;				// SegmentationQuality
+	int32_t				reserved;
+	double				queueMs;				// from the request being read to a worker taking it
+	double				processMs;
+	char				error[SERVICE_ERROR_SIZE];	// NUL terminated, for SERVICE_FAILED and others
+};
+
+// salient region box, see SaliencyBox
+struct ServiceBox
+{
+	int32_t				label;
+	int32_t				x;
+	int32_t				y;
+	int32_t				width;
+	int32_t				height;
+	int32_t				pointCount;
+};
+
+//---------------------------------------------------------------------------
+// Byte offsets of the areas of the shared memory object of a request.
+//---------------------------------------------------------------------------
+struct ServiceLayout
+{
+	size_t				input;					// uint32 0x00RRGGBB per pixel, row-major
+	size_t				labels;
+	size_t				salmap;
+	size_t				mask;
+	size_t				boxes;
+	size_t				total;
+
+	ServiceLayout(const int& width, const int& height, const int& maxBoxes)
+	{
+		const size_t pixels = (width > 0 && height > 0) ? size_t(width)*size_t(height) : 0;
+		input	= 0;
+		labels	= Align(input + 4*pixels);
+		salmap	= Align(labels + 4*pixels);
+		mask	= Align(salmap + 4*pixels);
+		boxes	= Align(mask + pixels);
+		total	= Align(boxes + sizeof(ServiceBox)*size_t(maxBoxes > 0 ? maxBoxes : 0));
+	}
+
+	static size_t Align(const size_t& offset) { return (offset + 63) & ~size_t(63); }
+};
+
+#endif // !defined(_SERVICEPROTOCOL_H_INCLUDED_)
@@ -0,0 +1,582 @@
+// StageCache.cpp: implementation of the StageCache class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StageCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#include <sys/utime.h>
+#define getpid		_getpid
+#define utime		_utime
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+static const char		s_magic[4] = {'S', 'R', 'D', 'C'};
+static const char*		s_suffix = ".sce";
+
+//---------------------------------------------------------------------------
+// 64-bit hash, two lanes of multiply-rotate over 8-byte words and a final
+// avalanche. Fast enough to be lost next to the image decoding; it is only
+// used to name cache entries, not against deliberate collisions.
+//---------------------------------------------------------------------------
+static const uint64_t	s_prime1 = 0x9e3779b185ebca87ULL;
+static const uint64_t	s_prime2 = 0xc2b2ae3d27d4eb4fULL;
+
+static inline uint64_t Rotl(const uint64_t& x, const int& r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t Avalanche(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+//---------------------------------------------------------------------------
+// The hash fed piece by piece, for images hashed row by row; gives what
+// HashBytes gives for the same bytes in one piece.
+//---------------------------------------------------------------------------
+class ByteHasher
+{
+public:
+	ByteHasher(const uint64_t& seed) : m_a(seed + s_prime1), m_b(seed ^ s_prime2), m_pending(0), m_size(0) {}
+
+	void Update(const void* data, size_t size)
+	{
+		const unsigned char* p = (const unsigned char*)data;
+		m_size += size;
+		if( m_pending )
+		{
+			size_t n = min(size, sizeof(m_block) - m_pending);
+			memcpy(m_block + m_pending, p, n);
+			m_pending += n;
+			p += n;
+			size -= n;
+			if( m_pending < sizeof(m_block) ) return;
+			Block(m_block);
+			m_pending = 0;
+		}
+		for( ; size >= sizeof(m_block); p += sizeof(m_block), size -= sizeof(m_block) ) Block(p);
+		if( size ) memcpy(m_block, p, size);
+		m_pending = size;
+	}
+
+	uint64_t Final() const
+	{
+		uint64_t a = m_a;
+		uint64_t tail(0);
+		for( size_t k = 0; k < m_pending; k++ )
+		{
+			tail ^= uint64_t(m_block[k]) << (8*(k & 7));
+			if( (k & 7) == 7 ) { a = Rotl(a ^ (tail * s_prime2), 31) * s_prime1; tail = 0; }
+		}
+		a ^= tail * s_prime2;
+		return Avalanche(a ^ Rotl(m_b, 17) ^ uint64_t(m_size));
+	}
+
+private:
+	void Block(const unsigned char* p)
+	{
+		uint64_t w0, w1;
+		memcpy(&w0, p, 8);
+		memcpy(&w1, p + 8, 8);
+		m_a = Rotl(m_a ^ (w0 * s_prime2), 31) * s_prime1;
+		m_b = Rotl(m_b ^ (w1 * s_prime2), 29) * s_prime1;
+	}
+
+	uint64_t			m_a;
+	uint64_t			m_b;
+	unsigned char		m_block[16];
+	size_t				m_pending;
+	uint64_t			m_size;
+};
+
+static uint64_t HashBytes(const void* data, const size_t& size, const uint64_t& seed)
+{
+	ByteHasher hasher(seed);
+	hasher.Update(data, size);
+	return hasher.Final();
+}
+
+static size_t AlignUp(const size_t& n)
+{
+	return (n + 7) & ~size_t(7);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+StageCache::StageCache()
+	: m_cap(0), m_bytes(0), m_clock(0), m_tmpcount(0)
+{
+
+}
+
+StageCache::~StageCache()
+{
+
+}
+
+//===========================================================================
+///	Open
+///
+///	The entries found are ordered by their file times, oldest first.
+//===========================================================================
+bool StageCache::Open(const string& folder, const uint64_t& capBytes)
+{
+	lock_guard<mutex> lk(m_lock);
+	m_folder.clear();
+	m_entries.clear();
+	m_order.clear();
+	m_bytes = 0;
+	m_cap	= capBytes;
+	if( folder.empty() ) return false;
+
+	string dir(folder);
+	char last = dir[dir.size()-1];
+	if( last == '/' || last == '\\' ) dir.erase(dir.size()-1);
+
+	struct Found { uint64_t time; uint64_t key; uint64_t size; };
+	vector<Found> found(0);
+#ifdef _WIN32
+	_mkdir(dir.c_str());
+	DWORD attr = GetFileAttributesA(dir.c_str());
+	if( INVALID_FILE_ATTRIBUTES == attr || !(attr & FILE_ATTRIBUTE_DIRECTORY) ) return false;
+
+	WIN32_FIND_DATAA fd;
+	HANDLE h = FindFirstFileA((dir + "\\*" + s_suffix).c_str(), &fd);
+	if( INVALID_HANDLE_VALUE != h )
+	{
+		do
+		{
+			string name(fd.cFileName);
+			if( name.size() != 16 + strlen(s_suffix) ) continue;
+			string hex = name.substr(0, 16);
+			char* end(NULL);
+			Found f;
+			f.key	= strtoull(hex.c_str(), &end, 16);
+			if( *end != '\0' ) continue;
+			f.time	= (uint64_t(fd.ftLastWriteTime.dwHighDateTime) << 32) | fd.ftLastWriteTime.dwLowDateTime;
+			f.size	= (uint64_t(fd.nFileSizeHigh) << 32) | fd.nFileSizeLow;
+			found.push_back(f);
+		} while( FindNextFileA(h, &fd) );
+		FindClose(h);
+	}
+	m_folder = dir + "\\";
+#else
+	mkdir(dir.c_str(), 0777);
+	DIR* d = opendir(dir.c_str());
+	if( NULL == d ) return false;
+	m_folder = dir + "/";
+	struct dirent* de;
+	while( NULL != (de = readdir(d)) )
+	{
+		string name(de->d_name);
+		if( name.size() != 16 + strlen(s_suffix) || name.compare(16, string::npos, s_suffix) != 0 ) continue;
+		string hex = name.substr(0, 16);
+		char* end(NULL);
+		Found f;
+		f.key = strtoull(hex.c_str(), &end, 16);
+		if( *end != '\0' ) continue;
+		struct stat st;
+		if( stat((m_folder + name).c_str(), &st) != 0 ) continue;
+		f.time	= uint64_t(st.st_mtime);
+		f.size	= uint64_t(st.st_size);
+		found.push_back(f);
+	}
+	closedir(d);
+#endif
+
+	sort(found.begin(), found.end(), [](const Found& x, const Found& y) { return x.time < y.time; });
+	for( size_t i = 0; i < found.size(); i++ ) Insert(found[i].key, found[i].size);
+	Evict();
+	return true;
+}
+
+//===========================================================================
+///	ImageKey
+//===========================================================================
+uint64_t StageCache::ImageKey(
+	const vector<UINT>&				inputimg,
+	const int&						width,
+	const int&						height)
+{
+	uint64_t seed = (uint64_t(uint32_t(width)) << 32 | uint32_t(height)) ^ STAGE_CACHE_VERSION;
+	return HashBytes(inputimg.empty() ? NULL : &inputimg[0], inputimg.size()*sizeof(UINT), seed);
+}
+
+// the key of the same pixels in a 0x00RRGGBB buffer
+uint64_t StageCache::ImageKey(
+	const ImageView&				image)
+{
+	uint64_t seed = (uint64_t(uint32_t(image.width)) << 32 | uint32_t(image.height)) ^ STAGE_CACHE_VERSION;
+	if( image.IsEmpty() ) return HashBytes(NULL, 0, seed);
+	if( image.IsContiguousXRGB() ) return HashBytes(image.data, size_t(image.width)*image.height*sizeof(UINT), seed);
+
+	ByteHasher hasher(seed);
+	vector<UINT> scratch(image.width);
+	for( int y = 0; y < image.height; y++ )
+	{
+		hasher.Update(image.ReadRow(y, &scratch[0]), sizeof(UINT)*image.width);
+	}
+	return hasher.Final();
+}
+
+uint64_t StageCache::SaliencyKey(
+	const uint64_t&					imageKey)
+{
+	uint64_t words[2] = {imageKey, STAGE_CACHE_SALIENCY};
+	return HashBytes(words, sizeof(words), STAGE_CACHE_VERSION);
+}
+
+uint64_t StageCache::SegmentationKey(
+	const uint64_t&					imageKey,
+	const SaliencyParams&			params)
+{
+	uint32_t sigmaR(0);
+	memcpy(&sigmaR, &params.sigmaR, sizeof(sigmaR));
+	uint64_t words[4] = {imageKey, STAGE_CACHE_SEGMENTATION,
+		uint64_t(uint32_t(params.sigmaS)) << 32 | sigmaR, uint64_t(uint32_t(params.minRegion))};
+	return HashBytes(words, sizeof(words), STAGE_CACHE_VERSION);
+}
+
+//===========================================================================
+///	LoadSaliency
+//===========================================================================
+bool StageCache::LoadSaliency(
+	const uint64_t&					key,
+	const int&						width,
+	const int&						height,
+	vector<double>&					salmap)
+{
+	MappedFile file;
+	const StageCacheHeader* header(NULL);
+	if( !MapEntry(key, STAGE_CACHE_SALIENCY, width, height, file, header) ) return false;
+
+	const size_t sz = size_t(width)*height;
+	if( header->payloadSize != sz*sizeof(double) )
+	{
+		Drop(key, true);
+		return false;
+	}
+	const double* p = (const double*)(file.GetData() + sizeof(StageCacheHeader));
+	salmap.assign(p, p + sz);
+	Touch(key, file.GetSize());
+	return true;
+}
+
+//===========================================================================
+///	LoadSegmentation
+///
+///	Every label is checked against the region count, so that a damaged
+/// entry cannot send the later stages out of their tables.
+//===========================================================================
+bool StageCache::LoadSegmentation(
+	const uint64_t&					key,
+	const int&						width,
+	const int&						height,
+	StageSegmentation&				seg)
+{
+	MappedFile file;
+	const StageCacheHeader* header(NULL);
+	if( !MapEntry(key, STAGE_CACHE_SEGMENTATION, width, height, file, header) ) return false;
+
+	const size_t sz			= size_t(width)*height;
+	const int numlabels		= header->numlabels;
+	const size_t modesAt	= AlignUp(sz*sizeof(int32_t));
+	const size_t colorsAt	= modesAt + size_t(numlabels)*3*sizeof(float);
+	bool valid = numlabels >= 0 && numlabels <= int(sz) &&
+		header->payloadSize == colorsAt + size_t(numlabels)*sizeof(uint32_t);
+
+	const unsigned char* payload = file.GetData() + sizeof(StageCacheHeader);
+	if( valid )
+	{
+		const int32_t* labels = (const int32_t*)payload;
+		seg.labels.resize(sz);
+		for( size_t i = 0; i < sz && valid; i++ )
+		{
+			valid = labels[i] >= 0 && labels[i] < numlabels;
+			seg.labels[i] = labels[i];
+		}
+	}
+	if( !valid )
+	{
+		seg = StageSegmentation();
+		Drop(key, true);
+		return false;
+	}
+	const float* modes		= (const float*)(payload + modesAt);
+	const uint32_t* colors	= (const uint32_t*)(payload + colorsAt);
+	seg.numlabels = numlabels;
+	seg.modes.assign(modes, modes + 3*numlabels);
+	seg.colors.assign(colors, colors + numlabels);
+	Touch(key, file.GetSize());
+	return true;
+}
+
+//===========================================================================
+///	StoreSaliency
+//===========================================================================
+void StageCache::StoreSaliency(
+	const uint64_t&					key,
+	const int&						width,
+	const int&						height,
+	const vector<double>&			salmap)
+{
+	const size_t sz = size_t(width)*height;
+	if( !IsOpen() || salmap.size() != sz ) return;
+
+	vector<unsigned char> bytes(sizeof(StageCacheHeader) + sz*sizeof(double), 0);
+	StageCacheHeader* header = (StageCacheHeader*)&bytes[0];
+	memcpy(header->magic, s_magic, 4);
+	header->version		= STAGE_CACHE_VERSION;
+	header->kind		= STAGE_CACHE_SALIENCY;
+	header->width		= width;
+	header->height		= height;
+	header->numlabels	= 0;
+	header->key			= key;
+	header->payloadSize	= sz*sizeof(double);
+	if( sz ) memcpy(&bytes[sizeof(StageCacheHeader)], &salmap[0], sz*sizeof(double));
+	header->checksum	= HashBytes(&bytes[sizeof(StageCacheHeader)], sz*sizeof(double), key);
+	Store(key, bytes);
+}
+
+//===========================================================================
+///	StoreSegmentation
+//===========================================================================
+void StageCache::StoreSegmentation(
+	const uint64_t&					key,
+	const int&						width,
+	const int&						height,
+	const StageSegmentation&		seg)
+{
+	const size_t sz = size_t(width)*height;
+	const size_t numlabels = size_t(seg.numlabels);
+	if( !IsOpen() || seg.labels.size() != sz || seg.modes.size() != 3*numlabels || seg.colors.size() != numlabels ) return;
+
+	const size_t modesAt	= AlignUp(sz*sizeof(int32_t));
+	const size_t colorsAt	= modesAt + numlabels*3*sizeof(float);
+	const size_t payload	= colorsAt + numlabels*sizeof(uint32_t);
+	vector<unsigned char> bytes(sizeof(StageCacheHeader) + payload, 0);
+	StageCacheHeader* header = (StageCacheHeader*)&bytes[0];
+	memcpy(header->magic, s_magic, 4);
+	header->version		= STAGE_CACHE_VERSION;
+	header->kind		= STAGE_CACHE_SEGMENTATION;
+	header->width		= width;
+	header->height		= height;
+	header->numlabels	= seg.numlabels;
+	header->key			= key;
+	header->payloadSize	= payload;
+
+	unsigned char* p = &bytes[sizeof(StageCacheHeader)];
+	for( size_t i = 0; i < sz; i++ )
+	{
+		int32_t label = seg.labels[i];
+		memcpy(p + i*sizeof(int32_t), &label, sizeof(label));
+	}
+	if( numlabels )
+	{
+		memcpy(p + modesAt, &seg.modes[0], numlabels*3*sizeof(float));
+		for( size_t n = 0; n < numlabels; n++ )
+		{
+			uint32_t color = seg.colors[n];
+			memcpy(p + colorsAt + n*sizeof(uint32_t), &color, sizeof(color));
+		}
+	}
+	header->checksum	= HashBytes(p, payload, key);
+	Store(key, bytes);
+}
+
+//===========================================================================
+///	GetStats
+//===========================================================================
+StageCacheStats StageCache::GetStats() const
+{
+	lock_guard<mutex> lk(m_lock);
+	StageCacheStats stats = m_stats;
+	stats.entries	= int(m_entries.size());
+	stats.bytes		= m_bytes;
+	return stats;
+}
+
+//===========================================================================
+///	EntryPath
+//===========================================================================
+string StageCache::EntryPath(const uint64_t& key) const
+{
+	char name[32];
+	sprintf(name, "%016llx", (unsigned long long)key);
+	return m_folder + name + s_suffix;
+}
+
+//===========================================================================
+///	MapEntry
+///
+///	Maps the entry of key and checks its header and checksum. Entries
+/// written by another process since Open() are found too; damaged ones are
+/// deleted.
+//===========================================================================
+bool StageCache::MapEntry(
+	const uint64_t&					key,
+	const StageCacheKind&			kind,
+	const int&						width,
+	const int&						height,
+	MappedFile&						file,
+	const StageCacheHeader*&		header)
+{
+	if( !IsOpen() || !file.Open(EntryPath(key)) )
+	{
+		Drop(key, false);
+		return false;
+	}
+	header = (const StageCacheHeader*)file.GetData();
+	if( file.GetSize() < sizeof(StageCacheHeader) ||
+		memcmp(header->magic, s_magic, 4) != 0 ||
+		header->version != STAGE_CACHE_VERSION ||
+		header->kind != uint32_t(kind) ||
+		header->key != key ||
+		header->payloadSize != file.GetSize() - sizeof(StageCacheHeader) ||
+		header->checksum != HashBytes(file.GetData() + sizeof(StageCacheHeader), size_t(header->payloadSize), key) )
+	{
+		file.Close();
+		Drop(key, true);
+		return false;
+	}
+	if( header->width != width || header->height != height )
+	{
+		// a hash collision; not damaged, but of no use here
+		lock_guard<mutex> lk(m_lock);
+		m_stats.misses++;
+		return false;
+	}
+	return true;
+}
+
+//===========================================================================
+///	Touch
+///
+///	A hit: makes the entry the most recently used, here and in its file time.
+//===========================================================================
+void StageCache::Touch(const uint64_t& key, const uint64_t& size)
+{
+	{
+		lock_guard<mutex> lk(m_lock);
+		m_stats.hits++;
+		Insert(key, size);
+		Evict();
+	}
+	utime(EntryPath(key).c_str(), NULL);
+}
+
+//===========================================================================
+///	Drop
+///
+///	A miss. A damaged entry is deleted.
+//===========================================================================
+void StageCache::Drop(const uint64_t& key, const bool& damaged)
+{
+	lock_guard<mutex> lk(m_lock);
+	m_stats.misses++;
+	if( !IsOpen() ) return;
+	if( damaged ) remove(EntryPath(key).c_str());
+	Erase(key);
+}
+
+//===========================================================================
+///	Store
+///
+///	Writes the entry under a name of its own and renames it into place. If
+/// the rename fails because another writer got there first (rename does
+/// not replace files on Windows), that writer's entry is kept; both hold
+/// the same data.
+//===========================================================================
+void StageCache::Store(const uint64_t& key, const vector<unsigned char>& bytes)
+{
+	if( bytes.size() > m_cap ) return;
+
+	string path = EntryPath(key);
+	char suffix[64];
+	{
+		lock_guard<mutex> lk(m_lock);
+		sprintf(suffix, ".%d.%u.tmp", int(getpid()), m_tmpcount++);
+	}
+	string tmp = path + suffix;
+
+	FILE* fp = fopen(tmp.c_str(), "wb");
+	if( NULL == fp ) return;
+	bool written = fwrite(&bytes[0], 1, bytes.size(), fp) == bytes.size();
+	written = (0 == fclose(fp)) && written;
+	if( !written || 0 != rename(tmp.c_str(), path.c_str()) )
+	{
+		remove(tmp.c_str());
+		if( !written ) return;
+		FILE* existing = fopen(path.c_str(), "rb");
+		if( NULL == existing ) return;
+		fclose(existing);
+	}
+
+	lock_guard<mutex> lk(m_lock);
+	m_stats.stores++;
+	Insert(key, bytes.size());
+	Evict();
+}
+
+//===========================================================================
+///	Insert
+///
+///	Adds or updates an entry as the most recently used.
+//===========================================================================
+void StageCache::Insert(const uint64_t& key, const uint64_t& size)
+{
+	Erase(key);
+	Entry e;
+	e.size	= size;
+	e.stamp	= ++m_clock;
+	m_entries[key]		= e;
+	m_order[e.stamp]	= key;
+	m_bytes += size;
+}
+
+void StageCache::Erase(const uint64_t& key)
+{
+	map<uint64_t, Entry>::iterator it = m_entries.find(key);
+	if( it == m_entries.end() ) return;
+	m_bytes -= it->second.size;
+	m_order.erase(it->second.stamp);
+	m_entries.erase(it);
+}
+
+//===========================================================================
+///	Evict
+///
+///	Deletes the least recently used entries until the cap is met. The
+/// newest entry always fits (Store() skips larger ones), so it stays.
+//===========================================================================
+void StageCache::Evict()
+{
+	while( m_bytes > m_cap && !m_order.empty() )
+	{
+		uint64_t key = m_order.begin()->second;
+		remove(EntryPath(key).c_str());
+		Erase(key);
+		m_stats.evictions++;
+	}
+}
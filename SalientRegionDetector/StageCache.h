@@ -0,0 +1,172 @@
+// StageCache.h: interface for the StageCache class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Persistent cache of the expensive pipeline stages, so that a rerun of
+// the same images with only downstream settings changed (selection
+// thresholds, box areas, outputs) skips the saliency map and the mean
+// shift segmentation. Entries are content addressed: the key is a hash of
+// the pixels and of the parameters the stage depends on, so a changed
+// image or a changed sigmaS, sigmaR or minRegion simply misses.
+//
+// Each entry is one file "<key>.sce" in the cache folder, holding a fixed
+// header followed by the stage data, naturally aligned so that it can be
+// read straight from a mapping:
+//
+//   saliency       width*height doubles, the map in [0,255]
+//   segmentation   width*height 32-bit labels, then per region the Lab
+//                  mode (3 floats) and the packed colour of the mode
+//
+// Entries are written to a temporary file and renamed into place, so a
+// reader never sees a partial entry, and carry a checksum that is verified
+// on every read, so a damaged one is deleted instead of used. The total size is kept under a cap by
+// evicting the least recently used entries; the order is kept in memory
+// and in the file times, so it carries over to the next run. Several
+// processes may share a folder, but each only evicts what it knows of.
+// All methods may be called from several threads at once.
+//===========================================================================
+
+#if !defined(_STAGECACHE_H_INCLUDED_)
+#define _STAGECACHE_H_INCLUDED_
+
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include "SaliencyPipeline.h"
+#include "MappedFile.h"
+using namespace std;
+
+// change when a stage would give different results for the same inputs
+#define STAGE_CACHE_VERSION		1
+
+enum StageCacheKind
+{
+	STAGE_CACHE_SALIENCY = 1,
+	STAGE_CACHE_SEGMENTATION
+};
+
+struct StageCacheHeader
+{
+	char				magic[4];		// "SRDC"
+	uint32_t			version;		// STAGE_CACHE_VERSION
+	uint32_t			kind;			// StageCacheKind
+	int32_t				width;
+	int32_t				height;
+	int32_t				numlabels;		// segmentation only
+	uint64_t			key;
+	uint64_t			payloadSize;	// bytes after the header
+	uint64_t			checksum;		// hash of those bytes
+};
+
+//---------------------------------------------------------------------------
+// Mean shift result of one image. colors[n] is the 0x00RRGGBB colour of
+// region n in the segmented image.
+//---------------------------------------------------------------------------
+struct StageSegmentation
+{
+	vector<int>			labels;
+	int					numlabels;
+	vector<float>		modes;			// 3 per region, Lab
+	vector<UINT>		colors;
+
+	StageSegmentation() : numlabels(0) {}
+};
+
+struct StageCacheStats
+{
+	int					hits;
+	int					misses;
+	int					stores;
+	int					evictions;
+	int					entries;
+	uint64_t			bytes;			// size of the entries known to this process
+
+	StageCacheStats() : hits(0), misses(0), stores(0), evictions(0), entries(0), bytes(0) {}
+};
+
+class StageCache
+{
+public:
+	StageCache();
+	virtual ~StageCache();
+
+	// Uses folder, creating it if needed, and indexes the entries already
+	// there (evicting down to capBytes). False if it cannot be created.
+	bool Open(const string& folder, const uint64_t& capBytes);
+	bool IsOpen() const { return !m_folder.empty(); }
+
+	// Hash of the pixels and size of an image, the base of the stage keys.
+	static uint64_t ImageKey(
+		const vector<UINT>&				inputimg,
+		const int&						width,
+		const int&						height);
+
+	static uint64_t ImageKey(
+		const ImageView&				image);
+
+	static uint64_t SaliencyKey(
+		const uint64_t&					imageKey);
+
+	static uint64_t SegmentationKey(
+		const uint64_t&					imageKey,
+		const SaliencyParams&			params);	// sigmaS, sigmaR and minRegion
+
+	// False on a miss, or if the entry is damaged or of another size.
+	bool LoadSaliency(
+		const uint64_t&					key,
+		const int&						width,
+		const int&						height,
+		vector<double>&					salmap);			//OUTPUT
+
+	bool LoadSegmentation(
+		const uint64_t&					key,
+		const int&						width,
+		const int&						height,
+		StageSegmentation&				seg);				//OUTPUT
+
+	// Failures to write are not reported; the stage is recomputed next time.
+	void StoreSaliency(
+		const uint64_t&					key,
+		const int&						width,
+		const int&						height,
+		const vector<double>&			salmap);
+
+	void StoreSegmentation(
+		const uint64_t&					key,
+		const int&						width,
+		const int&						height,
+		const StageSegmentation&		seg);
+
+	StageCacheStats GetStats() const;
+
+private:
+	struct Entry
+	{
+		uint64_t						size;
+		uint64_t						stamp;			// last use, larger is newer
+	};
+
+	string EntryPath(const uint64_t& key) const;
+	bool MapEntry(const uint64_t& key, const StageCacheKind& kind, const int& width, const int& height,
+		MappedFile& file, const StageCacheHeader*& header);
+	void Touch(const uint64_t& key, const uint64_t& size);
+	void Drop(const uint64_t& key, const bool& damaged);
+	void Store(const uint64_t& key, const vector<unsigned char>& bytes);
+	void Insert(const uint64_t& key, const uint64_t& size);		// these three need m_lock held
+	void Erase(const uint64_t& key);
+	void Evict();
+
+	string								m_folder;		// with a trailing separator
+	uint64_t							m_cap;
+	map<uint64_t, Entry>				m_entries;		// by key
+	map<uint64_t, uint64_t>				m_order;		// stamp -> key, least recently used first
+	uint64_t							m_bytes;
+	uint64_t							m_clock;
+	unsigned int						m_tmpcount;
+	StageCacheStats						m_stats;
+	mutable mutex						m_lock;
+};
+
+#endif // !defined(_STAGECACHE_H_INCLUDED_)
@@ -0,0 +1,244 @@
+// StagedPipeline.cpp: implementation of the StagedPipeline class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "StagedPipeline.h"
+#include "BoundedQueue.h"
+#include "Trace.h"
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <exception>
+
+typedef chrono::high_resolution_clock StageClock;
+
+static double ElapsedMs(const StageClock::time_point& start)
+{
+	return chrono::duration<double, milli>(StageClock::now() - start).count();
+}
+
+//===========================================================================
+///	Backoff
+///
+/// Waiting on a full or empty queue: spin briefly, then yield, then sleep.
+//===========================================================================
+static void Backoff(int& spins)
+{
+	spins++;
+	if( spins < 16 )		return;
+	else if( spins < 64 )	this_thread::yield();
+	else					this_thread::sleep_for(chrono::microseconds(200));
+}
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+StagedPipeline::StagedPipeline(
+	const SaliencyParams&			params,
+	const IoFunc&					decoder,
+	const IoFunc&					encoder,
+	const int&						queueCapacity)
+	: m_pipeline(params), m_decoder(decoder), m_encoder(encoder),
+	  m_queueCapacity(queueCapacity < 2 ? 2 : queueCapacity)
+{
+	for( int s = 0; s < STAGE_COUNT; s++ ) m_workers[s] = 1;
+}
+
+StagedPipeline::~StagedPipeline()
+{
+
+}
+
+void StagedPipeline::SetWorkers(const PipelineStage& stage, const int& workers)
+{
+	m_workers[stage] = (workers < 1) ? 1 : workers;
+}
+
+const char* StagedPipeline::StageName(const PipelineStage& stage)
+{
+	switch( stage )
+	{
+	case STAGE_DECODE:			return "decode";
+	case STAGE_SALIENCY:		return "saliency";
+	case STAGE_SEGMENTATION:	return "segmentation";
+	case STAGE_ENCODE:			return "encode";
+	default:					return "";
+	}
+}
+
+//===========================================================================
+///	Run
+///
+/// Decode workers take the next file name from a shared counter; every
+/// other worker pops from the queue in front of its stage and pushes to the
+/// one behind it. A stage finishes when its queue is empty and all workers
+/// of the previous stage have finished.
+//===========================================================================
+void StagedPipeline::Run(
+	const vector<string>&			filenames,
+	const DoneFunc&					done,
+	vector<StageStats>&				stats,
+	double&							wallMs)
+{
+	StageClock::time_point start = StageClock::now();
+
+	// queue[s] feeds stage s; queue[STAGE_DECODE] is unused
+	BoundedQueue<StageWork*>* queue[STAGE_COUNT] = {NULL};
+	for( int s = STAGE_SALIENCY; s < STAGE_COUNT; s++ )
+		queue[s] = new BoundedQueue<StageWork*>(m_queueCapacity);
+
+	atomic<int> nextFile(0);
+	atomic<int> active[STAGE_COUNT];
+	for( int s = 0; s < STAGE_COUNT; s++ ) active[s].store(m_workers[s]);
+
+	mutex statsLock;
+	stats.assign(STAGE_COUNT, StageStats());
+	vector<size_t> depthSamples(STAGE_COUNT, 0);
+	vector<double> depthSum(STAGE_COUNT, 0);
+	for( int s = 0; s < STAGE_COUNT; s++ )
+	{
+		stats[s].name			= StageName(PipelineStage(s));
+		stats[s].workers		= m_workers[s];
+		stats[s].queueCapacity	= queue[s] ? queue[s]->Capacity() : 0;
+	}
+
+	const int numfiles = int(filenames.size());
+
+	function<void(int)> worker = [&](int stage)
+	{
+		Trace::SetThreadName(string(StageName(PipelineStage(stage))) + " worker");
+		int items(0);
+		double busy(0);
+		size_t pushes(0), maxDepth(0);
+		double depths(0);
+
+		for(;;)
+		{
+			//-------------------------------
+			// take the next piece of work
+			//-------------------------------
+			StageWork* work = NULL;
+			if( STAGE_DECODE == stage )
+			{
+				int index = nextFile.fetch_add(1);
+				if( index >= numfiles ) break;
+				work = new StageWork;
+				work->index		= index;
+				work->filename	= filenames[index];
+			}
+			else
+			{
+				int spins(0);
+				while( !queue[stage]->TryPop(work) )
+				{
+					if( 0 == active[stage-1].load() )
+					{
+						// upstream finished: one last look, then stop
+						if( !queue[stage]->TryPop(work) ) work = NULL;
+						break;
+					}
+					Backoff(spins);
+				}
+				if( !work ) break;
+			}
+
+			//-------------------------------
+			// run the stage
+			//-------------------------------
+			StageClock::time_point t0 = StageClock::now();
+			if( !work->failed )
+			{
+				TRACE_SPAN(span, StageName(PipelineStage(stage)), "stage");
+				span.SetDetail(work->filename);
+				try
+				{
+					switch( stage )
+					{
+					case STAGE_DECODE:
+						if( !m_decoder(*work) )
+						{
+							work->failed = true;
+							if( work->error.empty() ) work->error = "cannot read image";
+						}
+						work->decodeMs = ElapsedMs(t0);
+						break;
+					case STAGE_SALIENCY:
+						m_pipeline.ProcessSaliency(work->img, work->width, work->height, work->lab, work->result);
+						break;
+					case STAGE_SEGMENTATION:
+						m_pipeline.ProcessSegmentation(work->img, work->lab, work->result);
+						break;
+					case STAGE_ENCODE:
+						if( !m_encoder(*work) )
+						{
+							work->failed = true;
+							if( work->error.empty() ) work->error = "cannot write image";
+						}
+						work->encodeMs = ElapsedMs(t0);
+						break;
+					}
+				}
+				catch( const exception& e )
+				{
+					work->failed = true;
+					work->error  = e.what();
+				}
+				catch( ... )
+				{
+					work->failed = true;
+					work->error  = "unknown error";
+				}
+			}
+			busy += ElapsedMs(t0);
+			items++;
+
+			//-------------------------------
+			// hand it on
+			//-------------------------------
+			if( STAGE_ENCODE == stage )
+			{
+				if( done ) done(*work);
+				delete work;
+			}
+			else
+			{
+				int spins(0);
+				while( !queue[stage+1]->TryPush(work) ) Backoff(spins);
+				size_t depth = queue[stage+1]->SizeApprox();
+				if( depth > maxDepth ) maxDepth = depth;
+				depths += double(depth);
+				pushes++;
+			}
+		}
+
+		lock_guard<mutex> lk(statsLock);
+		stats[stage].items	+= items;
+		stats[stage].busyMs	+= busy;
+		if( stage+1 < STAGE_COUNT )
+		{
+			if( maxDepth > stats[stage+1].maxQueueDepth ) stats[stage+1].maxQueueDepth = maxDepth;
+			depthSum[stage+1]		+= depths;
+			depthSamples[stage+1]	+= pushes;
+		}
+		active[stage].fetch_sub(1);
+	};
+
+	vector<thread> threads;
+	for( int s = 0; s < STAGE_COUNT; s++ )
+	{
+		for( int w = 0; w < m_workers[s]; w++ )
+			threads.push_back(thread(worker, s));
+	}
+	for( size_t t = 0; t < threads.size(); t++ ) threads[t].join();
+
+	for( int s = STAGE_SALIENCY; s < STAGE_COUNT; s++ ) delete queue[s];
+
+	wallMs = ElapsedMs(start);
+	for( int s = 0; s < STAGE_COUNT; s++ )
+	{
+		if( wallMs > 0 ) stats[s].utilization = stats[s].busyMs / (stats[s].workers * wallMs);
+		if( depthSamples[s] ) stats[s].meanQueueDepth = depthSum[s] / depthSamples[s];
+	}
+}
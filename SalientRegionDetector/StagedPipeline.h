@@ -0,0 +1,112 @@
+// StagedPipeline.h: interface for the StagedPipeline class.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Streams images through four stages - decode, saliency, segmentation and
+// encode - each served by its own set of worker threads. The stages are
+// connected by bounded lock-free queues (BoundedQueue), so decoding and
+// encoding overlap with the computation and the throughput is set by the
+// slowest stage; the queue capacity bounds the number of images in memory.
+// Decoding and encoding are supplied by the caller.
+//===========================================================================
+
+#if !defined(_STAGEDPIPELINE_H_INCLUDED_)
+#define _STAGEDPIPELINE_H_INCLUDED_
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <stddef.h>
+#include "SaliencyPipeline.h"
+using namespace std;
+
+enum PipelineStage
+{
+	STAGE_DECODE = 0,
+	STAGE_SALIENCY,
+	STAGE_SEGMENTATION,
+	STAGE_ENCODE,
+	STAGE_COUNT
+};
+
+//---------------------------------------------------------------------------
+// One image on its way through the stages.
+//---------------------------------------------------------------------------
+struct StageWork
+{
+	int					index;			// position in the input list
+	string				filename;
+	vector<UINT>		img;			// filled by the decoder
+	int					width;
+	int					height;
+	SaliencyLab			lab;			// saliency -> segmentation
+	SaliencyResult		result;
+	double				decodeMs;
+	double				encodeMs;
+	bool				failed;			// later stages are skipped
+	string				error;
+
+	StageWork() : index(0), width(0), height(0), decodeMs(0), encodeMs(0), failed(false) {}
+};
+
+//---------------------------------------------------------------------------
+// What each stage did during Run(). The queue figures are for the queue in
+// front of the stage (none for decode), sampled after every push.
+//---------------------------------------------------------------------------
+struct StageStats
+{
+	const char*			name;
+	int					workers;
+	int					items;
+	double				busyMs;			// summed over the workers
+	double				utilization;	// busyMs / (workers * wall time)
+	size_t				queueCapacity;
+	size_t				maxQueueDepth;
+	double				meanQueueDepth;
+
+	StageStats() : name(""), workers(0), items(0), busyMs(0), utilization(0),
+		queueCapacity(0), maxQueueDepth(0), meanQueueDepth(0) {}
+};
+
+class StagedPipeline
+{
+public:
+	// returns false if the image could not be read or written
+	typedef function<bool(StageWork&)>	IoFunc;
+	// called once per image, after encoding or failure, on an encode worker
+	typedef function<void(StageWork&)>	DoneFunc;
+
+	StagedPipeline(
+		const SaliencyParams&			params,
+		const IoFunc&					decoder,
+		const IoFunc&					encoder,
+		const int&						queueCapacity = 4);
+	virtual ~StagedPipeline();
+
+	void SetWorkers(const PipelineStage& stage, const int& workers);
+	int GetWorkers(const PipelineStage& stage) const { return m_workers[stage]; }
+
+	// see SaliencyPipeline::SetCache
+	void SetCache(StageCache* cache) { m_pipeline.SetCache(cache); }
+
+	// see SaliencyPipeline::SetCancelFlag; a canceled image fails with its error
+	void SetCancelFlag(const atomic<bool>* cancel) { m_pipeline.SetCancelFlag(cancel); }
+
+	void Run(
+		const vector<string>&			filenames,
+		const DoneFunc&					done,
+		vector<StageStats>&				stats,		// one entry per PipelineStage
+		double&							wallMs);
+
+	static const char* StageName(const PipelineStage& stage);
+
+private:
+
+	SaliencyPipeline					m_pipeline;
+	IoFunc								m_decoder;
+	IoFunc								m_encoder;
+	int									m_queueCapacity;
+	int									m_workers[STAGE_COUNT];
+};
+
+#endif // !defined(_STAGEDPIPELINE_H_INCLUDED_)
@@ -0,0 +1,159 @@
+// SyntheticImage.cpp: implementation of the synthetic test image generator.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "SyntheticImage.h"
+#include "ParallelFor.h"
+#include <cmath>
+
+namespace
+{
+	const int		BAND_ROWS	= 64;
+	const double	TWO_PI		= 6.283185307179586;
+
+	struct SyntheticSeed
+	{
+		double			x;
+		double			y;
+		int				r, g, b;
+		double			fx;				// texture wave vector, radians per pixel
+		double			fy;
+		double			phase;
+	};
+
+	//-----------------------------------------------------------------------
+	// 32-bit mix of the seed and a counter, the start of every generator
+	//-----------------------------------------------------------------------
+	unsigned int Mix(unsigned int a, unsigned int b)
+	{
+		unsigned int h = a*0x9E3779B1u ^ (b + 0x7F4A7C15u);
+		h ^= h >> 16;	h *= 0x85EBCA6Bu;
+		h ^= h >> 13;	h *= 0xC2B2AE35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+	// uniform in [0,1)
+	double NextUniform(unsigned int& state)
+	{
+		state = state*1664525u + 1013904223u;
+		return (state >> 8)*(1.0/16777216.0);
+	}
+
+	// zero mean, unit variance: the sum of four uniforms is close enough
+	// to a Gaussian for test noise and much cheaper than Box-Muller
+	double NextNoise(unsigned int& state)
+	{
+		double sum = NextUniform(state) + NextUniform(state) + NextUniform(state) + NextUniform(state);
+		return (sum - 2.0)*1.7320508075688772;
+	}
+
+	int Clamp(const double& v)
+	{
+		return v < 0 ? 0 : (v > 255 ? 255 : int(v + 0.5));
+	}
+}
+
+//===========================================================================
+///	MakeSyntheticImage
+///
+/// The seeds are jittered within the middle 80% of their grid cell, so the
+/// nearest seed of a pixel is always within two cells of the pixel's cell
+/// and a 5x5 neighbourhood of cells is searched.
+//===========================================================================
+int MakeSyntheticImage(
+	const SyntheticSpec&			spec,
+	vector<UINT>&					img,
+	vector<int>*					truth,
+	const int&						threads)
+{
+	const int width		= spec.width;
+	const int height	= spec.height;
+	img.resize(size_t(width)*height);
+	if( truth ) truth->resize(size_t(width)*height);
+	if( width <= 0 || height <= 0 ) return 0;
+
+	int regions = spec.regions < 1 ? 1 : spec.regions;
+	int gx = int(sqrt(double(regions)*width/height) + 0.5);
+	if( gx < 1 )		gx = 1;
+	if( gx > width )	gx = width;
+	int gy = int(double(regions)/gx + 0.5);
+	if( gy < 1 )		gy = 1;
+	if( gy > height )	gy = height;
+	const double cw = double(width)/gx;
+	const double ch = double(height)/gy;
+
+	vector<SyntheticSeed> seeds(size_t(gx)*gy);
+	unsigned int state = Mix(spec.seed, 0xFFFFFFFFu);
+	for( int j = 0; j < gy; j++ )
+	{
+		for( int i = 0; i < gx; i++ )
+		{
+			SyntheticSeed& s = seeds[size_t(j)*gx + i];
+			s.x = (i + 0.1 + 0.8*NextUniform(state))*cw;
+			s.y = (j + 0.1 + 0.8*NextUniform(state))*ch;
+			s.r = 32 + int(192*NextUniform(state));
+			s.g = 32 + int(192*NextUniform(state));
+			s.b = 32 + int(192*NextUniform(state));
+			double angle	= TWO_PI*NextUniform(state);
+			double period	= 6.0 + 18.0*NextUniform(state);
+			s.fx	= TWO_PI*cos(angle)/period;
+			s.fy	= TWO_PI*sin(angle)/period;
+			s.phase	= TWO_PI*NextUniform(state);
+		}
+	}
+
+	const double amplitude = 64.0*spec.texture;
+	const int bands = (height + BAND_ROWS - 1)/BAND_ROWS;
+	ParallelFor(bands, threads, [&](int band)
+	{
+		int ylast = (band + 1)*BAND_ROWS < height ? (band + 1)*BAND_ROWS : height;
+		for( int y = band*BAND_ROWS; y < ylast; y++ )
+		{
+			unsigned int rowstate = Mix(spec.seed, unsigned(y));
+			int cj = int(y/ch);
+			if( cj >= gy ) cj = gy - 1;
+			int jfirst	= cj - 2 < 0 ? 0 : cj - 2;
+			int jlast	= cj + 2 >= gy ? gy - 1 : cj + 2;
+
+			UINT* out = &img[size_t(y)*width];
+			int* lab = truth ? &(*truth)[size_t(y)*width] : NULL;
+			for( int x = 0; x < width; x++ )
+			{
+				int ci = int(x/cw);
+				if( ci >= gx ) ci = gx - 1;
+				int ifirst	= ci - 2 < 0 ? 0 : ci - 2;
+				int ilast	= ci + 2 >= gx ? gx - 1 : ci + 2;
+
+				int nearest(0);
+				double best(-1);
+				for( int j = jfirst; j <= jlast; j++ )
+				{
+					for( int i = ifirst; i <= ilast; i++ )
+					{
+						const SyntheticSeed& s = seeds[size_t(j)*gx + i];
+						double dist = (x - s.x)*(x - s.x) + (y - s.y)*(y - s.y);
+						if( best < 0 || dist < best )
+						{
+							best	= dist;
+							nearest	= j*gx + i;
+						}
+					}
+				}
+
+				const SyntheticSeed& s = seeds[nearest];
+				double tex = amplitude > 0 ? amplitude*sin(s.fx*x + s.fy*y + s.phase) : 0;
+				double r(s.r + tex), g(s.g + tex), b(s.b + tex);
+				if( spec.noise > 0 )
+				{
+					r += spec.noise*NextNoise(rowstate);
+					g += spec.noise*NextNoise(rowstate);
+					b += spec.noise*NextNoise(rowstate);
+				}
+				out[x] = UINT(Clamp(r)) << 16 | UINT(Clamp(g)) << 8 | UINT(Clamp(b));
+				if( lab ) lab[x] = nearest;
+			}
+		}
+	});
+	return gx*gy;
+}
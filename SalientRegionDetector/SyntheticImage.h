@@ -0,0 +1,49 @@
+// SyntheticImage.h: interface for the synthetic test image generator.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Test images of any size with a known number of colour regions, for
+// benchmarks that sweep the image size and for accuracy checks that need
+// a ground truth. The regions are the cells of a Voronoi diagram whose
+// seeds are jittered on a grid, so they have about the same area and the
+// region count does not change with the resolution. Each region has a
+// flat colour, optionally overlaid with a sinusoidal texture of its own
+// orientation and period, and every pixel gets approximately Gaussian
+// noise.
+//
+// The image depends only on the spec: rows are generated in bands that
+// may run on several threads, and each row draws its noise from a
+// generator seeded by the row, so the pixels are the same whatever the
+// number of threads.
+//===========================================================================
+
+#if !defined(_SYNTHETICIMAGE_H_INCLUDED_)
+#define _SYNTHETICIMAGE_H_INCLUDED_
+
+#include <vector>
+#include <stddef.h>
+using namespace std;
+
+typedef unsigned int UINT;
+
+struct SyntheticSpec
+{
+	int					width;
+	int					height;
+	int					regions;		// requested; the grid gives the nearest count it can
+	double				noise;			// standard deviation per channel, in grey levels
+	double				texture;		// texture amplitude, 0 (flat) to 1 (+-64 grey levels)
+	unsigned int		seed;
+
+	SyntheticSpec() : width(640), height(480), regions(16), noise(0), texture(0), seed(1) {}
+};
+
+// Returns the number of regions generated. truth, if given, receives the
+// region of each pixel, in [0, returned count).
+int MakeSyntheticImage(
+	const SyntheticSpec&			spec,
+	vector<UINT>&					img,				//OUTPUT: 0x00RRGGBB, row-major
+	vector<int>*					truth = NULL,		//OUTPUT: optional region per pixel
+	const int&						threads = 1);
+
+#endif // !defined(_SYNTHETICIMAGE_H_INCLUDED_)
@@ -0,0 +1,291 @@
+// Trace.cpp: implementation of the Trace spans.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "Trace.h"
+#include "MeanShiftCode/msImageProcessor.h"
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// VS2013 has no thread_local; a pointer is all that is kept per thread
+#if defined(_MSC_VER)
+#define TRACE_TLS	__declspec(thread)
+#else
+#define TRACE_TLS	__thread
+#endif
+
+namespace
+{
+	struct TraceRecord
+	{
+		const char*		name;
+		const char*		category;
+		double			start;			// microseconds
+		double			duration;
+		const char*		argName;
+		int64_t			argValue;
+		string			detail;
+	};
+
+	//-----------------------------------------------------------------------
+	// Spans of one thread. The lock is only contended while the trace is
+	// written or cleared.
+	//-----------------------------------------------------------------------
+	struct TraceBuffer
+	{
+		int					tid;
+		string				threadName;
+		mutex				lock;
+		vector<TraceRecord>	records;
+	};
+
+	// Buffers are created on a thread's first span and kept for the rest of
+	// the process, so the pointer a thread holds never dangles, not even in
+	// a thread still running while the statics are destroyed at exit.
+	mutex					s_registryLock;
+	vector<TraceBuffer*>&	s_buffers = *new vector<TraceBuffer*>;
+	bool					s_hooked(false);
+
+	TRACE_TLS TraceBuffer*	t_buffer(NULL);
+
+	TraceBuffer* ThreadBuffer()
+	{
+		if( NULL == t_buffer )
+		{
+			TraceBuffer* buffer = new TraceBuffer;
+			lock_guard<mutex> lk(s_registryLock);
+			buffer->tid = int(s_buffers.size()) + 1;
+			s_buffers.push_back(buffer);
+			t_buffer = buffer;
+		}
+		return t_buffer;
+	}
+
+	// msImageProcessor reports kernel calls in milliseconds of the same clock
+	void TraceKernel(const char* kernel, double start, double end)
+	{
+		if( Trace::IsEnabled() ) Trace::Record(kernel, "meanshift", start*1000.0, end*1000.0);
+	}
+
+	// bytes of the well formed UTF-8 sequence at c, 0 if there is none
+	int Utf8Length(const unsigned char* c)
+	{
+		int n(0);
+		if( c[0] >= 0xc2 && c[0] <= 0xdf )		n = 2;
+		else if( c[0] >= 0xe0 && c[0] <= 0xef )	n = 3;
+		else if( c[0] >= 0xf0 && c[0] <= 0xf4 )	n = 4;
+		else return 0;
+		for( int k = 1; k < n; k++ )
+		{
+			if( (c[k] & 0xc0) != 0x80 ) return 0;
+		}
+		// overlong forms, surrogates and code points past U+10FFFF
+		if( (c[0] == 0xe0 && c[1] < 0xa0) || (c[0] == 0xed && c[1] >= 0xa0) ||
+			(c[0] == 0xf0 && c[1] < 0x90) || (c[0] == 0xf4 && c[1] >= 0x90) ) return 0;
+		return n;
+	}
+
+#ifdef _WIN32
+	// file names come in the ANSI code page (GBK on Chinese systems)
+	string ToUtf8(const char* text)
+	{
+		int wide = MultiByteToWideChar(CP_ACP, 0, text, -1, NULL, 0);
+		if( wide <= 1 ) return string(text);
+		vector<wchar_t> w(wide);
+		MultiByteToWideChar(CP_ACP, 0, text, -1, &w[0], wide);
+		int bytes = WideCharToMultiByte(CP_UTF8, 0, &w[0], -1, NULL, 0, NULL, NULL);
+		if( bytes <= 1 ) return string(text);
+		vector<char> u(bytes);
+		WideCharToMultiByte(CP_UTF8, 0, &w[0], -1, &u[0], bytes, NULL, NULL);
+		return string(&u[0]);
+	}
+#endif
+
+	// JSON strings must be UTF-8: on Windows the text is converted from the
+	// ANSI code page first, and any byte still not part of a well formed
+	// sequence is written as the code point of the same value
+	void WriteJsonString(FILE* out, const char* text)
+	{
+#ifdef _WIN32
+		const string utf8 = ToUtf8(text);
+		text = utf8.c_str();
+#endif
+		fputc('"', out);
+		for( const unsigned char* c = (const unsigned char*)text; *c; c++ )
+		{
+			int n = (*c >= 0x80) ? Utf8Length(c) : 1;
+			if( *c == '"' || *c == '\\' )	fprintf(out, "\\%c", *c);
+			else if( *c < 0x20 || 0 == n )	fprintf(out, "\\u%04x", *c);
+			else
+			{
+				fwrite(c, 1, size_t(n), out);
+				c += n - 1;
+			}
+		}
+		fputc('"', out);
+	}
+}
+
+atomic<bool> Trace::s_enabled(false);
+
+//===========================================================================
+///	Enable
+//===========================================================================
+void Trace::Enable(const bool& enable)
+{
+	if( enable )
+	{
+		lock_guard<mutex> lk(s_registryLock);
+		if( !s_hooked )
+		{
+			msImageProcessor::SetKernelHook(&TraceKernel);
+			s_hooked = true;
+		}
+	}
+	s_enabled.store(enable);
+}
+
+//===========================================================================
+///	Clear
+//===========================================================================
+void Trace::Clear()
+{
+	lock_guard<mutex> lk(s_registryLock);
+	for( size_t b = 0; b < s_buffers.size(); b++ )
+	{
+		lock_guard<mutex> blk(s_buffers[b]->lock);
+		s_buffers[b]->records.clear();
+	}
+}
+
+//===========================================================================
+///	SetThreadName
+//===========================================================================
+void Trace::SetThreadName(const string& name)
+{
+	if( !IsEnabled() ) return;
+	TraceBuffer* buffer = ThreadBuffer();
+	lock_guard<mutex> lk(buffer->lock);
+	buffer->threadName = name;
+}
+
+//===========================================================================
+///	Now
+//===========================================================================
+double Trace::Now()
+{
+	return chrono::duration<double, micro>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//===========================================================================
+///	Record
+//===========================================================================
+void Trace::Record(
+	const char*						name,
+	const char*						category,
+	const double&					start,
+	const double&					end,
+	const char*						argName,
+	const int64_t&					argValue,
+	const string&					detail)
+{
+	TraceBuffer* buffer = ThreadBuffer();
+	TraceRecord r;
+	r.name		= name;
+	r.category	= category;
+	r.start		= start;
+	r.duration	= end > start ? end - start : 0;
+	r.argName	= argName;
+	r.argValue	= argValue;
+	r.detail	= detail;
+
+	lock_guard<mutex> lk(buffer->lock);
+	buffer->records.push_back(r);
+}
+
+//===========================================================================
+///	GetSpanCount
+//===========================================================================
+size_t Trace::GetSpanCount()
+{
+	size_t count(0);
+	lock_guard<mutex> lk(s_registryLock);
+	for( size_t b = 0; b < s_buffers.size(); b++ )
+	{
+		lock_guard<mutex> blk(s_buffers[b]->lock);
+		count += s_buffers[b]->records.size();
+	}
+	return count;
+}
+
+//===========================================================================
+///	WriteChromeJson
+///
+/// Complete ("X") events, one per span, with the times relative to the
+/// first span, and a thread_name metadata event per named thread.
+//===========================================================================
+bool Trace::WriteChromeJson(const string& path)
+{
+	FILE* out = fopen(path.c_str(), "w");
+	if( NULL == out ) return false;
+
+	lock_guard<mutex> lk(s_registryLock);
+	double origin(-1);
+	for( size_t b = 0; b < s_buffers.size(); b++ )
+	{
+		lock_guard<mutex> blk(s_buffers[b]->lock);
+		const vector<TraceRecord>& records = s_buffers[b]->records;
+		for( size_t i = 0; i < records.size(); i++ )
+		{
+			if( origin < 0 || records[i].start < origin ) origin = records[i].start;
+		}
+	}
+	if( origin < 0 ) origin = 0;
+
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"SalientRegionDetector\"}}");
+	for( size_t b = 0; b < s_buffers.size(); b++ )
+	{
+		TraceBuffer* buffer = s_buffers[b];
+		lock_guard<mutex> blk(buffer->lock);
+		if( !buffer->threadName.empty() )
+		{
+			fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", buffer->tid);
+			WriteJsonString(out, buffer->threadName.c_str());
+			fprintf(out, "}}");
+		}
+		for( size_t i = 0; i < buffer->records.size(); i++ )
+		{
+			const TraceRecord& r = buffer->records[i];
+			fprintf(out, ",\n{\"name\":");
+			WriteJsonString(out, r.name);
+			fprintf(out, ",\"cat\":");
+			WriteJsonString(out, r.category);
+			fprintf(out, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d",
+				r.start - origin, r.duration, buffer->tid);
+			if( r.argName || !r.detail.empty() )
+			{
+				fprintf(out, ",\"args\":{");
+				if( r.argName )
+				{
+					WriteJsonString(out, r.argName);
+					fprintf(out, ":%lld", (long long)r.argValue);
+				}
+				if( !r.detail.empty() )
+				{
+					fprintf(out, "%s\"detail\":", r.argName ? "," : "");
+					WriteJsonString(out, r.detail.c_str());
+				}
+				fprintf(out, "}");
+			}
+			fprintf(out, "}");
+		}
+	}
+	fprintf(out, "\n]}\n");
+	return 0 == fclose(out);
+}
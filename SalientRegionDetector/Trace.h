@@ -0,0 +1,117 @@
+// Trace.h: interface for the Trace spans.
+//
+//////////////////////////////////////////////////////////////////////
+//===========================================================================
+// Scoped spans that record where the time of a run goes, stage by stage
+// and thread by thread, exported in the Chrome trace_event JSON format so
+// that a run, parallel ones included, can be inspected in a trace viewer
+// (chrome://tracing, Perfetto).
+//
+//   TRACE_SCOPE("lab");					// until the end of the block
+//   TRACE_SCOPE("blur", "saliency");		// with a category
+//   TRACE_SPAN(span, "encode");			// named, to attach arguments
+//   span.SetDetail(path);
+//
+// Tracing is off until Trace::Enable(true). A span then costs one relaxed
+// load of the enabled flag when off, and two clock reads and an append to
+// a buffer of the calling thread when on; the buffers are only merged by
+// WriteChromeJson(). Span names and categories must be string literals
+// (they are kept as pointers); a per-span detail string is copied. With
+// SRD_NO_TRACE defined the macros compile to nothing.
+//
+// The mean shift kernels are traced through msImageProcessor's kernel
+// hook, installed by Enable(), so each filter, Connect, BuildRAM, closure
+// iteration and Prune call is a span of its own.
+//===========================================================================
+
+#if !defined(_TRACE_H_INCLUDED_)
+#define _TRACE_H_INCLUDED_
+
+#include <string>
+#include <atomic>
+#include <stdint.h>
+using namespace std;
+
+class Trace
+{
+public:
+	static void Enable(const bool& enable);
+	static bool IsEnabled() { return s_enabled.load(memory_order_relaxed); }
+
+	// Drops the spans recorded so far.
+	static void Clear();
+
+	// Names the calling thread in the trace ("writer 1"); shown by the viewer
+	// instead of its number. Ignored while tracing is off.
+	static void SetThreadName(const string& name);
+
+	// Microseconds from a steady clock, the time base of the spans.
+	static double Now();
+
+	// Adds a finished span of the calling thread. argName, if not NULL, is a
+	// string literal naming argValue; detail, if not empty, is shown as well.
+	static void Record(
+		const char*						name,
+		const char*						category,
+		const double&					start,
+		const double&					end,
+		const char*						argName = NULL,
+		const int64_t&					argValue = 0,
+		const string&					detail = string());
+
+	// Writes every span recorded so far; false if the file cannot be written.
+	// Call it once the traced threads are idle.
+	static bool WriteChromeJson(const string& path);
+
+	// Number of spans recorded so far.
+	static size_t GetSpanCount();
+
+private:
+	static atomic<bool>					s_enabled;
+};
+
+//---------------------------------------------------------------------------
+// Records one span from its construction to its destruction, if tracing
+// was enabled when it was constructed.
+//---------------------------------------------------------------------------
+class TraceSpan
+{
+public:
+	TraceSpan(const char* name, const char* category = "pipeline")
+		: m_name(name), m_category(category), m_start(Trace::IsEnabled() ? Trace::Now() : -1),
+		  m_argName(NULL), m_argValue(0) {}
+	~TraceSpan()
+	{
+		if( m_start >= 0 ) Trace::Record(m_name, m_category, m_start, Trace::Now(), m_argName, m_argValue, m_detail);
+	}
+
+	bool IsRecording() const { return m_start >= 0; }
+	void SetArg(const char* name, const int64_t& value) { m_argName = name; m_argValue = value; }
+	void SetDetail(const string& detail) { if( m_start >= 0 ) m_detail = detail; }
+
+private:
+	TraceSpan(const TraceSpan&);
+	TraceSpan& operator=(const TraceSpan&);
+
+	const char*							m_name;
+	const char*							m_category;
+	double								m_start;
+	const char*							m_argName;
+	int64_t								m_argValue;
+	string								m_detail;
+};
+
+#define TRACE_CONCAT_(a, b)		a##b
+#define TRACE_CONCAT(a, b)		TRACE_CONCAT_(a, b)
+
+// the arguments are those of TraceSpan: a name and optionally a category
+#if defined(SRD_NO_TRACE)
+#define TRACE_SCOPE(...)		((void)0)
+#define TRACE_SPAN(var, ...)	struct TRACE_CONCAT(TraceOff, __LINE__) { void SetArg(const char*, const int64_t&) {} \
+									void SetDetail(const string&) {} } var
+#else
+#define TRACE_SCOPE(...)		TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(__VA_ARGS__)
+#define TRACE_SPAN(var, ...)	TraceSpan var(__VA_ARGS__)
+#endif
+
+#endif // !defined(_TRACE_H_INCLUDED_)